@@ -0,0 +1,14 @@
+// microbenchmark of the native key comparators, run with: node benchmark/compare.js
+import { nativeAddon } from '../native.js';
+let { benchmarkCompare } = nativeAddon;
+const implementations = ['scalar', 'sse2', 'avx2'];
+const iterations = 10000000;
+benchmarkCompare(0, 32, 31, iterations); // warm up
+for (let keySize of [8, 16, 32, 64, 128, 256, 1024]) {
+	let results = implementations.map((name, implementation) => {
+		// keys that differ in the last byte, so the whole key is compared
+		let nanoseconds = benchmarkCompare(implementation, keySize, keySize - 1, iterations);
+		return name + ': ' + (nanoseconds < 0 ? 'not supported' : nanoseconds.toFixed(2) + 'ns');
+	});
+	console.log('key size ' + keySize + ' - ' + results.join(', '));
+}
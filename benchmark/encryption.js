@@ -0,0 +1,49 @@
+'use strict';
+// Compares read throughput of unencrypted and encrypted (chacha8, chacha20) databases. Each round reopens the
+// database, so the pages are not in the page cache and every page that is read is decrypted.
+var testDirPath = new URL('./benchdata-encryption', import.meta.url).toString().slice(8);
+import fs from 'fs';
+import { open } from '../index.js';
+
+var total = 50000;
+var rounds = 5;
+let value = 'hello world!';
+for (let i = 0; i < 6; i++) {
+  value += value;
+}
+const key = 'Use this key to encrypt the data';
+const configurations = {
+  plaintext: {},
+  chacha8: { encryptionKey: key },
+  chacha20: { encryptionKey: key, encryptionCipher: 'chacha20' },
+};
+
+async function run(name, options) {
+  let path = testDirPath + '-' + name + '.mdb';
+  fs.rmSync(path, { force: true });
+  fs.rmSync(path + '-lock', { force: true });
+  let store = open(path, Object.assign({ encoding: 'string' }, options));
+  await store.transaction(() => {
+    for (let i = 0; i < total; i++) store.put(i, value);
+  });
+  await store.close();
+  let bytes = fs.statSync(path).size;
+  let best = Infinity;
+  for (let r = 0; r < rounds; r++) {
+    store = open(path, Object.assign({ encoding: 'string' }, options));
+    let start = process.hrtime.bigint();
+    let count = 0;
+    for (let { value } of store.getRange()) count += value.length;
+    let elapsed = Number(process.hrtime.bigint() - start) / 1e9;
+    if (count !== total * value.length) throw new Error('Unexpected read size ' + count);
+    best = Math.min(best, elapsed);
+    await store.close();
+  }
+  console.log(name + ': ' + (bytes / best / 1e6).toFixed(0) + ' MB/s (' + (best * 1000).toFixed(1) + 'ms to read ' + (bytes / 1e6).toFixed(1) + 'MB)');
+  fs.rmSync(path, { force: true });
+  fs.rmSync(path + '-lock', { force: true });
+}
+
+for (let name in configurations) {
+  await run(name, configurations[name]);
+}
@@ -34,6 +34,7 @@
         "src/lmdb-js.cpp",
         "dependencies/lmdb/libraries/liblmdb/midl.c",
         "dependencies/lmdb/libraries/liblmdb/chacha8.c",
+        "dependencies/lmdb/libraries/liblmdb/crc32c.c",
         "dependencies/lz4/lib/lz4.h",
         "dependencies/lz4/lib/lz4.c",
         "src/writer.cpp",
@@ -44,6 +45,17 @@
         "src/txn.cpp",
         "src/dbi.cpp",
         "src/cursor.cpp",
+        "src/bulk-load.cpp",
+        "src/merge.cpp",
+        "src/backup.cpp",
+        "src/value-cache.cpp",
+        "src/key-filter.cpp",
+        "src/warm.cpp",
+        "src/access-profile.cpp",
+        "src/projection.cpp",
+        "src/export-range.cpp",
+        "src/histogram.cpp",
+        "src/notify.cpp",
         "src/v8-functions.cpp"
       ],
       "include_dirs": [
@@ -158,6 +158,22 @@ export const CachingStore = (Store, env) => {
 		this.cache.delete(id);
 		return super.removeSync(id, ifVersion);
 	}
+	addToValue(id, delta, version) {
+		this.cache.delete(id);
+		return super.addToValue(id, delta, version);
+	}
+	compareAndSwap(id, expectedValue, value, version) {
+		this.cache.delete(id);
+		return super.compareAndSwap(id, expectedValue, value, version);
+	}
+	merge(id, operator, operand, options) {
+		this.cache.delete(id);
+		return super.merge(id, operator, operand, options);
+	}
+	appendToValue(id, value, version) {
+		this.cache.delete(id);
+		return super.appendToValue(id, value, version);
+	}
 	clearAsync(callback) {
 		this.cache.clear();
 		return super.clearAsync(callback);
@@ -166,6 +182,12 @@ export const CachingStore = (Store, env) => {
 		this.cache.clear();
 		super.clearSync();
 	}
+	bulkLoad(entries, options) {
+		return super.bulkLoad(entries, options).then((count) => {
+			this.cache.clear();
+			return count;
+		});
+	}
 	childTransaction(callback) {
 		return super.childTransaction(() => {
 			let cache = this.cache;
@@ -9,6 +9,26 @@ Public domain.
 //#include <sys/param.h>
 
 #include "chacha8.h"
+
+/*
+ * On x86-64 the keystream is also generated for 4 (SSE2) or 8 (AVX2) blocks at a
+ * time, with each vector lane computing a separate block, and AVX2 is selected at
+ * runtime. The output is identical to the scalar implementation.
+ */
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHACHA_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define CHACHA_AVX2
+#define CHACHA_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER)
+#define CHACHA_AVX2
+#define CHACHA_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
 #if 0
 #include "common/int-util.h"
 #include "warnings.h"
@@ -53,7 +73,7 @@ static uint32_t rol32(uint32_t x, int r) {
 	return (x << (r & 31)) | (x >> (-r & 31));
 }
 
-void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher) {
+static void chacha_scalar(const void* data, size_t length, const uint32_t* state, int rounds, char* cipher) {
   uint32_t x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
   uint32_t j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
   char* ctarget = 0;
@@ -62,22 +82,22 @@ void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t*
 
   if (!length) return;
 
-  j0  = U8TO32_LITTLE(sigma + 0);
-  j1  = U8TO32_LITTLE(sigma + 4);
-  j2  = U8TO32_LITTLE(sigma + 8);
-  j3  = U8TO32_LITTLE(sigma + 12);
-  j4  = U8TO32_LITTLE(key + 0);
-  j5  = U8TO32_LITTLE(key + 4);
-  j6  = U8TO32_LITTLE(key + 8);
-  j7  = U8TO32_LITTLE(key + 12);
-  j8  = U8TO32_LITTLE(key + 16);
-  j9  = U8TO32_LITTLE(key + 20);
-  j10 = U8TO32_LITTLE(key + 24);
-  j11 = U8TO32_LITTLE(key + 28);
-  j12 = 0;
-  j13 = 0;
-  j14 = U8TO32_LITTLE(iv + 0);
-  j15 = U8TO32_LITTLE(iv + 4);
+  j0  = state[0];
+  j1  = state[1];
+  j2  = state[2];
+  j3  = state[3];
+  j4  = state[4];
+  j5  = state[5];
+  j6  = state[6];
+  j7  = state[7];
+  j8  = state[8];
+  j9  = state[9];
+  j10 = state[10];
+  j11 = state[11];
+  j12 = state[12];
+  j13 = state[13];
+  j14 = state[14];
+  j15 = state[15];
 
   for (;;) {
     if (length < 64) {
@@ -102,7 +122,7 @@ void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t*
     x13 = j13;
     x14 = j14;
     x15 = j15;
-    for (i = 8;i > 0;i -= 2) {
+    for (i = rounds;i > 0;i -= 2) {
       QUARTERROUND( x0, x4, x8,x12)
       QUARTERROUND( x1, x5, x9,x13)
       QUARTERROUND( x2, x6,x10,x14)
@@ -181,3 +201,191 @@ void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t*
     data = (uint8_t*)data + 64;
   }
 }
+
+#ifdef CHACHA_SSE2
+#define ROTATE128(v,c) _mm_or_si128(_mm_slli_epi32(v, c), _mm_srli_epi32(v, 32 - (c)))
+#define QUARTERROUND128(a,b,c,d) \
+  a = _mm_add_epi32(a,b); d = ROTATE128(_mm_xor_si128(d,a),16); \
+  c = _mm_add_epi32(c,d); b = ROTATE128(_mm_xor_si128(b,c),12); \
+  a = _mm_add_epi32(a,b); d = ROTATE128(_mm_xor_si128(d,a), 8); \
+  c = _mm_add_epi32(c,d); b = ROTATE128(_mm_xor_si128(b,c), 7);
+
+/* transpose four words of four blocks, and xor them into the output at 64 byte intervals */
+static void chacha_store128(__m128i a, __m128i b, __m128i c, __m128i d, const uint8_t* data, uint8_t* cipher) {
+  __m128i t0 = _mm_unpacklo_epi32(a, b);
+  __m128i t1 = _mm_unpacklo_epi32(c, d);
+  __m128i t2 = _mm_unpackhi_epi32(a, b);
+  __m128i t3 = _mm_unpackhi_epi32(c, d);
+  _mm_storeu_si128((__m128i*)(cipher +   0), _mm_xor_si128(_mm_unpacklo_epi64(t0, t1), _mm_loadu_si128((const __m128i*)(data +   0))));
+  _mm_storeu_si128((__m128i*)(cipher +  64), _mm_xor_si128(_mm_unpackhi_epi64(t0, t1), _mm_loadu_si128((const __m128i*)(data +  64))));
+  _mm_storeu_si128((__m128i*)(cipher + 128), _mm_xor_si128(_mm_unpacklo_epi64(t2, t3), _mm_loadu_si128((const __m128i*)(data + 128))));
+  _mm_storeu_si128((__m128i*)(cipher + 192), _mm_xor_si128(_mm_unpackhi_epi64(t2, t3), _mm_loadu_si128((const __m128i*)(data + 192))));
+}
+
+/* encrypt 4 blocks (256 bytes), and advance the counter */
+static void chacha_sse2(const uint8_t* data, uint32_t* state, int rounds, uint8_t* cipher) {
+  __m128i x[16], j[16];
+  uint32_t counter[8];
+  int i;
+  for (i = 0; i < 16; i++)
+    j[i] = _mm_set1_epi32((int) state[i]);
+  for (i = 0; i < 4; i++) {
+    counter[i] = state[12] + i;
+    counter[i + 4] = state[13] + (counter[i] < state[12]);
+  }
+  j[12] = _mm_loadu_si128((const __m128i*) counter);
+  j[13] = _mm_loadu_si128((const __m128i*) (counter + 4));
+  for (i = 0; i < 16; i++)
+    x[i] = j[i];
+  for (i = rounds; i > 0; i -= 2) {
+    QUARTERROUND128(x[0], x[4], x[8], x[12])
+    QUARTERROUND128(x[1], x[5], x[9], x[13])
+    QUARTERROUND128(x[2], x[6], x[10], x[14])
+    QUARTERROUND128(x[3], x[7], x[11], x[15])
+    QUARTERROUND128(x[0], x[5], x[10], x[15])
+    QUARTERROUND128(x[1], x[6], x[11], x[12])
+    QUARTERROUND128(x[2], x[7], x[8], x[13])
+    QUARTERROUND128(x[3], x[4], x[9], x[14])
+  }
+  for (i = 0; i < 16; i++)
+    x[i] = _mm_add_epi32(x[i], j[i]);
+  for (i = 0; i < 4; i++)
+    chacha_store128(x[i * 4], x[i * 4 + 1], x[i * 4 + 2], x[i * 4 + 3], data + i * 16, cipher + i * 16);
+  state[12] += 4;
+  if (state[12] < 4)
+    state[13]++;
+}
+#endif
+
+#ifdef CHACHA_AVX2
+#define ROTATE256(v,c) _mm256_or_si256(_mm256_slli_epi32(v, c), _mm256_srli_epi32(v, 32 - (c)))
+#define QUARTERROUND256(a,b,c,d) \
+  a = _mm256_add_epi32(a,b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d,a), rot16); \
+  c = _mm256_add_epi32(c,d); b = ROTATE256(_mm256_xor_si256(b,c),12); \
+  a = _mm256_add_epi32(a,b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d,a), rot8); \
+  c = _mm256_add_epi32(c,d); b = ROTATE256(_mm256_xor_si256(b,c), 7);
+
+/* encrypt 8 blocks (512 bytes), and advance the counter */
+CHACHA_TARGET_AVX2
+static void chacha_avx2(const uint8_t* data, uint32_t* state, int rounds, uint8_t* cipher) {
+  __m256i x[16], j[16], g[4];
+  __m256i rot16 = _mm256_setr_epi8(2,3,0,1, 6,7,4,5, 10,11,8,9, 14,15,12,13, 2,3,0,1, 6,7,4,5, 10,11,8,9, 14,15,12,13);
+  __m256i rot8 = _mm256_setr_epi8(3,0,1,2, 7,4,5,6, 11,8,9,10, 15,12,13,14, 3,0,1,2, 7,4,5,6, 11,8,9,10, 15,12,13,14);
+  uint32_t counter[16];
+  int i, k;
+  for (i = 0; i < 16; i++)
+    j[i] = _mm256_set1_epi32((int) state[i]);
+  for (i = 0; i < 8; i++) {
+    counter[i] = state[12] + i;
+    counter[i + 8] = state[13] + (counter[i] < state[12]);
+  }
+  j[12] = _mm256_loadu_si256((const __m256i*) counter);
+  j[13] = _mm256_loadu_si256((const __m256i*) (counter + 8));
+  for (i = 0; i < 16; i++)
+    x[i] = j[i];
+  for (i = rounds; i > 0; i -= 2) {
+    QUARTERROUND256(x[0], x[4], x[8], x[12])
+    QUARTERROUND256(x[1], x[5], x[9], x[13])
+    QUARTERROUND256(x[2], x[6], x[10], x[14])
+    QUARTERROUND256(x[3], x[7], x[11], x[15])
+    QUARTERROUND256(x[0], x[5], x[10], x[15])
+    QUARTERROUND256(x[1], x[6], x[11], x[12])
+    QUARTERROUND256(x[2], x[7], x[8], x[13])
+    QUARTERROUND256(x[3], x[4], x[9], x[14])
+  }
+  for (i = 0; i < 16; i++)
+    x[i] = _mm256_add_epi32(x[i], j[i]);
+  /* transpose within each 128-bit lane, so x[4 * g + k] holds words 4g..4g+3 of block k (low) and k + 4 (high) */
+  for (i = 0; i < 16; i += 4) {
+    __m256i t0 = _mm256_unpacklo_epi32(x[i], x[i + 1]);
+    __m256i t1 = _mm256_unpacklo_epi32(x[i + 2], x[i + 3]);
+    __m256i t2 = _mm256_unpackhi_epi32(x[i], x[i + 1]);
+    __m256i t3 = _mm256_unpackhi_epi32(x[i + 2], x[i + 3]);
+    x[i] = _mm256_unpacklo_epi64(t0, t1);
+    x[i + 1] = _mm256_unpackhi_epi64(t0, t1);
+    x[i + 2] = _mm256_unpacklo_epi64(t2, t3);
+    x[i + 3] = _mm256_unpackhi_epi64(t2, t3);
+  }
+  for (k = 0; k < 4; k++) {
+    g[0] = _mm256_permute2x128_si256(x[k], x[4 + k], 0x20);
+    g[1] = _mm256_permute2x128_si256(x[8 + k], x[12 + k], 0x20);
+    g[2] = _mm256_permute2x128_si256(x[k], x[4 + k], 0x31);
+    g[3] = _mm256_permute2x128_si256(x[8 + k], x[12 + k], 0x31);
+    for (i = 0; i < 4; i++) {
+      size_t offset = (i < 2 ? k * 64 : (k + 4) * 64) + (i & 1) * 32;
+      _mm256_storeu_si256((__m256i*)(cipher + offset),
+        _mm256_xor_si256(g[i], _mm256_loadu_si256((const __m256i*)(data + offset))));
+    }
+  }
+  state[12] += 8;
+  if (state[12] < 8)
+    state[13]++;
+}
+
+static int chacha_has_avx2(void) {
+  static int hasAvx2 = -1;
+  if (hasAvx2 < 0) {
+#ifdef _MSC_VER
+    int info[4];
+    hasAvx2 = 0;
+    __cpuid(info, 1);
+    /* OSXSAVE and AVX, and the OS saves the ymm registers */
+    if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6) {
+      __cpuidex(info, 7, 0);
+      hasAvx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    hasAvx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+  }
+  return hasAvx2;
+}
+#endif
+
+static void chacha(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher, int rounds) {
+  uint32_t state[16];
+  state[0]  = U8TO32_LITTLE(sigma + 0);
+  state[1]  = U8TO32_LITTLE(sigma + 4);
+  state[2]  = U8TO32_LITTLE(sigma + 8);
+  state[3]  = U8TO32_LITTLE(sigma + 12);
+  state[4]  = U8TO32_LITTLE(key + 0);
+  state[5]  = U8TO32_LITTLE(key + 4);
+  state[6]  = U8TO32_LITTLE(key + 8);
+  state[7]  = U8TO32_LITTLE(key + 12);
+  state[8]  = U8TO32_LITTLE(key + 16);
+  state[9]  = U8TO32_LITTLE(key + 20);
+  state[10] = U8TO32_LITTLE(key + 24);
+  state[11] = U8TO32_LITTLE(key + 28);
+  state[12] = 0;
+  state[13] = 0;
+  state[14] = U8TO32_LITTLE(iv + 0);
+  state[15] = U8TO32_LITTLE(iv + 4);
+#ifdef CHACHA_AVX2
+  if (length >= 512 && chacha_has_avx2()) {
+    do {
+      chacha_avx2((const uint8_t*) data, state, rounds, (uint8_t*) cipher);
+      data = (const uint8_t*) data + 512;
+      cipher += 512;
+      length -= 512;
+    } while (length >= 512);
+  }
+#endif
+#ifdef CHACHA_SSE2
+  while (length >= 256) {
+    chacha_sse2((const uint8_t*) data, state, rounds, (uint8_t*) cipher);
+    data = (const uint8_t*) data + 256;
+    cipher += 256;
+    length -= 256;
+  }
+#endif
+  chacha_scalar(data, length, state, rounds, cipher);
+}
+
+void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher) {
+  chacha(data, length, key, iv, cipher, 8);
+}
+
+void chacha20(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher) {
+  chacha(data, length, key, iv, cipher, 20);
+}
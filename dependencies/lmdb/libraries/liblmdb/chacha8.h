@@ -4,6 +4,8 @@
 extern "C" {
 #endif
 void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher);
+/* the same cipher with 20 rounds, the two are not compatible */
+void chacha20(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher);
 
 #define CHACHA8_KEY_SIZE 32
 #define CHACHA8_IV_SIZE 8
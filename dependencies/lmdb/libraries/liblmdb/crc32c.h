@@ -0,0 +1,13 @@
+#include <stdint.h>
+#include <stddef.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* update a CRC32C (Castagnoli) checksum with data, starting from 0 */
+uint32_t crc32c(uint32_t crc, const void* data, size_t length);
+
+#define CRC32C_SIZE 4
+
+#ifdef __cplusplus
+}
+#endif
@@ -555,6 +555,9 @@ typedef struct MDB_metrics {
 	uint64_t time_start_txns;
 	uint64_t time_page_flushes;
 	uint64_t time_sync;
+	uint64_t checksums_verified;	/**< pages (or overflow page runs) with a verified checksum */
+	uint64_t checksum_failures;
+	uint64_t time_checksums;	/**< time spent verifying checksums */
 } MDB_metrics;
 
 /** @brief Statistics for a database in the environment */
@@ -816,6 +819,60 @@ int  mdb_env_copy2(MDB_env *env, const char *path, unsigned int flags);
 	 */
 int  mdb_env_copyfd2(MDB_env *env, mdb_filehandle_t fd, unsigned int flags);
 
+	/** @brief Copy the pages of an LMDB environment that changed after a txn.
+	 *
+	 * This may be used to make incremental backups. It writes the meta
+	 * pages and every page of the current snapshot (including the freelist)
+	 * with a txnid greater than \b since, to a new file, which can be applied
+	 * to a copy of the \b since txn with #mdb_env_apply_incremental().
+	 * A \b since of 0 copies all the pages in use.
+	 * The copy must be applied to a copy that was made without compaction.
+	 * @param[in] env An environment handle returned by #mdb_env_create(). It
+	 * must have already been opened successfully.
+	 * @param[in] path The file to write the copy to. It must not exist.
+	 * @param[in] since The txnid of the copy this is relative to.
+	 * @param[out] txnid The txnid of the snapshot that was copied.
+	 * @param[out] pages The number of pages that were copied.
+	 * @return A non-zero error value on failure and 0 on success. Returns
+	 * #MDB_INCOMPATIBLE if the environment is remapped in chunks.
+	 */
+int  mdb_env_copy_incremental(MDB_env *env, const char *path, mdb_size_t since,
+	mdb_size_t *txnid, mdb_size_t *pages);
+
+	/** @brief Apply a copy from #mdb_env_copy_incremental() to a data file.
+	 *
+	 * The data file must not be open. A full copy (since 0) is applied to
+	 * a new file, and otherwise the latest txn of the data file must be the
+	 * txn the copy is relative to.
+	 * @param[in] path The data file to apply the copy to.
+	 * @param[in] incpath The file of the incremental copy.
+	 * @param[out] txnid The txnid of the data file after applying the copy.
+	 * @return A non-zero error value on failure and 0 on success. Returns
+	 * #MDB_INCOMPATIBLE if the data file is not at the txn the copy is
+	 * relative to.
+	 */
+int  mdb_env_apply_incremental(const char *path, const char *incpath, mdb_size_t *txnid);
+#define MDB_INCREMENTAL_COPY	1
+
+	/** @brief Compact an LMDB environment in a write transaction.
+	 *
+	 * This moves up to \b max pages from the end of the file to free pages
+	 * before them, and removes free pages at the end of the file from the
+	 * database. The file itself is not truncated: that is left to the caller,
+	 * once the transaction is committed and synced. Pages that are moved
+	 * are freed when the transaction commits, and can be removed by a later
+	 * step once no reader is using an older snapshot, so this is called
+	 * repeatedly, in separate transactions, until nothing is moved or removed.
+	 * @param[in] txn A top-level write transaction.
+	 * @param[in] max The maximum number of pages to move.
+	 * @param[out] moved The number of pages that were moved.
+	 * @param[out] trimmed The number of pages that were removed from the end of the file.
+	 * @return A non-zero error value on failure and 0 on success. Returns
+	 * #MDB_INCOMPATIBLE if the environment is remapped in chunks.
+	 */
+int  mdb_env_compact_step(MDB_txn *txn, mdb_size_t max, mdb_size_t *moved, mdb_size_t *trimmed);
+#define MDB_COMPACT_STEP	1
+
 	/** @brief Return statistics about the LMDB environment.
 	 *
 	 * @param[in] env An environment handle returned by #mdb_env_create()
@@ -832,6 +889,18 @@ int  mdb_env_stat(MDB_env *env, MDB_stat *stat);
 	 */
 int  mdb_env_info(MDB_env *env, MDB_envinfo *stat);
 
+	/** @brief Return the address of the ID of the last committed transaction.
+	 *
+	 * This is in the shared lock region, so it can be read (without locking)
+	 * by any thread or process to check if a newer snapshot is available,
+	 * without renewing a read transaction.
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @return The address, or NULL if the environment has no lock region
+	 * (opened with #MDB_NOLOCK).
+	 */
+volatile mdb_size_t *mdb_env_last_txnid_address(MDB_env *env);
+#define MDB_LAST_TXNID_ADDRESS	1
+
 	/** @brief Flush the data buffers to disk.
 	 *
 	 * Data is always written to disk when #mdb_txn_commit() is called,
@@ -1088,6 +1157,42 @@ int mdb_env_set_encrypt(MDB_env *env, MDB_enc_func *func, const MDB_val *key, un
 	 * @return A non-zero error value on failure and 0 on success.
 	 */
 int mdb_env_set_checksum(MDB_env *env, MDB_sum_func *func, unsigned int size);
+
+	/** @brief Set the size of the caches of mapped chunks used with #MDB_REMAP_CHUNKS.
+	 *
+	 * This must be called before #mdb_env_open().
+	 * Each chunk maps 16 pages, and when encryption is in use, also holds
+	 * the decrypted copies of its pages.
+	 * @param[in] env An environment handle returned by #mdb_env_create().
+	 * @param[in] env_chunks The number of chunks kept mapped by the environment,
+	 * shared by all transactions. Unreferenced chunks are unmapped when there
+	 * are more than this. Zero for the default of 16384.
+	 * @param[in] txn_chunks The number of chunks a transaction can reference,
+	 * zero for the default of 4096. The minimum is 256.
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int mdb_env_set_rpage_cache(MDB_env *env, unsigned int env_chunks, unsigned int txn_chunks);
+
+/** @brief Statistics for the caches of mapped chunks */
+typedef struct MDB_rpage_stat {
+	mdb_size_t	ms_hits;		/**< chunks found already mapped */
+	mdb_size_t	ms_misses;		/**< chunks that had to be mapped */
+	mdb_size_t	ms_evictions;	/**< chunks unmapped to make room */
+	mdb_size_t	ms_decrypts;	/**< pages decrypted */
+	mdb_size_t	ms_chunks;		/**< chunks currently mapped by the environment */
+	mdb_size_t	ms_mapped;		/**< bytes currently mapped by the environment */
+	unsigned int	ms_env_chunks;	/**< size of the environment cache */
+	unsigned int	ms_txn_chunks;	/**< size of each transaction's cache */
+} MDB_rpage_stat;
+
+	/** @brief Return statistics about the caches of mapped chunks.
+	 *
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[out] stat The address of an #MDB_rpage_stat structure
+	 * @return A non-zero error value on failure and 0 on success. Returns
+	 * EINVAL if the environment is not open with #MDB_REMAP_CHUNKS.
+	 */
+int mdb_env_rpage_stat(MDB_env *env, MDB_rpage_stat *stat);
 #endif
 
 	/** @brief Create a transaction for use with the environment.
@@ -1311,6 +1416,16 @@ int  mdb_stat(MDB_txn *txn, MDB_dbi dbi, MDB_stat *stat);
 	 */
 int mdb_dbi_flags(MDB_txn *txn, MDB_dbi dbi, unsigned int *flags);
 
+	/** @brief Check whether a database has been written in a write transaction.
+	 *
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] dbi A database handle returned by #mdb_dbi_open()
+	 * @return 0 if the database was written in this transaction (or a parent
+	 * transaction), #MDB_NOTFOUND if it was not, or EINVAL for an invalid handle.
+	 */
+int mdb_dbi_dirty(MDB_txn *txn, MDB_dbi dbi);
+#define MDB_DBI_DIRTY	1
+
 	/** @brief Close a database handle. Normally unnecessary. Use with care:
 	 *
 	 * This call is not mutex protected. Handles should only be closed by
@@ -1361,6 +1476,21 @@ int  mdb_drop(MDB_txn *txn, MDB_dbi dbi, int del);
 	 */
 int  mdb_set_compare(MDB_txn *txn, MDB_dbi dbi, MDB_cmp_func *cmp);
 
+	/** @brief Set a custom key comparison function that orders keys lexically.
+	 *
+	 * This is the same as #mdb_set_compare(), but declares that the comparison
+	 * function orders keys byte-wise, with shorter keys collating before longer
+	 * keys (like the default comparison). This allows searches within a page to
+	 * skip the prefix shared by the keys in the page, and compare the next 8 bytes
+	 * as integers, only calling the comparison function on ties.
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] dbi A database handle returned by #mdb_dbi_open()
+	 * @param[in] cmp A #MDB_cmp_func function
+	 * @return A non-zero error value on failure and 0 on success.
+	 */
+int  mdb_set_lexical_compare(MDB_txn *txn, MDB_dbi dbi, MDB_cmp_func *cmp);
+#define MDB_LEXICAL_COMPARE	1
+
 	/** @brief Set a custom data comparison function for a #MDB_DUPSORT database.
 	 *
 	 * This comparison function is called whenever it is necessary to compare a data
@@ -1450,6 +1580,27 @@ int  mdb_get_with_txn(MDB_txn *txn, MDB_dbi dbi, MDB_val *key, MDB_val *data, md
 
 int  mdb_get(MDB_txn *txn, MDB_dbi dbi, MDB_val *key, MDB_val *data);
 
+	/** @brief Get the txn id of the page that holds a value.
+	 *
+	 * A committed page is never modified, so a value returned by #mdb_get() or
+	 * #mdb_cursor_get() can be identified by its offset in the data file and the
+	 * txn id of its page, in any transaction that reads it from the same page
+	 * (even if the map has been moved since).
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] val A value returned by a get in this transaction
+	 * @param[out] txn_id The txn id of the page that holds the value
+	 * @param[out] offset The offset of the value in the data file
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_NOTFOUND - the value is not in the memory map, is in a page
+	 *	that this transaction can modify, or the map is remapped (MDB_REMAP_CHUNKS).
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_val_txnid(MDB_txn *txn, const MDB_val *val, mdb_size_t *txn_id, mdb_size_t *offset);
+#define MDB_VAL_TXNID	1
+
 	/** @brief Store items into a database.
 	 *
 	 * This function stores key/data pairs in the database. The default behavior
@@ -1762,6 +1913,71 @@ int	mdb_reader_list(MDB_env *env, MDB_msg_func *func, void *ctx);
 	 * @return 0 on success, non-zero on failure.
 	 */
 int	mdb_reader_check(MDB_env *env, int *dead);
+
+	/** @brief Count the entries in use in the reader lock table.
+	 *
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[out] used Number of slots owned by a process (including reset
+	 * read transactions that are keeping their slot)
+	 * @param[out] active Number of slots holding a snapshot
+	 * @return 0 on success, non-zero on failure.
+	 */
+int	mdb_reader_count(MDB_env *env, unsigned int *used, unsigned int *active);
+#define MDB_READER_COUNT	1
+
+	/** @brief A callback function for #mdb_txn_warm(), called with the name
+	 * of each database before it is read (NULL for the main database).
+	 * @return 1 to read all of the database's pages, 0 to read only the
+	 * top levels of its branch pages, or -1 to stop.
+	 */
+typedef int (MDB_warm_db_func)(const MDB_val *name, void *ctx);
+
+	/** @brief A callback function for #mdb_txn_warm(), called after each page
+	 * is read with the number of pages read so far.
+	 * @return 0 to continue, or a non-zero value to stop, which is returned
+	 * by #mdb_txn_warm().
+	 */
+typedef int (MDB_warm_func)(mdb_size_t pages, void *ctx);
+
+	/** @brief Read the pages of the trees of every database, so they are in the OS cache.
+	 *
+	 * This touches the top levels of branch pages of the main database and
+	 * of each named database, or all of the branch and leaf pages of the
+	 * databases selected by \b dbfunc (overflow pages are not read). It is
+	 * meant to be run in a background thread, in a read-only transaction.
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] levels The number of levels of branch pages to read
+	 * @param[in] dbfunc A #MDB_warm_db_func function
+	 * @param[in] func A #MDB_warm_func function, to report progress, throttle, or stop
+	 * @param[in] ctx Anything the functions need
+	 * @return 0 on success, the value returned by \b func if it stopped the
+	 * walk, or another non-zero error value on failure.
+	 */
+int	mdb_txn_warm(MDB_txn *txn, unsigned int levels, MDB_warm_db_func *dbfunc, MDB_warm_func *func, void *ctx);
+#define MDB_TXN_WARM	1
+
+	/** @brief A callback function for #mdb_dbi_boundaries(), called with each
+	 * separator key, in order. The key is only valid during the call.
+	 * @return 0 to continue, or a non-zero value to stop, which is returned
+	 * by #mdb_dbi_boundaries().
+	 */
+typedef int (MDB_boundary_func)(const MDB_val *key, void *ctx);
+
+	/** @brief Report the keys that separate the subtrees of a database.
+	 *
+	 * These are the keys of the top levels of branch pages, which split the
+	 * database into ranges of about the same number of pages, so it can be
+	 * read in parallel. A database with only a leaf page has no boundaries.
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] dbi A database handle returned by #mdb_dbi_open()
+	 * @param[in] levels The number of levels of branch pages to report the keys of
+	 * @param[in] func A #MDB_boundary_func function
+	 * @param[in] ctx Anything the function needs
+	 * @return 0 on success, the value returned by \b func if it stopped, or
+	 * another non-zero error value on failure.
+	 */
+int	mdb_dbi_boundaries(MDB_txn *txn, MDB_dbi dbi, unsigned int levels, MDB_boundary_func *func, void *ctx);
+#define MDB_DBI_BOUNDARIES	1
 /**	@} */
 
 /** @defgroup crypto LMDB Encryption Helper API
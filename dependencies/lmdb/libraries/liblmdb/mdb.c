@@ -1114,6 +1114,13 @@ typedef struct MDB_dovpage {
 	/** The number of overflow pages needed to store the given size. */
 #define OVPAGES(size, psize)	((PAGEHDRSZ-1 + (size)) / (psize) + 1)
 
+	/** The size of the checksum and authentication data at the end of each page */
+#if MDB_RPAGE_CACHE
+#define PAGETAIL(env)	((env)->me_sumsize + (env)->me_esumsize)
+#else
+#define PAGETAIL(env)	0
+#endif
+
 	/** Link in #MDB_txn.%mt_loose_pgs list.
 	 *  Kept outside the page header, which is needed when reusing the page.
 	 */
@@ -1344,6 +1351,7 @@ typedef struct MDB_dbx {
 	MDB_cmp_func	*md_dcmp;	/**< function for comparing data items */
 	MDB_rel_func	*md_rel;	/**< user relocate function */
 	void		*md_relctx;		/**< user-provided context for md_rel */
+	int		md_lexical;		/**< md_cmp orders keys lexically, like #mdb_cmp_memn */
 } MDB_dbx;
 
 	/** A database transaction.
@@ -1438,9 +1446,9 @@ struct MDB_txn {
 	 * reduce the frequency of mmap/munmap calls.
 	 */
 #define MDB_RPAGE_CHUNK	16
-#define MDB_TRPAGE_SIZE	4096	/**< size of #mt_rpages array of chunks */
-#define MDB_TRPAGE_MAX	(MDB_TRPAGE_SIZE-1)	/**< maximum chunk index */
+#define MDB_TRPAGE_SIZE	4096	/**< default size of #mt_rpages array of chunks */
 	unsigned int mt_rpcheck;	/**< threshold for reclaiming unref'd chunks */
+	unsigned int mt_rphits;	/**< chunks found in #mt_rpages, added to #me_rphits at txn end */
 #endif
 	/**	Number of DB records in use, or 0 when the txn is finished.
 	 *	This number only ever increments until the txn finishes; we
@@ -1642,6 +1650,10 @@ struct MDB_env {
 	MDB_pgstate	me_pgstate;		/**< state of old pages from freeDB */
 #	define		me_pglast	me_pgstate.mf_pglast
 #	define		me_pghead	me_pgstate.mf_pghead
+	/** Run index of me_pghead, for multi-page allocations. It is reset
+	 *	whenever me_pghead is changed other than by #mdb_page_alloc().
+	 */
+	MDB_RUNL	me_pgruns;
 	MDB_page	*me_dpages;		/**< list of malloc'd blocks for re-use */
 	/** IDL of pages that became unused in a write txn */
 	MDB_IDL		me_free_pgs;
@@ -1682,10 +1694,20 @@ struct MDB_env {
 	pthread_mutex_t	me_rpmutex;	/**< control access to #me_rpages */
 	MDB_sum_func *me_sumfunc;	/**< checksum env data */
 	unsigned short me_sumsize;	/**< size of per-page checksums */
-#define MDB_ERPAGE_SIZE	16384
-#define MDB_ERPAGE_MAX	(MDB_ERPAGE_SIZE-1)
+#define MDB_ERPAGE_SIZE	16384	/**< default number of chunks kept in #me_rpages */
 	unsigned short me_esumsize;	/**< size of per-page authentication data */
-	unsigned int me_rpcheck;
+	/** #me_rpages is an open addressed hash table of chunks, with
+	 * the number of chunks in el[0].mid and #me_rpmask+1 slots after it.
+	 * An empty slot has a NULL mptr.
+	 */
+	unsigned int me_rpsize;	/**< number of chunks to keep mapped */
+	unsigned int me_rpmask;	/**< number of hash slots - 1 */
+	unsigned int me_rphand;	/**< next slot to check for eviction */
+	unsigned int me_trpsize;	/**< size of #mt_rpages */
+	mdb_size_t	me_rphits;	/**< chunks found in #me_rpages or #mt_rpages */
+	mdb_size_t	me_rpmisses;	/**< chunks that had to be mapped */
+	mdb_size_t	me_rpevictions;	/**< chunks unmapped to make room */
+	mdb_size_t	me_rpdecrypts;	/**< pages decrypted */
 
 	MDB_enc_func *me_encfunc;	/**< encrypt env data */
 	MDB_val		me_enckey;	/**< key for env encryption */
@@ -2294,6 +2316,126 @@ mdb_dlist_free(MDB_txn *txn)
 #define MDB_REMAPPING(flags)	((flags) & MDB_REMAP_CHUNKS)
 #endif
 
+/** Home slot of a chunk in #me_rpages */
+static unsigned
+mdb_rpage_hash(MDB_env *env, pgno_t pgno)
+{
+	return 1 + (unsigned)(((uint64_t)(pgno / MDB_RPAGE_CHUNK) * 0x9E3779B97F4A7C15ULL) >> 32 & env->me_rpmask);
+}
+
+/** Find a chunk in #me_rpages. #me_rpmutex must be held.
+ * @return the slot of the chunk, or 0 if it is not mapped.
+ */
+static unsigned
+mdb_rpage_find(MDB_env *env, pgno_t pgno)
+{
+	MDB_ID3L el = env->me_rpages;
+	unsigned x = mdb_rpage_hash(env, pgno);
+	while (el[x].mptr) {
+		if (el[x].mid == pgno)
+			return x;
+		x = x == env->me_rpmask + 1 ? 1 : x + 1;
+	}
+	return 0;
+}
+
+/** Add a chunk to #me_rpages. #me_rpmutex must be held, and the
+ * chunk must not already be present. The table always has free slots,
+ * since it is kept at least twice the size of #me_rpsize and
+ * #mdb_rpage_get won't let it fill past 3/4.
+ */
+static void
+mdb_rpage_insert(MDB_env *env, MDB_ID3 *id3)
+{
+	MDB_ID3L el = env->me_rpages;
+	unsigned x = mdb_rpage_hash(env, id3->mid);
+	while (el[x].mptr)
+		x = x == env->me_rpmask + 1 ? 1 : x + 1;
+	el[x] = *id3;
+	el[0].mid++;
+}
+
+/** Remove the chunk in slot \b x of #me_rpages, shifting back any
+ * following entries of the probe sequence so lookups still find them.
+ */
+static void
+mdb_rpage_remove(MDB_env *env, unsigned x)
+{
+	MDB_ID3L el = env->me_rpages;
+	unsigned last = env->me_rpmask + 1, y = x, home;
+	for (;;) {
+		y = y == last ? 1 : y + 1;
+		if (!el[y].mptr)
+			break;
+		home = mdb_rpage_hash(env, el[y].mid);
+		/* move y into the hole at x unless its home is cyclically in (x, y] */
+		if (x <= y ? (home <= x || home > y) : (home <= x && home > y)) {
+			el[x] = el[y];
+			x = y;
+		}
+	}
+	el[x].mptr = NULL;
+	el[0].mid--;
+}
+
+/** Unmap unref'd chunks of #me_rpages until it is back under #me_rpsize,
+ * sweeping a clock hand around the table so that the chunks that have
+ * been mapped the longest go first. #me_rpmutex must be held.
+ * @return the number of chunks unmapped.
+ */
+static unsigned
+mdb_rpage_evict(MDB_env *env)
+{
+	MDB_ID3L el = env->me_rpages;
+	unsigned last = env->me_rpmask + 1, x = env->me_rphand, n = 0, i;
+	unsigned target = env->me_rpsize - env->me_rpsize / 8;
+	for (i = 0; i < 2 * last && el[0].mid > target; i++) {
+		if (x < 1 || x > last)
+			x = 1;
+		if (el[x].mptr && !el[x].mref) {
+			munmap(el[x].mptr, env->me_psize * el[x].mcnt);
+			if (el[x].menc)
+				mdb_rpage_dispose(env, &el[x]);
+			mdb_rpage_remove(env, x);
+			n++;
+			/* another chunk may have been shifted into this slot */
+			continue;
+		}
+		x++;
+	}
+	env->me_rphand = x;
+	env->me_rpevictions += n;
+	return n;
+}
+
+/** Forget that pages about to be overwritten have been decrypted or
+ * verified, in the env cache and in the writing txn's own cache. A page
+ * can be written more than once with the same txnid (when it is spilled),
+ * which the header check in #mdb_rpage_decrypt cannot detect.
+ */
+static void
+mdb_rpage_invalidate(MDB_txn *txn, pgno_t pg0, int numpgs)
+{
+	MDB_env *env = txn->mt_env;
+	MDB_ID3L el = env->me_rpages, tl = txn->mt_rpages;
+	unsigned x, rem = pg0 & (MDB_RPAGE_CHUNK-1);
+	pgno_t pgno = pg0 ^ rem;
+	unsigned short bits = rem + numpgs >= MDB_RPAGE_CHUNK ?
+		(unsigned short)(0xffff << rem) : (unsigned short)(((1 << numpgs) - 1) << rem);
+	pthread_mutex_lock(&env->me_rpmutex);
+	if ((x = mdb_rpage_find(env, pgno))) {
+		el[x].muse &= ~bits;
+		el[x].mhead &= ~bits;
+	}
+	pthread_mutex_unlock(&env->me_rpmutex);
+	if (tl) {
+		for (x = mdb_mid3l_search(tl, pgno); x <= tl[0].mid && tl[x].mid < pgno + MDB_RPAGE_CHUNK; x++) {
+			tl[x].muse &= ~bits;
+			tl[x].mhead &= ~bits;
+		}
+	}
+}
+
 static void
 mdb_page_unref(MDB_txn *txn, MDB_page *mp)
 {
@@ -2726,12 +2868,27 @@ mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
 		 * pages at the tail, just truncating the list.
 		 */
 		if (mop_len > n2) {
-			i = mop_len;
-			do {
+			MDB_RUNL *rl = &env->me_pgruns;
+			unsigned run;
+			if (!n2 && (rl->mr_ids != mop || rl->mr_len != mop_len)) {
+				/* A single page is always the tail, the index is left to be rebuilt */
+				i = mop_len;
 				pgno = mop[i];
-				if (mop[i-n2] == pgno+n2)
-					goto search_done;
-			} while (--i > n2);
+				goto search_done;
+			}
+			/* Find the lowest run that is long enough with the run index,
+			 * rather than scanning the list, which is slow when it is large
+			 */
+			if ((rl->mr_ids != mop || rl->mr_len != mop_len) && (rc = mdb_runl_build(rl, mop))) {
+				mdb_runl_reset(rl);
+				goto fail;
+			}
+			if ((run = mdb_runl_find(rl, num))) {
+				pgno = mdb_runl_take(rl, run, num);
+				i = mdb_midl_search(mop, pgno);
+				mdb_tassert(txn, i <= mop_len && mop[i] == pgno);
+				goto search_done;
+			}
 			if (--retry < 0)
 				break;
 		}
@@ -3083,6 +3240,13 @@ uint64_t get_time64() {
 }
 #endif
 
+/** Add to a metrics counter that can be updated by concurrent readers */
+#ifdef _WIN32
+#define ATOMIC_ADD64(ptr, value)	InterlockedExchangeAdd64((volatile LONG64 *)(ptr), (LONG64)(value))
+#else
+#define ATOMIC_ADD64(ptr, value)	__atomic_fetch_add((ptr), (value), __ATOMIC_RELAXED)
+#endif
+
 int
 mdb_env_sync0(MDB_env *env, int force, pgno_t numpgs)
 {
@@ -3577,13 +3741,13 @@ mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 	}
 #if MDB_RPAGE_CACHE
 	if (MDB_REMAPPING(env->me_flags) && !parent) {
-		txn->mt_rpages = malloc(MDB_TRPAGE_SIZE * sizeof(MDB_ID3));
+		txn->mt_rpages = malloc(env->me_trpsize * sizeof(MDB_ID3));
 		if (!txn->mt_rpages) {
 			free(txn);
 			return ENOMEM;
 		}
 		txn->mt_rpages[0].mid = 0;
-		txn->mt_rpcheck = MDB_TRPAGE_SIZE/2;
+		txn->mt_rpcheck = env->me_trpsize/2;
 	}
 #endif
 	txn->mt_dbxs = env->me_dbxs;	/* static */
@@ -3631,6 +3795,7 @@ mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 		rc = 0;
 		ntxn = (MDB_ntxn *)txn;
 		ntxn->mnt_pgstate = env->me_pgstate; /* save parent me_pghead & co */
+		mdb_runl_reset(&env->me_pgruns);
 		if (env->me_pghead) {
 			size = MDB_IDL_SIZEOF(env->me_pghead);
 			env->me_pghead = mdb_midl_alloc(env->me_pghead[0]);
@@ -3782,12 +3947,15 @@ mdb_txn_end(MDB_txn *txn, unsigned mode)
 			free(txn->mt_u.dirty_list);
 		}
 		mdb_midl_free(pghead);
+		mdb_runl_reset(&env->me_pgruns);
 	}
 #if MDB_RPAGE_CACHE
 	if (MDB_REMAPPING(env->me_flags) && !txn->mt_parent) {
 		MDB_ID3L el = env->me_rpages, tl = txn->mt_rpages;
 		unsigned i, x, n = tl[0].mid;
 		pthread_mutex_lock(&env->me_rpmutex);
+		env->me_rphits += txn->mt_rphits;
+		txn->mt_rphits = 0;
 		for (i = 1; i <= n; i++) {
 			if (tl[i].mid & (MDB_RPAGE_CHUNK-1)) {
 				/* tmp overflow pages that we didn't share in env */
@@ -3797,10 +3965,14 @@ mdb_txn_end(MDB_txn *txn, unsigned mode)
 					tl[i].menc = NULL;
 				}
 			} else {
-				x = mdb_mid3l_search(el, tl[i].mid);
-				if (tl[i].mptr == el[x].mptr) {
+				x = mdb_rpage_find(env, tl[i].mid);
+				if (x && tl[i].mptr == el[x].mptr) {
 					el[x].mref--;
-					if (!el[x].mref)
+					/* decrypted pages are checked against their header
+					 * before reuse, but verified checksums are not kept
+					 * once the chunk is idle.
+					 */
+					if (!el[x].mref && !env->me_encfunc)
 						el[x].muse = 0;
 				} else {
 					/* another tmp overflow page */
@@ -3868,6 +4040,7 @@ mdb_freelist_save(MDB_txn *txn)
 	ssize_t	head_room = 0, total_room = 0, mop_len, clean_limit;
 
 	mdb_cursor_init(&mc, txn, FREE_DBI, NULL);
+	mdb_runl_reset(&env->me_pgruns);
 
 	if (env->me_pghead) {
 		/* Make sure first page of freeDB is touched and on freelist */
@@ -4039,6 +4212,7 @@ mdb_freelist_save(MDB_txn *txn)
 		loose[0] = count;
 		mdb_midl_sort(loose);
 		mdb_midl_xmerge(mop, loose);
+		mdb_runl_reset(&env->me_pgruns);
 		txn->mt_loose_pgs = NULL;
 		txn->mt_loose_count = 0;
 		mop_len = mop[0];
@@ -4089,7 +4263,7 @@ mdb_freelist_save(MDB_txn *txn)
 }
 
 #if MDB_RPAGE_CACHE
-static int mdb_rpage_decrypt(MDB_env *env, MDB_ID3 *id3, int rem, int numpgs);
+static int mdb_rpage_decrypt(MDB_env *env, MDB_ID3 *id3, int rem, int numpgs, int *decrypted);
 static int mdb_page_encrypt(MDB_env *env, MDB_page *in, MDB_page *out, size_t size);
 static int mdb_page_chk_checksum(MDB_env *env, MDB_page *mp, size_t size);
 static void mdb_page_set_checksum(MDB_env *env, MDB_page *mp, size_t size);
@@ -4309,6 +4483,8 @@ retry_seek:
 			wsize = 0;
 		}
 #if MDB_RPAGE_CACHE
+		if ((env->me_sumfunc || env->me_encfunc) && env->me_rpages)
+			mdb_rpage_invalidate(txn, pgno, nump);
 		if (env->me_sumfunc) {
 			mdb_page_set_checksum(env, dp, size);
 		}
@@ -4611,6 +4787,7 @@ mdb_txn_commit(MDB_txn *txn)
 
 	mdb_midl_free(env->me_pghead);
 	env->me_pghead = NULL;
+	mdb_runl_reset(&env->me_pgruns);
 	mdb_midl_shrink(&txn->mt_free_pgs);
 
 #if (MDB_DEBUG) > 2
@@ -5086,6 +5263,10 @@ mdb_env_create(MDB_env **env)
 	e->me_sync_mutex->semid = -1;
 #endif
 	e->me_pid = getpid();
+#if MDB_RPAGE_CACHE
+	e->me_rpsize = MDB_ERPAGE_SIZE;
+	e->me_trpsize = MDB_TRPAGE_SIZE;
+#endif
 	GET_PAGESIZE(e->me_os_psize);
 	VGMEMP_CREATE(e,0,0);
 	*env = e;
@@ -5664,8 +5845,11 @@ mdb_env_open2(MDB_env *env, int prev)
 		return MDB_ENV_ENCRYPTION;
 
 #if MDB_RPAGE_CACHE
-	if (!newenv && env->me_sumfunc) {
-		/* for checksums, check sum size from tail of page 0 */
+	if (!newenv) {
+		/* for checksums, check sum size from tail of page 0. This is also
+		 * checked without checksums, since pages written without them
+		 * would fail verification later.
+		 */
 		char *ptr = env->me_map + env->me_psize;
 		unsigned short *u = (unsigned short *)(ptr - 2);
 		if (*u != env->me_sumsize)
@@ -5674,7 +5858,7 @@ mdb_env_open2(MDB_env *env, int prev)
 #endif
 
 	env->me_maxfree_1pg = (env->me_psize - PAGEHDRSZ) / sizeof(pgno_t) - 1;
-	env->me_nodemax = (((env->me_psize - PAGEHDRSZ) / MDB_MINKEYS) & -2)
+	env->me_nodemax = (((env->me_psize - PAGEHDRSZ - PAGETAIL(env)) / MDB_MINKEYS) & -2)
 		- sizeof(indx_t);
 #if !(MDB_MAXKEYSIZE)
 	env->me_maxkey = env->me_nodemax - (NODESIZE + sizeof(MDB_db));
@@ -6373,13 +6557,17 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 #if MDB_RPAGE_CACHE
 	if (MDB_REMAPPING(flags))
 	{
-		env->me_rpages = malloc(MDB_ERPAGE_SIZE * sizeof(MDB_ID3));
+		/* leave plenty of room to go over a small limit when every chunk is in use */
+		unsigned int slots = 1024;
+		while (slots < env->me_rpsize * 2)
+			slots <<= 1;
+		env->me_rpmask = slots - 1;
+		env->me_rphand = 1;
+		env->me_rpages = calloc(slots + 1, sizeof(MDB_ID3));
 		if (!env->me_rpages) {
 			rc = ENOMEM;
 			goto leave;
 		}
-		env->me_rpages[0].mid = 0;
-		env->me_rpcheck = MDB_ERPAGE_SIZE/2;
 	}
 #endif
 	/*<lmdb-js>*/
@@ -6502,14 +6690,14 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 				txn->mt_env = env;
 #if MDB_RPAGE_CACHE
 				if (MDB_REMAPPING(env->me_flags)) {
-				txn->mt_rpages = malloc(MDB_TRPAGE_SIZE * sizeof(MDB_ID3));
+				txn->mt_rpages = malloc(env->me_trpsize * sizeof(MDB_ID3));
 				if (!txn->mt_rpages) {
 					free(txn);
 					rc = ENOMEM;
 					goto leave;
 				}
 				txn->mt_rpages[0].mid = 0;
-				txn->mt_rpcheck = MDB_TRPAGE_SIZE/2;
+				txn->mt_rpcheck = env->me_trpsize/2;
 				}
 #endif
 				txn->mt_dbxs = env->me_dbxs;
@@ -6560,14 +6748,20 @@ mdb_env_close_active(MDB_env *env, int excl)
 	if (env->me_rpages) {
 		MDB_ID3L el = env->me_rpages;
 		unsigned int x;
-		for (x=1; x<=el[0].mid; x++)
+		for (x=1; x<=env->me_rpmask+1; x++) {
+			if (!el[x].mptr)
+				continue;
 			munmap(el[x].mptr, el[x].mcnt * env->me_psize);
+			if (el[x].menc)
+				mdb_rpage_dispose(env, &el[x]);
+		}
 		free(el);
 	}
 	}
 #endif
 	free(env->me_txn0);
 	mdb_midl_free(env->me_free_pgs);
+	mdb_runl_free(&env->me_pgruns);
 
 	if (env->me_flags & MDB_ENV_TXKEY) {
 		pthread_key_delete(env->me_txkey);
@@ -6819,6 +7013,48 @@ mdb_cmp_memnr(const MDB_val *a, const MDB_val *b)
 	return len_diff<0 ? -1 : len_diff;
 }
 
+/** Load up to 8 bytes of a key, starting at offset, as a big-endian
+ * integer (zero padded), so that comparing these integers orders keys
+ * lexically, except for ties.
+ */
+static uint64_t
+mdb_key_prefix64(const MDB_val *key, size_t offset)
+{
+	const unsigned char *p = (const unsigned char *)key->mv_data + offset;
+	size_t i, len = key->mv_size - offset;
+	uint64_t prefix = 0;
+	if (len >= 8) {
+		memcpy(&prefix, p, 8);
+#if BYTE_ORDER == LITTLE_ENDIAN
+# ifdef _MSC_VER
+		prefix = _byteswap_uint64(prefix);
+# else
+		prefix = __builtin_bswap64(prefix);
+# endif
+#endif
+		return prefix;
+	}
+	for (i = 0; i < len; i++)
+		prefix |= (uint64_t)p[i] << (56 - (i << 3));
+	return prefix;
+}
+
+/** Length of the common prefix of two keys */
+static size_t
+mdb_common_prefix(const MDB_val *a, const MDB_val *b)
+{
+	const unsigned char *pa = a->mv_data, *pb = b->mv_data;
+	size_t i = 0, len = a->mv_size < b->mv_size ? a->mv_size : b->mv_size;
+	while (i + 8 <= len && !memcmp(pa + i, pb + i, 8))
+		i += 8;
+	while (i < len && pa[i] == pb[i])
+		i++;
+	return i;
+}
+
+/** Minimum number of keys in a page to use prefix search */
+#define MDB_PREFIX_SEARCH_MIN	8
+
 /** Search for key within a page, using binary search.
  * Returns the smallest entry larger or equal to the key.
  * If exactp is non-null, stores whether the found entry was an exact match
@@ -6875,6 +7111,28 @@ mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp)
 				high = i - 1;
 		}
 	} else {
+		/* With a lexical comparator, all the keys between the first and last
+		 * key in the page share their common prefix. If the search key
+		 * shares it too, we can compare the next 8 bytes after the prefix as
+		 * integers, and only call the comparator on ties.
+		 */
+		int prefixSearch = 0;
+		size_t prefix = 0;
+		uint64_t keyPrefix = 0;
+		if (mc->mc_dbx->md_lexical && high - low >= MDB_PREFIX_SEARCH_MIN - 1) {
+			MDB_val first, last;
+			node = NODEPTR(mp, low);
+			first.mv_size = NODEKSZ(node);
+			first.mv_data = NODEKEY(node);
+			node = NODEPTR(mp, high);
+			last.mv_size = NODEKSZ(node);
+			last.mv_data = NODEKEY(node);
+			prefix = mdb_common_prefix(&first, &last);
+			if (key->mv_size >= prefix && !memcmp(key->mv_data, first.mv_data, prefix)) {
+				prefixSearch = 1;
+				keyPrefix = mdb_key_prefix64(key, prefix);
+			}
+		}
 		while (low <= high) {
 			i = (low + high) >> 1;
 
@@ -6882,7 +7140,11 @@ mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp)
 			nodekey.mv_size = NODEKSZ(node);
 			nodekey.mv_data = NODEKEY(node);
 
-			rc = cmp(key, &nodekey);
+			if (prefixSearch) {
+				uint64_t nodePrefix = mdb_key_prefix64(&nodekey, prefix);
+				rc = keyPrefix > nodePrefix ? 1 : keyPrefix < nodePrefix ? -1 : cmp(key, &nodekey);
+			} else
+				rc = cmp(key, &nodekey);
 #if MDB_DEBUG
 			if (IS_LEAF(mp))
 				DPRINTF(("found leaf index %u [%s], rc = %i",
@@ -6976,11 +7238,13 @@ mdb_rpage_encsum(MDB_env *env, MDB_ID3 *id3, unsigned rem, int numpgs)
 {
 	int rc = 0;
 	if (env->me_encfunc) {
-		unsigned short muse = id3->muse;
-		rc = mdb_rpage_decrypt(env, id3, rem, numpgs);
-		if (!rc && env->me_sumfunc && muse != id3->muse) {
+		int decrypted = 0;
+		rc = mdb_rpage_decrypt(env, id3, rem, numpgs, &decrypted);
+		if (!rc && env->me_sumfunc && decrypted) {
 			MDB_page *p = (MDB_page *)((char *)id3->menc + rem * env->me_psize);
 			rc = mdb_page_chk_checksum(env, p, numpgs * env->me_psize);
+			if (rc)	/* verify it again on the next access */
+				id3->mhead &= ~(1 << rem);
 		}
 	} else {
 		if (!(id3->muse & (1 << rem))) {
@@ -6992,9 +7256,10 @@ mdb_rpage_encsum(MDB_env *env, MDB_ID3 *id3, unsigned rem, int numpgs)
 			else
 				bit = 1;
 
-			id3->muse |= (bit << rem);
 			p = (MDB_page *)((char *)id3->mptr + rem * env->me_psize);
 			rc = mdb_page_chk_checksum(env, p, numpgs * env->me_psize);
+			if (!rc)
+				id3->muse |= (bit << rem);
 		}
 	}
 	return rc;
@@ -7010,15 +7275,16 @@ mdb_rpage_encsum(MDB_env *env, MDB_ID3 *id3, unsigned rem, int numpgs)
  * When the per-txn list gets full, all pages with refcnt=0 are purged from the
  * list and their refcnts in the per-env list are decremented.
  *
- * When the per-env list gets full, all pages with refcnt=0 are purged from the
- * list and their pages are unmapped.
+ * The per-env list is a hash table. When it holds more than #me_rpsize
+ * chunks, unref'd chunks are unmapped in clock order until it is back
+ * under the limit (see #mdb_rpage_evict).
  *
- * @note "full" means the list has reached its respective rpcheck threshold.
- * This threshold slowly raises if no pages could be purged on a given check,
- * and returns to its original value when enough pages were purged.
+ * @note for the per-txn list, "full" means the list has reached its rpcheck
+ * threshold. This threshold slowly raises if no pages could be purged on a
+ * given check, and returns to its original value when enough pages were purged.
  *
  * If purging doesn't free any slots, filling the per-txn list will return
- * MDB_TXN_FULL, and filling the per-env list returns MDB_MAP_FULL.
+ * MDB_TXN_FULL, and filling the per-env hash table returns MDB_MAP_FULL.
  *
  * Reference tracking in a txn is imperfect, pages can linger with non-zero
  * refcnt even without active references. It was deemed to be too invasive
@@ -7089,6 +7355,7 @@ mdb_rpage_get(MDB_txn *txn, pgno_t pg0, int numpgs, MDB_page **ret)
 	id3.mid = 0;
 	id3.menc = NULL;
 	id3.muse = 0;
+	id3.mhead = 0;
 	x = mdb_mid3l_search(tl, pgno);
 	if (x <= tl[0].mid && tl[x].mid == pgno) {
 		if (x != tl[0].mid && tl[x+1].mid == pg0)
@@ -7118,49 +7385,62 @@ mdb_rpage_get(MDB_txn *txn, pgno_t pg0, int numpgs, MDB_page **ret)
 				goto notlocal;
 			} else {
 				/* ignore the mapping we got from env, use new one */
+				MDB_ID3 old = tl[x];
+				unsigned i;
 				tl[x].mptr = id3.mptr;
 				tl[x].mcnt = id3.mcnt;
-				if (tl[x].menc)
-					mdb_rpage_dispose(env, &tl[x]);
 				tl[x].menc = id3.menc;
 				tl[x].muse = id3.muse;
-				/* if no active ref, see if we can replace in env */
-				if (!tl[x].mref) {
-					unsigned i;
-					pthread_mutex_lock(&env->me_rpmutex);
-					i = mdb_mid3l_search(el, tl[x].mid);
-					if (el[i].mref == 1) {
-						/* just us, replace it */
-						munmap(el[i].mptr, el[i].mcnt * env->me_psize);
-						el[i].mptr = tl[x].mptr;
-						el[i].mcnt = tl[x].mcnt;
-						if (el[i].menc)
-							mdb_rpage_dispose(env, &el[i]);
-						el[i].menc = tl[x].menc;
-						el[i].muse = tl[x].muse;
-					} else {
-						/* there are others, remove ourself */
-						el[i].mref--;
+				tl[x].mhead = id3.mhead;
+				pthread_mutex_lock(&env->me_rpmutex);
+				i = mdb_rpage_find(env, old.mid);
+				if (i && el[i].mptr == old.mptr) {
+					/* if no active ref, see if we can replace in env.
+					 * Otherwise the old chunk stays shared with env.
+					 */
+					if (!old.mref) {
+						if (el[i].mref == 1) {
+							/* just us, replace it */
+							munmap(el[i].mptr, el[i].mcnt * env->me_psize);
+							el[i].mptr = tl[x].mptr;
+							el[i].mcnt = tl[x].mcnt;
+							if (el[i].menc)
+								mdb_rpage_dispose(env, &el[i]);
+							el[i].menc = tl[x].menc;
+							el[i].muse = tl[x].muse;
+							el[i].mhead = tl[x].mhead;
+						} else {
+							/* there are others, remove ourself */
+							el[i].mref--;
+						}
 					}
-					pthread_mutex_unlock(&env->me_rpmutex);
+				} else if (!old.mref) {
+					/* the old mapping was our own */
+					munmap(old.mptr, old.mcnt * env->me_psize);
+					if (old.menc)
+						mdb_rpage_dispose(env, &old);
 				}
+				pthread_mutex_unlock(&env->me_rpmutex);
 			}
 		}
 		id3.mptr = tl[x].mptr;
 		id3.mcnt = tl[x].mcnt;
 		id3.menc = tl[x].menc;
 		id3.muse = tl[x].muse;
+		id3.mhead = tl[x].mhead;
 		tl[x].mref++;
+		txn->mt_rphits++;
 		if (env->me_encfunc || env->me_sumfunc) {
 			rc = mdb_rpage_encsum(env, &id3, rem, numpgs);
 			if (rc) return rc;
 			tl[x].muse = id3.muse;
+			tl[x].mhead = id3.mhead;
 		}
 		goto ok;
 	}
 
 notlocal:
-	if (tl[0].mid >= MDB_TRPAGE_MAX - txn->mt_rpcheck) {
+	if (tl[0].mid >= env->me_trpsize - 1 - txn->mt_rpcheck) {
 		unsigned i, y;
 		/* purge unref'd pages from our list and unref in env */
 		pthread_mutex_lock(&env->me_rpmutex);
@@ -7176,8 +7456,17 @@ retry:
 						mdb_rpage_dispose(env, &tl[i]);
 					continue;
 				}
-				x = mdb_mid3l_search(el, tl[i].mid);
-				el[x].mref--;
+				x = mdb_rpage_find(env, tl[i].mid);
+				if (x && el[x].mptr == tl[i].mptr) {
+					el[x].mref--;
+					if (!el[x].mref && !env->me_encfunc)
+						el[x].muse = 0;
+				} else {
+					/* a chunk we remapped for an overflow page */
+					munmap(tl[i].mptr, tl[i].mcnt * env->me_psize);
+					if (tl[i].menc)
+						mdb_rpage_dispose(env, &tl[i]);
+				}
 			}
 		}
 		pthread_mutex_unlock(&env->me_rpmutex);
@@ -7185,7 +7474,7 @@ retry:
 			/* we didn't find any unref'd chunks.
 			 * if we're out of room, fail.
 			 */
-			if (tl[0].mid >= MDB_TRPAGE_MAX)
+			if (tl[0].mid >= env->me_trpsize - 1)
 				return MDB_TXN_FULL;
 			/* otherwise, raise threshold for next time around
 			 * and let this go.
@@ -7200,11 +7489,11 @@ retry:
 			/* decrease the check threshold toward its original value */
 			if (!txn->mt_rpcheck)
 				txn->mt_rpcheck = 1;
-			while (txn->mt_rpcheck < tl[0].mid && txn->mt_rpcheck < MDB_TRPAGE_SIZE/2)
+			while (txn->mt_rpcheck < tl[0].mid && txn->mt_rpcheck < env->me_trpsize/2)
 				txn->mt_rpcheck *= 2;
 		}
 	}
-	if (tl[0].mid < MDB_TRPAGE_SIZE) {
+	if (tl[0].mid < env->me_trpsize - 1) {
 		id3.mref = 1;
 		if (id3.mid)
 			goto found;
@@ -7218,11 +7507,13 @@ retry:
 
 		/* search for page in env */
 		pthread_mutex_lock(&env->me_rpmutex);
-		x = mdb_mid3l_search(el, pgno);
-		if (x <= el[0].mid && el[x].mid == pgno) {
+		x = mdb_rpage_find(env, pgno);
+		if (x) {
+			env->me_rphits++;
 			id3.mptr = el[x].mptr;
 			id3.menc = el[x].menc;
 			id3.muse = el[x].muse;
+			id3.mhead = el[x].mhead;
 			/* check for overflow size */
 			if (id3.mcnt > el[x].mcnt) {
 				SET_OFF(off, pgno * env->me_psize);
@@ -7236,6 +7527,7 @@ retry:
 						goto fail;
 					}
 					id3.muse = 0;
+					id3.mhead = 0;
 				}
 				if (!el[x].mref) {
 					munmap(el[x].mptr, env->me_psize * el[x].mcnt);
@@ -7245,13 +7537,16 @@ retry:
 						mdb_rpage_dispose(env, &el[x]);
 					el[x].menc = id3.menc;
 					el[x].muse = id3.muse;
+					el[x].mhead = id3.mhead;
 				} else {
 					id3.mid = pg0;
 					if (env->me_encfunc || env->me_sumfunc) {
 						rc = mdb_rpage_encsum(env, &id3, rem, numpgs);
 						if (rc)
 							goto fail;
-						el[x].muse = id3.muse;
+						/* the bits of a private decrypted copy don't apply to env's */
+						if (!env->me_encfunc)
+							el[x].muse = id3.muse;
 					}
 					pthread_mutex_unlock(&env->me_rpmutex);
 					goto found;
@@ -7263,44 +7558,25 @@ retry:
 				if (rc)
 					goto fail;
 				el[x].muse = id3.muse;
+				el[x].mhead = id3.mhead;
 			}
 			pthread_mutex_unlock(&env->me_rpmutex);
 			goto found;
 		}
-		if (el[0].mid >= MDB_ERPAGE_MAX - env->me_rpcheck) {
-			/* purge unref'd pages */
-			unsigned i, y = 0;
-			for (i=1; i<=el[0].mid; i++) {
-				if (!el[i].mref) {
-					if (!y) y = i;
-					munmap(el[i].mptr, env->me_psize * el[i].mcnt);
-					if (el[i].menc)
-						mdb_rpage_dispose(env, &el[i]);
-				}
+		if (el[0].mid >= env->me_rpsize && !mdb_rpage_evict(env)) {
+			if (retries) {
+				/* see if we can unref some local pages */
+				retries--;
+				id3.mid = 0;
+				goto retry;
 			}
-			if (!y) {
-				if (retries) {
-					/* see if we can unref some local pages */
-					retries--;
-					id3.mid = 0;
-					goto retry;
-				}
-				if (el[0].mid >= MDB_ERPAGE_MAX) {
-					pthread_mutex_unlock(&env->me_rpmutex);
-					return MDB_MAP_FULL;
-				}
-				env->me_rpcheck /= 2;
-			} else {
-				for (i=y+1; i<= el[0].mid; i++)
-					if (el[i].mref)
-						el[y++] = el[i];
-				el[0].mid = y-1;
-				if (!env->me_rpcheck)
-					env->me_rpcheck = 1;
-				while (env->me_rpcheck < el[0].mid && env->me_rpcheck < MDB_ERPAGE_SIZE/2)
-					env->me_rpcheck *= 2;
+			/* everything is in use, go over the limit while the table has room */
+			if (el[0].mid >= env->me_rpmask - env->me_rpmask / 4) {
+				pthread_mutex_unlock(&env->me_rpmutex);
+				return MDB_MAP_FULL;
 			}
 		}
+		env->me_rpmisses++;
 		SET_OFF(off, pgno * env->me_psize);
 		MAP(rc, env, id3.mptr, len, off);
 		if (rc) {
@@ -7320,10 +7596,30 @@ fail:
 			if (rc)
 				goto fail;
 		}
-		mdb_mid3l_insert(el, &id3);
+		mdb_rpage_insert(env, &id3);
 		pthread_mutex_unlock(&env->me_rpmutex);
 found:
-		mdb_mid3l_insert(tl, &id3);
+		if (mdb_mid3l_insert(tl, &id3)) {
+			/* we already had a private mapping of this overflow page, and
+			 * lost the chunk it starts in. Use the old mapping if it is big
+			 * enough, otherwise replace it, unless a cursor still uses it.
+			 */
+			x = mdb_mid3l_search(tl, id3.mid);
+			if (tl[x].mcnt >= id3.mcnt) {
+				munmap(id3.mptr, id3.mcnt * env->me_psize);
+				if (id3.menc)
+					mdb_rpage_dispose(env, &id3);
+				tl[x].mref++;
+				id3 = tl[x];
+			} else {
+				if (!tl[x].mref) {
+					munmap(tl[x].mptr, tl[x].mcnt * env->me_psize);
+					if (tl[x].menc)
+						mdb_rpage_dispose(env, &tl[x]);
+				}
+				tl[x] = id3;
+			}
+		}
 	} else {
 		return MDB_TXN_FULL;
 	}
@@ -7368,21 +7664,34 @@ static int mdb_page_encrypt(MDB_env *env, MDB_page *dp, MDB_page *encp, size_t s
 	return env->me_encfunc(&in, &out, enckeys, 1);
 }
 
-static int mdb_rpage_decrypt(MDB_env *env, MDB_ID3 *id3, int rem, int numpgs)
+/** Decrypt a page into the chunk's clear buffer, unless it already
+ * holds it. The unencrypted header of each page is copied into the clear
+ * page, and since a page is only rewritten with a new txnid (except when
+ * spilled, see #mdb_rpage_invalidate), a clear page whose header matches
+ * the encrypted page can be reused, even by later txns.
+ */
+static int mdb_rpage_decrypt(MDB_env *env, MDB_ID3 *id3, int rem, int numpgs, int *decrypted)
 {
 	int rc = 0;
-	if (!(id3->muse & (1 << rem))) {
+	MDB_page *penc = (MDB_page *)((char *)id3->mptr + rem * env->me_psize);
+	MDB_page *pclr = (MDB_page *)((char *)id3->menc + rem * env->me_psize);
+	if (!(id3->muse & id3->mhead & (1 << rem)) ||
+		pclr->mp_pgno != penc->mp_pgno || pclr->mp_txnid != penc->mp_txnid) {
 		MDB_val in, out, enckeys[3];
-		int bit;
+		unsigned short bits;
 		int xsize = sizeof(pgno_t) + sizeof(txnid_t);
 
 		/* If this is an overflow page, set all use bits to the end */
-		if (rem + numpgs > MDB_RPAGE_CHUNK)
-			bit = 0xffff;
+		if (rem + numpgs >= MDB_RPAGE_CHUNK)
+			bits = 0xffff << rem;
 		else
-			bit = 1;
+			bits = ((1 << numpgs) - 1) << rem;
 
-		id3->muse |= (bit << rem);
+		id3->muse |= bits;
+		/* only the first page has a header to check */
+		id3->mhead = (id3->mhead & ~bits) | (1 << rem);
+		*decrypted = 1;
+		ATOMIC_ADD64(&env->me_rpdecrypts, 1);
 		in.mv_size = numpgs * env->me_psize - xsize;
 		in.mv_data = (char *)id3->mptr + rem * env->me_psize + xsize;
 		enckeys[0] = env->me_enckey;
@@ -7398,12 +7707,10 @@ static int mdb_rpage_decrypt(MDB_env *env, MDB_ID3 *id3, int rem, int numpgs)
 		}
 		out.mv_size = in.mv_size;
 		out.mv_data = (char *)id3->menc + rem * env->me_psize + xsize;
-		if (env->me_encfunc(&in, &out, enckeys, 0))
+		if (env->me_encfunc(&in, &out, enckeys, 0)) {
+			id3->mhead &= ~(1 << rem);
 			rc = MDB_CRYPTO_FAIL;
-		else {
-			MDB_page *penc, *pclr;
-			penc = (MDB_page *)enckeys[1].mv_data;
-			pclr = (MDB_page *)((char *)out.mv_data - xsize);
+		} else {
 			pclr->mp_pgno = penc->mp_pgno;
 			pclr->mp_txnid = penc->mp_txnid;
 		}
@@ -7447,6 +7754,10 @@ static int mdb_page_chk_checksum(MDB_env *env, MDB_page *mp, size_t size)
 {
 	MDB_val src, dst, chk, *key;
 	char sumbuf[256];
+	uint64_t start = 0;
+	int rc;
+	if (env->me_flags & MDB_TRACK_METRICS)
+		start = get_time64();
 	src.mv_size = size - env->me_sumsize;
 	src.mv_data = mp;
 	chk.mv_size = env->me_sumsize;
@@ -7458,7 +7769,16 @@ static int mdb_page_chk_checksum(MDB_env *env, MDB_page *mp, size_t size)
 	else
 		key = NULL;
 	env->me_sumfunc(&src, &dst, key);
-	return memcmp(chk.mv_data, dst.mv_data, env->me_sumsize) ? MDB_BAD_CHECKSUM : 0;
+	rc = memcmp(chk.mv_data, dst.mv_data, env->me_sumsize) ? MDB_BAD_CHECKSUM : 0;
+	if (env->me_flags & MDB_TRACK_METRICS) {
+		/* pages are verified by concurrent readers */
+		MDB_metrics *metrics = (MDB_metrics *)env->me_userctx;
+		ATOMIC_ADD64(&metrics->checksums_verified, 1);
+		ATOMIC_ADD64(&metrics->time_checksums, get_time64() - start);
+		if (rc)
+			ATOMIC_ADD64(&metrics->checksum_failures, 1);
+	}
+	return rc;
 }
 #endif
 
@@ -7816,6 +8136,7 @@ release:
 		while (j>i)
 			mop[j--] = pg++;
 		mop[0] += ovpages;
+		mdb_runl_reset(&env->me_pgruns);
 	} else {
 		rc = mdb_midl_append_range(&txn->mt_free_pgs, pg, ovpages);
 		if (rc)
@@ -7923,6 +8244,32 @@ mdb_get_with_txn(MDB_txn *txn, MDB_dbi dbi,
 	return rc;
 }
 
+int
+mdb_val_txnid(MDB_txn *txn, const MDB_val *val, mdb_size_t *txn_id, mdb_size_t *offset)
+{
+	MDB_env *env;
+	MDB_page *mp;
+	char *ptr;
+
+	if (!txn || !val || !txn_id || !offset)
+		return EINVAL;
+	env = txn->mt_env;
+	/* Remapped pages can move, and the value must be in the current map */
+	if (MDB_REMAPPING(env->me_flags))
+		return MDB_NOTFOUND;
+	ptr = (char *)val->mv_data;
+	if (ptr < env->me_map || ptr >= env->me_map + env->me_mapsize)
+		return MDB_NOTFOUND;
+	/* Leaf values and overflow values both start in the page that holds them */
+	mp = (MDB_page *)(env->me_map + (ptr - env->me_map) / env->me_psize * env->me_psize);
+	/* A dirty page can still be modified by this txn */
+	if (!F_ISSET(txn->mt_flags, MDB_TXN_RDONLY) && IS_WRITABLE(txn, mp))
+		return MDB_NOTFOUND;
+	*txn_id = mp->mp_txnid;
+	*offset = ptr - env->me_map;
+	return MDB_SUCCESS;
+}
+
 /** Find a sibling for a page.
  * Replaces the page at the top of the cursor's stack with the
  * specified sibling, if one exists.
@@ -8957,7 +9304,7 @@ prep_subDB:
 					if ((rc = mdb_page_alloc(mc, 1, &mp)))
 						return rc;
 					fp_flags |= mp->mp_flags; /* P_ADM_FLAGS */
-					offset = env->me_psize - olddata.mv_size;
+					offset = env->me_psize - PAGETAIL(env) - olddata.mv_size;
 					flags |= F_DUPDATA|F_SUBDATA;
 					dummy.md_root = mp->mp_pgno;
 					sub_root = mp;
@@ -8993,7 +9340,7 @@ current:
 		if (F_ISSET(leaf->mn_flags, F_BIGDATA)) {
 			MDB_page *omp;
 			MDB_ovpage ovp;
-			int ovpages, dpages = OVPAGES(data->mv_size, env->me_psize);
+			int ovpages, dpages = OVPAGES(data->mv_size + PAGETAIL(env), env->me_psize);
 
 			memcpy(&ovp, olddata.mv_data, sizeof(ovp));
 			if ((rc2 = MDB_PAGE_GET(mc, ovp.op_pgno, ovp.op_pages, &omp)) != 0)
@@ -9324,11 +9671,7 @@ mdb_page_new(MDB_cursor *mc, uint32_t flags, int num, MDB_page **mp)
 	    np->mp_pgno, mc->mc_txn->mt_env->me_psize));
 	np->mp_flags |= flags;
 	np->mp_lower = (PAGEHDRSZ-PAGEBASE);
-	np->mp_upper = mc->mc_txn->mt_env->me_psize - PAGEBASE;
-#if MDB_RPAGE_CACHE
-	np->mp_upper -= mc->mc_txn->mt_env->me_sumsize;
-	np->mp_upper -= mc->mc_txn->mt_env->me_esumsize;
-#endif
+	np->mp_upper = mc->mc_txn->mt_env->me_psize - PAGETAIL(mc->mc_txn->mt_env) - PAGEBASE;
 
 	if (IS_BRANCH(np))
 		mc->mc_db->md_branch_pages++;
@@ -9456,7 +9799,7 @@ mdb_node_add(MDB_cursor *mc, indx_t indx,
 			/* Data already on overflow page. */
 			node_size += sizeof(MDB_ovpage);
 		} else if (node_size + data->mv_size > mc->mc_txn->mt_env->me_nodemax) {
-			int ovpages = OVPAGES(data->mv_size, mc->mc_txn->mt_env->me_psize);
+			int ovpages = OVPAGES(data->mv_size + PAGETAIL(mc->mc_txn->mt_env), mc->mc_txn->mt_env->me_psize);
 			int rc;
 			/* Put data on overflow page. */
 			DPRINTF(("data size is %"Z"u, node would be %"Z"u, put data on overflow page",
@@ -9664,6 +10007,7 @@ mdb_xcursor_init0(MDB_cursor *mc)
 	mx->mx_dbx.md_name.mv_size = 0;
 	mx->mx_dbx.md_name.mv_data = NULL;
 	mx->mx_dbx.md_cmp = mc->mc_dbx->md_dcmp;
+	mx->mx_dbx.md_lexical = mx->mx_dbx.md_cmp == mdb_cmp_memn;
 	mx->mx_dbx.md_dcmp = NULL;
 	mx->mx_dbx.md_rel = mc->mc_dbx->md_rel;
 }
@@ -10889,7 +11233,7 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 		} else {
 			int psize, nsize, k;
 			/* Maximum free space in an empty page */
-			pmax = env->me_psize - PAGEHDRSZ;
+			pmax = env->me_psize - PAGEHDRSZ - PAGETAIL(env);
 			if (IS_LEAF(mp))
 				nsize = mdb_leaf_size(env, newkey, newdata);
 			else
@@ -10905,7 +11249,7 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 			copy->mp_pgno  = mp->mp_pgno;
 			copy->mp_flags = mp->mp_flags;
 			copy->mp_lower = (PAGEHDRSZ-PAGEBASE);
-			copy->mp_upper = env->me_psize - PAGEBASE;
+			copy->mp_upper = env->me_psize - PAGETAIL(env) - PAGEBASE;
 
 			/* prepare to insert */
 			for (i=0, j=0; i<nkeys; i++) {
@@ -11082,7 +11426,7 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 		mp->mp_lower = copy->mp_lower;
 		mp->mp_upper = copy->mp_upper;
 		memcpy(NODEPTR(mp, nkeys-1), NODEPTR(copy, nkeys-1),
-			env->me_psize - copy->mp_upper - PAGEBASE);
+			env->me_psize - PAGETAIL(env) - copy->mp_upper - PAGEBASE);
 
 		/* reset back to original page */
 		if (newindx < split_indx) {
@@ -11771,100 +12115,843 @@ mdb_env_copy(MDB_env *env, const char *path)
 	return mdb_env_copy2(env, path, 0);
 }
 
-int ESECT
-mdb_env_set_flags(MDB_env *env, unsigned int flag, int onoff)
+	/** Header of an incremental copy, see #mdb_env_copy_incremental().
+	 *	It is followed (at page boundaries) by the meta pages, a table
+	 *	of #MDB_incr_run, and then the pages of each run.
+	 */
+typedef struct MDB_incr_header {
+	uint32_t	mi_magic;		/**< #MDB_INCR_MAGIC */
+	uint32_t	mi_psize;		/**< page size of the environment */
+	mdb_size_t	mi_since;		/**< txnid the copy is relative to, 0 for a full copy */
+	mdb_size_t	mi_txnid;		/**< txnid of the snapshot that was copied */
+	mdb_size_t	mi_next_pgno;	/**< first unallocated page of the snapshot */
+	mdb_size_t	mi_runs;		/**< number of page runs */
+} MDB_incr_header;
+#define MDB_INCR_MAGIC	0x4c4d4449
+
+	/** A run of consecutive pages in an incremental copy */
+typedef struct MDB_incr_run {
+	pgno_t	mr_pgno;
+	pgno_t	mr_count;
+} MDB_incr_run;
+
+	/** State needed for collecting the pages of an incremental copy */
+typedef struct mdb_incr {
+	MDB_txn	*mi_txn;
+	txnid_t	mi_since;
+	MDB_incr_run	*mi_runs;
+	size_t	mi_count;
+	size_t	mi_size;
+} mdb_incr;
+
+static int ESECT
+mdb_incr_add(mdb_incr *my, pgno_t pgno, pgno_t count)
 {
-	if (flag & ~CHANGEABLE)
-		return EINVAL;
-	if (onoff)
-		env->me_flags |= flag;
-	else
-		env->me_flags &= ~flag;
+	if (pgno + count > my->mi_txn->mt_next_pgno)
+		return MDB_CORRUPTED;
+	if (my->mi_count == my->mi_size) {
+		size_t size = my->mi_size ? my->mi_size * 2 : 1024;
+		MDB_incr_run *runs = realloc(my->mi_runs, size * sizeof(MDB_incr_run));
+		if (!runs)
+			return ENOMEM;
+		my->mi_runs = runs;
+		my->mi_size = size;
+	}
+	my->mi_runs[my->mi_count].mr_pgno = pgno;
+	my->mi_runs[my->mi_count++].mr_count = count;
 	return MDB_SUCCESS;
 }
 
-int ESECT
-mdb_env_get_flags(MDB_env *env, unsigned int *arg)
+	/** Depth-first tree traversal for incremental copy. Pages are copied
+	 * on write all the way up to the root, so a page that is not newer
+	 * than mi_since has no newer pages below it, and is skipped.
+	 * @param[in] my control structure.
+	 * @param[in] pg database root.
+	 * @param[in] flags includes #F_DUPDATA if it is a sorted-duplicate sub-DB.
+	 */
+static int ESECT
+mdb_env_iwalk(mdb_incr *my, pgno_t pg, int flags)
 {
-	if (!env || !arg)
-		return EINVAL;
+	MDB_env *env = my->mi_txn->mt_env;
+	MDB_page *mp, *omp;
+	MDB_node *ni;
+	unsigned int i, n;
+	int rc;
 
-	*arg = env->me_flags & EXPOSED;
-	return MDB_SUCCESS;
-}
+	if (pg == P_INVALID)
+		return MDB_SUCCESS;
+	if (pg >= my->mi_txn->mt_next_pgno)
+		return MDB_CORRUPTED;
+	mp = (MDB_page *)(env->me_map + (mdb_size_t)env->me_psize * pg);
+	if (mp->mp_txnid <= my->mi_since)
+		return MDB_SUCCESS;
+	if ((rc = mdb_incr_add(my, pg, 1)))
+		return rc;
+	n = NUMKEYS(mp);
+	if (IS_BRANCH(mp)) {
+		for (i=0; i<n; i++) {
+			rc = mdb_env_iwalk(my, NODEPGNO(NODEPTR(mp, i)), flags);
+			if (rc)
+				return rc;
+		}
+	} else if (IS_LEAF(mp) && !IS_LEAF2(mp) && !(flags & F_DUPDATA)) {
+		for (i=0; i<n; i++) {
+			ni = NODEPTR(mp, i);
+			if (ni->mn_flags & F_BIGDATA) {
+				MDB_ovpage ovp;
+
+				memcpy(&ovp, NODEDATA(ni), sizeof(ovp));
+				if (ovp.op_pgno >= my->mi_txn->mt_next_pgno)
+					return MDB_CORRUPTED;
+				omp = (MDB_page *)(env->me_map + (mdb_size_t)env->me_psize * ovp.op_pgno);
+				if (omp->mp_txnid > my->mi_since &&
+					(rc = mdb_incr_add(my, ovp.op_pgno, ovp.op_pages)))
+					return rc;
+			} else if (ni->mn_flags & F_SUBDATA) {
+				MDB_db db;
 
-int ESECT
-mdb_env_set_userctx(MDB_env *env, void *ctx)
-{
-	if (!env)
-		return EINVAL;
-	if (ctx)
-		env->me_userctx = ctx;
+				memcpy(&db, NODEDATA(ni), sizeof(db));
+				rc = mdb_env_iwalk(my, db.md_root, ni->mn_flags & F_DUPDATA);
+				if (rc)
+					return rc;
+			}
+		}
+	}
 	return MDB_SUCCESS;
 }
 
-void * ESECT
-mdb_env_get_userctx(MDB_env *env)
+static int
+mdb_incr_cmp(const void *a, const void *b)
 {
-	return env ? env->me_userctx : NULL;
+	pgno_t pa = ((const MDB_incr_run *)a)->mr_pgno, pb = ((const MDB_incr_run *)b)->mr_pgno;
+	return pa < pb ? -1 : pa > pb;
 }
 
-int ESECT
-mdb_env_set_assert(MDB_env *env, MDB_assert_func *func)
+	/** Positional read or write of a whole buffer */
+static int ESECT
+mdb_incr_io(HANDLE fd, char *ptr, size_t size, mdb_size_t pos, int write)
 {
-	if (!env)
-		return EINVAL;
-#ifndef NDEBUG
-	env->me_assert_func = func;
+	while (size > 0) {
+		size_t chunk = size > MAX_WRITE ? MAX_WRITE : size;
+#ifdef _WIN32
+		DWORD len;
+		OVERLAPPED ov;
+		memset(&ov, 0, sizeof(ov));
+		ov.Offset = pos & 0xffffffff;
+		ov.OffsetHigh = pos >> 16 >> 16;
+		if (!(write ? WriteFile(fd, ptr, (DWORD)chunk, &len, &ov) :
+				ReadFile(fd, ptr, (DWORD)chunk, &len, &ov)))
+			return ErrCode() == ERROR_HANDLE_EOF ? MDB_INVALID : ErrCode();
+#else
+		ssize_t len = write ? pwrite(fd, ptr, chunk, pos) : pread(fd, ptr, chunk, pos);
+		if (len < 0)
+			return ErrCode();
 #endif
+		if (len == 0)
+			return write ? EIO : MDB_INVALID;	/* the copy was truncated */
+		ptr += len;
+		pos += len;
+		size -= len;
+	}
 	return MDB_SUCCESS;
 }
 
 int ESECT
-mdb_env_set_callback(MDB_env *env, MDB_check_fd *func)
-{
-	if (!env)
-		return EINVAL;
-	env->me_callback = func;
-	return MDB_SUCCESS;
-}
-
-#if MDB_RPAGE_CACHE
-int ESECT
-mdb_env_set_encrypt(MDB_env *env, MDB_enc_func *func, const MDB_val *key, unsigned int size)
+mdb_env_copy_incremental(MDB_env *env, const char *path, mdb_size_t since,
+	mdb_size_t *txnid, mdb_size_t *pages)
 {
-	char *kdata;
+	MDB_txn *txn = NULL;
+	mdb_mutexref_t wmutex = NULL;
+	MDB_name fname;
+	HANDLE fd = INVALID_HANDLE_VALUE;
+	MDB_incr_header *head;
+	mdb_incr my = {0};
+	unsigned int psize = env->me_psize;
+	char *raw = NULL, *buf, *table;
+	size_t i, j, tsize;
+	mdb_size_t pos, count = 0;
+	int rc;
 
-	if (!env || !func || !key)
-		return EINVAL;
-	if (env->me_flags & MDB_ENV_ACTIVE)
-		return EINVAL;
-	if (! (kdata = malloc(key[0].mv_size)))
-		return ENOMEM;
+	/* Pages are read straight from the map, which must hold all of them */
+	if (MDB_REMAPPING(env->me_flags))
+		return MDB_INCOMPATIBLE;
 
-	memcpy(kdata,  key->mv_data, key->mv_size);
-	free(env->me_enckey.mv_data);
-	env->me_enckey.mv_data = kdata;
-	env->me_enckey.mv_size = key->mv_size;
-	env->me_encfunc = func;
-	if (size)
-		env->me_esumsize = size;
-	env->me_flags |= MDB_REMAP_CHUNKS | MDB_ENCRYPT;
-	return MDB_SUCCESS;
-}
+	rc = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+	if (rc)
+		return rc;
+	/* Aligned space for the header and meta pages, for unbuffered writes */
+	raw = malloc((size_t)psize * (NUM_METAS + 2));
+	if (!raw) {
+		rc = ENOMEM;
+		goto leave;
+	}
+	buf = (char *)(((size_t)raw + psize - 1) & ~(size_t)(psize - 1));
+	memset(buf, 0, psize);
 
-int ESECT
-mdb_env_set_checksum(MDB_env *env, MDB_sum_func *func, unsigned int size)
-{
-	if (!env || !func || !size)
-		return EINVAL;
-	if (env->me_flags & MDB_ENV_ACTIVE)
-		return EINVAL;
-	env->me_sumfunc = func;
-	env->me_sumsize = size;
-	return MDB_SUCCESS;
-}
-#endif
+	if (env->me_txns) {
+		/* We must start the actual read txn after blocking writers */
+		mdb_txn_end(txn, MDB_END_RESET_TMP);
+
+		/* Temporarily block writers until we snapshot the meta pages */
+		wmutex = env->me_wmutex;
+		if (LOCK_MUTEX(rc, env, wmutex))
+			goto leave;
+
+		rc = mdb_txn_renew0(txn);
+		if (rc) {
+			UNLOCK_MUTEX(wmutex);
+			goto leave;
+		}
+	}
+	memcpy(buf + psize, env->me_map, (size_t)psize * NUM_METAS);
+	if (wmutex)
+		UNLOCK_MUTEX(wmutex);
+
+	my.mi_txn = txn;
+	my.mi_since = since;
+	rc = mdb_env_iwalk(&my, txn->mt_dbs[FREE_DBI].md_root, 0);
+	if (!rc)
+		rc = mdb_env_iwalk(&my, txn->mt_dbs[MAIN_DBI].md_root, 0);
+	if (rc)
+		goto leave;
+
+	/* Sort the pages, so they are read sequentially, and merge adjacent runs */
+	qsort(my.mi_runs, my.mi_count, sizeof(MDB_incr_run), mdb_incr_cmp);
+	for (i=0, j=0; i<my.mi_count; i++) {
+		count += my.mi_runs[i].mr_count;
+		if (j && my.mi_runs[j-1].mr_pgno + my.mi_runs[j-1].mr_count == my.mi_runs[i].mr_pgno)
+			my.mi_runs[j-1].mr_count += my.mi_runs[i].mr_count;
+		else
+			my.mi_runs[j++] = my.mi_runs[i];
+	}
+	my.mi_count = j;
+
+	head = (MDB_incr_header *)buf;
+	head->mi_magic = MDB_INCR_MAGIC;
+	head->mi_psize = psize;
+	head->mi_since = since;
+	head->mi_txnid = txn->mt_txnid;
+	head->mi_next_pgno = txn->mt_next_pgno;
+	head->mi_runs = my.mi_count;
+
+	rc = mdb_fname_init(path, env->me_flags | MDB_NOSUBDIR | MDB_NOLOCK, &fname);
+	if (rc)
+		goto leave;
+	rc = mdb_fopen(env, &fname, MDB_O_COPY, 0666, &fd);
+	mdb_fname_destroy(fname);
+	if (rc)
+		goto leave;
+
+	rc = mdb_incr_io(fd, buf, (size_t)psize * (NUM_METAS + 1), 0, 1);
+	if (rc)
+		goto leave;
+	pos = (mdb_size_t)psize * (NUM_METAS + 1);
+	/* The run table is padded to a page, it is written from its own aligned buffer */
+	tsize = (my.mi_count * sizeof(MDB_incr_run) + psize - 1) & ~(size_t)(psize - 1);
+	if (tsize) {
+		free(raw);
+		raw = malloc(tsize + psize);
+		if (!raw) {
+			rc = ENOMEM;
+			goto leave;
+		}
+		table = (char *)(((size_t)raw + psize - 1) & ~(size_t)(psize - 1));
+		memset(table, 0, tsize);
+		memcpy(table, my.mi_runs, my.mi_count * sizeof(MDB_incr_run));
+		rc = mdb_incr_io(fd, table, tsize, pos, 1);
+		if (rc)
+			goto leave;
+		pos += tsize;
+	}
+	for (i=0; i<my.mi_count; i++) {
+		size_t size = (size_t)psize * my.mi_runs[i].mr_count;
+		rc = mdb_incr_io(fd, env->me_map + (mdb_size_t)psize * my.mi_runs[i].mr_pgno, size, pos, 1);
+		if (rc)
+			goto leave;
+		pos += size;
+	}
+	if (txnid)
+		*txnid = txn->mt_txnid;
+	if (pages)
+		*pages = count;
+
+leave:
+	if (fd != INVALID_HANDLE_VALUE && close(fd) < 0 && rc == MDB_SUCCESS)
+		rc = ErrCode();
+	free(my.mi_runs);
+	free(raw);
+	mdb_txn_abort(txn);
+	return rc;
+}
+
+	/** Open a file for applying an incremental copy */
+static int ESECT
+mdb_incr_open(const char *path, int write, HANDLE *res)
+{
+	MDB_name fname;
+	int rc;
+
+	rc = mdb_fname_init(path, MDB_NOSUBDIR | MDB_NOLOCK, &fname);
+	if (rc)
+		return rc;
+#ifdef _WIN32
+	*res = CreateFileW(fname.mn_val, write ? GENERIC_READ|GENERIC_WRITE : GENERIC_READ,
+		FILE_SHARE_READ, NULL, write ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+	*res = open(fname.mn_val, (write ? O_RDWR|O_CREAT : O_RDONLY) | MDB_CLOEXEC, 0666);
+#endif
+	if (*res == INVALID_HANDLE_VALUE)
+		rc = ErrCode();
+	mdb_fname_destroy(fname);
+	return rc;
+}
+
+int ESECT
+mdb_env_apply_incremental(const char *path, const char *incpath, mdb_size_t *txnid)
+{
+	HANDLE fd = INVALID_HANDLE_VALUE, ifd = INVALID_HANDLE_VALUE;
+	MDB_incr_header head;
+	MDB_incr_run *runs = NULL;
+	MDB_page *mp;
+	MDB_meta *mm;
+	char *buf = NULL;
+	mdb_size_t fsize = 0, pos, last = 0;
+	size_t i, tsize, size;
+	unsigned int psize;
+	pgno_t pgno, count;
+	int rc;
+
+	rc = mdb_incr_open(incpath, 0, &ifd);
+	if (rc)
+		return rc;
+	rc = mdb_incr_io(ifd, (char *)&head, sizeof(head), 0, 0);
+	if (rc)
+		goto leave;
+	psize = head.mi_psize;
+	if (head.mi_magic != MDB_INCR_MAGIC || psize < 512 || psize > MAX_PAGESIZE ||
+			(psize & (psize - 1))) {
+		rc = MDB_INVALID;
+		goto leave;
+	}
+	buf = malloc(MDB_WBUF > (size_t)psize * NUM_METAS ? MDB_WBUF : (size_t)psize * NUM_METAS);
+	if (!buf) {
+		rc = ENOMEM;
+		goto leave;
+	}
+
+	rc = mdb_incr_open(path, 1, &fd);
+	if (!rc)
+		rc = mdb_fsize(fd, &fsize);
+	if (rc)
+		goto leave;
+	if (head.mi_since) {
+		/* The copy only has the pages that changed after mi_since, so it
+		 * can only be applied to a copy of that txn
+		 */
+		if (fsize < (mdb_size_t)psize * NUM_METAS) {
+			rc = MDB_INVALID;
+			goto leave;
+		}
+		rc = mdb_incr_io(fd, buf, (size_t)psize * NUM_METAS, 0, 0);
+		if (rc)
+			goto leave;
+		/* Find the latest meta, which may be at a half page with overlapping sync */
+		for (i=0; i<NUM_METAS*2; i++) {
+			mp = (MDB_page *)(buf + (psize >> 1) * i);
+			mm = METADATA(mp);
+			if (F_ISSET(mp->mp_flags, P_META) && mm->mm_magic == MDB_MAGIC && mm->mm_txnid > last)
+				last = mm->mm_txnid;
+		}
+		if (last != head.mi_since) {
+			rc = MDB_INCOMPATIBLE;
+			goto leave;
+		}
+	} else if (fsize) {
+		rc = EEXIST;	/* A full copy must be applied to a new file */
+		goto leave;
+	}
+
+	tsize = (head.mi_runs * sizeof(MDB_incr_run) + psize - 1) & ~(size_t)(psize - 1);
+	if (tsize) {
+		runs = malloc(tsize);
+		if (!runs) {
+			rc = ENOMEM;
+			goto leave;
+		}
+		rc = mdb_incr_io(ifd, (char *)runs, head.mi_runs * sizeof(MDB_incr_run),
+			(mdb_size_t)psize * (NUM_METAS + 1), 0);
+		if (rc)
+			goto leave;
+	}
+	pos = (mdb_size_t)psize * (NUM_METAS + 1) + tsize;
+	for (i=0; i<head.mi_runs; i++) {
+		pgno = runs[i].mr_pgno;
+		count = runs[i].mr_count;
+		if (pgno < NUM_METAS || pgno + count > head.mi_next_pgno) {
+			rc = MDB_CORRUPTED;
+			goto leave;
+		}
+		while (count) {
+			size = (size_t)psize * count;
+			if (size > MDB_WBUF)
+				size = MDB_WBUF - MDB_WBUF % psize;
+			rc = mdb_incr_io(ifd, buf, size, pos, 0);
+			if (!rc)
+				rc = mdb_incr_io(fd, buf, size, (mdb_size_t)psize * pgno, 1);
+			if (rc)
+				goto leave;
+			pos += size;
+			pgno += size / psize;
+			count -= size / psize;
+		}
+	}
+	/* The pages must be durable before the metas refer to them */
+	if (MDB_FDATASYNC(fd)) {
+		rc = ErrCode();
+		goto leave;
+	}
+	rc = mdb_incr_io(ifd, buf, (size_t)psize * NUM_METAS, psize, 0);
+	if (!rc)
+		rc = mdb_incr_io(fd, buf, (size_t)psize * NUM_METAS, 0, 1);
+	if (rc)
+		goto leave;
+	/* Free pages at the end may not have been written, the file must still cover them */
+	if (!(rc = mdb_fsize(fd, &fsize)) && fsize < (mdb_size_t)psize * head.mi_next_pgno) {
+#ifdef _WIN32
+		LARGE_INTEGER end;
+		end.QuadPart = (mdb_size_t)psize * head.mi_next_pgno;
+		if (!SetFilePointerEx(fd, end, NULL, FILE_BEGIN) || !SetEndOfFile(fd))
+			rc = ErrCode();
+#else
+		if (ftruncate(fd, (mdb_size_t)psize * head.mi_next_pgno) < 0)
+			rc = ErrCode();
+#endif
+	}
+	if (!rc && MDB_FDATASYNC(fd))
+		rc = ErrCode();
+	if (!rc && txnid)
+		*txnid = head.mi_txnid;
+
+leave:
+	if (fd != INVALID_HANDLE_VALUE)
+		close(fd);
+	close(ifd);
+	free(runs);
+	free(buf);
+	return rc;
+}
+
+	/** Load every freeDB record that is old enough to reuse into me_pghead,
+	 * like #mdb_page_alloc() does as it needs them.
+	 */
+static int ESECT
+mdb_freelist_load(MDB_txn *txn)
+{
+	MDB_env *env = txn->mt_env;
+	MDB_cursor m2;
+	MDB_cursor_op op = MDB_FIRST;
+	MDB_val key, data;
+	txnid_t oldest, last = env->me_pglast;
+	pgno_t *idl;
+	int rc;
+
+	oldest = env->me_pgoldest = mdb_find_oldest(txn);
+	mdb_cursor_init(&m2, txn, FREE_DBI, NULL);
+	if (last) {
+		op = MDB_SET_RANGE;
+		key.mv_data = &last; /* will look up last+1 */
+		key.mv_size = sizeof(last);
+	}
+	for (;;) {
+		last++;
+		if (oldest <= last)
+			break;
+		rc = mdb_cursor_get(&m2, &key, NULL, op);
+		if (rc)
+			return rc == MDB_NOTFOUND ? MDB_SUCCESS : rc;
+		last = *(txnid_t*)key.mv_data;
+		if (oldest <= last)
+			break;
+		rc = mdb_node_read(&m2, NODEPTR(m2.mc_pg[m2.mc_top], m2.mc_ki[m2.mc_top]), &data);
+		if (rc)
+			return rc;
+		idl = (MDB_ID *) data.mv_data;
+		if (!env->me_pghead) {
+			if (!(env->me_pghead = mdb_midl_alloc(idl[0])))
+				return ENOMEM;
+		} else if ((rc = mdb_midl_need(&env->me_pghead, idl[0])) != 0)
+			return rc;
+		env->me_pglast = last;
+		/* Merge in descending sorted order */
+		mdb_midl_xmerge(env->me_pghead, idl);
+		mdb_runl_reset(&env->me_pgruns);
+		op = MDB_NEXT;
+	}
+	return MDB_SUCCESS;
+}
+
+	/** Remove the free pages at the end of the file from me_pghead,
+	 * and lower the txn's next page to them.
+	 * @return the number of pages that were removed.
+	 */
+static pgno_t ESECT
+mdb_freelist_trim(MDB_txn *txn)
+{
+	pgno_t *mop = txn->mt_env->me_pghead, n = 0;
+
+	if (!mop)
+		return 0;
+	/* me_pghead is sorted in descending order, so the tail is first */
+	while (n < mop[0] && mop[n+1] == txn->mt_next_pgno - 1 - n)
+		n++;
+	if (n) {
+		memmove(mop + 1, mop + 1 + n, (mop[0] - n) * sizeof(pgno_t));
+		mop[0] -= n;
+		txn->mt_next_pgno -= n;
+		mdb_runl_reset(&txn->mt_env->me_pgruns);
+	}
+	return n;
+}
+
+	/** Copy the pages in a cursor's path that are at or past limit, by
+	 * touching them (#mdb_page_alloc() takes the lowest free pages).
+	 */
+static int ESECT
+mdb_compact_path(MDB_cursor *mc, pgno_t limit, mdb_size_t *moved)
+{
+	unsigned int i, tail = 0;
+
+	for (i=0; i<mc->mc_snum; i++) {
+		if (mc->mc_pg[i]->mp_pgno >= limit && !IS_WRITABLE(mc->mc_txn, mc->mc_pg[i]))
+			tail++;
+	}
+	if (!tail)
+		return MDB_SUCCESS;
+	*moved += tail;
+	return mdb_cursor_touch(mc);
+}
+
+	/** Move the overflow pages of the i'th node of the cursor's leaf,
+	 * if they are at or past limit and there is a lower run of free pages.
+	 */
+static int ESECT
+mdb_compact_ovpage(MDB_cursor *mc, unsigned int i, pgno_t limit, mdb_size_t *moved)
+{
+	MDB_txn *txn = mc->mc_txn;
+	MDB_page *omp, *np;
+	MDB_ovpage ovp;
+	pgno_t pgno;
+	txnid_t pgtxnid;
+	int rc;
+
+	memcpy(&ovp, NODEDATA(NODEPTR(mc->mc_pg[mc->mc_top], i)), sizeof(ovp));
+	if (ovp.op_pgno < limit)
+		return MDB_SUCCESS;
+	if ((rc = MDB_PAGE_GET(mc, ovp.op_pgno, ovp.op_pages, &omp)))
+		return rc;
+	if (IS_WRITABLE(txn, omp))
+		return MDB_SUCCESS;
+	if ((rc = mdb_page_alloc(mc, ovp.op_pages, &np)))
+		return rc;
+	/* mdb_ovpage_free() subtracts the pages it frees */
+	mc->mc_db->md_overflow_pages += ovp.op_pages;
+	if (np->mp_pgno > ovp.op_pgno) {
+		/* There was no lower run that fits, give the pages back */
+		np->mp_flags = P_OVERFLOW;
+		np->mp_pages = ovp.op_pages;
+		return mdb_ovpage_free(mc, np);
+	}
+	pgno = np->mp_pgno;
+	pgtxnid = np->mp_txnid;
+	memcpy(np, omp, (size_t)txn->mt_env->me_psize * ovp.op_pages);
+	np->mp_pgno = pgno;
+	np->mp_txnid = pgtxnid;
+	/* The node is updated in place, so the leaf must be writable */
+	if ((rc = mdb_cursor_touch(mc)) || (rc = mdb_ovpage_free(mc, omp)))
+		return rc;
+	ovp.op_pgno = pgno;
+	ovp.op_txnid = txn->mt_txnid;
+	memcpy(NODEDATA(NODEPTR(mc->mc_pg[mc->mc_top], i)), &ovp, sizeof(ovp));
+	*moved += ovp.op_pages;
+	return MDB_SUCCESS;
+}
+
+	/** Move the pages of a DB (or the sorted-duplicate sub-DB of the
+	 * i'th node of the parent cursor's leaf) that are at or past limit.
+	 * @param[in] mc a cursor for the DB.
+	 * @param[in] parent the cursor of the node of a sub-DB, or NULL.
+	 */
+static int ESECT
+mdb_compact_walk(MDB_cursor *mc, MDB_cursor *parent, unsigned int pi,
+	pgno_t limit, mdb_size_t max, mdb_size_t *moved)
+{
+	MDB_page *mp;
+	MDB_node *ni;
+	mdb_size_t before = *moved;
+	unsigned int i;
+	int rc;
+
+	rc = mdb_page_search(mc, NULL, MDB_PS_FIRST);
+	while (!rc && *moved < max) {
+		for (i=0; i<mc->mc_snum; i++) {
+			if (mc->mc_pg[i]->mp_pgno >= limit && !IS_WRITABLE(mc->mc_txn, mc->mc_pg[i]))
+				break;
+		}
+		/* The sub-DB record is in the parent's leaf, which must be writable too */
+		if (parent && i < mc->mc_snum && (rc = mdb_cursor_touch(parent)))
+			break;
+		if ((rc = mdb_compact_path(mc, limit, moved)))
+			break;
+		mp = mc->mc_pg[mc->mc_top];
+		if (!parent && !IS_LEAF2(mp)) {
+			for (i=0; i<NUMKEYS(mp) && !rc; i++) {
+				ni = NODEPTR(mc->mc_pg[mc->mc_top], i);
+				if (ni->mn_flags & F_BIGDATA)
+					rc = mdb_compact_ovpage(mc, i, limit, moved);
+				else if ((ni->mn_flags & (F_SUBDATA|F_DUPDATA)) == (F_SUBDATA|F_DUPDATA)) {
+					mc->mc_ki[mc->mc_top] = i;
+					mdb_xcursor_init1(mc, ni);
+					rc = mdb_compact_walk(&mc->mc_xcursor->mx_cursor, mc, i, limit, max, moved);
+				}
+			}
+			if (rc)
+				break;
+		}
+		rc = mdb_cursor_sibling(mc, 1);
+	}
+	if (rc == MDB_NOTFOUND)
+		rc = MDB_SUCCESS;
+	if (!rc && parent && *moved != before) {
+		/* Save the new root of the sub-DB */
+		ni = NODEPTR(parent->mc_pg[parent->mc_top], pi);
+		memcpy(NODEDATA(ni), &parent->mc_xcursor->mx_db, sizeof(MDB_db));
+	}
+	return rc;
+}
+
+int ESECT
+mdb_env_compact_step(MDB_txn *txn, mdb_size_t max, mdb_size_t *moved, mdb_size_t *trimmed)
+{
+	MDB_env *env = txn->mt_env;
+	MDB_cursor mc;
+	MDB_xcursor mx;
+	MDB_val key, data;
+	MDB_dbi dbi;
+	char *names = NULL, *name;
+	size_t size = 0, used = 0;
+	mdb_size_t count = 0, trim;
+	pgno_t limit;
+	int rc;
+
+	if (F_ISSET(txn->mt_flags, MDB_TXN_RDONLY) || txn->mt_parent)
+		return EINVAL;
+	if (txn->mt_flags & MDB_TXN_BLOCKED)
+		return MDB_BAD_TXN;
+	if (MDB_REMAPPING(env->me_flags))
+		return MDB_INCOMPATIBLE;
+
+	if ((rc = mdb_freelist_load(txn)))
+		goto fail;
+	trim = mdb_freelist_trim(txn);
+	/* Pages past this are moved to free pages before it */
+	limit = txn->mt_next_pgno - (env->me_pghead ? env->me_pghead[0] : 0);
+	if (limit < txn->mt_next_pgno) {
+		/* Collect the names first, moving pages of named DBs modifies the main DB */
+		if (!(txn->mt_dbs[MAIN_DBI].md_flags & (MDB_DUPSORT|MDB_INTEGERKEY))) {
+			mdb_cursor_init(&mc, txn, MAIN_DBI, NULL);
+			rc = mdb_cursor_first(&mc, &key, &data);
+			while (!rc) {
+				MDB_node *ni = NODEPTR(mc.mc_pg[mc.mc_top], mc.mc_ki[mc.mc_top]);
+				/* Names are stored with their terminating NUL */
+				if ((ni->mn_flags & F_SUBDATA) && key.mv_size &&
+						memchr(key.mv_data, 0, key.mv_size) == (char *)key.mv_data + key.mv_size - 1) {
+					if (used + key.mv_size > size) {
+						size = (used + key.mv_size) * 2;
+						if (!(name = realloc(names, size))) {
+							rc = ENOMEM;
+							goto fail;
+						}
+						names = name;
+					}
+					memcpy(names + used, key.mv_data, key.mv_size);
+					used += key.mv_size;
+				}
+				rc = mdb_cursor_next(&mc, &key, &data, MDB_NEXT);
+			}
+			if (rc != MDB_NOTFOUND)
+				goto fail;
+			rc = MDB_SUCCESS;
+		}
+		for (name = names; name < names + used && count < max; name += strlen(name) + 1) {
+			if ((rc = mdb_dbi_open(txn, name, 0, &dbi))) {
+				if (rc == MDB_NOTFOUND || rc == MDB_INCOMPATIBLE || rc == MDB_DBS_FULL)
+					continue;
+				goto fail;
+			}
+			mdb_cursor_init(&mc, txn, dbi, &mx);
+			if ((rc = mdb_compact_walk(&mc, NULL, 0, limit, max, &count)))
+				goto fail;
+		}
+		if (count < max) {
+			mdb_cursor_init(&mc, txn, MAIN_DBI, &mx);
+			if ((rc = mdb_compact_walk(&mc, NULL, 0, limit, max, &count)))
+				goto fail;
+		}
+	}
+	/* This only lowers mt_next_pgno. The file can't be truncated until
+	 * a meta page with the new size is durable, since the last committed
+	 * meta still covers the trimmed pages.
+	 */
+	trim += mdb_freelist_trim(txn);
+	if (moved)
+		*moved = count;
+	if (trimmed)
+		*trimmed = trim;
+	if (trim || count)
+		txn->mt_flags |= MDB_TXN_DIRTY;
+	free(names);
+	return MDB_SUCCESS;
+
+fail:
+	free(names);
+	txn->mt_flags |= MDB_TXN_ERROR;
+	return rc;
+}
+
+int ESECT
+mdb_env_set_flags(MDB_env *env, unsigned int flag, int onoff)
+{
+	if (flag & ~CHANGEABLE)
+		return EINVAL;
+	if (onoff)
+		env->me_flags |= flag;
+	else
+		env->me_flags &= ~flag;
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_env_get_flags(MDB_env *env, unsigned int *arg)
+{
+	if (!env || !arg)
+		return EINVAL;
+
+	*arg = env->me_flags & EXPOSED;
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_env_set_userctx(MDB_env *env, void *ctx)
+{
+	if (!env)
+		return EINVAL;
+	if (ctx)
+		env->me_userctx = ctx;
+	return MDB_SUCCESS;
+}
+
+void * ESECT
+mdb_env_get_userctx(MDB_env *env)
+{
+	return env ? env->me_userctx : NULL;
+}
+
+int ESECT
+mdb_env_set_assert(MDB_env *env, MDB_assert_func *func)
+{
+	if (!env)
+		return EINVAL;
+#ifndef NDEBUG
+	env->me_assert_func = func;
+#endif
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_env_set_callback(MDB_env *env, MDB_check_fd *func)
+{
+	if (!env)
+		return EINVAL;
+	env->me_callback = func;
+	return MDB_SUCCESS;
+}
+
+#if MDB_RPAGE_CACHE
+int ESECT
+mdb_env_set_encrypt(MDB_env *env, MDB_enc_func *func, const MDB_val *key, unsigned int size)
+{
+	char *kdata;
+
+	if (!env || !func || !key)
+		return EINVAL;
+	if (env->me_flags & MDB_ENV_ACTIVE)
+		return EINVAL;
+	if (! (kdata = malloc(key[0].mv_size)))
+		return ENOMEM;
+
+	memcpy(kdata,  key->mv_data, key->mv_size);
+	free(env->me_enckey.mv_data);
+	env->me_enckey.mv_data = kdata;
+	env->me_enckey.mv_size = key->mv_size;
+	env->me_encfunc = func;
+	if (size)
+		env->me_esumsize = size;
+	env->me_flags |= MDB_REMAP_CHUNKS | MDB_ENCRYPT;
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_env_set_checksum(MDB_env *env, MDB_sum_func *func, unsigned int size)
+{
+	if (!env || !func || !size)
+		return EINVAL;
+	if (env->me_flags & MDB_ENV_ACTIVE)
+		return EINVAL;
+	env->me_sumfunc = func;
+	env->me_sumsize = size;
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_env_set_rpage_cache(MDB_env *env, unsigned int env_chunks, unsigned int txn_chunks)
+{
+	if (!env)
+		return EINVAL;
+	if (env->me_flags & MDB_ENV_ACTIVE)
+		return EINVAL;
+	/* a write txn can keep many chunks referenced through its cursors */
+	if (txn_chunks && txn_chunks < 256)
+		txn_chunks = 256;
+	env->me_rpsize = env_chunks ? env_chunks : MDB_ERPAGE_SIZE;
+	env->me_trpsize = txn_chunks ? txn_chunks : MDB_TRPAGE_SIZE;
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_env_rpage_stat(MDB_env *env, MDB_rpage_stat *stat)
+{
+	MDB_ID3L el;
+	unsigned int x;
+	if (!env || !stat || !env->me_rpages)
+		return EINVAL;
+	el = env->me_rpages;
+	pthread_mutex_lock(&env->me_rpmutex);
+	stat->ms_hits = env->me_rphits;
+	stat->ms_misses = env->me_rpmisses;
+	stat->ms_evictions = env->me_rpevictions;
+	stat->ms_decrypts = env->me_rpdecrypts;
+	stat->ms_chunks = el[0].mid;
+	stat->ms_mapped = 0;
+	for (x = 1; x <= env->me_rpmask + 1; x++) {
+		if (el[x].mptr)
+			stat->ms_mapped += (mdb_size_t)el[x].mcnt * env->me_psize;
+	}
+	pthread_mutex_unlock(&env->me_rpmutex);
+	stat->ms_env_chunks = env->me_rpsize;
+	stat->ms_txn_chunks = env->me_trpsize;
+	return MDB_SUCCESS;
+}
+#endif
 
 int ESECT
 mdb_env_get_path(MDB_env *env, const char **arg)
@@ -11950,6 +13037,14 @@ mdb_env_info(MDB_env *env, MDB_envinfo *arg)
 	return MDB_SUCCESS;
 }
 
+volatile mdb_size_t * ESECT
+mdb_env_last_txnid_address(MDB_env *env)
+{
+	if (env == NULL || !env->me_txns)
+		return NULL;
+	return &env->me_txns->mti_txnid;
+}
+
 /** Set the default comparison functions for a database.
  * Called immediately after a database is opened to set the defaults.
  * The user can then override them with #mdb_set_compare() or
@@ -11965,6 +13060,7 @@ mdb_default_cmp(MDB_txn *txn, MDB_dbi dbi)
 	txn->mt_dbxs[dbi].md_cmp =
 		(f & MDB_REVERSEKEY) ? mdb_cmp_memnr :
 		(f & MDB_INTEGERKEY) ? mdb_cmp_cint  : mdb_cmp_memn;
+	txn->mt_dbxs[dbi].md_lexical = txn->mt_dbxs[dbi].md_cmp == mdb_cmp_memn;
 
 	txn->mt_dbxs[dbi].md_dcmp =
 		!(f & MDB_DUPSORT) ? 0 :
@@ -12135,6 +13231,18 @@ int mdb_dbi_flags(MDB_txn *txn, MDB_dbi dbi, unsigned int *flags)
 	return MDB_SUCCESS;
 }
 
+int mdb_dbi_dirty(MDB_txn *txn, MDB_dbi dbi)
+{
+	if (!TXN_DBI_EXIST(txn, dbi, DB_USRVALID))
+		return EINVAL;
+	/* A child txn starts with the parent's DB records, so check the parents too */
+	for (; txn; txn = txn->mt_parent) {
+		if (dbi < txn->mt_numdbs && (txn->mt_dbflags[dbi] & DB_DIRTY))
+			return MDB_SUCCESS;
+	}
+	return MDB_NOTFOUND;
+}
+
 /** Add all the DB's pages to the free list.
  * @param[in] mc Cursor on the DB to free.
  * @param[in] subs non-Zero to check for sub-DBs in this DB.
@@ -12294,6 +13402,17 @@ int mdb_set_compare(MDB_txn *txn, MDB_dbi dbi, MDB_cmp_func *cmp)
 		return EINVAL;
 
 	txn->mt_dbxs[dbi].md_cmp = cmp;
+	txn->mt_dbxs[dbi].md_lexical = 0;
+	return MDB_SUCCESS;
+}
+
+int mdb_set_lexical_compare(MDB_txn *txn, MDB_dbi dbi, MDB_cmp_func *cmp)
+{
+	if (!TXN_DBI_EXIST(txn, dbi, DB_USRVALID))
+		return EINVAL;
+
+	txn->mt_dbxs[dbi].md_cmp = cmp;
+	txn->mt_dbxs[dbi].md_lexical = 1;
 	return MDB_SUCCESS;
 }
 
@@ -12368,6 +13487,165 @@ mdb_reader_list(MDB_env *env, MDB_msg_func *func, void *ctx)
 	return rc;
 }
 
+int ESECT
+mdb_reader_count(MDB_env *env, unsigned int *used, unsigned int *active)
+{
+	unsigned int i, rdrs;
+	MDB_reader *mr;
+
+	if (!env || !used || !active)
+		return EINVAL;
+	*used = *active = 0;
+	if (!env->me_txns)
+		return MDB_SUCCESS;
+	rdrs = env->me_txns->mti_numreaders;
+	mr = env->me_txns->mti_readers;
+	for (i=0; i<rdrs; i++) {
+		if (mr[i].mr_pid) {
+			(*used)++;
+			if (mr[i].mr_txnid != (txnid_t)-1)
+				(*active)++;
+		}
+	}
+	return MDB_SUCCESS;
+}
+
+/** Read a page and, down to \b depth, its children, so they are in the OS cache */
+static int ESECT
+mdb_warm_page(MDB_cursor *mc, pgno_t pgno, unsigned int depth, MDB_warm_func *func, void *ctx, mdb_size_t *count)
+{
+	MDB_env *env = mc->mc_txn->mt_env;
+	MDB_page *mp;
+	unsigned int i, n;
+	volatile char touched = 0;
+	int rc;
+
+	if ((rc = MDB_PAGE_GET(mc, pgno, 1, &mp)))
+		return rc;
+	/* touch each OS page, so the faults happen in this thread */
+	for (i = 0; i < env->me_psize; i += env->me_os_psize)
+		touched += ((char *)mp)[i];
+	rc = func(++*count, ctx);
+	if (!rc && IS_BRANCH(mp) && depth > 1) {
+		n = NUMKEYS(mp);
+		for (i = 0; i < n && !rc; i++)
+			rc = mdb_warm_page(mc, NODEPGNO(NODEPTR(mp, i)), depth - 1, func, ctx, count);
+	}
+	MDB_PAGE_UNREF(mc->mc_txn, mp);
+	return rc;
+}
+
+/** Read the top levels of a tree, or all of its pages (except overflow pages) */
+static int ESECT
+mdb_warm_tree(MDB_cursor *mc, MDB_db *db, unsigned int levels, int leaves, MDB_warm_func *func, void *ctx, mdb_size_t *count)
+{
+	unsigned int depth = db->md_depth;
+	if (db->md_root == P_INVALID)
+		return MDB_SUCCESS;
+	if (!leaves) {
+		/* leave out the leaf level */
+		if (depth <= 1)
+			return MDB_SUCCESS;
+		depth--;
+		if (depth > levels)
+			depth = levels;
+	}
+	return mdb_warm_page(mc, db->md_root, depth, func, ctx, count);
+}
+
+int ESECT
+mdb_txn_warm(MDB_txn *txn, unsigned int levels, MDB_warm_db_func *dbfunc, MDB_warm_func *func, void *ctx)
+{
+	MDB_cursor mc;
+	MDB_val key, data;
+	MDB_db db;
+	mdb_size_t count = 0;
+	int rc, leaves;
+
+	if (!txn || !dbfunc || !func)
+		return EINVAL;
+	if (txn->mt_flags & MDB_TXN_BLOCKED)
+		return MDB_BAD_TXN;
+	mdb_cursor_init(&mc, txn, MAIN_DBI, NULL);
+	leaves = dbfunc(NULL, ctx);
+	if (leaves < 0)
+		return MDB_SUCCESS;
+	rc = mdb_warm_tree(&mc, &txn->mt_dbs[MAIN_DBI], levels, leaves, func, ctx, &count);
+	if (rc || (txn->mt_dbs[MAIN_DBI].md_flags & (MDB_DUPSORT|MDB_INTEGERKEY)))
+		return rc;
+	/* the named databases are the nodes of the main database with F_SUBDATA */
+	for (rc = mdb_cursor_get(&mc, &key, &data, MDB_FIRST); !rc;
+		rc = mdb_cursor_get(&mc, &key, &data, MDB_NEXT)) {
+		MDB_node *node = NODEPTR(mc.mc_pg[mc.mc_top], mc.mc_ki[mc.mc_top]);
+		if ((node->mn_flags & (F_DUPDATA|F_SUBDATA)) != F_SUBDATA || data.mv_size != sizeof(MDB_db))
+			continue;
+		memcpy(&db, data.mv_data, sizeof(MDB_db));
+		leaves = dbfunc(&key, ctx);
+		if (leaves < 0)
+			break;
+		if ((rc = mdb_warm_tree(&mc, &db, levels, leaves, func, ctx, &count)))
+			break;
+	}
+	MDB_CURSOR_UNREF(&mc, 1);
+	return rc == MDB_NOTFOUND ? MDB_SUCCESS : rc;
+}
+
+/** Report the separator keys of a branch page and, down to \b depth, of its children, in key order */
+static int ESECT
+mdb_boundaries_page(MDB_cursor *mc, pgno_t pgno, unsigned int depth, MDB_boundary_func *func, void *ctx)
+{
+	MDB_page *mp;
+	MDB_node *node;
+	MDB_val key;
+	unsigned int i, n;
+	int rc;
+
+	if ((rc = MDB_PAGE_GET(mc, pgno, 1, &mp)))
+		return rc;
+	n = IS_BRANCH(mp) ? NUMKEYS(mp) : 0;
+	for (i = 0; i < n && !rc; i++) {
+		node = NODEPTR(mp, i);
+		/* the first node of a branch page has no key, its lower bound is in the parent */
+		if (i > 0) {
+			key.mv_size = NODEKSZ(node);
+			key.mv_data = NODEKEY(node);
+			rc = func(&key, ctx);
+		}
+		if (!rc && depth > 1)
+			rc = mdb_boundaries_page(mc, NODEPGNO(node), depth - 1, func, ctx);
+	}
+	MDB_PAGE_UNREF(mc->mc_txn, mp);
+	return rc;
+}
+
+int ESECT
+mdb_dbi_boundaries(MDB_txn *txn, MDB_dbi dbi, unsigned int levels, MDB_boundary_func *func, void *ctx)
+{
+	MDB_cursor mc;
+	MDB_xcursor mx;
+	MDB_db *db;
+	unsigned int depth;
+	int rc;
+
+	if (!func || !TXN_DBI_EXIST(txn, dbi, DB_USRVALID))
+		return EINVAL;
+	if (txn->mt_flags & MDB_TXN_BLOCKED)
+		return MDB_BAD_TXN;
+	/* this also loads the record of a named database */
+	mdb_cursor_init(&mc, txn, dbi, &mx);
+	db = &txn->mt_dbs[dbi];
+	rc = MDB_SUCCESS;
+	if (db->md_root != P_INVALID && db->md_depth > 1) {
+		/* the level above the leaves is the deepest with separator keys */
+		depth = db->md_depth - 1;
+		if (depth > levels)
+			depth = levels;
+		rc = mdb_boundaries_page(&mc, db->md_root, depth, func, ctx);
+	}
+	MDB_CURSOR_UNREF(&mc, 1);
+	return rc;
+}
+
 /** Insert pid into list if not already present.
  * return -1 if already present.
  */
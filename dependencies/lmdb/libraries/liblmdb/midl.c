@@ -386,6 +386,78 @@ int mdb_mid2l_need( MDB_ID2L *idp, unsigned num )
 	return 0;
 }
 
+int mdb_runl_build( MDB_RUNL *rl, MDB_IDL ids )
+{
+	MDB_ID *start;
+	unsigned *max;
+	unsigned i, j, n = 0, leaves;
+
+	/* Count the runs, the IDL is descending so they are found in ascending order from the end */
+	for (i = (unsigned)ids[0]; i; i--) {
+		if (i == ids[0] || ids[i+1] + 1 != ids[i])
+			n++;
+	}
+	for (leaves = 1; leaves < n; leaves <<= 1) ;
+	if (leaves > rl->mr_alloc) {
+		if (!(start = realloc(rl->mr_start, leaves * sizeof(MDB_ID))))
+			return ENOMEM;
+		rl->mr_start = start;
+		if (!(max = realloc(rl->mr_max, 2 * leaves * sizeof(unsigned))))
+			return ENOMEM;
+		rl->mr_max = max;
+		rl->mr_alloc = leaves;
+	}
+	start = rl->mr_start;
+	max = rl->mr_max;
+	memset(max, 0, 2 * leaves * sizeof(unsigned));
+	for (i = (unsigned)ids[0], j = 0; i; i--) {
+		if (i == ids[0] || ids[i+1] + 1 != ids[i]) {
+			start[j] = ids[i];
+			max[leaves + j++] = 1;
+		} else
+			max[leaves + j - 1]++;
+	}
+	for (i = leaves - 1; i; i--)
+		max[i] = max[2*i] > max[2*i+1] ? max[2*i] : max[2*i+1];
+	rl->mr_ids = ids;
+	rl->mr_len = ids[0];
+	rl->mr_count = n;
+	rl->mr_leaves = leaves;
+	return 0;
+}
+
+unsigned mdb_runl_find( MDB_RUNL *rl, unsigned num )
+{
+	unsigned *max = rl->mr_max, i = 1;
+
+	if (!rl->mr_count || max[1] < num)
+		return 0;
+	/* Descend to the leftmost (lowest) leaf that is long enough */
+	while (i < rl->mr_leaves)
+		i = max[2*i] >= num ? 2*i : 2*i+1;
+	return i - rl->mr_leaves + 1;
+}
+
+MDB_ID mdb_runl_take( MDB_RUNL *rl, unsigned run, unsigned num )
+{
+	unsigned *max = rl->mr_max, i = rl->mr_leaves + run - 1;
+	MDB_ID id = rl->mr_start[run-1];
+
+	rl->mr_start[run-1] += num;
+	rl->mr_len -= num;
+	max[i] -= num;
+	for (i >>= 1; i; i >>= 1)
+		max[i] = max[2*i] > max[2*i+1] ? max[2*i] : max[2*i+1];
+	return id;
+}
+
+void mdb_runl_free( MDB_RUNL *rl )
+{
+	free(rl->mr_start);
+	free(rl->mr_max);
+	memset(rl, 0, sizeof(*rl));
+}
+
 #if MDB_RPAGE_CACHE
 unsigned mdb_mid3l_search( MDB_ID3L ids, MDB_ID id )
 {
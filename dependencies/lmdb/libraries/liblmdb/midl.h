@@ -184,6 +184,53 @@ void mdb_mid2l_free(MDB_ID2L ids);
 
 int mdb_mid2l_need( MDB_ID2L *idp, unsigned num );
 
+	/** A run index of an IDL, for finding a run of consecutive IDs of a
+	 * given length without scanning the IDL. The runs are kept in ascending
+	 * order, with a max tree of their lengths, so the lowest run that is
+	 * long enough is found in O(log n). It is only valid for the IDL (and
+	 * length of it) that it was built from, and must be rebuilt (or taken
+	 * from) as the IDL changes.
+	 */
+typedef struct MDB_RUNL {
+	MDB_IDL		mr_ids;		/**< The IDL the index was built from, or NULL */
+	MDB_ID		mr_len;		/**< The length of the IDL */
+	unsigned	mr_count;	/**< The number of runs */
+	unsigned	mr_leaves;	/**< The number of leaves in the tree, a power of two */
+	unsigned	mr_alloc;	/**< The number of leaves allocated */
+	MDB_ID		*mr_start;	/**< The lowest ID of each run */
+	unsigned	*mr_max;	/**< The max tree, the leaves are the run lengths */
+} MDB_RUNL;
+
+	/** Build a run index of a (descending) IDL.
+	 * @param[in,out] rl	The run index.
+	 * @param[in] ids	The IDL to index.
+	 * @return	0 on success, ENOMEM on failure.
+	 */
+int mdb_runl_build( MDB_RUNL *rl, MDB_IDL ids );
+
+	/** Find the lowest run with at least num IDs.
+	 * @param[in] rl	The run index.
+	 * @param[in] num	The number of IDs.
+	 * @return	The position of the run plus one, or 0 if there is none.
+	 */
+unsigned mdb_runl_find( MDB_RUNL *rl, unsigned num );
+
+	/** Take the lowest num IDs of a run, the caller removes them from the IDL.
+	 * @param[in,out] rl	The run index.
+	 * @param[in] run	The position of the run plus one, from #mdb_runl_find().
+	 * @param[in] num	The number of IDs.
+	 * @return	The lowest ID that was taken.
+	 */
+MDB_ID mdb_runl_take( MDB_RUNL *rl, unsigned run, unsigned num );
+
+	/** Free the memory of a run index.
+	 * @param[in,out] rl	The run index.
+	 */
+void mdb_runl_free( MDB_RUNL *rl );
+
+	/** Invalidate a run index, after its IDL is changed. */
+#define mdb_runl_reset(rl)	((rl)->mr_ids = NULL)
+
 #if MDB_RPAGE_CACHE
 typedef struct MDB_ID3 {
 	MDB_ID mid;		/**< The ID */
@@ -192,6 +239,7 @@ typedef struct MDB_ID3 {
 	unsigned int mcnt;		/**< Number of pages */
 	unsigned short mref;	/**< Refcounter */
 	unsigned short muse;	/**< Bitmap of used pages */
+	unsigned short mhead;	/**< Bitmap of pages decrypted as the start of a page */
 } MDB_ID3;
 
 typedef MDB_ID3 *MDB_ID3L;
@@ -57,6 +57,12 @@ declare namespace lmdb {
 		* @param ids The keys for the entries to get
 		**/
 		getMany(ids: K[], callback?: (error: any, values: V[]) => any): Promise<(V | undefined)[]>
+		/**
+		* Asynchronously get the selected fields of the values stored by the given ids, as columns in the order of the ids.
+		* @param ids The keys for the entries to get
+		* @param options The fields to read
+		**/
+		getMany(ids: K[], options: { columns: string[] }, callback?: (error: any, values: ColumnBatch<K>) => any): Promise<ColumnBatch<K>>
 
 		/**
 		* Store the provided value, using the provided id/key
@@ -154,6 +160,7 @@ declare namespace lmdb {
 		* existing version
 		* @param options The options for the range/iterator
 		**/
+		getRange(options: RangeOptions & { columns: string[] }): RangeIterable<ColumnBatch<K>>
 		getRange(options?: RangeOptions): RangeIterable<{ key: K, value: V, version?: number }>
 		/**
 		* Get the count of all the entries for the given range
@@ -253,6 +260,55 @@ declare namespace lmdb {
 		* Synchronously clear all the entries from this database/store.
 		**/
 		clearSync(): void
+		/**
+		* Atomically add to the number stored at the key (a missing entry counts as zero), computing the new value in the
+		* write thread. Only supported with msgpack encoding. Resolves to false if the existing value is not a number.
+		* @param key The key of the entry
+		* @param delta The number to add
+		* @param version The version to set for the entry (if using versions)
+		**/
+		addToValue(id: K, delta: number, version?: number): Promise<boolean>
+		/**
+		* Atomically replace the value at the key if the existing (encoded) value is the same as the expected value,
+		* comparing in the write thread. Resolves to true if the value was replaced.
+		* @param key The key of the entry
+		* @param expectedValue The expected existing value, or undefined if the entry is expected to not exist
+		* @param value The new value
+		* @param version The version to set for the entry (if using versions)
+		**/
+		compareAndSwap(id: K, expectedValue: V | undefined, value: V, version?: number): Promise<boolean>
+		/**
+		* Atomically append the bytes of the (encoded) value to the existing value at the key, in the write thread.
+		* This is intended for binary or string encoded databases.
+		* @param key The key of the entry
+		* @param value The value to append
+		* @param version The version to set for the entry (if using versions)
+		**/
+		appendToValue(id: K, value: V, version?: number): Promise<boolean>
+		/**
+		* Merge the operand into the value at the key with a native merge operator, computing the new value in the write
+		* thread. Built-in operators are 'add' and 'max' (numbers), 'union' (sorted sets of scalar values in arrays),
+		* and 'append' (lists of scalar values, optionally bounded by maxLength). Only supported with msgpack encoding.
+		* Resolves to false if the existing value can not be merged.
+		* @param key The key of the entry
+		* @param operator The name of the merge operator
+		* @param operand The value to merge into the existing value
+		**/
+		merge(id: K, operator: 'add' | 'max' | 'union' | 'append' | string, operand: any, options?: { maxLength?: number, version?: number }): Promise<boolean>
+		/**
+		* Execute the writes (puts and removes) in the callback as a single batch, without tracking a result for each
+		* write (the writes return undefined). Returns a promise that resolves once the batch is committed, with the
+		* transaction id and a bitmap of the operations that failed (by the order they were written in the callback).
+		* The callback must be synchronous.
+		**/
+		batchWithoutResults(callback: () => void): Promise<{ txnId: number, failedCount: number, failed: Uint32Array }>
+		/**
+		* Load a large number of entries, in any order, into this database. The entries are sorted in runs in separate
+		* threads (spilling runs to temporary files once the memory limit is reached), and then merged and appended to the database.
+		* Returns a promise for the number of entries that were loaded.
+		* @param entries An iterable or async iterable of the entries to load
+		**/
+		bulkLoad(entries: Iterable<{ key: K, value: V, version?: number }> | AsyncIterable<{ key: K, value: V, version?: number }>, options?: BulkLoadOptions): Promise<number>
 		/** A promise-like object that resolves when previous writes have been committed.  */
 		committed: Promise<boolean>
 		/** A promise-like object that resolves when previous writes have been committed and fully flushed/synced to disk/storage.  */
@@ -267,8 +323,46 @@ declare namespace lmdb {
 		readerList(): string
 		/**
 		* Returns statistics about the current database
+		* @param options.freeRuns Read the free pages, to include a histogram of the lengths of runs of contiguous free pages
+		**/
+		getStats(options?: { freeRuns?: boolean }): {}
+		/**
+		* Returns a snapshot of the latency histograms of operations, if the database was opened with trackMetrics
+		* @param reset Reset the histograms after reading them
+		**/
+		getLatencyHistograms(reset?: boolean): { [operation: string]: LatencyHistogram } | undefined
+		/**
+		* Wait for a transaction to be committed (by any thread or process) after the given transaction id
+		* @param afterTxnId The transaction id to wait for a commit after, defaults to the last committed transaction
+		* @param timeout The maximum time to wait in milliseconds, defaults to waiting indefinitely
+		**/
+		waitForCommit(afterTxnId?: number, timeout?: number): Promise<CommitNotification>
+		/**
+		* Read the top levels of the B-trees of every database (and all the pages of hot databases) in a worker thread, so they are in the OS page cache
 		**/
-		getStats(): {}
+		warm(options?: WarmOptions): Promise<{ pages: number, bytes: number, cancelled: boolean }>
+		/**
+		* Stop any warming that is in progress
+		**/
+		cancelWarm(): void
+		/** The warming started with the warm option, when the database was opened */
+		warmed?: Promise<{ pages: number, bytes: number, cancelled: boolean }>
+		/**
+		* Export the keys and fixed-offset numbers of the values of a range into typed arrays, reading sub-ranges on multiple threads
+		* @param start The first key of the range, or undefined to start from the first entry
+		* @param end The key to stop before, or undefined to export to the last entry
+		* @param schema The arrays to fill
+		**/
+		exportRange(start: K | undefined, end: K | undefined, schema: ExportSchema<K>): Promise<{ count: number, more: boolean }>
+		/**
+		* Get the changes that were committed since the given transaction id, if the changeLog option is enabled
+		* @param startTxnId The transaction id to start from
+		**/
+		getChanges(startTxnId?: number, options?: RangeOptions): RangeIterable<Change>
+		/**
+		* Remove the changes of transactions before the given transaction id from the change log
+		**/
+		pruneChanges(beforeTxnId: number): Promise<boolean>
 		/**
 		* Explicitly force the read transaction to reset to the latest snapshot/version of the database
 		**/
@@ -280,6 +374,18 @@ declare namespace lmdb {
 		**/
 		backup(path: string, compact: boolean): Promise<void>
 		/**
+		* Make an incremental backup of the pages that were written after the given transaction, in a background thread
+		* @param path Path to store the backup
+		* @param sinceTxnId The transaction id of the previous backup, or omit to include all the pages in use
+		**/
+		backupIncremental(path: string, sinceTxnId?: number): Promise<{ txnId: number, pages: number }>
+		/**
+		* Compact the database file while it is in use, by moving pages from the end of the file into free pages, in a series of write transactions, and truncating the file
+		* @param options.maxPages The maximum number of pages to move in each transaction (default 1000)
+		* @param options.delay The delay in milliseconds between transactions (default 10)
+		**/
+		compact(options?: { maxPages?: number, delay?: number }): Promise<{ moved: number, trimmed: number, steps: number }>
+		/**
 		* Close the current database.
 		**/
 		close(): Promise<void>
@@ -320,6 +426,8 @@ declare namespace lmdb {
 		keyEncoding?: 'uint32' | 'binary' | 'ordered-binary'
 		dupSort?: boolean
 		strictAsyncOrder?: boolean
+		/** Enables a negative lookup filter of the keys, so gets of keys that don't exist don't need to search the database */
+		keyFilter?: boolean | { bitsPerKey?: number }
 	}
 	interface RootDatabaseOptions extends DatabaseOptions {
 		/** The maximum number of databases to be able to open (there is some extra overhead if this is set very high).*/
@@ -338,6 +446,18 @@ declare namespace lmdb {
 		pageSize?: number
 		/** This enables committing transactions where LMDB waits for a transaction to be fully flushed to disk after the transaction has been committed and defaults to being enabled on non-Windows OSes. This option is discussed in more detail below. */
 		overlappingSync?: boolean
+		/** Track timing metrics and latency histograms of operations **/
+		trackMetrics?: boolean
+		/** Cache decompressed values in a native cache shared by all threads, optionally with the size in bytes (default 64MB) **/
+		sharedValueCache?: boolean | number
+		/** Start reading the top levels of every database (and all of the pages of hot databases) into the OS cache in the background when the database is opened, see warm() */
+		warm?: boolean | WarmOptions
+		/** Sample the pages that gets read, save them on close, and read them ahead on the next open, optionally with the number of samples to keep (default 65536) and the interval between sampled gets (default 16) */
+		accessProfile?: boolean | { pages?: number, sampleInterval?: number }
+		/** Publish commits to a notification file shared with other processes, so waitForCommit can wake as soon as a commit happens, with the databases that were written **/
+		commitNotifications?: boolean
+		/** Record committed writes in a change log, which can be read with getChanges, optionally including the values **/
+		changeLog?: boolean | { values?: boolean }
 		/** Resolve asynchronous operations when commits are finished and visible and include a separate promise for when a commit is flushed to disk, as a flushed property on the commit promise. Note that you can alternately use the flushed property on the database. */
 		separateFlushed?: boolean
 		/** 
@@ -345,6 +465,10 @@ declare namespace lmdb {
 		 * This is enabled by default on 32-bit operating systems (which require this to go beyond 4GB database size) if mapSize is not specified, otherwise it is disabled by default.
 		 **/
 		remapChunks?: boolean
+		/** With remapChunks, the number of chunks (of 16 pages) that are kept mapped (and decrypted) for reuse by all transactions, defaults to 16384 */
+		remapCacheChunks?: number
+		/** With remapChunks, the number of chunks a single transaction can reference, defaults to 4096 */
+		remapTxnCacheChunks?: number
 		/** This provides a small performance boost (when not using useWritemap) for writes, by skipping zero'ing out malloc'ed data, but can leave application data in unused portions of the database. This is recommended unless there are concerns of database files being accessible. */
 		noMemInit?: boolean
 		/** Use writemaps, discouraged at this. This improves performance by reducing malloc calls, but it is possible for a stray pointer to corrupt data. */
@@ -364,6 +488,10 @@ declare namespace lmdb {
 		maxReaders?: number
 		/** This enables encryption, and the provided value is the key that is used for encryption. This may be a buffer or string, but must be 32 bytes/characters long. This uses the Chacha8 cipher for fast and secure on-disk encryption of data. */
 		encryptionKey?: string | Buffer
+		/** The cipher used with encryptionKey, chacha20 uses 20 rounds instead of 8. The same cipher must be used every time the database is opened. Defaults to chacha8. */
+		encryptionCipher?: 'chacha8' | 'chacha20'
+		/** Stores a CRC32C checksum in each page, which is verified when the page is first read. A database created with checksums must always be opened with checksums. */
+		checksum?: boolean
 		/**
 		 * This is enabled by default and will ensure that all asynchronous write operations performed in the same event turn will be batched together into the same transaction.
 		 * Disabling this allows lmdb-js to commit a transaction at any time, and asynchronous operations will only be guaranteed to be in the same transaction if explicitly batched together (with transaction, batch, ifVersion).
@@ -378,6 +506,8 @@ declare namespace lmdb {
 	interface CompressionOptions {
 		threshold?: number
 		dictionary?: Buffer
+		/** The size (in bytes) of a cache of decompressed values, so frequently read values are not repeatedly decompressed (disabled by default, not used with remapChunks or encryption) */
+		cacheSize?: number
 	}
 	interface GetOptions {
 		transaction?: Transaction
@@ -399,6 +529,27 @@ declare namespace lmdb {
 		snapshot?: boolean
 		/** Use the provided transaction for this range query */
 		transaction?: Transaction
+		/** Read only these fields of the values, in batches of columns, instead of each entry **/
+		columns?: string[]
+		/** The number of entries in each batch of columns (default 1024) **/
+		batchSize?: number
+	}
+	interface ColumnBatch<K> {
+		/** The number of entries in the batch */
+		count: number
+		/** The keys of the entries (not included for getMany) */
+		keys?: K[]
+		/** The values of each field, a Float64Array if every value is a number */
+		columns: { [field: string]: Float64Array | any[] }
+	}
+	type ExportArray = Int8Array | Uint8Array | Int16Array | Uint16Array | Int32Array | Uint32Array | Float32Array | Float64Array | BigInt64Array | BigUint64Array
+	interface ExportSchema<K> {
+		/** The array to fill with the keys (uint32 keys are converted natively) */
+		keys?: ExportArray | K[]
+		/** The columns to fill, with the byte offset of each number in the values */
+		columns?: { [name: string]: { array: ExportArray, offset: number, bigEndian?: boolean } }
+		/** The number of threads to read sub-ranges on (default 4) */
+		threads?: number
 	}
 	interface PutOptions {
 		/* Append to the database using MDB_APPEND, which can be faster */
@@ -412,6 +563,58 @@ declare namespace lmdb {
 		/* The version of the entry to set */
 		version?: number
 	}
+	interface LatencyHistogram {
+		/** The number of recorded operations */
+		count: number
+		/** The latencies, in seconds */
+		mean: number
+		max: number
+		p50: number
+		p90: number
+		p99: number
+		p999: number
+	}
+	interface Change {
+		txnId: number
+		operation: 'put' | 'delete' | 'deleteValue' | 'drop'
+		/** The database that was written, if it is open */
+		db?: Database
+		key?: Key
+		version?: number
+		value?: any
+	}
+	interface WarmOptions {
+		/** The number of levels of branch pages to read from the top of each database, defaults to 3 */
+		levels?: number
+		/** The names of databases to read all of the branch and leaf pages of (null for the root database), or true for all databases */
+		hotDbs?: (string | null)[] | true
+		/** Limit the reads to this many bytes per second */
+		bytesPerSecond?: number
+		/** Called periodically with the number of pages and bytes that have been read */
+		onProgress?: (pages: number, bytes: number) => void
+	}
+	interface CommitNotification {
+		/** The id of the last committed transaction (not after afterTxnId if it timed out) */
+		txnId: number
+		/** The databases written by each commit after afterTxnId, from the commit notification ring */
+		commits: { txnId: number, dbi: number }[]
+		/** Whether commits includes every commit after afterTxnId (false if commitNotifications is not enabled or the ring wrapped) */
+		complete: boolean
+		/** Whether this database may have been written */
+		touched: boolean
+	}
+	interface BulkLoadOptions {
+		/* The size of the buffers of entries that are each sorted as a run (defaults to 16MB) */
+		runSize?: number
+		/* The number of runs to sort concurrently (defaults to 4, the default size of the libuv thread pool) */
+		concurrency?: number
+		/* The maximum number of bytes of sorted runs to hold in memory before writing runs to temporary files (defaults to 256MB) */
+		memoryLimit?: number
+		/* The directory for the temporary files of sorted runs (defaults to the system temporary directory) */
+		tempDirectory?: string
+		/* The number of entries to write in each transaction (defaults to 100000) */
+		entriesPerTransaction?: number
+	}
 	export enum TransactionFlags {
 		/* Indicates that the transaction needs to be abortable */
 		ABORTABLE = 1,
@@ -437,6 +640,8 @@ declare namespace lmdb {
 		done(): void
 	}
 	export function getLastVersion(): number
+	/* Apply incremental backups (from backupIncremental) in order to a database that is not open, returning the transaction id it was restored to */
+	export function restoreIncrementalBackup(path: string, backupPaths: string | string[], options?: { noSubdir?: boolean }): number
 	export function compareKeys(a: Key, b: Key): number
 	class Binary {}
 	/* Wrap a Buffer/Uint8Array for direct assignment as a value bypassing any encoding, for put (and doesExist) operations.
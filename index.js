@@ -25,14 +25,14 @@ import { levelup } from './level.js';
 export { clearKeptObjects } from './native.js';
 import { nativeAddon } from './native.js';
 export let { noop } = nativeAddon;
-export { open, openAsClass, getLastVersion, allDbs, getLastTxnId } from './open.js';
+export { open, openAsClass, getLastVersion, allDbs, getLastTxnId, restoreIncrementalBackup } from './open.js';
 import { toBufferKey as keyValueToBuffer, compareKeys as compareKey, fromBufferKey as bufferToKeyValue } from 'ordered-binary';
-import { open, openAsClass, getLastVersion } from './open.js';
+import { open, openAsClass, getLastVersion, restoreIncrementalBackup } from './open.js';
 export const TransactionFlags = {
 	ABORTABLE: 1,
 	SYNCHRONOUS_COMMIT: 2,
 	NO_SYNC_FLUSH: 0x10000,
 };
 export default {
-	open, openAsClass, getLastVersion, compareKey, keyValueToBuffer, bufferToKeyValue, ABORT, IF_EXISTS, asBinary, levelup, TransactionFlags
+	open, openAsClass, getLastVersion, restoreIncrementalBackup, compareKey, keyValueToBuffer, bufferToKeyValue, ABORT, IF_EXISTS, asBinary, levelup, TransactionFlags
 };
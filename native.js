@@ -1,7 +1,7 @@
 import { dirname, join, default as pathModule } from 'path';
 import { fileURLToPath } from 'url';
 import loadNAPI from 'node-gyp-build-optional-packages';
-export let Env, Txn, Dbi, Compression, Cursor, getAddress, getBufferAddress, createBufferForAddress, clearKeptObjects, globalBuffer, setGlobalBuffer, arch, fs, os, onExit, tmpdir, lmdbError, path, EventEmitter, orderedBinary, MsgpackrEncoder, WeakLRUCache, setEnvMap, getEnvMap, getByBinary, detachBuffer, startRead, setReadCallback, write, position, iterate, prefetch, resetTxn, getCurrentValue, getCurrentShared, getStringByBinary, getSharedByBinary, getSharedBuffer, compress;
+export let Env, Txn, Dbi, Compression, Cursor, getAddress, getBufferAddress, createBufferForAddress, clearKeptObjects, globalBuffer, setGlobalBuffer, arch, fs, os, onExit, tmpdir, lmdbError, path, EventEmitter, orderedBinary, MsgpackrEncoder, WeakLRUCache, setEnvMap, getEnvMap, getByBinary, detachBuffer, startRead, setReadCallback, write, position, iterate, prefetch, resetTxn, getCurrentValue, getCurrentShared, getStringByBinary, getSharedByBinary, getSharedBuffer, compress, BulkLoader, getMergeOperators, getByUint32, projectEntries, projectValues, exportRange;
 path = pathModule;
 let dirName = dirname(fileURLToPath(import.meta.url)).replace(/dist$/, '');
 export let nativeAddon = loadNAPI(dirName);
@@ -14,6 +14,11 @@ if (process.isBun && false) {
 			returns: FFIType.u32,
 			ptr: nativeAddon.getByBinaryPtr
 		},
+		getByUint32: {
+			args: [FFIType.f64, FFIType.u32, FFIType.u32, FFIType.f64],
+			returns: FFIType.u32,
+			ptr: nativeAddon.getByUint32Ptr
+		},
 		iterate: {
 			args: [FFIType.f64],
 			returns: FFIType.i32,
@@ -51,6 +56,7 @@ export function setNativeFunctions(externals) {
 	createBufferForAddress = externals.createBufferForAddress;
 	clearKeptObjects = externals.clearKeptObjects || function() {};
 	getByBinary = externals.getByBinary;
+	getByUint32 = externals.getByUint32;
 	detachBuffer  = externals.detachBuffer;
 	startRead = externals.startRead;
 	setReadCallback = externals.setReadCallback;
@@ -68,6 +74,11 @@ export function setNativeFunctions(externals) {
 	write = externals.write;
 	compress = externals.compress;
 	Cursor = externals.Cursor;
+	BulkLoader = externals.BulkLoader;
+	getMergeOperators = externals.getMergeOperators;
+	projectEntries = externals.projectEntries;
+	projectValues = externals.projectValues;
+	exportRange = externals.exportRange;
 	lmdbError = externals.lmdbError;
 	if (externals.tmpdir)
         tmpdir = externals.tmpdir
@@ -12,7 +12,7 @@ export function setRequire(require) {
 setGetLastVersion(getLastVersion, getLastTxnId);
 let keyBytes, keyBytesView;
 const buffers = [];
-const { onExit, getEnvsPointer, setEnvsPointer, getEnvFlags, setJSFlags } = nativeAddon;
+const { onExit, getEnvsPointer, setEnvsPointer, getEnvFlags, setJSFlags, setValueCacheSize } = nativeAddon;
 if (globalThis.__lmdb_envs__)
 	setEnvsPointer(globalThis.__lmdb_envs__);
 else
@@ -65,7 +65,7 @@ export function open(path, options) {
 	let extension = pathModule.extname(path);
 	let name = pathModule.basename(path, extension);
 	let is32Bit = arch().endsWith('32');
-	let remapChunks = options.remapChunks || options.encryptionKey || (options.mapSize ?
+	let remapChunks = options.remapChunks || options.encryptionKey || options.checksum || (options.mapSize ?
 		(is32Bit && options.mapSize > 0x100000000) : // larger than fits in address space, must use dynamic maps
 		is32Bit); // without a known map size, we default to being able to handle large data correctly/well*/
 	let userMapSize = options.mapSize;
@@ -135,7 +135,11 @@ export function open(path, options) {
 	let env = new Env();
 	let jsFlags = (options.overlappingSync ? 0x1000 : 0) |
 		(options.separateFlushed ? 1 : 0) |
-		(options.deleteOnClose ? 2 : 0);
+		(options.deleteOnClose ? 2 : 0) |
+		(options.commitNotifications ? 4 : 0) |
+		(options.sharedValueCache ? 8 : 0);
+	if (options.sharedValueCache)
+		setValueCacheSize(typeof options.sharedValueCache == 'number' ? options.sharedValueCache : 0x4000000);
 	let rc = env.open(options, flags, jsFlags);
 	env.path = path;
    if (rc)
@@ -160,11 +164,13 @@ export function open(path, options) {
 	}
 
 	env.readerCheck(); // clear out any stale entries
-	if ((options.overlappingSync || options.deleteOnClose) && !hasRegisteredOnExit && process.on) {
+	if ((options.overlappingSync || options.deleteOnClose || options.accessProfile) && !hasRegisteredOnExit && process.on) {
 		hasRegisteredOnExit = true;
 		process.on('exit', onExit);
 	}
 
+	let dbiStores = new Map(); // for decoding the keys and values of changes
+	let changeLog;
 	class LMDBStore extends EventEmitter {
 		constructor(dbName, dbOptions) {
 			super();
@@ -210,11 +216,17 @@ export function open(path, options) {
 				this.resetReadTxn();
 				this.ensureReadTxn();
 				this.db = new Dbi(env, flags, dbName, keyType, dbOptions.compression);
+				openKeyFilter(this.db);
 			} else {
 				this.transactionSync(() => {
 					this.db = new Dbi(env, flags, dbName, keyType, dbOptions.compression);
+					openKeyFilter(this.db); // in the write txn, so no writes can happen while it is built
 				}, options.overlappingSync ? 0x10002 : 2); // no flush-sync, but synchronously commit
 			}
+			function openKeyFilter(db) {
+				if (dbOptions.keyFilter && db.dbi != 0xffffffff)
+					db.openKeyFilter(dbName || null, dbOptions.keyFilter.bitsPerKey || 10);
+			}
 			this._commitReadTxn(); // current read transaction becomes invalid after opening another db
 			if (!this.db || this.db.dbi == 0xffffffff) {// not found
 				throw new Error('Database not found')
@@ -264,6 +276,7 @@ export function open(path, options) {
 			this.maxKeySize = maxKeySize;
 			applyKeyHandling(this);
 			allDbs.set(dbName ? name + '-' + dbName : name, this);
+			dbiStores.set(this.db.dbi, this);
 		}
 		openDB(dbName, dbOptions) {
 			if (this.dupSort && this.name == null)
@@ -304,6 +317,49 @@ export function open(path, options) {
 				}
 			}));
 		}
+		backupIncremental(path, sinceTxnId) {
+			if (noFSAccess)
+				return;
+			fs.mkdirSync(pathModule.dirname(path), { recursive: true });
+			return new Promise((resolve, reject) => env.copyIncremental(path, sinceTxnId || 0, (error, txnId, pages) => {
+				if (error) {
+					reject(error);
+				} else {
+					resolve({ txnId, pages });
+				}
+			}));
+		}
+		async compact(compactOptions) {
+			let maxPages = compactOptions?.maxPages || 1000; // pages moved in each write transaction
+			let delay = compactOptions?.delay >= 0 ? compactOptions.delay : 10; // ms between steps, to throttle the compaction
+			let moved = 0, trimmed = 0, steps = 0;
+			while (true) {
+				let step = this.transactionSync(() => env.compactStep(maxPages), options.overlappingSync ? 0x10002 : 2);
+				moved += step.moved;
+				trimmed += step.trimmed;
+				steps++;
+				if (!step.moved && !step.trimmed)
+					break;
+				// wait for the step to commit, so the pages it freed can be reused and trimmed by the next step
+				await this.committed;
+				await new Promise(resolve => setTimeout(resolve, delay));
+			}
+			return { moved, trimmed, steps };
+		}
+		getChanges(startTxnId, options) {
+			if (!changeLog)
+				throw new Error('The changeLog option must be enabled to get changes');
+			return changeLog.getRange(Object.assign({}, options, { start: changeKey(startTxnId) }))
+				.map(({ key, value }) => decodeChange(key, value));
+		}
+		pruneChanges(beforeTxnId) {
+			if (!changeLog)
+				throw new Error('The changeLog option must be enabled to prune changes');
+			return changeLog.transaction(() => {
+				for (let key of changeLog.getKeys({ end: changeKey(beforeTxnId) }))
+					changeLog.remove(key);
+			});
+		}
 		isOperational() {
 			return this.status == 'open';
 		}
@@ -392,8 +448,73 @@ export function open(path, options) {
 		deferredOpen: true,
 		openCallback: true,	
 	};
+	if (options.changeLog && !options.readOnly) {
+		changeLog = new LMDBStore('__changes__', { keyEncoding: 'binary', encoding: 'binary', compression: false });
+		env.setChangeLog(changeLog.db.dbi, !!options.changeLog.values);
+	}
+	function decodeChange(key, record) {
+		let view = new DataView(record.buffer, record.byteOffset, record.length);
+		let flags = record[1];
+		let store = dbiStores.get(view.getUint32(4, true));
+		let keySize = view.getUint32(8, true);
+		let position = 12;
+		let keyView = new DataView(key.buffer, key.byteOffset, key.length);
+		let change = {
+			txnId: keyView.getUint32(0) * 0x100000000 + keyView.getUint32(4),
+			operation: CHANGE_OPERATIONS[record[0]],
+			db: store,
+		};
+		if (flags & CHANGE_HAS_VERSION) {
+			change.version = view.getFloat64(position, true);
+			position += 8;
+		}
+		if (change.operation != 'drop')
+			change.key = store ? store.readKey(record, position, position + keySize) : record.subarray(position, position + keySize);
+		position += keySize;
+		if (flags & CHANGE_HAS_VALUE) {
+			let bytes = record.subarray(position);
+			if (!store || store.encoding == 'binary')
+				change.value = bytes;
+			else if (store.decoder)
+				change.value = store.decoder.decode(bytes);
+			else {
+				change.value = new TextDecoder().decode(bytes);
+				if (store.encoding == 'json')
+					change.value = JSON.parse(change.value);
+			}
+		}
+		return change;
+	}
 	let Class = options.cache ? CachingStore(LMDBStore, env) : LMDBStore;
-	return options.asClass ? Class : new Class(options.name || null, options);
+	if (options.asClass)
+		return Class;
+	let warmOptions = options.warm;
+	delete options.warm; // don't copy to the store, it would hide the warm method
+	let store = new Class(options.name || null, options);
+	if (warmOptions) {
+		store.warmed = store.warm(warmOptions === true ? {} : warmOptions);
+		store.warmed.catch(() => {}); // reported to anyone awaiting it
+	}
+	return store;
+}
+function changeKey(txnId) {
+	let key = new Uint8Array(12); // change log keys are the txn id and sequence, big-endian
+	let view = new DataView(key.buffer);
+	view.setUint32(0, Math.floor((txnId || 0) / 0x100000000));
+	view.setUint32(4, (txnId || 0) >>> 0);
+	return key;
+}
+const CHANGE_OPERATIONS = { 12: 'drop', 13: 'delete', 14: 'deleteValue', 15: 'put' };
+const CHANGE_HAS_VERSION = 1;
+const CHANGE_HAS_VALUE = 2;
+export function restoreIncrementalBackup(path, backupPaths, options) {
+	let noSubdir = options && options.noSubdir != null ? options.noSubdir : Boolean(pathModule.extname(path));
+	let dataPath = noSubdir ? path : path + '/data.mdb';
+	fs.mkdirSync(pathModule.dirname(dataPath), { recursive: true });
+	let txnId;
+	for (let backupPath of typeof backupPaths == 'string' ? [backupPaths] : backupPaths)
+		txnId = nativeAddon.applyIncrementalBackup(dataPath, backupPath);
+	return txnId;
 }
 export function openAsClass(path, options) {
 	if (typeof path == 'object' && !options) {
@@ -1,5 +1,5 @@
 import { RangeIterable }  from './util/RangeIterable.js';
-import { getAddress, Cursor, Txn, orderedBinary, lmdbError, getByBinary, setGlobalBuffer, prefetch, iterate, position as doPosition, resetTxn, getCurrentValue, getCurrentShared, getStringByBinary, globalBuffer, getSharedBuffer, startRead, setReadCallback } from './native.js';
+import { getAddress, Cursor, Txn, orderedBinary, lmdbError, getByBinary, getByUint32, setGlobalBuffer, prefetch, exportRange, iterate, position as doPosition, resetTxn, getCurrentValue, getCurrentShared, getStringByBinary, globalBuffer, getSharedBuffer, startRead, setReadCallback, projectEntries, projectValues } from './native.js';
 import { saveKey }  from './keys.js';
 const IF_EXISTS = 3.542694326329068e-103;
 const ITERATOR_DONE = { done: true, value: undefined };
@@ -13,6 +13,18 @@ if (!getValueBytes.maxLength) {
 const START_ADDRESS_POSITION = 4064;
 const NEW_BUFFER_THRESHOLD = 0x8000;
 const SOURCE_SYMBOL = Symbol.for('source');
+const PROJECTION_HEAP_FULL = 1;
+const PROJECTION_DONE = 2;
+const DEFAULT_COLUMN_BATCH_SIZE = 1024;
+const KEPT_READ_TXN_TIME = 50; // ms an idle read txn is kept, so an idle process doesn't hold back the reuse of freed pages
+// the typed arrays that can be exported to, in the order of the element types in export-range.cpp
+const EXPORT_ARRAY_TYPES = [Int8Array, Uint8Array, Int16Array, Uint16Array, Int32Array, Uint32Array, Float32Array, Float64Array,
+	typeof BigInt64Array == 'undefined' ? null : BigInt64Array, typeof BigUint64Array == 'undefined' ? null : BigUint64Array];
+const EXPORT_HEADER_SIZE = 8;
+const EXPORT_FIELD_SIZE = 4;
+const EXPORT_KEYS_RAW = -1;
+const EXPORT_KEYS_NONE = -2;
+const DEFAULT_EXPORT_THREADS = 4;
 export const UNMODIFIED = {};
 let mmaps = [];
 
@@ -20,6 +32,8 @@ export function addReadMethods(LMDBStore, {
 	maxKeySize, env, keyBytes, keyBytesView, getLastVersion, getLastTxnId
 }) {
 	let readTxn, readTxnRenewed, asSafeBuffer = false;
+	let commitSequence; // the id of the last committed txn, in the shared lock region
+	let keptReadTxnTimer;
 	let renewId = 1;
 	let outstandingReads = 0;
 	Object.assign(LMDBStore.prototype, {
@@ -38,7 +52,10 @@ export function addReadMethods(LMDBStore, {
 		getBinaryFast(id, options) {
 			let rc;
 			let txn = env.writeTxn || (options && options.transaction) || (readTxnRenewed ? readTxn : renewReadTxn(this));
-			rc = this.lastSize = getByBinary(this.dbAddress, this.writeKey(id, keyBytes, 0), (options && options.ifNotTxnId) || 0, txn.address || 0);
+			rc = this.lastSize = this.keyIsUint32 && id >>> 0 === id ?
+				// integer keys are passed directly, without writing to the key buffer
+				getByUint32(this.dbAddress, id, (options && options.ifNotTxnId) || 0, txn.address || 0) :
+				getByBinary(this.dbAddress, this.writeKey(id, keyBytes, 0), (options && options.ifNotTxnId) || 0, txn.address || 0);
 			if (rc < 0) {
 				if (rc == -30798) // MDB_NOTFOUND
 					return; // undefined
@@ -340,6 +357,9 @@ export function addReadMethods(LMDBStore, {
 			let db = this.db;
 			let snapshot = options.snapshot;
 			let compression = this.compression;
+			let columns = options.columns;
+			if (columns && (snapshot === false || valuesForKey || !includeValues))
+				throw new Error('Columns can only be read from the entries of a snapshot');
 			iterable.iterate = () => {
 				let currentKey = valuesForKey ? options.key : options.start;
 				const reverse = options.reverse;
@@ -351,6 +371,7 @@ export function addReadMethods(LMDBStore, {
 					(options.inclusiveEnd ? 0x8000 : 0) |
 					(options.exclusiveStart ? 0x10000 : 0);
 				let store = this;
+				let projection = columns && getProjection(store, columns, options.batchSize || DEFAULT_COLUMN_BATCH_SIZE);
 				function resetCursor() {
 					try {
 						if (cursor)
@@ -450,8 +471,34 @@ export function addReadMethods(LMDBStore, {
 						}
 					}
 				}
+				// read the selected fields of a batch of entries into columns
+				function nextColumns() {
+					if (count === 0 && !projection.done) {
+						let keySize = position(options.offset);
+						if (keySize < 0)
+							lmdbError(keySize);
+						projection.done = keySize === 0;
+					}
+					let rows = Math.min(projection.rowCapacity, (limit === undefined ? Infinity : limit) - count);
+					if (projection.done || rows <= 0) {
+						finishCursor();
+						return ITERATOR_DONE;
+					}
+					let batch = readColumns(store, projection, rows, true,
+						() => projectEntries(cursorAddress, projection.address, projection.heap.address));
+					count += batch.count;
+					if (projection.status === PROJECTION_DONE)
+						projection.done = true;
+					if (batch.count === 0) {
+						finishCursor();
+						return ITERATOR_DONE;
+					}
+					return { value: batch };
+				}
 				return {
 					next() {
+						if (projection)
+							return nextColumns();
 						let keySize, lastSize;
 						if (cursorRenewId && (cursorRenewId != renewId || txn.isDone)) {
 							resetCursor();
@@ -550,21 +597,65 @@ export function addReadMethods(LMDBStore, {
 			return iterable;
 		},
 
-		getMany(keys, callback) {
+		getMany(keys, options, callback) {
 			// this is an asynchronous get for multiple keys. It actually works by prefetching asynchronously,
 			// allowing a separate to absorb the potentially largest cost: hard page faults (and disk I/O).
 			// And then we just do standard sync gets (to deserialized data) to fulfil the callback/promise
 			// once the prefetch occurs
-			let promise = callback ? undefined : new Promise(resolve => callback = (error, results) => resolve(results));
+			if (typeof options == 'function') {
+				callback = options;
+				options = undefined;
+			}
+			let promise = callback ? undefined : new Promise((resolve, reject) =>
+				callback = (error, results) => error ? reject(error) : resolve(results));
 			this.prefetch(keys, () => {
-				let results = new Array(keys.length);
-				for (let i = 0, l = keys.length; i < l; i++) {
-					results[i] = get.call(this, keys[i]);
+				let results;
+				try {
+					if (options && options.columns)
+						results = this._getManyColumns(keys, options.columns);
+					else {
+						results = new Array(keys.length);
+						for (let i = 0, l = keys.length; i < l; i++) {
+							results[i] = get.call(this, keys[i]);
+						}
+					}
+				} catch (error) {
+					// this runs in the prefetch callback, so errors have to be passed on rather than thrown
+					return callback(error);
 				}
 				callback(null, results);
 			});
 			return promise;
 		},
+		_getManyColumns(keys, fields) {
+			// write the keys, each as a uint32 length followed by the key, padded to 4 bytes
+			let size = 4;
+			let encodedKeys = keys.map((key) => {
+				let keySize = this.writeKey(key, keyBytes, 0);
+				size += 4 + ((keySize + 3) & ~3);
+				return Uint8ArraySlice.call(keyBytes, 0, keySize);
+			});
+			let keyBuffer = new ArrayBuffer(size);
+			let keyLengths = new Uint32Array(keyBuffer);
+			let keyData = new Uint8Array(keyBuffer);
+			let offset = 0;
+			for (let key of encodedKeys) {
+				keyLengths[offset >> 2] = key.length;
+				keyData.set(key, offset + 4);
+				offset += 4 + ((key.length + 3) & ~3);
+			}
+			keyLengths[offset >> 2] = 0xffffffff;
+			let keysAddress = getAddress(keyBuffer);
+			let projection = getProjection(this, fields, Math.max(keys.length, 1));
+			let txn = env.writeTxn || (readTxnRenewed ? readTxn : renewReadTxn(this));
+			let batch;
+			do {
+				// if the values don't fit in the heap, it is grown and the batch is read again
+				batch = readColumns(this, projection, keys.length, false,
+					() => projectValues(this.dbAddress, txn.address || 0, keysAddress, 0, projection.address, projection.heap.address));
+			} while (batch.count < keys.length && growHeap(projection));
+			return batch;
+		},
 		getSharedBufferForGet(id, options) {
 			let txn = env.writeTxn || (options && options.transaction) || (readTxnRenewed ? readTxn : renewReadTxn(this));
 			this.lastSize = this.keyIsCompatibility ? txn.getBinaryShared(id) : this.db.get(this.writeKey(id, keyBytes, 0));
@@ -631,6 +722,82 @@ export function addReadMethods(LMDBStore, {
 			if (!callback)
 				return new Promise(resolve => callback = resolve);
 		},
+		warm(options) {
+			options = options || {};
+			outstandingReads++;
+			return new Promise((resolve, reject) => {
+				env.warm(options.levels || 3, options.hotDbs || [], options.bytesPerSecond || 0, options.onProgress,
+					(error, pages, bytes, cancelled) => {
+						outstandingReads--;
+						if (error)
+							reject(error);
+						else
+							resolve({ pages, bytes, cancelled });
+					});
+			});
+		},
+		cancelWarm() {
+			env.cancelWarm();
+		},
+		exportRange(start, end, schema) {
+			if (this.compression)
+				throw new Error('Ranges of compressed databases can not be exported');
+			let columns = schema.columns || {};
+			let names = Object.keys(columns);
+			let descriptor = new Float64Array(EXPORT_HEADER_SIZE + names.length * EXPORT_FIELD_SIZE);
+			let capacity = 0xffffffff;
+			let arrayAddress = (array) => {
+				let type = EXPORT_ARRAY_TYPES.indexOf(array && array.constructor);
+				if (type == -1)
+					throw new Error('Ranges can only be exported to typed arrays');
+				capacity = Math.min(capacity, array.length);
+				return [getAddress(array.buffer) + array.byteOffset, type];
+			};
+			names.forEach((name, i) => {
+				let { array, offset, bigEndian } = columns[name];
+				if (!(offset >= 0))
+					throw new Error('The column ' + name + ' needs an offset in the value');
+				let position = EXPORT_HEADER_SIZE + i * EXPORT_FIELD_SIZE;
+				[descriptor[position], descriptor[position + 1]] = arrayAddress(array);
+				descriptor[position + 2] = offset;
+				descriptor[position + 3] = bigEndian ? 1 : 0;
+			});
+			let keys = schema.keys;
+			descriptor[4] = EXPORT_KEYS_NONE;
+			if (keys) {
+				if (this.keyIsUint32 && !Array.isArray(keys))
+					[descriptor[3], descriptor[4]] = arrayAddress(keys); // converted natively
+				else {
+					// other keys are decoded here, from the binary keys (an Array grows to hold them)
+					if (!Array.isArray(keys))
+						capacity = Math.min(capacity, keys.length);
+					descriptor[4] = EXPORT_KEYS_RAW;
+				}
+			}
+			descriptor[0] = names.length;
+			descriptor[1] = capacity;
+			descriptor[2] = schema.threads || DEFAULT_EXPORT_THREADS;
+			let encodeKey = (key) => key === undefined ? undefined : Uint8ArraySlice.call(keyBytes, 0, this.writeKey(key, keyBytes, 0));
+			let startKey = encodeKey(start), endKey = encodeKey(end);
+			return new Promise((resolve, reject) => {
+				exportRange(this.dbAddress, descriptor, startKey, endKey, (error, count, more, rawKeys) => {
+					outstandingReads--;
+					schema = null; // this held on to the arrays (that are written by address) until the export was done
+					if (error)
+						return reject(error);
+					if (rawKeys) {
+						let view = new DataView(rawKeys.buffer, rawKeys.byteOffset, rawKeys.byteLength);
+						for (let i = 0, position = 0; i < count; i++) {
+							let keySize = view.getUint32(position, true);
+							keys[i] = this.readKey(rawKeys, position + 4, position + 4 + keySize);
+							position += 4 + keySize;
+						}
+					}
+					resolve({ count, more });
+				});
+				outstandingReads++; // closing waits for the export
+			});
+		},
 		useReadTransaction() {
 			let txn = readTxnRenewed ? readTxn : renewReadTxn(this);
 			if (!txn.use) {
@@ -643,6 +810,7 @@ export function addReadMethods(LMDBStore, {
 			this.status = 'closing';
 			let txnPromise;
 			if (this.isRoot) {
+				env.cancelWarm(); // closing waits for outstanding reads, including warming
 				// if it is root, we need to abort and/or wait for transactions to finish
 				if (readTxn) readTxn.abort();
 				else readTxn = {};
@@ -680,14 +848,39 @@ export function addReadMethods(LMDBStore, {
 				return Promise.resolve();
 			}
 		},
-		getStats() {
+		getStats(options) {
 			let txn = env.writeTxn || (readTxnRenewed ? readTxn : renewReadTxn(this));
 			let dbStats = this.db.stat();
 			dbStats.root = env.stat();
 			Object.assign(dbStats, env.info());
-			dbStats.free = env.freeStat();
+			dbStats.free = env.freeStat(options?.freeRuns);
+			let keyFilter = this.db.getKeyFilterStats();
+			if (keyFilter)
+				dbStats.keyFilter = keyFilter;
+			if (this.compression?.cacheSize)
+				dbStats.decompressionCache = this.compression.getCacheStats();
 			return dbStats;
 		},
+		getLatencyHistograms(reset) {
+			return env.getLatencyHistograms(reset);
+		},
+		waitForCommit(afterTxnId, timeout) {
+			return new Promise((resolve, reject) => {
+				let after = env.waitForCommit(afterTxnId ?? -1, timeout ?? -1, (error, txnId) => {
+					if (error)
+						return reject(error); // the database was closed
+					let { commits, complete } = env.getRecentCommits(after);
+					let dbi = this.db.dbi;
+					resolve({
+						txnId,
+						commits,
+						complete,
+						// if we don't have all the commits, we can't rule out a write to this database
+						touched: txnId > after && (!complete || commits.some((commit) => commit.dbi === dbi)),
+					});
+				});
+			});
+		},
 	});
 	let get = LMDBStore.prototype.get;
 	let lastReadTxnRef;
@@ -703,6 +896,18 @@ export function addReadMethods(LMDBStore, {
 		if (!env.address) {
 			throw new Error('Can not renew a transaction from a closed database');
 		}
+		if (commitSequence === undefined) {
+			let buffer = env.getCommitSequence();
+			commitSequence = buffer ? new BigUint64Array(buffer) : null;
+		}
+		let sequence = commitSequence && commitSequence[0];
+		if (readTxn && readTxn.kept) {
+			// the read txn was kept across turns because nothing had been committed, reset it if that has changed
+			clearTimeout(keptReadTxnTimer);
+			readTxn.kept = false;
+			if (sequence !== readTxn.sequence)
+				resetTxn(readTxn.address);
+		}
 		if (!readTxn) {
 			let retries = 0;
 			let waitArray;
@@ -728,6 +933,7 @@ export function addReadMethods(LMDBStore, {
 		}
 		// we actually don't renew here, we let the renew take place in the next 
 		// lmdb native read/call so as to avoid an extra native call
+		readTxn.sequence = sequence; // the snapshot is at least as new as this
 		readTxnRenewed = setTimeout(resetReadTxn, 0);
 		store.emit('begin-transaction');
 		return readTxn;
@@ -741,13 +947,152 @@ export function addReadMethods(LMDBStore, {
 				lastReadTxnRef = new WeakRef(readTxn);
 				readTxn = null;
 			} else if (readTxn.address && !readTxn.isDone) {
-				resetTxn(readTxn.address);
+				if (isSnapshotCurrent(readTxn)) {
+					// nothing has been committed since, so the snapshot is current and we can keep it for a little while
+					readTxn.kept = true;
+					keptReadTxnTimer = setTimeout(releaseKeptReadTxn, KEPT_READ_TXN_TIME);
+					keptReadTxnTimer.unref?.();
+				} else
+					resetTxn(readTxn.address);
 			} else {
 				console.warn('Attempt to reset an invalid read txn', readTxn);
 				throw new Error('Attempt to reset an invalid read txn');
 			}
+		} else if (readTxn && readTxn.kept && !isSnapshotCurrent(readTxn)) {
+			// called after a commit, we don't want to hold on to the older snapshot
+			releaseKeptReadTxn();
+		}
+	}
+	function isSnapshotCurrent(txn) {
+		return commitSequence && env.address && commitSequence[0] === txn.sequence;
+	}
+	function releaseKeptReadTxn() {
+		if (readTxn && readTxn.kept) {
+			clearTimeout(keptReadTxnTimer);
+			readTxn.kept = false;
+			if (env.address && readTxn.address && !readTxn.isDone)
+				resetTxn(readTxn.address);
+		}
+	}
+}
+function allocateHeap(size) {
+	let heap = typeof Buffer != 'undefined' ? Buffer.allocUnsafeSlow(size) : new Uint8Array(size);
+	heap.address = getAddress(heap.buffer);
+	return heap;
+}
+function growHeap(projection) {
+	projection.heap = allocateHeap(projection.heap.length * 2);
+	projection.header[3] = projection.heap.length;
+	return true;
+}
+/*
+Lays out the workspace that the native projection (projection.cpp) reads the positions of the fields from, and writes
+the columns to: a header, the position of each field in each shared structure, and then the values, lengths, key
+positions and types of the rows. Strings and other values are written to a separate heap.
+*/
+function getProjection(store, fields, rowCapacity) {
+	if (store.encoding && store.encoding != 'msgpack' || !store.decoder)
+		throw new Error('Columns can only be read from msgpack encoded values');
+	let structures;
+	if (store.sharedStructuresKey && !store.randomAccessStructure) { // random access structures are decoded in full
+		let buffer = store.getBinary(store.sharedStructuresKey);
+		structures = buffer && store.decoder.decode(buffer);
+	}
+	// msgpackr uses single byte ids for (up to) the first 32 shared structures
+	structures = Array.isArray(structures) ? structures.slice(0, 32) : [];
+	let fieldCount = fields.length;
+	let tableWords = structures.length * (1 + fieldCount);
+	let valuesOffset = ((8 + tableWords) * 4 + 7) & ~7;
+	let lengthsOffset = valuesOffset + fieldCount * rowCapacity * 8;
+	let keyStartsOffset = lengthsOffset + fieldCount * rowCapacity * 4;
+	let keyLengthsOffset = keyStartsOffset + rowCapacity * 4;
+	let typesOffset = keyLengthsOffset + rowCapacity * 4;
+	let workspace = new ArrayBuffer(typesOffset + fieldCount * rowCapacity);
+	let heap = allocateHeap(0x10000);
+	let header = new Uint32Array(workspace, 0, 8);
+	header[0] = fieldCount;
+	header[2] = rowCapacity;
+	header[3] = heap.length;
+	header[4] = structures.length;
+	let table = new Int32Array(workspace, 32, tableWords);
+	structures.forEach((structure, i) => {
+		let entry = i * (1 + fieldCount);
+		table[entry] = structure.length;
+		for (let f = 0; f < fieldCount; f++)
+			table[entry + 1 + f] = structure.indexOf(fields[f]);
+	});
+	return {
+		fields, rowCapacity, header, heap,
+		address: getAddress(workspace),
+		values: new Float64Array(workspace, valuesOffset, fieldCount * rowCapacity),
+		lengths: new Uint32Array(workspace, lengthsOffset, fieldCount * rowCapacity),
+		keyStarts: new Uint32Array(workspace, keyStartsOffset, rowCapacity),
+		keyLengths: new Uint32Array(workspace, keyLengthsOffset, rowCapacity),
+		types: new Uint8Array(workspace, typesOffset, fieldCount * rowCapacity),
+	};
+}
+// runs the native projection of (up to) the given number of rows, and decodes the columns
+function readColumns(store, projection, rows, includeKeys, project) {
+	let { fields, rowCapacity, header, values, lengths, types } = projection;
+	let count;
+	while (true) {
+		header[1] = rows;
+		count = project();
+		if (count < 0)
+			lmdbError(count);
+		if (count > 0 || header[5] !== PROJECTION_HEAP_FULL)
+			break;
+		growHeap(projection); // a single entry didn't fit
+	}
+	projection.status = header[5];
+	let heap = projection.heap;
+	let keys;
+	if (includeKeys) {
+		keys = new Array(count);
+		for (let r = 0; r < count; r++) {
+			let start = projection.keyStarts[r];
+			keys[r] = store.readKey(heap, start, start + projection.keyLengths[r]);
+		}
+	}
+	let columns = {};
+	let wholeValues; // values that couldn't be projected natively, decoded in full
+	for (let f = 0; f < fields.length; f++) {
+		let base = f * rowCapacity;
+		let numeric = true;
+		for (let r = 0; r < count; r++) {
+			if (types[base + r] !== 1) {
+				numeric = false;
+				break;
+			}
+		}
+		if (numeric) {
+			columns[fields[f]] = values.slice(base, base + count);
+			continue;
+		}
+		let column = columns[fields[f]] = new Array(count);
+		for (let r = 0; r < count; r++) {
+			let i = base + r;
+			switch (types[i]) {
+				case 1: column[r] = values[i]; break;
+				case 2: column[r] = values[i] === 1; break;
+				case 3: column[r] = null; break;
+				case 4: column[r] = store.decoder.decode(heap.subarray(values[i], values[i] + lengths[i])); break;
+				case 5: {
+					if (!wholeValues)
+						wholeValues = new Array(count);
+					let value = wholeValues[r];
+					if (value === undefined)
+						value = wholeValues[r] = store.decoder.decode(heap.subarray(values[i], values[i] + lengths[i]));
+					column[r] = value != null && typeof value == 'object' ? value[fields[f]] : undefined;
+					break;
+				}
+				case 6: column[r] = heap.toString ? heap.toString('utf8', values[i], values[i] + lengths[i]) :
+					new TextDecoder().decode(heap.subarray(values[i], values[i] + lengths[i])); break;
+				default: column[r] = undefined;
+			}
 		}
 	}
+	return { count, keys, columns };
 }
 export function makeReusableBuffer(size) {
 	let bytes = typeof Buffer != 'undefined' ? Buffer.alloc(size) : new Uint8Array(size);
@@ -0,0 +1,237 @@
+#include "lmdb-js.h"
+#include <cstdio>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace Napi;
+
+/*
+An access profile is a sample of the pages that reads have recently used, so that a restart can bring those pages back
+into the page cache at once, rather than faulting them in one read at a time while the application warms up (like
+InnoDB's buffer pool dump and load). Every sampleInterval-th get records the page(s) its value was read from (the leaf
+page, or the overflow pages of a large value) into a ring of the most recent samples. The profile is shared by all the
+threads that use the env, and is saved when the env is closed (including by the onExit hook when the process exits).
+The next time the database is opened, the saved pages are read ahead with madvise(MADV_WILLNEED), and seed the ring, so
+a short run doesn't throw away the profile of a long one. Only values that are read directly from the memory map can be
+sampled, so nothing is recorded for encrypted databases (which are read through remapped, decrypted chunks).
+*/
+const uint32_t ACCESS_PROFILE_MAGIC = 0x4c415031;
+const uint32_t DEFAULT_PROFILE_PAGES = 0x10000;
+const uint32_t DEFAULT_SAMPLE_INTERVAL = 16;
+const uint64_t MAX_RUN_PAGES = 0xffff; // entries are the page number << 16 | the number of pages
+
+struct access_profile_t {
+	MDB_env* env;
+	std::atomic<uint64_t>* entries;
+	uint32_t capacity; // a power of 2
+	uint32_t sampleMask;
+	unsigned int pageSize;
+	std::atomic<uint32_t> gets;
+	std::atomic<uint32_t> position;
+	std::atomic<uint64_t> samples;
+	uint64_t replayedPages;
+};
+
+typedef struct {
+	uint32_t magic;
+	uint32_t pageSize;
+	uint64_t entries;
+} access_profile_header_t;
+
+static pthread_mutex_t* initAccessProfilesLock() {
+	pthread_mutex_t* lock = new pthread_mutex_t;
+	pthread_mutex_init(lock, nullptr);
+	return lock;
+}
+static pthread_mutex_t* accessProfilesLock = initAccessProfilesLock();
+static std::vector<access_profile_t*> accessProfiles; // guarded by accessProfilesLock
+static std::atomic<int> accessProfileCount;
+
+static uint32_t roundUpToPowerOf2(uint32_t n) {
+	uint32_t power = 1;
+	while (power < n && power < 0x80000000)
+		power <<= 1;
+	return power;
+}
+
+static std::string accessProfilePath(MDB_env* env) {
+	const char* path;
+	unsigned int flags;
+	mdb_env_get_path(env, &path);
+	mdb_env_get_flags(env, &flags);
+	return std::string(path) + ((flags & MDB_NOSUBDIR) ? "-access-profile" : "/access-profile.mdb");
+}
+
+static access_profile_t* findProfile(MDB_env* env) {
+	for (auto profile : accessProfiles) {
+		if (profile->env == env)
+			return profile;
+	}
+	return nullptr;
+}
+
+static void addEntry(access_profile_t* profile, uint64_t entry) {
+	profile->entries[profile->position.fetch_add(1, std::memory_order_relaxed) & (profile->capacity - 1)]
+		.store(entry, std::memory_order_relaxed);
+}
+
+static void readAhead(char* map, size_t offset, size_t length) {
+#if defined(MADV_WILLNEED) || defined(POSIX_MADV_WILLNEED)
+	static size_t osPageSize = sysconf(_SC_PAGESIZE);
+	size_t aligned = offset & ~(osPageSize - 1); // madvise needs a page aligned address
+	length += offset - aligned;
+#ifdef MADV_WILLNEED
+	madvise(map + aligned, length, MADV_WILLNEED);
+#else
+	posix_madvise(map + aligned, length, POSIX_MADV_WILLNEED);
+#endif
+#endif
+}
+
+// load the saved profile into the ring, and read its pages ahead
+static void loadAccessProfile(access_profile_t* profile) {
+	std::string path = accessProfilePath(profile->env);
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return;
+	access_profile_header_t header;
+	std::vector<uint64_t> entries;
+	if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == ACCESS_PROFILE_MAGIC &&
+			header.pageSize == profile->pageSize && header.entries <= 0x10000000) {
+		entries.resize(header.entries);
+		if (fread(entries.data(), sizeof(uint64_t), entries.size(), file) != entries.size())
+			entries.clear();
+	}
+	fclose(file);
+	MDB_envinfo info;
+	mdb_env_info(profile->env, &info);
+	char* map = (char*) info.me_mapaddr;
+	// the entries are saved in page order, so adjacent runs can be read ahead together
+	size_t runStart = 0, runEnd = 0;
+	for (uint64_t entry : entries) {
+		uint64_t pgno = entry >> 16;
+		uint64_t pages = entry & MAX_RUN_PAGES;
+		if (pgno + pages > info.me_last_pgno + 1)
+			continue; // the database has been compacted or replaced since the profile was saved
+		addEntry(profile, entry);
+		profile->replayedPages += pages;
+		if (!map)
+			continue;
+		size_t start = pgno * profile->pageSize, end = (pgno + pages) * profile->pageSize;
+		if (start > runEnd) {
+			if (runEnd > runStart)
+				readAhead(map, runStart, runEnd - runStart);
+			runStart = start;
+		}
+		if (end > runEnd)
+			runEnd = end;
+	}
+	if (map && runEnd > runStart)
+		readAhead(map, runStart, runEnd - runStart);
+}
+
+static void saveAccessProfile(access_profile_t* profile) {
+	std::vector<uint64_t> entries;
+	uint32_t count = profile->position.load() < profile->capacity ? profile->position.load() : profile->capacity;
+	for (uint32_t i = 0; i < count; i++) {
+		uint64_t entry = profile->entries[i].load(std::memory_order_relaxed);
+		if (entry)
+			entries.push_back(entry);
+	}
+	if (entries.empty())
+		return;
+	// sort by page, and keep one entry (the longest) for each page
+	std::sort(entries.begin(), entries.end());
+	size_t unique = 0;
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (unique > 0 && (entries[unique - 1] >> 16) == (entries[i] >> 16))
+			entries[unique - 1] = entries[i];
+		else
+			entries[unique++] = entries[i];
+	}
+	entries.resize(unique);
+	access_profile_header_t header = {};
+	header.magic = ACCESS_PROFILE_MAGIC;
+	header.pageSize = profile->pageSize;
+	header.entries = entries.size();
+	// write to a temporary file and rename it, so a partially written profile is never loaded
+	std::string path = accessProfilePath(profile->env);
+	std::string tempPath = path + ".tmp";
+	FILE* file = fopen(tempPath.c_str(), "wb");
+	if (!file)
+		return;
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(entries.data(), sizeof(uint64_t), entries.size(), file) == entries.size();
+	written = !fclose(file) && written;
+	remove(path.c_str());
+	if (!written || rename(tempPath.c_str(), path.c_str()))
+		remove(tempPath.c_str());
+}
+
+/*
+Returns the access profile of the env, creating it if it isn't open yet. When it is created, the saved profile is
+loaded and read ahead.
+*/
+access_profile_t* openAccessProfile(MDB_env* env, uint32_t pages, uint32_t sampleInterval) {
+	pthread_mutex_lock(accessProfilesLock);
+	access_profile_t* profile = findProfile(env);
+	if (!profile) {
+		MDB_stat stat;
+		mdb_env_stat(env, &stat);
+		profile = new access_profile_t();
+		profile->env = env;
+		profile->capacity = roundUpToPowerOf2(pages ? pages : DEFAULT_PROFILE_PAGES);
+		profile->sampleMask = roundUpToPowerOf2(sampleInterval ? sampleInterval : DEFAULT_SAMPLE_INTERVAL) - 1;
+		profile->pageSize = stat.ms_psize;
+		profile->entries = new std::atomic<uint64_t>[profile->capacity]();
+		profile->replayedPages = 0;
+		loadAccessProfile(profile);
+		accessProfiles.push_back(profile);
+		accessProfileCount++;
+	}
+	pthread_mutex_unlock(accessProfilesLock);
+	return profile;
+}
+
+// the profile of an env, for reads that don't go through an EnvWrap
+void recordAccess(access_profile_t* profile, MDB_val* data) {
+	if (profile->gets.fetch_add(1, std::memory_order_relaxed) & profile->sampleMask)
+		return;
+	MDB_envinfo info;
+	mdb_env_info(profile->env, &info);
+	char* map = (char*) info.me_mapaddr;
+	char* address = (char*) data->mv_data;
+	// a value that was decrypted, or is a dirty copy in a write txn, isn't in the map
+	if (!map || address < map || address >= map + info.me_mapsize)
+		return;
+	uint64_t pgno = (address - map) / profile->pageSize;
+	uint64_t pages = (address - map + (data->mv_size ? data->mv_size - 1 : 0)) / profile->pageSize - pgno + 1;
+	addEntry(profile, (pgno << 16) | (pages < MAX_RUN_PAGES ? pages : MAX_RUN_PAGES));
+	profile->samples++;
+}
+
+void getAccessProfileStats(access_profile_t* profile, uint64_t* samples, uint64_t* replayedPages) {
+	*samples = profile->samples.load();
+	*replayedPages = profile->replayedPages;
+}
+
+// saves and frees the profile of the env, when the env is being closed
+void closeAccessProfile(MDB_env* env) {
+	if (!accessProfileCount.load())
+		return;
+	pthread_mutex_lock(accessProfilesLock);
+	for (auto it = accessProfiles.begin(); it != accessProfiles.end(); it++) {
+		access_profile_t* profile = *it;
+		if (profile->env == env) {
+			saveAccessProfile(profile);
+			accessProfiles.erase(it);
+			accessProfileCount--;
+			delete[] profile->entries;
+			delete profile;
+			break;
+		}
+	}
+	pthread_mutex_unlock(accessProfilesLock);
+}
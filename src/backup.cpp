@@ -0,0 +1,152 @@
+#include "lmdb-js.h"
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Napi;
+
+/*
+Incremental backups copy the pages that were written after the txn of a previous backup (pages are copied on write, so
+that is every page that has changed), along with the meta pages and freelist, and can be applied to that backup to
+restore the later txn.
+*/
+class IncrementalCopyWorker : public AsyncWorker {
+  public:
+	IncrementalCopyWorker(MDB_env* env, std::string path, mdb_size_t since, const Function& callback)
+	 : AsyncWorker(callback), env(env), path(path), since(since), txnId(0), pages(0) {
+	}
+
+	void Execute() {
+		int rc = mdb_env_copy_incremental(env, path.c_str(), since, &txnId, &pages);
+		if (rc != 0) {
+			SetError(mdb_strerror(rc));
+		}
+	}
+	void OnOK() {
+		napi_value result, args[3];
+		napi_get_null(Env(), &args[0]);
+		napi_create_double(Env(), (double) txnId, &args[1]);
+		napi_create_double(Env(), (double) pages, &args[2]);
+		// we use direct napi call here because node-addon-api interface with throw a fatal error if a worker thread is terminating
+		napi_call_function(Env(), Env().Undefined(), Callback().Value(), 3, args, &result);
+	}
+	void OnError(const Error& e) {
+		napi_value result;
+		napi_value arg = e.Value();
+		napi_call_function(Env(), Env().Undefined(), Callback().Value(), 1, &arg, &result);
+	}
+
+  private:
+	MDB_env* env;
+	std::string path;
+	mdb_size_t since;
+	mdb_size_t txnId;
+	mdb_size_t pages;
+};
+
+Napi::Value EnvWrap::copyIncremental(const CallbackInfo& info) {
+	if (!this->env) {
+		return throwError(info.Env(), "The environment is already closed.");
+	}
+	if (!info[0].IsString() || !info[2].IsFunction()) {
+		return throwError(info.Env(), "Call env.copyIncremental(path, since, callback) with a file path.");
+	}
+	double since = info[1].As<Number>();
+	IncrementalCopyWorker* worker = new IncrementalCopyWorker(
+		this->env, info[0].As<String>().Utf8Value(), since > 0 ? (mdb_size_t) since : 0, info[2].As<Function>()
+	);
+	worker->Queue();
+	return info.Env().Undefined();
+}
+
+/*
+Online compaction moves the pages at the end of the file into free pages earlier in the file, a limited number of pages
+in each step (write txn), so other writes can proceed between steps, and truncates the free pages from the end of the
+file.
+*/
+/*
+Truncates the pages that previous compaction steps trimmed from the end of the file. A step only lowers the next page
+number in its txn, and the file can't be shorter than the last durable meta page says it is, so this is done at the
+start of the next step: in a write txn (so no other commit is writing past the end), after syncing the committed txns,
+and never below the next page number of the last committed txn.
+*/
+static int truncateTrimmed(MDB_env* env) {
+#ifndef _WIN32 // Windows can not shrink a mapped file
+	unsigned int flags;
+	mdb_env_get_flags(env, &flags);
+	if (flags & (MDB_WRITEMAP | MDB_RDONLY))
+		return 0; // with a writemap, the file is kept at the map size
+#ifdef MDB_RPAGE_CACHE
+	if (flags & MDB_REMAP_CHUNKS)
+		return 0; // compaction isn't supported
+#endif
+	MDB_envinfo info;
+	mdb_env_info(env, &info);
+	MDB_stat stat;
+	mdb_env_stat(env, &stat);
+	off_t end = (off_t) (info.me_last_pgno + 1) * stat.ms_psize;
+	mdb_filehandle_t fd;
+	mdb_env_get_fd(env, &fd);
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size <= end)
+		return 0;
+	int rc = mdb_env_sync(env, 1);
+	if (rc)
+		return rc;
+	if (ftruncate(fd, end) < 0)
+		return errno;
+#endif
+	return 0;
+}
+
+Napi::Value EnvWrap::compactStep(const CallbackInfo& info) {
+	if (!this->env) {
+		return throwError(info.Env(), "The environment is already closed.");
+	}
+	if (!this->writeTxn) {
+		return throwError(info.Env(), "Compaction must be performed in a write transaction.");
+	}
+	double maxPages = info[0].As<Number>();
+	mdb_size_t moved = 0, trimmed = 0;
+	int rc = truncateTrimmed(this->env);
+	if (rc == 0)
+		rc = mdb_env_compact_step(this->writeTxn->txn, maxPages > 0 ? (mdb_size_t) maxPages : 0, &moved, &trimmed);
+	if (rc) {
+		if (rc == MDB_INCOMPATIBLE)
+			return throwError(info.Env(), "Compaction is not supported with remapChunks or encryption");
+		return throwLmdbError(info.Env(), rc);
+	}
+	Object result = Object::New(info.Env());
+	result.Set("moved", Number::New(info.Env(), (double) moved));
+	result.Set("trimmed", Number::New(info.Env(), (double) trimmed));
+	return result;
+}
+
+static std::string getStringArg(napi_env env, napi_value arg) {
+	size_t length;
+	napi_get_value_string_utf8(env, arg, nullptr, 0, &length);
+	std::string value(length, '\0');
+	napi_get_value_string_utf8(env, arg, &value[0], length + 1, &length);
+	return value;
+}
+
+// applies an incremental backup to a data file (which must not be open), returning the txn id it was restored to
+NAPI_FUNCTION(applyIncrementalBackup) {
+	ARGS(2)
+	mdb_size_t txnId;
+	int rc = mdb_env_apply_incremental(getStringArg(env, args[0]).c_str(), getStringArg(env, args[1]).c_str(), &txnId);
+	if (rc) {
+		if (rc == MDB_INCOMPATIBLE)
+			THROW_ERROR("The incremental backup is not relative to the last transaction of the restored database");
+		if (rc == EEXIST)
+			THROW_ERROR("A full incremental backup can only be restored to a new database");
+		return throwLmdbError(env, rc);
+	}
+	napi_create_double(env, (double) txnId, &returnValue);
+	return returnValue;
+}
+
+void setupExportBackup(Napi::Env env, Object exports) {
+	EXPORT_NAPI_FUNCTION("applyIncrementalBackup", applyIncrementalBackup);
+}
@@ -0,0 +1,407 @@
+#include "lmdb-js.h"
+#include <cstdio>
+#include <queue>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace Napi;
+
+// size of the buffer used for reading and writing run files
+const size_t RUN_FILE_BUFFER_SIZE = 0x100000;
+
+/*
+Entries that are added to the bulk loader and the entries in the sorted runs use the same format:
+header (16 bytes):
+	uint32: key size
+	uint32: value size
+	float64: version (only used if the dbi has versions)
+key bytes
+value bytes
+Entries from JS are padded to 8 bytes, entries in sorted runs are packed.
+*/
+typedef struct {
+	uint32_t keySize;
+	uint32_t valueSize;
+	double version;
+} sort_entry_header_t;
+
+typedef struct {
+	uint64_t prefix; // first 8 bytes of the key in big-endian order so that most comparisons are a single integer compare
+	char* entry;
+} sort_entry_t;
+
+class SortedRun {
+public:
+	uint32_t runIndex;
+	// in memory run
+	char* data;
+	size_t size;
+	size_t position;
+	// spilled run
+	FILE* file;
+	std::string path;
+	char* readBuffer;
+	size_t readBufferSize;
+	// current entry
+	sort_entry_header_t header;
+	char* key;
+	char* value;
+	SortedRun(uint32_t runIndex) : runIndex(runIndex), data(nullptr), size(0), position(0), file(nullptr),
+		readBuffer(nullptr), readBufferSize(0) {}
+	~SortedRun() {
+		if (data)
+			free(data);
+		if (readBuffer)
+			free(readBuffer);
+		if (file) {
+			fclose(file);
+			if (!path.empty())
+				remove(path.c_str());
+		}
+	}
+	// advance to the next entry, returning false if the run is finished
+	bool next() {
+		if (file) {
+			if (fread(&header, sizeof(header), 1, file) != 1)
+				return false;
+			size_t entrySize = header.keySize + header.valueSize;
+			if (entrySize > readBufferSize) {
+				readBufferSize = entrySize > 0x1000 ? entrySize : 0x1000;
+				char* newBuffer = (char*) realloc(readBuffer, readBufferSize);
+				if (!newBuffer)
+					return false;
+				readBuffer = newBuffer;
+			}
+			if (entrySize && fread(readBuffer, entrySize, 1, file) != 1)
+				return false;
+			key = readBuffer;
+		} else {
+			if (position >= size)
+				return false;
+			memcpy(&header, data + position, sizeof(header));
+			key = data + position + sizeof(header);
+			position += sizeof(header) + header.keySize + header.valueSize;
+		}
+		value = key + header.keySize;
+		return true;
+	}
+};
+
+static inline int compareEntries(const char* a, uint32_t aSize, const char* b, uint32_t bSize, bool integerKey) {
+	if (integerKey) {
+		uint32_t aInt, bInt;
+		memcpy(&aInt, a, 4);
+		memcpy(&bInt, b, 4);
+		return aInt < bInt ? -1 : aInt > bInt ? 1 : 0;
+	}
+	int diff = memcmp(a, b, aSize < bSize ? aSize : bSize);
+	return diff ? diff : aSize < bSize ? -1 : aSize > bSize ? 1 : 0;
+}
+
+static inline uint64_t keyPrefix(const char* key, uint32_t keySize, bool integerKey) {
+	if (integerKey) {
+		uint32_t intKey;
+		memcpy(&intKey, key, 4);
+		return intKey;
+	}
+	uint64_t prefix = 0;
+	for (uint32_t i = 0; i < 8; i++)
+		prefix = (prefix << 8) | (i < keySize ? (uint8_t) key[i] : 0);
+	return prefix;
+}
+
+static int compareHeaders(const char* a, const char* b, bool integerKey, bool dupSort) {
+	sort_entry_header_t aHeader, bHeader;
+	memcpy(&aHeader, a, sizeof(aHeader));
+	memcpy(&bHeader, b, sizeof(bHeader));
+	a += sizeof(aHeader);
+	b += sizeof(bHeader);
+	int diff = compareEntries(a, aHeader.keySize, b, bHeader.keySize, integerKey);
+	if (diff || !dupSort)
+		return diff;
+	return compareEntries(a + aHeader.keySize, aHeader.valueSize, b + bHeader.keySize, bHeader.valueSize, false);
+}
+
+BulkLoader::BulkLoader(const CallbackInfo& info) : ObjectWrap<BulkLoader>(info) {
+	napi_unwrap(info.Env(), info[0], (void**) &dw);
+	Object options = info[1].As<Object>();
+	Value memoryLimit = options.Get("memoryLimit");
+	this->memoryLimit = memoryLimit.IsNumber() ? (size_t) memoryLimit.As<Number>().Int64Value() : 0x10000000;
+	Value tempDirectory = options.Get("tempDirectory");
+	if (tempDirectory.IsString())
+		this->tempDirectory = tempDirectory.As<String>().Utf8Value();
+	memoryUsed = 0;
+	pendingRuns = 0;
+	merging = false;
+	nextFileId = 0;
+	runsLock = new pthread_mutex_t;
+	pthread_mutex_init(runsLock, nullptr);
+	info.This().As<Object>().Set("address", Number::New(info.Env(), (size_t) this));
+}
+
+BulkLoader::~BulkLoader() {
+	clear();
+	pthread_mutex_destroy(runsLock);
+	delete runsLock;
+}
+
+void BulkLoader::clear() {
+	for (SortedRun* run : runs)
+		delete run;
+	runs.clear();
+	merge.clear();
+	memoryUsed = 0;
+	merging = false;
+}
+
+/*
+Sort the entries of one chunk and store the sorted run in memory, or in a temporary file if the memory limit
+has been reached. This is called from the thread pool, so different runs are sorted concurrently.
+*/
+int BulkLoader::sortRun(char* chunk, size_t chunkSize, uint32_t runIndex) {
+	bool integerKey = dw->keyType == LmdbKeyType::Uint32Key;
+	bool dupSort = dw->flags & MDB_DUPSORT;
+	std::vector<sort_entry_t> entries;
+	size_t position = 0;
+	size_t runSize = 0;
+	while (position + sizeof(sort_entry_header_t) <= chunkSize) {
+		char* entry = chunk + position;
+		sort_entry_header_t header;
+		memcpy(&header, entry, sizeof(header));
+		size_t entrySize = sizeof(header) + header.keySize + header.valueSize;
+		if (position + entrySize > chunkSize || (integerKey && header.keySize != 4))
+			return EINVAL;
+		entries.push_back({ keyPrefix(entry + sizeof(header), header.keySize, integerKey), entry });
+		runSize += entrySize;
+		position = (position + entrySize + 7) & ~7;
+	}
+	// stable, so that later entries for the same key are merged after earlier ones (and win)
+	std::stable_sort(entries.begin(), entries.end(), [integerKey, dupSort](const sort_entry_t& a, const sort_entry_t& b) {
+		if (a.prefix != b.prefix)
+			return a.prefix < b.prefix;
+		return compareHeaders(a.entry, b.entry, integerKey, dupSort) < 0;
+	});
+	Compression* compression = dw->compression;
+	if (compression)
+		runSize += runSize >> 3; // room for incompressible values to grow
+	char* data = (char*) malloc(runSize + 8);
+	if (!data)
+		return ENOMEM;
+	position = 0;
+	for (sort_entry_t& entry : entries) {
+		sort_entry_header_t header;
+		memcpy(&header, entry.entry, sizeof(header));
+		MDB_val value;
+		value.mv_data = entry.entry + sizeof(header) + header.keySize;
+		value.mv_size = header.valueSize;
+		argtokey_callback_t freeValue = compression ? compression->compress(&value, nullptr) : nullptr;
+		header.valueSize = value.mv_size;
+		size_t entrySize = sizeof(header) + header.keySize + header.valueSize;
+		if (position + entrySize > runSize) {
+			runSize = (position + entrySize) * 2;
+			char* newData = (char*) realloc(data, runSize);
+			if (!newData) {
+				free(data);
+				if (freeValue)
+					freeValue(value);
+				return ENOMEM;
+			}
+			data = newData;
+		}
+		memcpy(data + position, &header, sizeof(header));
+		memcpy(data + position + sizeof(header), entry.entry + sizeof(header), header.keySize);
+		memcpy(data + position + sizeof(header) + header.keySize, value.mv_data, value.mv_size);
+		position += entrySize;
+		if (freeValue)
+			freeValue(value);
+	}
+	SortedRun* run = new SortedRun(runIndex);
+	run->size = position;
+	pthread_mutex_lock(runsLock);
+	bool spill = memoryUsed + position > memoryLimit;
+	if (!spill)
+		memoryUsed += position;
+	uint32_t fileId = nextFileId++;
+	pthread_mutex_unlock(runsLock);
+	int rc = 0;
+	if (spill) {
+		// over the memory limit, write the sorted run out to a temporary file
+		if (tempDirectory.empty())
+			run->file = tmpfile();
+		else {
+			char fileName[64];
+			snprintf(fileName, sizeof(fileName), "/lmdb-sort-%llx-%u.tmp", (unsigned long long) (size_t) this, fileId);
+			run->path = tempDirectory + fileName;
+			run->file = fopen(run->path.c_str(), "w+b");
+		}
+		if (!run->file)
+			rc = errno ? errno : EIO;
+		else {
+			setvbuf(run->file, nullptr, _IOFBF, RUN_FILE_BUFFER_SIZE);
+			if (position && fwrite(data, position, 1, run->file) != 1)
+				rc = errno ? errno : EIO;
+			else
+				rewind(run->file);
+		}
+		free(data);
+	} else
+		run->data = data;
+	pthread_mutex_lock(runsLock);
+	runs[runIndex] = run;
+	pthread_mutex_unlock(runsLock);
+	return rc;
+}
+
+class SortRunWorker : public AsyncWorker {
+  public:
+	SortRunWorker(BulkLoader* loader, char* chunk, size_t size, uint32_t runIndex, const Function& callback)
+	  : AsyncWorker(callback), loader(loader), chunk(chunk), size(size), runIndex(runIndex) {}
+
+	void Execute() {
+		int rc = loader->sortRun(chunk, size, runIndex);
+		if (rc)
+			SetError(mdb_strerror(rc));
+	}
+
+	void OnOK() {
+		loader->pendingRuns--;
+		napi_value result; // we use direct napi call here because node-addon-api interface with throw a fatal error if a worker thread is terminating
+		napi_call_function(Env(), Env().Undefined(), Callback().Value(), 0, {}, &result);
+	}
+	void OnError(const Error& e) {
+		loader->pendingRuns--;
+		napi_value result; // we use direct napi call here because node-addon-api interface with throw a fatal error if a worker thread is terminating
+		napi_value arg = e.Value();
+		napi_call_function(Env(), Env().Undefined(), Callback().Value(), 1, &arg, &result);
+	}
+
+  private:
+	BulkLoader* loader;
+	char* chunk; // this is JS buffer, which is kept pinned in memory by the callback
+	size_t size;
+	uint32_t runIndex;
+};
+
+Napi::Value BulkLoader::add(const CallbackInfo& info) {
+	if (merging)
+		return throwError(info.Env(), "Can not add entries after loading has started");
+	char* chunk;
+	size_t length;
+	napi_get_buffer_info(info.Env(), info[0], (void**) &chunk, &length);
+	size_t size = info[1].As<Number>().Int64Value();
+	if (size > length)
+		return throwError(info.Env(), "Size is larger than the buffer");
+	pthread_mutex_lock(runsLock);
+	uint32_t runIndex = runs.size();
+	runs.push_back(nullptr);
+	pthread_mutex_unlock(runsLock);
+	pendingRuns++;
+	SortRunWorker* worker = new SortRunWorker(this, chunk, size, runIndex, info[2].As<Function>());
+	worker->Queue();
+	return info.Env().Undefined();
+}
+
+static bool mergeOrder(SortedRun* a, SortedRun* b, bool integerKey, bool dupSort) {
+	// priority queue ordering, returns true if a should come after b
+	int diff = compareEntries(a->key, a->header.keySize, b->key, b->header.keySize, integerKey);
+	if (!diff && dupSort)
+		diff = compareEntries(a->value, a->header.valueSize, b->value, b->header.valueSize, false);
+	return diff ? diff > 0 : a->runIndex > b->runIndex; // for equal keys, earlier runs go first
+}
+
+static int appendEntry(MDB_cursor* cursor, SortedRun* run, bool hasVersions) {
+	MDB_val key, data;
+	key.mv_data = run->key;
+	key.mv_size = run->header.keySize;
+	unsigned int flags = MDB_APPEND;
+	int rc;
+	do {
+		if (hasVersions) {
+			data.mv_size = run->header.valueSize + 8;
+			rc = mdb_cursor_put(cursor, &key, &data, flags | MDB_RESERVE);
+			if (rc == 0) {
+				memcpy(data.mv_data, &run->header.version, 8);
+				memcpy((char*) data.mv_data + 8, run->value, run->header.valueSize);
+			}
+		} else {
+			data.mv_data = run->value;
+			data.mv_size = run->header.valueSize;
+			rc = mdb_cursor_put(cursor, &key, &data, flags);
+		}
+		// an existing key that sorts after this one (or a duplicate key) can't be appended, fall back to a normal put
+		if (rc != MDB_KEYEXIST || !flags)
+			return rc;
+		flags = 0;
+	} while (true);
+}
+
+/*
+Merge the sorted runs and write up to the given number of entries into the dbi, in the current write transaction.
+Returns the number of entries that were written, zero once all entries have been loaded.
+*/
+Napi::Value BulkLoader::load(const CallbackInfo& info) {
+	EnvWrap* ew = dw->ew;
+	if (!ew->writeTxn)
+		return throwError(info.Env(), "No current write transaction");
+	if (pendingRuns > 0)
+		return throwError(info.Env(), "Not all runs have finished sorting");
+	uint32_t maxEntries = info[0].As<Number>().Uint32Value();
+	bool integerKey = dw->keyType == LmdbKeyType::Uint32Key;
+	bool dupSort = dw->flags & MDB_DUPSORT;
+	if (!merging) {
+		merging = true;
+		for (SortedRun* run : runs) {
+			if (run && run->next())
+				merge.push_back(run);
+		}
+		std::make_heap(merge.begin(), merge.end(), [integerKey, dupSort](SortedRun* a, SortedRun* b) {
+			return mergeOrder(a, b, integerKey, dupSort);
+		});
+	}
+	MDB_cursor* cursor;
+	int rc = mdb_cursor_open(ew->writeTxn->txn, dw->dbi, &cursor);
+	if (rc)
+		return throwLmdbError(info.Env(), rc);
+	uint32_t count = 0;
+	while (count < maxEntries && !merge.empty()) {
+		SortedRun* run = merge.front();
+		rc = appendEntry(cursor, run, dw->hasVersions);
+		if (rc)
+			break;
+		MDB_val key;
+		key.mv_data = run->key;
+		key.mv_size = run->header.keySize;
+		addToKeyFilters(dw->env, dw->dbi, &key);
+		count++;
+		std::pop_heap(merge.begin(), merge.end(), [integerKey, dupSort](SortedRun* a, SortedRun* b) {
+			return mergeOrder(a, b, integerKey, dupSort);
+		});
+		if (run->next()) {
+			std::push_heap(merge.begin(), merge.end(), [integerKey, dupSort](SortedRun* a, SortedRun* b) {
+				return mergeOrder(a, b, integerKey, dupSort);
+			});
+		} else
+			merge.pop_back();
+	}
+	mdb_cursor_close(cursor);
+	if (rc)
+		return throwLmdbError(info.Env(), rc);
+	return Number::New(info.Env(), count);
+}
+
+Napi::Value BulkLoader::close(const CallbackInfo& info) {
+	if (pendingRuns > 0)
+		return throwError(info.Env(), "Not all runs have finished sorting");
+	clear();
+	return info.Env().Undefined();
+}
+
+void BulkLoader::setupExports(Napi::Env env, Object exports) {
+	Function BulkLoaderClass = DefineClass(env, "BulkLoader", {
+		BulkLoader::InstanceMethod("add", &BulkLoader::add),
+		BulkLoader::InstanceMethod("load", &BulkLoader::load),
+		BulkLoader::InstanceMethod("close", &BulkLoader::close),
+	});
+	exports.Set("BulkLoader", BulkLoaderClass);
+}
@@ -5,8 +5,15 @@
 using namespace Napi;
 
 thread_local LZ4_stream_t* Compression::stream = nullptr;
+std::atomic<uint32_t> Compression::mapGeneration;
 Compression::Compression(const CallbackInfo& info) : ObjectWrap<Compression>(info) {
 	unsigned int compressionThreshold = 1000;
+	cacheCapacity = 0;
+	cacheSize = 0;
+	cacheHand = 0;
+	cacheGeneration = mapGeneration.load();
+	cacheHits = 0;
+	cacheMisses = 0;
 	char* dictionary = nullptr;
 	size_t dictSize = 0;
 	if (info[0].IsObject()) {
@@ -23,6 +30,10 @@ Compression::Compression(const CallbackInfo& info) : ObjectWrap<Compression>(inf
 		if (thresholdOption.IsNumber()) {
 			compressionThreshold = thresholdOption.As<Number>();
 		}
+		auto cacheSizeOption = info[0].As<Object>().Get("cacheSize");
+		if (cacheSizeOption.IsNumber()) {
+			cacheCapacity = (size_t) cacheSizeOption.As<Number>().DoubleValue();
+		}
 	}
 	this->dictionary = this->compressDictionary = dictionary;
 	this->dictionarySize = dictSize;
@@ -90,6 +101,110 @@ void Compression::decompress(MDB_val& data, bool &isValid, bool canAllocate) {
 	isValid = true;
 }
 
+/*
+The decompressed value cache avoids decompressing the same value repeatedly. A committed page is never modified, so a
+compressed value is identified by its env, its offset in the data file, and the txn id of the page that holds it, in any
+read txn (and the map can be moved by a resize without invalidating it). Entries are evicted with the CLOCK algorithm, which only needs to set a flag
+on a hit, and since each thread has its own compression instance, no locking is needed.
+*/
+bool Compression::getDecompressed(MDB_val& data, MDB_env* env, mdb_size_t offset, mdb_size_t txnId) {
+	if (cacheGeneration != mapGeneration.load(std::memory_order_relaxed))
+		clearDecompressed(); // an env was closed, and another env could be opened at its address
+	auto position = cacheIndex.find(decompressed_key_t(env, offset));
+	if (position != cacheIndex.end()) {
+		decompressed_entry_t& entry = cacheEntries[position->second];
+		if (entry.txnId == txnId && entry.size <= decompressSize) {
+			memcpy(decompressTarget, entry.data, entry.size);
+			data.mv_data = decompressTarget;
+			data.mv_size = entry.size;
+			entry.referenced = true;
+			cacheHits++;
+			return true;
+		}
+	}
+	cacheMisses++;
+	return false;
+}
+
+void Compression::cacheDecompressed(MDB_env* env, mdb_size_t offset, mdb_size_t txnId, MDB_val& data) {
+	if (data.mv_size > cacheCapacity / 4) // don't let one large value flush the cache
+		return;
+	decompressed_key_t key(env, offset);
+	auto position = cacheIndex.find(key);
+	unsigned int slot;
+	if (position != cacheIndex.end()) {
+		// the page was freed and reused, replace the old value
+		slot = position->second;
+		cacheSize -= cacheEntries[slot].size;
+		free(cacheEntries[slot].data);
+	} else {
+		// sweep the clock hand until there is room, clearing referenced flags as we go
+		size_t maxEntries = cacheCapacity / 64 + 16;
+		while (cacheEntries.size() > 0 && (cacheSize + data.mv_size > cacheCapacity || cacheEntries.size() >= maxEntries)) {
+			if (cacheHand >= cacheEntries.size())
+				cacheHand = 0;
+			decompressed_entry_t& entry = cacheEntries[cacheHand];
+			if (entry.referenced) {
+				entry.referenced = false;
+				cacheHand++;
+				continue;
+			}
+			// evict by moving the last entry into this slot
+			cacheIndex.erase(decompressed_key_t(entry.env, entry.offset));
+			cacheSize -= entry.size;
+			free(entry.data);
+			if (cacheHand < cacheEntries.size() - 1) {
+				entry = cacheEntries.back();
+				cacheIndex[decompressed_key_t(entry.env, entry.offset)] = cacheHand;
+			}
+			cacheEntries.pop_back();
+		}
+		slot = cacheEntries.size();
+		cacheEntries.push_back(decompressed_entry_t());
+		cacheIndex[key] = slot;
+	}
+	decompressed_entry_t& entry = cacheEntries[slot];
+	entry.data = (char*) malloc(data.mv_size);
+	if (!entry.data) {
+		cacheIndex.erase(key);
+		cacheEntries[slot] = cacheEntries.back();
+		if (slot < cacheEntries.size() - 1)
+			cacheIndex[decompressed_key_t(cacheEntries[slot].env, cacheEntries[slot].offset)] = slot;
+		cacheEntries.pop_back();
+		return;
+	}
+	memcpy(entry.data, data.mv_data, data.mv_size);
+	entry.env = env;
+	entry.offset = offset;
+	entry.txnId = txnId;
+	entry.size = data.mv_size;
+	entry.referenced = false;
+	cacheSize += data.mv_size;
+}
+
+void Compression::clearDecompressed() {
+	for (decompressed_entry_t& entry : cacheEntries)
+		free(entry.data);
+	cacheEntries.clear();
+	cacheIndex.clear();
+	cacheSize = 0;
+	cacheHand = 0;
+	cacheGeneration = mapGeneration.load();
+}
+
+Compression::~Compression() {
+	clearDecompressed();
+}
+
+Napi::Value Compression::getCacheStats(const CallbackInfo& info) {
+	Object stats = Object::New(info.Env());
+	stats.Set("hits", Number::New(info.Env(), (double) cacheHits));
+	stats.Set("misses", Number::New(info.Env(), (double) cacheMisses));
+	stats.Set("entries", Number::New(info.Env(), (double) cacheEntries.size()));
+	stats.Set("size", Number::New(info.Env(), (double) cacheSize));
+	return stats;
+}
+
 int Compression::compressInstruction(EnvWrap* env, double* compressionAddress) {
 	MDB_val value;
 	value.mv_data = (void*)((size_t) * (compressionAddress - 1));
@@ -195,6 +310,7 @@ NAPI_FUNCTION(EnvWrap::compress) {
 void Compression::setupExports(Napi::Env env, Object exports) {
 	Function CompressionClass = DefineClass(env, "Compression", {
 		Compression::InstanceMethod("setBuffer", &Compression::setBuffer),
+		Compression::InstanceMethod("getCacheStats", &Compression::getCacheStats),
 	});
 	exports.Set("Compression", CompressionClass);
 //	compressionTpl->InstanceTemplate()->SetInternalFieldCount(1);
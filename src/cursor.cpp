@@ -98,7 +98,7 @@ int CursorWrap::returnEntry(int lastRC, MDB_val &key, MDB_val &data) {
 	}
 	char* keyBuffer = dw->ew->keyBuffer;
 	if (flags & INCLUDE_VALUES) {
-		int result = getVersionAndUncompress(data, dw);
+		int result = getVersionAndUncompress(data, dw, txn);
 		bool fits = true;
 		if (result) {
 			fits = valToBinaryFast(data, dw); // it fit in the global/compression-target buffer
@@ -126,6 +126,7 @@ int32_t CursorWrap::doPosition(uint32_t offset, uint32_t keySize, uint64_t endKe
 	if (dw->ew->env == nullptr) {
 		return MDB_BAD_TXN;
 	}
+	LatencyTimer timer(dw->ew->histogram(CURSOR_POSITION_LATENCY));
 	if (flags & RENEW_CURSOR) { // TODO: check the txn_id to determine if we need to renew
 		rc = mdb_cursor_renew(txn = dw->ew->getReadTxn(), cursor);
 		if (rc) {
@@ -270,6 +271,61 @@ int32_t CursorWrap::doPosition(uint32_t offset, uint32_t keySize, uint64_t endKe
 	// TODO: Handle count?
 	return returnEntry(rc, key, data);
 }
+/*
+Projects the entries from the current position of the cursor (after positioning it), up to the row limit in the
+header, leaving the cursor at the first entry that wasn't projected.
+*/
+int32_t CursorWrap::doProject(char* workspace, char* heap) {
+	projection_t projection(workspace, heap);
+	uint32_t rowLimit = projection.header[1];
+	MDB_val key, data;
+	if (dw->ew->env == nullptr)
+		return MDB_BAD_TXN;
+	LatencyTimer timer(dw->ew->histogram(CURSOR_ITERATE_LATENCY));
+	int rc = mdb_cursor_get(cursor, &key, &data, MDB_GET_CURRENT);
+	uint32_t rows = 0;
+	projection.header[5] = PROJECTION_FILLED;
+	while (!rc && rows < rowLimit) {
+		if (endKey.mv_size > 0) {
+			int comparison;
+			if (flags & VALUES_FOR_KEY)
+				comparison = mdb_dcmp(txn, dw->dbi, &endKey, &data);
+			else
+				comparison = mdb_cmp(txn, dw->dbi, &endKey, &key);
+			if ((flags & REVERSE) ? comparison >= 0 : (comparison <= 0)) {
+				if (!((flags & INCLUSIVE_END) && comparison == 0))
+					break;
+			}
+		}
+		MDB_val value = data;
+		if (!getVersionAndUncompress(value, dw, txn))
+			return -MDB_CORRUPTED;
+		if (!projection.projectRow(rows, &key, value)) {
+			projection.header[5] = PROJECTION_HEAP_FULL;
+			break;
+		}
+		rows++;
+		rc = mdb_cursor_get(cursor, &key, &data, iteratingOp);
+	}
+	if (rc && rc != MDB_NOTFOUND)
+		return rc > 0 ? -rc : rc;
+	// the cursor stays on the last entry when it runs out, so a batch that filled up at the end must end the iteration
+	if (rc == MDB_NOTFOUND || (rows < rowLimit && projection.header[5] != PROJECTION_HEAP_FULL))
+		projection.header[5] = PROJECTION_DONE;
+	projection.header[6] = projection.heapUsed;
+	return rows;
+}
+
+NAPI_FUNCTION(projectEntries) {
+	ARGS(3)
+	GET_INT64_ARG(0);
+	CursorWrap* cw = (CursorWrap*) i64;
+	int64_t workspace, heap;
+	napi_get_value_int64(env, args[1], &workspace);
+	napi_get_value_int64(env, args[2], &heap);
+	RETURN_INT32(cw->doProject((char*) workspace, (char*) heap));
+}
+
 NAPI_FUNCTION(position) {
 	ARGS(5)
     GET_INT64_ARG(0);
@@ -298,6 +354,7 @@ NAPI_FUNCTION(iterate) {
     CursorWrap* cw = (CursorWrap*) i64;
 	MDB_val key, data;
 	int rc;
+	LatencyTimer timer(cw->dw->ew->histogram(CURSOR_ITERATE_LATENCY));
 	if (cw->dw->ew->env == nullptr) rc = MDB_BAD_TXN;
 	else
 		rc = mdb_cursor_get(cw->cursor, &key, &data, cw->iteratingOp);
@@ -311,6 +368,7 @@ int32_t iterateFFI(double cwPointer) {
 	MDB_val key, data;
 	if (cw->dw->ew->env == nullptr)
 		return MDB_BAD_TXN;
+	LatencyTimer timer(dw->ew->histogram(CURSOR_ITERATE_LATENCY));
 	int rc = mdb_cursor_get(cw->cursor, &key, &data, cw->iteratingOp);
 	return cw->returnEntry(rc, key, data);
 }
@@ -336,7 +394,7 @@ NAPI_FUNCTION(getCurrentShared) {
 	int rc = mdb_cursor_get(cw->cursor, &key, &data, MDB_GET_CURRENT);
 	if (rc)
 		RETURN_INT32(cw->returnEntry(rc, key, data));
-	getVersionAndUncompress(data, cw->dw);
+	getVersionAndUncompress(data, cw->dw, cw->txn);
 	napi_create_external_buffer(env, data.mv_size,
 		(char*) data.mv_data, noopCursor, nullptr, &returnValue);
 	return returnValue;
@@ -362,6 +420,7 @@ void CursorWrap::setupExports(Napi::Env env, Object exports) {
 	EXPORT_NAPI_FUNCTION("getCurrentValue", getCurrentValue);
 	EXPORT_NAPI_FUNCTION("getCurrentShared", getCurrentShared);
 	EXPORT_NAPI_FUNCTION("renew", renew);
+	EXPORT_NAPI_FUNCTION("projectEntries", projectEntries);
 	EXPORT_FUNCTION_ADDRESS("positionPtr", positionFFI);
 	EXPORT_FUNCTION_ADDRESS("iteratePtr", iterateFFI);
 
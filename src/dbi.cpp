@@ -11,6 +11,7 @@ DbiWrap::DbiWrap(const Napi::CallbackInfo& info) : ObjectWrap<DbiWrap>(info) {
 	this->compression = nullptr;
 	this->isOpen = false;
 	this->getFast = false;
+	this->keyFilter = nullptr;
 	this->ew = nullptr;
 	EnvWrap *ew;
 	napi_unwrap(info.Env(), info[0], (void**) &ew);
@@ -78,13 +79,19 @@ int DbiWrap::open(int flags, char* name, bool hasVersions, LmdbKeyType keyType,
 		return rc;
 	this->isOpen = true;
 	if (keyType == LmdbKeyType::DefaultKey && name) { // use the fast compare, but can't do it if we have db table/names mixed in
-		mdb_set_compare(txn, dbi, compareFast);
+		#ifdef MDB_LEXICAL_COMPARE
+		// ordered-binary keys are compared lexically, so searches can use integer prefix comparisons
+		mdb_set_lexical_compare(txn, dbi, getCompareFast());
+		#else
+		mdb_set_compare(txn, dbi, getCompareFast());
+		#endif
 	}
 	return 0;
 }
 
 Value DbiWrap::close(const Napi::CallbackInfo& info) {
 	if (this->isOpen) {
+		dropKeyFilter(this->env, this->dbi);
 		mdb_dbi_close(this->env, this->dbi);
 		this->isOpen = false;
 		this->ew = nullptr;
@@ -119,6 +126,7 @@ Value DbiWrap::drop(const Napi::CallbackInfo& info) {
 
 	// Only close database if del == 1
 	if (del == 1) {
+		dropKeyFilter(env, dbi);
 		isOpen = false;
 		ew = nullptr;
 	}
@@ -139,11 +147,28 @@ Value DbiWrap::stat(const Napi::CallbackInfo& info) {
 }
 
 int32_t DbiWrap::doGetByBinary(uint32_t keySize, uint32_t ifNotTxnId, int64_t txnWrapAddress) {
+	MDB_val key;
+	key.mv_size = keySize;
+	key.mv_data = (void*) ew->keyBuffer;
+	return doGet(key, ifNotTxnId, txnWrapAddress);
+}
+
+int32_t DbiWrap::doGetByUint32(uint32_t keyValue, uint32_t ifNotTxnId, int64_t txnWrapAddress) {
+	// the key is passed directly, for MDB_INTEGERKEY databases, without going through the key buffer
+	MDB_val key;
+	key.mv_size = 4;
+	key.mv_data = (void*) &keyValue;
+	return doGet(key, ifNotTxnId, txnWrapAddress);
+}
+
+int32_t DbiWrap::doGet(MDB_val& key, uint32_t ifNotTxnId, int64_t txnWrapAddress) {
 	char* keyBuffer = ew->keyBuffer;
+	LatencyTimer timer(ew->histogram(GET_LATENCY));
 	MDB_txn* txn = ew->getReadTxn(txnWrapAddress);
-	MDB_val key, data;
-	key.mv_size = keySize;
-	key.mv_data = (void*) keyBuffer;
+	// a key that isn't in the filter doesn't exist, so we don't need to search for it
+	if (keyFilter && keyFilterExcludes(keyFilter, txn, &key))
+		return MDB_NOTFOUND;
+	MDB_val data;
 	uint32_t* currentTxnId = (uint32_t*) (keyBuffer + 32);
 	#ifdef MDB_RPAGE_CACHE
 	int result = mdb_get_with_txn(txn, dbi, &key, &data, (mdb_size_t*) currentTxnId);
@@ -155,11 +180,17 @@ int32_t DbiWrap::doGetByBinary(uint32_t keySize, uint32_t ifNotTxnId, int64_t tx
 			return -result;
 		return result;
 	}
+	if (ew->accessProfile)
+		recordAccess(ew->accessProfile, &data);
+	mdb_size_t valueTxnId = 0;
 	#ifdef MDB_RPAGE_CACHE
 	if (ifNotTxnId && ifNotTxnId == *currentTxnId)
 		return -30004;
+	// values in a write txn may not be committed, so they are not shared through the value cache
+	if (txnWrapAddress ? (((TxnWrap*) txnWrapAddress)->flags & MDB_RDONLY) : !(ew->writeTxn && ew->writeTxn->txn == txn))
+		valueTxnId = *((mdb_size_t*) currentTxnId);
 	#endif
-	result = getVersionAndUncompress(data, this);
+	result = getVersionAndUncompress(data, this, txn, &key, valueTxnId);
 	bool fits = true;
 	if (result) {
 		fits = valToBinaryFast(data, this); // it fits in the global/compression-target buffer
@@ -192,6 +223,24 @@ uint32_t getByBinaryFFI(double dwPointer, uint32_t keySize, uint32_t ifNotTxnId,
 	return dw->doGetByBinary(keySize, ifNotTxnId, txnAddress);
 }
 
+NAPI_FUNCTION(getByUint32) {
+	ARGS(4)
+	GET_INT64_ARG(0);
+	DbiWrap* dw = (DbiWrap*) i64;
+	uint32_t key;
+	GET_UINT32_ARG(key, 1);
+	uint32_t ifNotTxnId;
+	GET_UINT32_ARG(ifNotTxnId, 2);
+	int64_t txnAddress = 0;
+	napi_status status = napi_get_value_int64(env, args[3], &txnAddress);
+	RETURN_INT32(dw->doGetByUint32(key, ifNotTxnId, txnAddress));
+}
+
+uint32_t getByUint32FFI(double dwPointer, uint32_t key, uint32_t ifNotTxnId, uint64_t txnAddress) {
+	DbiWrap* dw = (DbiWrap*) (size_t) dwPointer;
+	return dw->doGetByUint32(key, ifNotTxnId, txnAddress);
+}
+
 napi_finalize noopDbi = [](napi_env, void *, void *) {
 	// Data belongs to LMDB, we shouldn't free it here
 };
@@ -213,7 +262,7 @@ NAPI_FUNCTION(getSharedByBinary) {
 		} else
 			return throwLmdbError(env, rc);
 	}
-	rc = getVersionAndUncompress(data, dw);
+	rc = getVersionAndUncompress(data, dw, txn);
 	napi_create_external_buffer(env, data.mv_size,
 		(char*) data.mv_data, noopDbi, nullptr, &returnValue);
 	return returnValue;
@@ -238,7 +287,7 @@ NAPI_FUNCTION(getStringByBinary) {
 		} else
 			return throwLmdbError(env, rc);
 	}
-	rc = getVersionAndUncompress(data, dw);
+	rc = getVersionAndUncompress(data, dw, txn);
 	if (rc)
 		napi_create_string_utf8(env, (char*) data.mv_data, data.mv_size, &returnValue);
 	else
@@ -344,13 +393,17 @@ void DbiWrap::setupExports(Napi::Env env, Object exports) {
 		DbiWrap::InstanceMethod("close", &DbiWrap::close),
 		DbiWrap::InstanceMethod("drop", &DbiWrap::drop),
 		DbiWrap::InstanceMethod("stat", &DbiWrap::stat),
+		DbiWrap::InstanceMethod("openKeyFilter", &DbiWrap::openKeyFilter),
+		DbiWrap::InstanceMethod("getKeyFilterStats", &DbiWrap::getKeyFilterStats),
 	});
 	exports.Set("Dbi", DbiClass);
 	EXPORT_NAPI_FUNCTION("getByBinary", getByBinary);
+	EXPORT_NAPI_FUNCTION("getByUint32", getByUint32);
 	EXPORT_NAPI_FUNCTION("prefetch", prefetchNapi);
 	EXPORT_NAPI_FUNCTION("getStringByBinary", getStringByBinary);
 	EXPORT_NAPI_FUNCTION("getSharedByBinary", getSharedByBinary);
 	EXPORT_FUNCTION_ADDRESS("getByBinaryPtr", getByBinaryFFI);
+	EXPORT_FUNCTION_ADDRESS("getByUint32Ptr", getByUint32FFI);
 	// TODO: wrap mdb_stat too
 }
 
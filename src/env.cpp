@@ -45,15 +45,30 @@ EnvWrap::EnvWrap(const CallbackInfo& info) : ObjectWrap<EnvWrap>(info) {
 
 	this->currentWriteTxn = nullptr;
 	this->currentReadTxn = nullptr;
+	this->currentReadTw = nullptr;
 	this->writeTxn = nullptr;
 	this->writeWorker = nullptr;
 	this->readTxnRenewed = false;
     this->hasWrites = false;
+	this->histograms = nullptr;
+	this->commitSequence = nullptr;
+	this->notifications = nullptr;
+	this->commitWatcher = nullptr;
+	this->warmers = 0;
+	this->warmCancelled = false;
+	this->warmCancels = 0;
+	this->accessProfile = nullptr;
+	this->changeLogDbi = 0;
+	this->changeLogValues = false;
+	this->changeLogTxnId = 0;
+	this->changeLogSequence = 0;
 	this->writingLock = new pthread_mutex_t;
 	this->writingCond = new pthread_cond_t;
+	this->warmLock = new pthread_mutex_t;
 	info.This().As<Object>().Set("address", Number::New(info.Env(), (size_t) this));
 	pthread_mutex_init(this->writingLock, nullptr);
 	cond_init(this->writingCond);
+	pthread_mutex_init(this->warmLock, nullptr);
 }
 MDB_env* foundEnv;
 const int EXISTING_ENV_FOUND = 10;
@@ -97,6 +112,7 @@ EnvWrap::~EnvWrap() {
 	closeEnv();
 	pthread_mutex_destroy(this->writingLock);
 	pthread_cond_destroy(this->writingCond);
+	pthread_mutex_destroy(this->warmLock);
 	
 }
 
@@ -112,13 +128,13 @@ void EnvWrap::cleanupStrayTxns() {
 	}*/
 	while (this->readTxns.size()) {
 		TxnWrap *tw = *this->readTxns.begin();
-		mdb_txn_abort(tw->txn);
+		releaseReadTxn(tw->txn, false);
 		tw->removeFromEnvWrap();
 	}
 }
 void EnvWrap::consolidateTxns() {
-	// sort read txns by txn id, and then abort newer ones that we can just reference older ones with.
-
+	// read txns at the same snapshot already share a pooled txn, so we can free the reader slots held by idle txns
+	releaseIdleReadTxns(env);
 }
 
 class SyncWorker : public AsyncWorker {
@@ -145,6 +161,7 @@ class SyncWorker : public AsyncWorker {
 	}
 
 	void Execute() {
+		LatencyTimer timer(env->histogram(SYNC_LATENCY));
 		#ifdef _WIN32
 		int rc = mdb_env_sync(env->env, 1);
 		#else
@@ -192,21 +209,26 @@ class CopyWorker : public AsyncWorker {
 };
 
 MDB_txn* EnvWrap::getReadTxn(int64_t tw_address) {
-	MDB_txn* txn;
+	TxnWrap* tw;
 	if (tw_address) // explicit txn
-		txn = ((TxnWrap*)tw_address)->txn;
-	else if (writeTxn && (txn = writeTxn->txn)) {
-		return txn; // no need to renew write txn
-	} else // default to current read txn
-		txn = currentReadTxn;
-	int rc = mdb_txn_renew(txn); // always try to renew
-	if (rc) {
-		if (!txn)
-			fprintf(stderr, "No current read transaction available");
-		if (rc != EINVAL)
-			return nullptr; // if there was a real error, signal with nullptr and let error propagate with last_error
-	}
-	return txn;
+		tw = (TxnWrap*) tw_address;
+	else if (writeTxn && writeTxn->txn) {
+		return writeTxn->txn; // no need to renew write txn
+	} else { // default to current read txn
+		if (currentReadTxn && readTxnRenewed)
+			return currentReadTxn; // it hasn't been reset since it was last renewed (or kept)
+		tw = currentReadTw;
+		if (!tw) {
+			if (!currentReadTxn)
+				fprintf(stderr, "No current read transaction available");
+			return currentReadTxn;
+		}
+	}
+	if (tw->isReset && tw->renewTxn())
+		return nullptr; // if there was a real error, signal with nullptr and let error propagate with last_error
+	if (tw == currentReadTw)
+		readTxnRenewed = true;
+	return tw->txn;
 }
 
 #ifdef MDB_RPAGE_CACHE
@@ -215,6 +237,16 @@ static int encfunc(const MDB_val* src, MDB_val* dst, const MDB_val* key, int enc
 	chacha8(src->mv_data, src->mv_size, (uint8_t*) key[0].mv_data, (uint8_t*) key[1].mv_data, (char*)dst->mv_data);
 	return 0;
 }
+static int encfunc20(const MDB_val* src, MDB_val* dst, const MDB_val* key, int encdec)
+{
+	chacha20(src->mv_data, src->mv_size, (uint8_t*) key[0].mv_data, (uint8_t*) key[1].mv_data, (char*)dst->mv_data);
+	return 0;
+}
+static void sumfunc(const MDB_val* src, MDB_val* dst, const MDB_val* key)
+{
+	uint32_t crc = crc32c(0, src->mv_data, src->mv_size);
+	memcpy(dst->mv_data, &crc, CRC32C_SIZE);
+}
 #endif
 
 void cleanup(void* data) {
@@ -269,18 +301,53 @@ Napi::Value EnvWrap::open(const CallbackInfo& info) {
 
 	Napi::Value encryptionKey = options.Get("encryptionKey");
 	std::string encryptKey;
+	int encryptionRounds = 8;
 	if (!encryptionKey.IsUndefined()) {
 		encryptKey = encryptionKey.As<String>().Utf8Value();
 		if (encryptKey.length() != 32) {
 			return throwError(info.Env(), "Encryption key must be 32 bytes long");
 		}
+		option = options.Get("encryptionCipher");
+		if (option.IsString()) {
+			std::string cipher = option.As<String>().Utf8Value();
+			if (cipher == "chacha20")
+				encryptionRounds = 20;
+			else if (cipher != "chacha8")
+				return throwError(info.Env(), "Unknown encryption cipher, must be chacha8 or chacha20");
+		}
 		#ifndef MDB_RPAGE_CACHE
 		return throwError(info.Env(), "Encryption not supported with data format version 1");
 		#endif
 	}
+	bool checksum = options.Get("checksum").ToBoolean();
+	#ifndef MDB_RPAGE_CACHE
+	if (checksum)
+		return throwError(info.Env(), "Checksums not supported with data format version 1");
+	#endif
+	unsigned int remapCacheChunks = 0;
+	option = options.Get("remapCacheChunks");
+	if (option.IsNumber())
+		remapCacheChunks = option.As<Number>().Uint32Value();
+	unsigned int remapTxnCacheChunks = 0;
+	option = options.Get("remapTxnCacheChunks");
+	if (option.IsNumber())
+		remapTxnCacheChunks = option.As<Number>().Uint32Value();
+	// accessProfile may be true, or an object with the number of pages to keep and the interval between samples
+	uint32_t accessProfilePages = 0, accessProfileInterval = 0;
+	option = options.Get("accessProfile");
+	if (option.IsObject()) {
+		Object profileOptions = option.As<Object>();
+		option = profileOptions.Get("pages");
+		accessProfilePages = option.IsNumber() ? option.As<Number>().Uint32Value() : 0;
+		option = profileOptions.Get("sampleInterval");
+		accessProfileInterval = option.IsNumber() ? option.As<Number>().Uint32Value() : 0;
+		if (!accessProfilePages)
+			accessProfilePages = 0x10000;
+	} else if (option.ToBoolean())
+		accessProfilePages = 0x10000;
 
 	napiEnv = info.Env();
-	rc = openEnv(flags, jsFlags, (const char*)pathString.c_str(), (char*) keyBuffer, compression, maxDbs, maxReaders, mapSize, pageSize, encryptKey.empty() ? nullptr : (char*)encryptKey.c_str());
+	rc = openEnv(flags, jsFlags, (const char*)pathString.c_str(), (char*) keyBuffer, compression, maxDbs, maxReaders, mapSize, pageSize, encryptKey.empty() ? nullptr : (char*)encryptKey.c_str(), encryptionRounds, checksum, remapCacheChunks, remapTxnCacheChunks, accessProfilePages, accessProfileInterval);
 	//delete[] pathBytes;
 	if (rc != 0)
 		return throwLmdbError(info.Env(), rc);
@@ -288,12 +355,14 @@ Napi::Value EnvWrap::open(const CallbackInfo& info) {
 	return info.Env().Undefined();
 }
 int EnvWrap::openEnv(int flags, int jsFlags, const char* path, char* keyBuffer, Compression* compression, int maxDbs,
-		int maxReaders, mdb_size_t mapSize, int pageSize, char* encryptionKey) {
+		int maxReaders, mdb_size_t mapSize, int pageSize, char* encryptionKey, int encryptionRounds, bool checksum,
+		unsigned int remapCacheChunks, unsigned int remapTxnCacheChunks, uint32_t accessProfilePages,
+		uint32_t accessProfileInterval) {
 	this->keyBuffer = keyBuffer;
 	this->compression = compression;
 	this->jsFlags = jsFlags;
 	#ifdef MDB_OVERLAPPINGSYNC
-	MDB_metrics* metrics;
+	env_metrics_t* metrics;
 	#endif
 	int rc;
 	rc = mdb_env_set_maxdbs(env, maxDbs);
@@ -312,12 +381,20 @@ int EnvWrap::openEnv(int flags, int jsFlags, const char* path, char* keyBuffer,
 		enckey.mv_data = encryptionKey;
 		enckey.mv_size = 32;
 		#ifdef MDB_RPAGE_CACHE
-		rc = mdb_env_set_encrypt(env, encfunc, &enckey, 0);
+		rc = mdb_env_set_encrypt(env, encryptionRounds == 20 ? encfunc20 : encfunc, &enckey, 0);
 		#else
 		rc = -1;
 		#endif
 		if (rc != 0) goto fail;
 	}
+	#ifdef MDB_RPAGE_CACHE
+	if (checksum) {
+		rc = mdb_env_set_checksum(env, sumfunc, CRC32C_SIZE);
+		if (rc != 0) goto fail;
+	}
+	rc = mdb_env_set_rpage_cache(env, remapCacheChunks, remapTxnCacheChunks);
+	if (rc != 0) goto fail;
+	#endif
 
 	if (flags & MDB_NOLOCK) {
 		fprintf(stderr, "You chose to use MDB_NOLOCK which is not officially supported by node-lmdb. You have been warned!\n");
@@ -329,8 +406,7 @@ int EnvWrap::openEnv(int flags, int jsFlags, const char* path, char* keyBuffer,
 	mdb_env_set_callback(env, checkExistingEnvs);
 	trackMetrics = !!(flags & MDB_TRACK_METRICS);
 	if (trackMetrics) {
-		metrics = new MDB_metrics;
-		memset(metrics, 0, sizeof(MDB_metrics));
+		metrics = new env_metrics_t();
 		rc = mdb_env_set_userctx(env, (void*) metrics);
 		if (rc) goto fail;
 	}
@@ -361,7 +437,7 @@ int EnvWrap::openEnv(int flags, int jsFlags, const char* path, char* keyBuffer,
 		}
 	}
 	mdb_env_get_flags(env, (unsigned int*) &flags);
-	if ((jsFlags & DELETE_ON_CLOSE)
+	if ((jsFlags & DELETE_ON_CLOSE) || accessProfilePages // the profile is saved by onExit
 	#ifdef MDB_OVERLAPPINGSYNC
 	 	|| (flags & MDB_OVERLAPPINGSYNC)
 	#endif
@@ -372,7 +448,12 @@ int EnvWrap::openEnv(int flags, int jsFlags, const char* path, char* keyBuffer,
 		}
 		openEnvWraps->push_back(this);
 	}
+	if (accessProfilePages)
+		accessProfile = openAccessProfile(env, accessProfilePages, accessProfileInterval);
 	pthread_mutex_unlock(envTracking->envsLock);
+	histograms = trackMetrics ? ::getLatencyHistograms(env) : nullptr;
+	if (jsFlags & COMMIT_NOTIFICATIONS)
+		notifications = openCommitNotifications(env);
 	return 0;
 
 	fail:
@@ -466,6 +547,33 @@ napi_finalize cleanupAllocatedExternal = [](napi_env env, void* data, void* buff
 	free(data);
 };
 
+Napi::Value EnvWrap::setChangeLog(const CallbackInfo& info) {
+	if (!this->env) {
+		return throwError(info.Env(), "The environment is already closed.");
+	}
+	changeLogDbi = info[0].As<Number>().Uint32Value();
+	changeLogValues = info[1].ToBoolean();
+	return info.Env().Undefined();
+}
+
+Napi::Value EnvWrap::getCommitSequence(const CallbackInfo& info) {
+	if (!this->env) {
+		return throwError(info.Env(), "The environment is already closed.");
+	}
+	napi_value arrayBuffer;
+	if (commitSequence && napi_get_reference_value(napiEnv, commitSequence, &arrayBuffer) == napi_ok && arrayBuffer)
+		return Value(info.Env(), arrayBuffer);
+	#ifdef MDB_LAST_TXNID_ADDRESS
+	volatile mdb_size_t* lastTxnId = mdb_env_last_txnid_address(this->env);
+	// this is only usable if there is a lock region, and external buffers are allowed (not in electron)
+	if (lastTxnId && sizeof(mdb_size_t) == 8 &&
+			napi_create_external_arraybuffer(napiEnv, (void*) lastTxnId, 8, cleanupSharedExternal, nullptr, &arrayBuffer) == napi_ok) {
+		napi_create_reference(napiEnv, arrayBuffer, 1, &commitSequence);
+		return Value(info.Env(), arrayBuffer);
+	}
+	#endif
+	return info.Env().Undefined();
+}
 
 NAPI_FUNCTION(getSharedBuffer) {
 	ARGS(2)
@@ -628,7 +736,36 @@ void EnvWrap::closeEnv(bool hasLock) {
 		}
 	}
 	napi_remove_env_cleanup_hook(napiEnv, cleanup, this);
+	// stop any warming, it has a read txn in this env. Warmers that haven't started will see this (under the lock) and
+	// not use the env, and we wait for the running ones, which check for cancellation between pages
+	pthread_mutex_lock(warmLock);
+	warmCancelled = true;
+	pthread_mutex_unlock(warmLock);
+	while (warmers > 0) {
+		#ifdef _WIN32
+		Sleep(1);
+		#else
+		usleep(1000);
+		#endif
+	}
 	cleanupStrayTxns();
+	consolidateTxns();
+	if (commitWatcher) {
+		// stop waiting for commits (waiters get an error) before the notifications are unmapped
+		closeCommitWatcher(commitWatcher);
+		commitWatcher = nullptr;
+	}
+	if (notifications) {
+		closeCommitNotifications(notifications);
+		notifications = nullptr;
+	}
+	if (commitSequence) {
+		napi_value arrayBuffer;
+		if (napi_get_reference_value(napiEnv, commitSequence, &arrayBuffer) == napi_ok && arrayBuffer)
+			napi_detach_arraybuffer(napiEnv, arrayBuffer);
+		napi_delete_reference(napiEnv, commitSequence);
+		commitSequence = nullptr;
+	}
 	if (!hasLock)
 		pthread_mutex_lock(envTracking->envsLock);
 	for (auto envPath = envTracking->envs.begin(); envPath != envTracking->envs.end(); ) {
@@ -645,13 +782,17 @@ void EnvWrap::closeEnv(bool hasLock) {
 					mdb_env_sync(env, 1);
 				}
 				if (envFlags & MDB_TRACK_METRICS) {
-					delete (MDB_metrics*) mdb_env_get_userctx(env);
+					delete (env_metrics_t*) mdb_env_get_userctx(env);
 				}
 				#endif
 				char* path;
 				mdb_env_get_path(env, (const char**)&path);
 				path = strdup(path);
+				closeKeyFilters(env);
+				closeAccessProfile(env);
 				mdb_env_close(env);
+				clearCachedValues(env);
+				Compression::mapGeneration++;
 				pthread_mutex_lock(&sharedBuffers->modification_lock);
 				for (auto bufferRef = EnvWrap::sharedBuffers->buffers.begin(); bufferRef != EnvWrap::sharedBuffers->buffers.end();) {
 					if (bufferRef->second.env == env) {
@@ -679,6 +820,8 @@ void EnvWrap::closeEnv(bool hasLock) {
 	}
 	if (!hasLock)
 		pthread_mutex_unlock(envTracking->envsLock);
+	histograms = nullptr;
+	accessProfile = nullptr;
 	env = nullptr;
 }
 
@@ -729,6 +872,50 @@ Napi::Value EnvWrap::freeStat(const CallbackInfo& info) {
 	stats.Set("treeLeafPageCount", Number::New(info.Env(), stat.ms_leaf_pages));
 	stats.Set("entryCount", Number::New(info.Env(), stat.ms_entries));
 	stats.Set("overflowPages", Number::New(info.Env(), stat.ms_overflow_pages));
+	if (info.Length() > 0 && info[0].ToBoolean()) {
+		// read every freelist record, to measure how fragmented the free pages are (this is proportional to the number
+		// of free pages, so it is only done when requested)
+		MDB_cursor *cursor;
+		MDB_val key, data;
+		rc = mdb_cursor_open(txn, 0, &cursor);
+		if (rc != 0) {
+			return throwLmdbError(info.Env(), rc);
+		}
+		std::vector<mdb_size_t> pages;
+		while ((rc = mdb_cursor_get(cursor, &key, &data, MDB_NEXT)) == 0) {
+			mdb_size_t* idl = (mdb_size_t*) data.mv_data;
+			pages.insert(pages.end(), idl + 1, idl + 1 + idl[0]);
+		}
+		mdb_cursor_close(cursor);
+		if (rc != MDB_NOTFOUND) {
+			return throwLmdbError(info.Env(), rc);
+		}
+		std::sort(pages.begin(), pages.end());
+		// count the runs of contiguous free pages, by the power of two of their length
+		std::vector<double> runs;
+		mdb_size_t runCount = 0, largestRun = 0;
+		for (size_t i = 0; i < pages.size();) {
+			size_t start = i;
+			while (++i < pages.size() && pages[i] == pages[i - 1] + 1) {}
+			mdb_size_t length = i - start;
+			int bucket = 0;
+			while ((length >> (bucket + 1)) > 0)
+				bucket++;
+			if (runs.size() <= (size_t) bucket)
+				runs.resize(bucket + 1);
+			runs[bucket]++;
+			runCount++;
+			if (length > largestRun)
+				largestRun = length;
+		}
+		Array histogram = Array::New(info.Env(), runs.size());
+		for (size_t i = 0; i < runs.size(); i++)
+			histogram.Set((uint32_t) i, Number::New(info.Env(), runs[i]));
+		stats.Set("freePages", Number::New(info.Env(), (double) pages.size()));
+		stats.Set("freeRuns", Number::New(info.Env(), (double) runCount));
+		stats.Set("largestFreeRun", Number::New(info.Env(), (double) largestRun));
+		stats.Set("freeRunLengths", histogram);
+	}
 	return stats;
 }
 
@@ -749,6 +936,43 @@ Napi::Value EnvWrap::info(const CallbackInfo& info) {
 	stats.Set("lastTxnId", Number::New(info.Env(), envinfo.me_last_txnid));
 	stats.Set("maxReaders", Number::New(info.Env(), envinfo.me_maxreaders));
 	stats.Set("numReaders", Number::New(info.Env(), envinfo.me_numreaders));
+	#ifdef MDB_READER_COUNT
+	unsigned int usedReaders, activeReaders;
+	if (mdb_reader_count(this->env, &usedReaders, &activeReaders) == 0) {
+		stats.Set("usedReaders", Number::New(info.Env(), usedReaders));
+		stats.Set("activeReaders", Number::New(info.Env(), activeReaders));
+	}
+	#endif
+	int pooledTxns, sharedTxns, idleTxns;
+	getReadTxnPoolStats(this->env, &pooledTxns, &sharedTxns, &idleTxns);
+	stats.Set("pooledReadTxns", Number::New(info.Env(), pooledTxns));
+	stats.Set("sharedReadTxns", Number::New(info.Env(), sharedTxns));
+	stats.Set("idleReadTxns", Number::New(info.Env(), idleTxns));
+	if (jsFlags & SHARED_VALUE_CACHE) {
+		uint64_t hits, misses;
+		size_t size;
+		getValueCacheStats(&hits, &misses, &size);
+		stats.Set("valueCacheHits", Number::New(info.Env(), (double) hits));
+		stats.Set("valueCacheMisses", Number::New(info.Env(), (double) misses));
+		stats.Set("valueCacheSize", Number::New(info.Env(), (double) size));
+	}
+	if (accessProfile) {
+		uint64_t samples, replayedPages;
+		getAccessProfileStats(accessProfile, &samples, &replayedPages);
+		stats.Set("accessProfileSamples", Number::New(info.Env(), (double) samples));
+		stats.Set("accessProfileReplayedPages", Number::New(info.Env(), (double) replayedPages));
+	}
+	#ifdef MDB_RPAGE_CACHE
+	MDB_rpage_stat rpageStat;
+	if (mdb_env_rpage_stat(this->env, &rpageStat) == 0) { // only with remapChunks
+		stats.Set("remapCacheHits", Number::New(info.Env(), (double) rpageStat.ms_hits));
+		stats.Set("remapCacheMisses", Number::New(info.Env(), (double) rpageStat.ms_misses));
+		stats.Set("remapCacheEvictions", Number::New(info.Env(), (double) rpageStat.ms_evictions));
+		stats.Set("remapCacheDecrypts", Number::New(info.Env(), (double) rpageStat.ms_decrypts));
+		stats.Set("remapCacheChunks", Number::New(info.Env(), (double) rpageStat.ms_chunks));
+		stats.Set("remapCacheMappedBytes", Number::New(info.Env(), (double) rpageStat.ms_mapped));
+	}
+	#endif
 	#ifdef MDB_OVERLAPPINGSYNC
 	if (this->trackMetrics) {
 		MDB_metrics* metrics = (MDB_metrics*) mdb_env_get_userctx(this->env);
@@ -763,6 +987,9 @@ Napi::Value EnvWrap::info(const CallbackInfo& info) {
 		stats.Set("writes", Number::New(info.Env(), metrics->writes));
 		stats.Set("puts", Number::New(info.Env(), metrics->puts));
 		stats.Set("deletes", Number::New(info.Env(), metrics->deletes));
+		stats.Set("checksumsVerified", Number::New(info.Env(), (double) metrics->checksums_verified));
+		stats.Set("checksumFailures", Number::New(info.Env(), (double) metrics->checksum_failures));
+		stats.Set("timeChecksums", Number::New(info.Env(), (double) metrics->time_checksums / TICKS_PER_SECOND));
 	}
 	#endif
 	return stats;
@@ -879,7 +1106,16 @@ Napi::Value EnvWrap::commitTxn(const CallbackInfo& info) {
 	int rc = 0;
 	if (currentTxn->flags & TXN_ABORTABLE) {
 		//fprintf(stderr, "txn_commit\n");
-		rc = mdb_txn_commit(currentTxn->txn);
+		if (currentTxn->parent)
+			rc = mdb_txn_commit(currentTxn->txn);
+		else {
+			mdb_size_t txnId = mdb_txn_id(currentTxn->txn);
+			rc = commitWithMetrics(currentTxn->txn, histograms);
+			if (rc == 0)
+				publishTouched(txnId);
+			else
+				touchedDbis.clear();
+		}
 	}
 	this->writeTxn = currentTxn->parent;
 	if (!this->writeTxn) {
@@ -905,6 +1141,8 @@ Napi::Value EnvWrap::abortTxn(const CallbackInfo& info) {
 	TxnTracked *currentTxn = this->writeTxn;
 	if (currentTxn->flags & TXN_ABORTABLE) {
 		mdb_txn_abort(currentTxn->txn);
+		if (!currentTxn->parent)
+			touchedDbis.clear();
 	} else {
 		throwError(info.Env(), "Can not abort this transaction");
 	}
@@ -949,6 +1187,7 @@ Napi::Value EnvWrap::sync(const CallbackInfo& info) {
 		SyncWorker* worker = new SyncWorker(this, info[0].As<Function>());
 		worker->Queue();
 	} else {
+		LatencyTimer timer(histogram(SYNC_LATENCY));
 		int rc = mdb_env_sync(this->env, 1);
 		if (rc != 0) {
 			return throwLmdbError(info.Env(), rc);
@@ -985,9 +1224,18 @@ void EnvWrap::setupExports(Napi::Env env, Object exports) {
 		EnvWrap::InstanceMethod("stat", &EnvWrap::stat),
 		EnvWrap::InstanceMethod("freeStat", &EnvWrap::freeStat),
 		EnvWrap::InstanceMethod("info", &EnvWrap::info),
+		EnvWrap::InstanceMethod("getLatencyHistograms", &EnvWrap::getLatencyHistograms),
+		EnvWrap::InstanceMethod("getCommitSequence", &EnvWrap::getCommitSequence),
+		EnvWrap::InstanceMethod("waitForCommit", &EnvWrap::waitForCommit),
+		EnvWrap::InstanceMethod("warm", &EnvWrap::warm),
+		EnvWrap::InstanceMethod("cancelWarm", &EnvWrap::cancelWarm),
+		EnvWrap::InstanceMethod("getRecentCommits", &EnvWrap::getRecentCommits),
+		EnvWrap::InstanceMethod("setChangeLog", &EnvWrap::setChangeLog),
 		EnvWrap::InstanceMethod("readerCheck", &EnvWrap::readerCheck),
 		EnvWrap::InstanceMethod("readerList", &EnvWrap::readerList),
 		EnvWrap::InstanceMethod("copy", &EnvWrap::copy),
+		EnvWrap::InstanceMethod("copyIncremental", &EnvWrap::copyIncremental),
+		EnvWrap::InstanceMethod("compactStep", &EnvWrap::compactStep),
 		//EnvWrap::InstanceMethod("detachBuffer", &EnvWrap::detachBuffer),
 	});
 	EXPORT_NAPI_FUNCTION("compress", compress);
@@ -0,0 +1,366 @@
+#include "lmdb-js.h"
+#include <string.h>
+#include <math.h>
+
+using namespace Napi;
+
+/*
+Exporting a range reads the keys and fixed-offset numeric fields of the values of a range of entries into typed arrays,
+for analytics that would otherwise decode every value. The range is split into sub-ranges at the keys that separate
+the subtrees of the database (from its top branch pages), and each sub-range is read by its own worker on the libuv
+pool, in its own read txn. The txns are all started on the main thread and checked to be on the same snapshot, so the
+export is consistent. Each worker writes into its own columns (of the same element type as the target array), and when
+the last one finishes, the columns are copied into the typed arrays in key order.
+Uint32 keys are converted here; other keys are returned as a buffer of (uint32 length, key) for JS to decode, since
+their encoding is defined in JS.
+The descriptor (written by exportRange in read.js) is a Float64Array of EXPORT_HEADER_SIZE numbers, followed by
+EXPORT_FIELD_SIZE numbers for each field: the address of its array, its element type, its offset in the value and
+whether it is big-endian.
+*/
+const int EXPORT_HEADER_SIZE = 8;
+const int EXPORT_FIELD_SIZE = 4;
+const int KEYS_RAW = -1;
+const int KEYS_NONE = -2;
+const int MAX_EXPORT_THREADS = 16;
+const int SNAPSHOT_ATTEMPTS = 10; // to start txns that are all on the same snapshot
+// the element types, in the order of EXPORT_ARRAY_TYPES in read.js
+enum ExportType { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64, BIGINT64, BIGUINT64 };
+static const uint8_t exportTypeSizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 8, 8 };
+
+typedef struct {
+	char* array; // where the column is copied to, when all the workers are done
+	int type;
+	uint32_t offset;
+	bool bigEndian;
+} export_field_t;
+
+// what a worker exported from its sub-range (kept here, since workers are deleted when they complete)
+typedef struct {
+	uint32_t rows;
+	bool full; // there are more entries in the sub-range than fit in the arrays
+	std::vector<std::vector<char>> columns;
+	std::vector<char> keys;
+} export_part_t;
+
+// the state of an export that is shared by its workers
+typedef struct {
+	std::vector<export_field_t> fields;
+	char* keys;
+	int keysType;
+	uint32_t capacity;
+	std::vector<export_part_t> parts;
+	int pending;
+	std::string error;
+} export_t;
+
+// writes a number to a typed array element
+static void storeNumber(char* target, int type, double value) {
+	switch (type) {
+		case INT8: *(int8_t*) target = (int8_t) value; break;
+		case UINT8: *(uint8_t*) target = (uint8_t) value; break;
+		case INT16: { int16_t v = (int16_t) value; memcpy(target, &v, 2); break; }
+		case UINT16: { uint16_t v = (uint16_t) value; memcpy(target, &v, 2); break; }
+		case INT32: { int32_t v = (int32_t) value; memcpy(target, &v, 4); break; }
+		case UINT32: { uint32_t v = (uint32_t) value; memcpy(target, &v, 4); break; }
+		case FLOAT32: { float v = (float) value; memcpy(target, &v, 4); break; }
+		case FLOAT64: memcpy(target, &value, 8); break;
+		case BIGINT64: { int64_t v = (int64_t) value; memcpy(target, &v, 8); break; }
+		case BIGUINT64: { uint64_t v = (uint64_t) value; memcpy(target, &v, 8); break; }
+	}
+}
+
+class ExportWorker : public AsyncWorker {
+  public:
+	ExportWorker(export_t* exp, export_part_t* part, DbiWrap* dw, MDB_txn* txn, std::string start, bool hasStart,
+			std::string end, bool hasEnd, const Function& callback)
+	 : AsyncWorker(callback), exp(exp), part(part), dbi(dw->dbi), hasVersions(dw->hasVersions), txn(txn), start(start),
+		hasStart(hasStart), end(end), hasEnd(hasEnd) {
+	}
+	void Execute() {
+		MDB_cursor* cursor;
+		int rc = mdb_cursor_open(txn, dbi, &cursor);
+		if (rc == 0) {
+			rc = exportEntries(cursor);
+			mdb_cursor_close(cursor);
+		}
+		mdb_txn_abort(txn);
+		txn = nullptr;
+		if (rc)
+			SetError(mdb_strerror(rc));
+	}
+	int exportEntries(MDB_cursor* cursor) {
+		MDB_val key, data, endKey;
+		endKey.mv_size = end.size();
+		endKey.mv_data = (void*) end.data();
+		key.mv_size = start.size();
+		key.mv_data = (void*) start.data();
+		int rc = mdb_cursor_get(cursor, &key, &data, hasStart ? MDB_SET_RANGE : MDB_FIRST);
+		size_t fieldCount = exp->fields.size();
+		uint32_t rows = 0;
+		while (rc == 0) {
+			if (hasEnd && mdb_cmp(txn, dbi, &key, &endKey) >= 0)
+				break;
+			if (rows == exp->capacity) {
+				part->full = true;
+				break;
+			}
+			const uint8_t* value = (const uint8_t*) data.mv_data;
+			size_t size = data.mv_size;
+			if (hasVersions) {
+				size_t versionSize = size < 8 ? size : 8;
+				value += versionSize;
+				size -= versionSize;
+			}
+			for (size_t f = 0; f < fieldCount; f++) {
+				export_field_t& field = exp->fields[f];
+				uint8_t elementSize = exportTypeSizes[field.type];
+				std::vector<char>& column = part->columns[f];
+				size_t position = column.size();
+				column.resize(position + elementSize);
+				char* target = column.data() + position;
+				if ((size_t) field.offset + elementSize <= size) {
+					if (field.bigEndian) {
+						for (uint8_t i = 0; i < elementSize; i++)
+							target[i] = value[field.offset + elementSize - 1 - i];
+					} else
+						memcpy(target, value + field.offset, elementSize);
+				} else // the value is too short to have this field
+					storeNumber(target, field.type, field.type == FLOAT32 || field.type == FLOAT64 ? NAN : 0);
+			}
+			if (exp->keysType == KEYS_RAW) {
+				uint32_t keySize = key.mv_size;
+				std::vector<char>& keys = part->keys;
+				size_t position = keys.size();
+				keys.resize(position + 4 + keySize);
+				memcpy(keys.data() + position, &keySize, 4);
+				memcpy(keys.data() + position + 4, key.mv_data, keySize);
+			} else if (exp->keysType >= 0) {
+				uint32_t uint32Key = 0;
+				memcpy(&uint32Key, key.mv_data, key.mv_size < 4 ? key.mv_size : 4);
+				std::vector<char>& keys = part->keys;
+				size_t position = keys.size();
+				keys.resize(position + exportTypeSizes[exp->keysType]);
+				storeNumber(keys.data() + position, exp->keysType, uint32Key);
+			}
+			rows++;
+			rc = mdb_cursor_get(cursor, &key, &data, MDB_NEXT);
+		}
+		part->rows = rows;
+		return rc == MDB_NOTFOUND ? 0 : rc;
+	}
+	void OnOK() {
+		finish();
+	}
+	void OnError(const Error& e) {
+		if (exp->error.empty())
+			exp->error = e.Message();
+		finish();
+	}
+	// when the last worker is done, copy the columns of every worker to the arrays, in order, and call back
+	void finish() {
+		if (--exp->pending > 0)
+			return;
+		napi_value result, args[4];
+		napi_env env = Env();
+		if (!exp->error.empty()) {
+			args[0] = Error::New(Env(), exp->error.c_str()).Value();
+			napi_call_function(env, Env().Undefined(), Callback().Value(), 1, args, &result);
+		} else {
+			uint32_t count = 0;
+			bool more = false;
+			std::vector<char> rawKeys;
+			for (export_part_t& part : exp->parts) {
+				uint32_t rows = part.rows < exp->capacity - count ? part.rows : exp->capacity - count;
+				more = more || part.full || rows < part.rows;
+				for (size_t f = 0; f < exp->fields.size(); f++) {
+					uint8_t elementSize = exportTypeSizes[exp->fields[f].type];
+					memcpy(exp->fields[f].array + (size_t) count * elementSize, part.columns[f].data(),
+						(size_t) rows * elementSize);
+				}
+				if (exp->keysType >= 0) {
+					uint8_t elementSize = exportTypeSizes[exp->keysType];
+					memcpy(exp->keys + (size_t) count * elementSize, part.keys.data(), (size_t) rows * elementSize);
+				} else if (exp->keysType == KEYS_RAW) {
+					size_t length = 0;
+					for (uint32_t i = 0; i < rows; i++) {
+						uint32_t keySize;
+						memcpy(&keySize, part.keys.data() + length, 4);
+						length += 4 + keySize;
+					}
+					rawKeys.insert(rawKeys.end(), part.keys.begin(), part.keys.begin() + length);
+				}
+				count += rows;
+			}
+			napi_get_null(env, &args[0]);
+			napi_create_uint32(env, count, &args[1]);
+			napi_get_boolean(env, more, &args[2]);
+			if (exp->keysType == KEYS_RAW)
+				napi_create_buffer_copy(env, rawKeys.size(), rawKeys.data(), nullptr, &args[3]);
+			else
+				napi_get_undefined(env, &args[3]);
+			// we use direct napi call here because node-addon-api interface with throw a fatal error if a worker thread is terminating
+			napi_call_function(env, Env().Undefined(), Callback().Value(), 4, args, &result);
+		}
+		delete exp;
+	}
+
+  private:
+	export_t* exp;
+	export_part_t* part;
+	MDB_dbi dbi;
+	bool hasVersions;
+	MDB_txn* txn;
+	std::string start;
+	bool hasStart;
+	std::string end;
+	bool hasEnd;
+};
+
+// begins read txns for the workers, which must all be on the same snapshot
+static int beginExportTxns(MDB_env* env, int count, std::vector<MDB_txn*>& txns) {
+	int rc = 0;
+	for (int attempt = 0; attempt < SNAPSHOT_ATTEMPTS; attempt++) {
+		bool sameSnapshot = true;
+		for (int i = 0; i < count && !rc && sameSnapshot; i++) {
+			MDB_txn* txn;
+			rc = mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn);
+			if (rc)
+				break;
+			txns.push_back(txn);
+			sameSnapshot = mdb_txn_id(txn) == mdb_txn_id(txns[0]);
+		}
+		if (!rc && sameSnapshot)
+			return 0;
+		// a write was committed while we were starting them, try again
+		for (MDB_txn* txn : txns)
+			mdb_txn_abort(txn);
+		txns.clear();
+		if (rc)
+			return rc;
+	}
+	return MDB_BAD_TXN;
+}
+
+#ifdef MDB_DBI_BOUNDARIES
+typedef struct {
+	MDB_txn* txn;
+	MDB_dbi dbi;
+	MDB_val* start;
+	MDB_val* end;
+	std::vector<std::string>* keys;
+} boundaries_t;
+
+const int BOUNDARIES_PAST_END = -1; // stops mdb_dbi_boundaries, but isn't an error
+
+static int addBoundary(const MDB_val* key, void* ctx) {
+	boundaries_t* boundaries = (boundaries_t*) ctx;
+	MDB_val* boundary = (MDB_val*) key;
+	if (boundaries->start && mdb_cmp(boundaries->txn, boundaries->dbi, boundary, boundaries->start) <= 0)
+		return 0;
+	if (boundaries->end && mdb_cmp(boundaries->txn, boundaries->dbi, boundary, boundaries->end) >= 0)
+		return BOUNDARIES_PAST_END; // the rest of the keys are after the range
+	boundaries->keys->push_back(std::string((char*) key->mv_data, key->mv_size));
+	return 0;
+}
+#endif
+
+// the keys that split the range into (up to) the given number of sub-ranges of about the same number of pages
+static void splitRange(MDB_txn* txn, MDB_dbi dbi, MDB_val* start, MDB_val* end, int parts,
+		std::vector<std::string>& splits) {
+#ifdef MDB_DBI_BOUNDARIES
+	std::vector<std::string> keys;
+	boundaries_t boundaries = { txn, dbi, start, end, &keys };
+	// the root page usually has enough keys, but a small (or narrow) range may need the next level
+	for (unsigned int levels = 1; levels <= 2 && (int) keys.size() < parts * 2; levels++) {
+		keys.clear();
+		int rc = mdb_dbi_boundaries(txn, dbi, levels, addBoundary, &boundaries);
+		if (rc && rc != BOUNDARIES_PAST_END)
+			break;
+	}
+	for (int i = 1; i < parts && (size_t) parts <= keys.size() + 1; i++)
+		splits.push_back(keys[keys.size() * i / parts]);
+#endif
+}
+
+/*
+Starts exporting a range: exportRange(dbiAddress, descriptor, start, end, callback), where start and end are keys (as
+Uint8Arrays) or undefined to export from the first or to the last entry.
+*/
+NAPI_FUNCTION(exportRange) {
+	ARGS(5)
+	GET_INT64_ARG(0);
+	DbiWrap* dw = (DbiWrap*) i64;
+	if (!dw->ew->env) {
+		napi_throw_error(env, nullptr, "The environment is already closed.");
+		return nullptr;
+	}
+	double* descriptor;
+	size_t length;
+	napi_get_typedarray_info(env, args[1], nullptr, &length, (void**) &descriptor, nullptr, nullptr);
+	export_t* exp = new export_t();
+	uint32_t fieldCount = (uint32_t) descriptor[0];
+	exp->capacity = (uint32_t) descriptor[1];
+	int threads = (int) descriptor[2];
+	if (threads < 1)
+		threads = 1;
+	if (threads > MAX_EXPORT_THREADS)
+		threads = MAX_EXPORT_THREADS;
+	exp->keys = (char*) (size_t) descriptor[3];
+	exp->keysType = (int) descriptor[4];
+	for (uint32_t i = 0; i < fieldCount; i++) {
+		double* fieldDescriptor = descriptor + EXPORT_HEADER_SIZE + i * EXPORT_FIELD_SIZE;
+		export_field_t field;
+		field.array = (char*) (size_t) fieldDescriptor[0];
+		field.type = (int) fieldDescriptor[1];
+		field.offset = (uint32_t) fieldDescriptor[2];
+		field.bigEndian = fieldDescriptor[3] != 0;
+		exp->fields.push_back(field);
+	}
+	std::string bounds[2];
+	bool hasBounds[2] = { false, false };
+	for (int i = 0; i < 2; i++) {
+		napi_valuetype type;
+		napi_typeof(env, args[2 + i], &type);
+		if (type != napi_object)
+			continue;
+		char* data;
+		size_t keyLength;
+		napi_get_typedarray_info(env, args[2 + i], nullptr, &keyLength, (void**) &data, nullptr, nullptr);
+		bounds[i] = std::string(data, keyLength);
+		hasBounds[i] = true;
+	}
+	MDB_val start = { bounds[0].size(), (void*) bounds[0].data() };
+	MDB_val end = { bounds[1].size(), (void*) bounds[1].data() };
+	std::vector<MDB_txn*> txns;
+	int rc = beginExportTxns(dw->ew->env, 1, txns);
+	std::vector<std::string> splits;
+	if (rc == 0)
+		splitRange(txns[0], dw->dbi, hasBounds[0] ? &start : nullptr, hasBounds[1] ? &end : nullptr, threads, splits);
+	if (rc == 0 && !splits.empty()) {
+		mdb_txn_abort(txns[0]);
+		txns.clear();
+		rc = beginExportTxns(dw->ew->env, splits.size() + 1, txns);
+	}
+	if (rc) {
+		delete exp;
+		return throwLmdbError(env, rc);
+	}
+	Function callback = Napi::Value(env, args[4]).As<Function>();
+	exp->parts.resize(txns.size());
+	exp->pending = txns.size();
+	for (size_t i = 0; i < txns.size(); i++) {
+		bool first = i == 0, last = i == txns.size() - 1;
+		export_part_t* part = &exp->parts[i];
+		part->rows = 0;
+		part->full = false;
+		part->columns.resize(fieldCount);
+		ExportWorker* worker = new ExportWorker(exp, part, dw, txns[i], first ? bounds[0] : splits[i - 1],
+			first ? hasBounds[0] : true, last ? bounds[1] : splits[i], last ? hasBounds[1] : true, callback);
+		worker->Queue();
+	}
+	RETURN_UNDEFINED;
+}
+
+void setupExportRange(Napi::Env env, Object exports) {
+	EXPORT_NAPI_FUNCTION("exportRange", exportRange);
+}
@@ -0,0 +1,107 @@
+#include "lmdb-js.h"
+
+using namespace Napi;
+
+static int bucketIndex(uint64_t time) {
+	if (time < (1 << HISTOGRAM_SUB_BUCKET_BITS))
+		return (int) time;
+	int magnitude = 63;
+#ifdef _WIN32
+	while (!(time >> magnitude))
+		magnitude--;
+#else
+	magnitude -= __builtin_clzll(time);
+#endif
+	int shift = magnitude - HISTOGRAM_SUB_BUCKET_BITS;
+	return ((shift + 1) << HISTOGRAM_SUB_BUCKET_BITS) + (int) ((time >> shift) & ((1 << HISTOGRAM_SUB_BUCKET_BITS) - 1));
+}
+
+// the highest value that is recorded in the bucket
+static uint64_t bucketUpperBound(int index) {
+	if (index < (1 << HISTOGRAM_SUB_BUCKET_BITS))
+		return index;
+	int shift = (index >> HISTOGRAM_SUB_BUCKET_BITS) - 1;
+	uint64_t subBucket = (index & ((1 << HISTOGRAM_SUB_BUCKET_BITS) - 1)) + (1 << HISTOGRAM_SUB_BUCKET_BITS);
+	return ((subBucket + 1) << shift) - 1;
+}
+
+void recordLatency(latency_histogram_t* histogram, uint64_t time) {
+	histogram->counts[bucketIndex(time)].fetch_add(1, std::memory_order_relaxed);
+	histogram->total.fetch_add(time, std::memory_order_relaxed);
+	uint64_t max = histogram->max.load(std::memory_order_relaxed);
+	while (time > max && !histogram->max.compare_exchange_weak(max, time, std::memory_order_relaxed)) {}
+}
+
+latency_histogram_t* getLatencyHistograms(MDB_env* env) {
+#ifdef MDB_OVERLAPPINGSYNC
+	unsigned int flags = 0;
+	mdb_env_get_flags(env, &flags);
+	env_metrics_t* metrics = (env_metrics_t*) mdb_env_get_userctx(env);
+	if ((flags & MDB_TRACK_METRICS) && metrics)
+		return metrics->histograms;
+#endif
+	return nullptr;
+}
+
+int commitWithMetrics(MDB_txn* txn, latency_histogram_t* histograms) {
+	if (!histograms)
+		return mdb_txn_commit(txn);
+#ifdef MDB_OVERLAPPINGSYNC
+	MDB_metrics* metrics = (MDB_metrics*) mdb_env_get_userctx(mdb_txn_env(txn));
+	uint64_t timeSync = metrics->time_sync;
+#endif
+	uint64_t start = get_time64();
+	int rc = mdb_txn_commit(txn);
+	recordLatency(histograms + COMMIT_LATENCY, get_time64() - start);
+#ifdef MDB_OVERLAPPINGSYNC
+	// the sync time is accumulated by LMDB, so we record the amount it increased by during this commit
+	if (metrics->time_sync > timeSync)
+		recordLatency(histograms + SYNC_LATENCY, metrics->time_sync - timeSync);
+#endif
+	return rc;
+}
+
+Napi::Value EnvWrap::getLatencyHistograms(const CallbackInfo& info) {
+	if (!this->env) {
+		return throwError(info.Env(), "The environment is already closed.");
+	}
+	if (!this->histograms)
+		return info.Env().Undefined();
+	bool reset = info.Length() > 0 && info[0].ToBoolean();
+	static const char* names[LATENCY_HISTOGRAM_COUNT] = {
+		"get", "cursorPosition", "cursorIterate", "readQueue", "readExecution", "writeBatch", "commit", "sync"
+	};
+	static const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+	static const char* percentileNames[] = { "p50", "p90", "p99", "p999" };
+	Object histograms = Object::New(info.Env());
+	uint64_t counts[HISTOGRAM_BUCKETS];
+	for (int i = 0; i < LATENCY_HISTOGRAM_COUNT; i++) {
+		latency_histogram_t* histogram = this->histograms + i;
+		// copy the counts, so the percentiles are computed from a consistent snapshot
+		uint64_t count = 0;
+		for (int j = 0; j < HISTOGRAM_BUCKETS; j++) {
+			counts[j] = reset ? histogram->counts[j].exchange(0, std::memory_order_relaxed) :
+				histogram->counts[j].load(std::memory_order_relaxed);
+			count += counts[j];
+		}
+		uint64_t total = reset ? histogram->total.exchange(0, std::memory_order_relaxed) : histogram->total.load(std::memory_order_relaxed);
+		uint64_t max = reset ? histogram->max.exchange(0, std::memory_order_relaxed) : histogram->max.load(std::memory_order_relaxed);
+		Object stats = Object::New(info.Env());
+		stats.Set("count", Number::New(info.Env(), (double) count));
+		stats.Set("mean", Number::New(info.Env(), count ? (double) total / count / TICKS_PER_SECOND : 0));
+		stats.Set("max", Number::New(info.Env(), (double) max / TICKS_PER_SECOND));
+		int bucket = 0;
+		uint64_t seen = 0;
+		for (int p = 0; p < 4; p++) {
+			uint64_t target = (uint64_t) (percentiles[p] * count + 0.5);
+			while (bucket < HISTOGRAM_BUCKETS - 1 && (seen + counts[bucket] < target || !counts[bucket])) {
+				seen += counts[bucket];
+				bucket++;
+			}
+			uint64_t value = count ? bucketUpperBound(bucket) : 0;
+			stats.Set(percentileNames[p], Number::New(info.Env(), (double) (value < max ? value : max) / TICKS_PER_SECOND));
+		}
+		histograms.Set(names[i], stats);
+	}
+	return histograms;
+}
@@ -0,0 +1,381 @@
+#include "lmdb-js.h"
+#include <cstdio>
+
+using namespace Napi;
+
+/*
+A key filter is a blocked Bloom filter of the keys of a database, that lets a get of a key that doesn't exist return
+NOTFOUND without searching the tree. Each key sets 8 bits in a single 64 byte block (one cache line), one bit in each
+64-bit word. A filter is shared by all the threads that use the env, and is maintained by the writes in DoWrites (and
+the bulk loader). It has every key that existed in the snapshot it was built from (buildTxnId), and every key that was
+inserted by the commits after that, up to validTxnId, which is extended by each commit from this process that follows
+the last one. A commit from another process (or from a path that doesn't maintain the filter) breaks the chain, and the
+filter is then only used for older snapshots, until it is rebuilt the next time the database is opened. Keys are never
+removed, so deleted keys are false positives until the filter is rebuilt.
+When an env is closed, the filters are saved, and are loaded the next time the database is opened, if there have been
+no commits since, so opening doesn't require a scan of the database.
+*/
+const uint32_t KEY_FILTER_MAGIC = 0x4b464c31;
+const int KEY_FILTER_BLOCK_WORDS = 8;
+const uint64_t MIN_KEY_FILTER_CAPACITY = 0x10000;
+static const uint32_t SALTS[KEY_FILTER_BLOCK_WORDS] = {
+	0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d, 0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31
+};
+
+struct key_filter_t {
+	MDB_env* env;
+	MDB_dbi dbi;
+	uint64_t nameHash;
+	std::atomic<uint64_t>* blocks;
+	uint32_t blockCount;
+	uint32_t bitsPerKey;
+	std::atomic<uint32_t> generation; // odd while the filter is being rebuilt
+	std::atomic<uint64_t> keyCount;
+	std::atomic<mdb_size_t> buildTxnId;
+	std::atomic<mdb_size_t> validTxnId; // 0 if the filter can't be used
+	std::atomic<bool> extendable;
+	std::atomic<uint64_t> checks;
+	std::atomic<uint64_t> excluded;
+};
+
+typedef struct {
+	uint32_t magic;
+	uint32_t blockCount;
+	uint32_t bitsPerKey;
+	uint32_t padding;
+	uint64_t nameHash;
+	uint64_t buildTxnId;
+	uint64_t validTxnId;
+	uint64_t entries;
+	uint64_t keyCount;
+} key_filter_header_t;
+
+static pthread_mutex_t* initKeyFiltersLock() {
+	pthread_mutex_t* lock = new pthread_mutex_t;
+	pthread_mutex_init(lock, nullptr);
+	return lock;
+}
+static pthread_mutex_t* keyFiltersLock = initKeyFiltersLock();
+static std::vector<key_filter_t*> keyFilters; // guarded by keyFiltersLock
+static std::vector<key_filter_t*> retiredKeyFilters; // dropped filters, that may still be referenced by DbiWraps
+static std::atomic<int> keyFilterCount;
+
+static uint64_t hashName(const char* name) {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (const char* c = name ? name : ""; *c; c++)
+		hash = (hash ^ (uint8_t) *c) * 0x100000001b3ull;
+	return hash;
+}
+
+static uint64_t hashKey(MDB_val* key) {
+	uint8_t* bytes = (uint8_t*) key->mv_data;
+	uint64_t hash = 0x9e3779b97f4a7c15ull ^ key->mv_size;
+	size_t i = 0;
+	for (; i + 8 <= key->mv_size; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, 8);
+		hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+		hash ^= hash >> 32;
+	}
+	uint64_t tail = 0;
+	memcpy(&tail, bytes + i, key->mv_size - i);
+	hash = (hash ^ tail) * 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	return hash ^ (hash >> 33);
+}
+
+static std::atomic<uint64_t>* blockFor(key_filter_t* filter, uint64_t hash) {
+	return filter->blocks + ((((hash >> 32) * filter->blockCount) >> 32) * KEY_FILTER_BLOCK_WORDS);
+}
+
+void addToKeyFilter(key_filter_t* filter, MDB_val* key) {
+	uint64_t hash = hashKey(key);
+	std::atomic<uint64_t>* block = blockFor(filter, hash);
+	for (int i = 0; i < KEY_FILTER_BLOCK_WORDS; i++) {
+		uint64_t bit = 1ull << (((uint32_t) hash * SALTS[i]) >> 26);
+		if (!(block[i].load(std::memory_order_relaxed) & bit))
+			block[i].fetch_or(bit, std::memory_order_relaxed);
+	}
+	filter->keyCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+static key_filter_t* findKeyFilter(MDB_env* env, MDB_dbi dbi) {
+	for (key_filter_t* filter : keyFilters) {
+		if (filter->env == env && filter->dbi == dbi)
+			return filter;
+	}
+	return nullptr;
+}
+
+// called by DoWrites for each put, before the txn is committed
+void addToKeyFilters(MDB_env* env, MDB_dbi dbi, MDB_val* key) {
+	if (!keyFilterCount.load(std::memory_order_relaxed))
+		return;
+	pthread_mutex_lock(keyFiltersLock);
+	key_filter_t* filter = findKeyFilter(env, dbi);
+	if (filter)
+		addToKeyFilter(filter, key);
+	pthread_mutex_unlock(keyFiltersLock);
+}
+
+// returns true if the key definitely doesn't exist in the snapshot of the txn
+bool keyFilterExcludes(key_filter_t* filter, MDB_txn* txn, MDB_val* key) {
+	uint32_t generation = filter->generation.load(std::memory_order_acquire);
+	if (generation & 1)
+		return false;
+	mdb_size_t txnId = mdb_txn_id(txn);
+	// write txns have a txn id after the last commit, so they don't use the filter
+	if (txnId > filter->validTxnId.load(std::memory_order_acquire) || txnId < filter->buildTxnId.load(std::memory_order_relaxed))
+		return false;
+	filter->checks.fetch_add(1, std::memory_order_relaxed);
+	uint64_t hash = hashKey(key);
+	std::atomic<uint64_t>* block = blockFor(filter, hash);
+	for (int i = 0; i < KEY_FILTER_BLOCK_WORDS; i++) {
+		if (!(block[i].load(std::memory_order_relaxed) & (1ull << (((uint32_t) hash * SALTS[i]) >> 26)))) {
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (filter->generation.load(std::memory_order_relaxed) != generation)
+				return false; // rebuilt while we were checking
+			filter->excluded.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+// called after a top-level commit from this process, to extend the txn ids that the filters are valid for
+void commitKeyFilters(MDB_env* env, mdb_size_t txnId) {
+	if (!keyFilterCount.load(std::memory_order_relaxed))
+		return;
+	pthread_mutex_lock(keyFiltersLock);
+	for (key_filter_t* filter : keyFilters) {
+		if (filter->env != env || !filter->extendable.load(std::memory_order_relaxed))
+			continue;
+		mdb_size_t previous = txnId - 1;
+		if (!filter->validTxnId.compare_exchange_strong(previous, txnId, std::memory_order_release))
+			filter->extendable.store(false); // there was a commit that we didn't see, the filter is stale
+	}
+	pthread_mutex_unlock(keyFiltersLock);
+}
+
+static void retireKeyFilter(key_filter_t* filter) {
+	filter->validTxnId.store(0, std::memory_order_release);
+	filter->extendable.store(false);
+	keyFilters.erase(std::find(keyFilters.begin(), keyFilters.end(), filter));
+	retiredKeyFilters.push_back(filter);
+	keyFilterCount--;
+}
+
+// the dbi is being closed or deleted, and the handle could be reused for another database
+void dropKeyFilter(MDB_env* env, MDB_dbi dbi) {
+	if (!keyFilterCount.load(std::memory_order_relaxed))
+		return;
+	pthread_mutex_lock(keyFiltersLock);
+	key_filter_t* filter = findKeyFilter(env, dbi);
+	if (filter)
+		retireKeyFilter(filter);
+	pthread_mutex_unlock(keyFiltersLock);
+}
+
+static std::string keyFilterPath(MDB_env* env, uint64_t nameHash) {
+	const char* path;
+	unsigned int flags;
+	mdb_env_get_path(env, &path);
+	mdb_env_get_flags(env, &flags);
+	char suffix[40];
+	snprintf(suffix, sizeof(suffix), (flags & MDB_NOSUBDIR) ? "-keyfilter-%016llx" : "/keyfilter-%016llx.mdb",
+		(unsigned long long) nameHash);
+	return std::string(path) + suffix;
+}
+
+// load a saved filter, if it was saved at the given txn id with the same number of entries
+static bool loadKeyFilter(key_filter_t* filter, mdb_size_t txnId, uint64_t entries, bool consume) {
+	std::string path = keyFilterPath(filter->env, filter->nameHash);
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	key_filter_header_t header;
+	bool loaded = fread(&header, sizeof(header), 1, file) == 1 && header.magic == KEY_FILTER_MAGIC &&
+		header.nameHash == filter->nameHash && header.blockCount == filter->blockCount &&
+		header.bitsPerKey == filter->bitsPerKey && header.validTxnId == txnId && header.entries == entries &&
+		fread((void*) filter->blocks, KEY_FILTER_BLOCK_WORDS * 8, filter->blockCount, file) == filter->blockCount;
+	fclose(file);
+	// the saved filter is only valid for the txn it was saved at, remove it so it can't be used after later commits
+	if (consume)
+		remove(path.c_str());
+	if (!loaded)
+		return false;
+	filter->keyCount.store(header.keyCount);
+	filter->buildTxnId.store(header.buildTxnId);
+	return true;
+}
+
+static void saveKeyFilter(key_filter_t* filter, MDB_txn* txn) {
+	std::string path = keyFilterPath(filter->env, filter->nameHash);
+	MDB_stat stat;
+	if (mdb_txn_id(txn) != filter->validTxnId.load() || mdb_stat(txn, filter->dbi, &stat))
+		return;
+	key_filter_header_t header = {};
+	header.magic = KEY_FILTER_MAGIC;
+	header.blockCount = filter->blockCount;
+	header.bitsPerKey = filter->bitsPerKey;
+	header.nameHash = filter->nameHash;
+	header.buildTxnId = filter->buildTxnId.load();
+	header.validTxnId = filter->validTxnId.load();
+	header.entries = stat.ms_entries;
+	header.keyCount = filter->keyCount.load();
+	// write to a temporary file and rename it, so a partially written filter is never loaded
+	std::string tempPath = path + ".tmp";
+	FILE* file = fopen(tempPath.c_str(), "wb");
+	if (!file)
+		return;
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite((void*) filter->blocks, KEY_FILTER_BLOCK_WORDS * 8, filter->blockCount, file) == filter->blockCount;
+	written = !fclose(file) && written;
+	remove(path.c_str());
+	if (!written || rename(tempPath.c_str(), path.c_str()))
+		remove(tempPath.c_str());
+}
+
+static int buildKeyFilter(key_filter_t* filter, MDB_txn* txn) {
+	MDB_cursor* cursor;
+	MDB_val key, data;
+	int rc = mdb_cursor_open(txn, filter->dbi, &cursor);
+	if (rc)
+		return rc;
+	memset((void*) filter->blocks, 0, (size_t) filter->blockCount * KEY_FILTER_BLOCK_WORDS * 8);
+	filter->keyCount.store(0);
+	rc = mdb_cursor_get(cursor, &key, &data, MDB_FIRST);
+	while (!rc) {
+		addToKeyFilter(filter, &key);
+		rc = mdb_cursor_get(cursor, &key, &data, MDB_NEXT_NODUP);
+	}
+	mdb_cursor_close(cursor);
+	return rc == MDB_NOTFOUND ? 0 : rc;
+}
+
+/*
+Opens the key filter of the database, loading the saved filter or building it if it isn't already open (or is stale).
+This must be called in a write txn (unless the env is read-only), so no other writes can be in progress.
+*/
+Napi::Value DbiWrap::openKeyFilter(const CallbackInfo& info) {
+	if (!this->isOpen)
+		return throwError(info.Env(), "The Dbi is not open");
+	uint64_t nameHash = hashName(info[0].IsString() ? info[0].As<String>().Utf8Value().c_str() : nullptr);
+	uint32_t bitsPerKey = info[1].As<Number>().Uint32Value();
+	if (bitsPerKey < 1 || bitsPerKey > 64)
+		return throwError(info.Env(), "bitsPerKey must be between 1 and 64");
+	bool writable = ew->writeTxn;
+	MDB_txn* txn = writable ? ew->writeTxn->txn : ew->getReadTxn();
+	// the snapshot of a write txn is the last commit
+	mdb_size_t snapshotTxnId = mdb_txn_id(txn) - (writable ? 1 : 0);
+	MDB_stat stat;
+	int rc = mdb_stat(txn, dbi, &stat);
+	if (rc)
+		return throwLmdbError(info.Env(), rc);
+	pthread_mutex_lock(keyFiltersLock);
+	key_filter_t* filter = findKeyFilter(env, dbi);
+	if (filter && filter->nameHash != nameHash) {
+		retireKeyFilter(filter); // the dbi handle was reused for another database
+		filter = nullptr;
+	}
+	bool needsBuild = !filter || (writable && filter->validTxnId.load() != snapshotTxnId);
+	if (filter && !needsBuild && writable)
+		filter->extendable.store(true); // it is up-to-date, and we will see the following commits
+	if (!filter) {
+		filter = new key_filter_t();
+		filter->env = env;
+		filter->dbi = dbi;
+		filter->nameHash = nameHash;
+		filter->bitsPerKey = bitsPerKey;
+		// size for twice the current number of entries, to leave room for growth
+		uint64_t capacity = stat.ms_entries * 2;
+		if (capacity < MIN_KEY_FILTER_CAPACITY)
+			capacity = MIN_KEY_FILTER_CAPACITY;
+		filter->blockCount = (uint32_t) ((capacity * bitsPerKey + 511) / 512);
+		filter->blocks = new std::atomic<uint64_t>[(size_t) filter->blockCount * KEY_FILTER_BLOCK_WORDS];
+		keyFilters.push_back(filter);
+		keyFilterCount++;
+	}
+	if (needsBuild) {
+		// mark it as rebuilding, so concurrent readers don't use it
+		filter->generation++;
+		filter->validTxnId.store(0);
+	}
+	pthread_mutex_unlock(keyFiltersLock);
+	if (needsBuild) {
+		// we hold the write lock, so there are no writes that could add keys while we build it
+		bool loaded = false;
+#ifdef MDB_DBI_DIRTY
+		// writes in this txn aren't in the saved filter
+		if (!writable || mdb_dbi_dirty(txn, dbi) == MDB_NOTFOUND)
+			loaded = loadKeyFilter(filter, snapshotTxnId, stat.ms_entries, writable);
+#endif
+		if (!loaded) {
+			rc = buildKeyFilter(filter, txn);
+			filter->buildTxnId.store(snapshotTxnId);
+		}
+		filter->extendable.store(writable && !rc);
+		if (!rc)
+			filter->validTxnId.store(snapshotTxnId, std::memory_order_release);
+		filter->generation++;
+	}
+	if (rc)
+		return throwLmdbError(info.Env(), rc);
+	this->keyFilter = filter;
+	return info.Env().Undefined();
+}
+
+Napi::Value DbiWrap::getKeyFilterStats(const CallbackInfo& info) {
+	key_filter_t* filter = this->keyFilter;
+	if (!filter)
+		return info.Env().Undefined();
+	Object stats = Object::New(info.Env());
+	stats.Set("validTxnId", Number::New(info.Env(), (double) filter->validTxnId.load()));
+	stats.Set("stale", Boolean::New(info.Env(), !filter->extendable.load()));
+	stats.Set("keys", Number::New(info.Env(), (double) filter->keyCount.load()));
+	stats.Set("size", Number::New(info.Env(), (double) filter->blockCount * KEY_FILTER_BLOCK_WORDS * 8));
+	stats.Set("checks", Number::New(info.Env(), (double) filter->checks.load()));
+	stats.Set("excluded", Number::New(info.Env(), (double) filter->excluded.load()));
+	return stats;
+}
+
+// save (if they are up-to-date) and free the filters of an env that is being closed
+void closeKeyFilters(MDB_env* env) {
+	if (!keyFilterCount.load() && retiredKeyFilters.empty())
+		return;
+	pthread_mutex_lock(keyFiltersLock);
+	MDB_txn* txn = nullptr;
+	for (auto it = keyFilters.begin(); it != keyFilters.end();) {
+		key_filter_t* filter = *it;
+		if (filter->env != env) {
+			it++;
+			continue;
+		}
+		if (filter->extendable.load()) {
+			if (!txn) {
+				// make sure the last commit is durable before saving a filter that is valid for it
+				mdb_env_sync(env, 1);
+				mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn);
+			}
+			if (txn)
+				saveKeyFilter(filter, txn);
+		}
+		delete[] filter->blocks;
+		delete filter;
+		it = keyFilters.erase(it);
+		keyFilterCount--;
+	}
+	if (txn)
+		mdb_txn_abort(txn);
+	for (auto it = retiredKeyFilters.begin(); it != retiredKeyFilters.end();) {
+		if ((*it)->env == env) {
+			delete[] (*it)->blocks;
+			delete *it;
+			it = retiredKeyFilters.erase(it);
+		} else
+			it++;
+	}
+	pthread_mutex_unlock(keyFiltersLock);
+}
@@ -23,9 +23,16 @@ Object InitAll(Napi::Env env, Object exports) {
 	DbiWrap::setupExports(env, exports);
 	CursorWrap::setupExports(env, exports);
 	Compression::setupExports(env, exports);
+	BulkLoader::setupExports(env, exports);
 
 	// Export misc things
 	setupExportMisc(env, exports);
+	setupExportMerge(env, exports);
+	setupExportBackup(env, exports);
+	setupExportValueCache(env, exports);
+	setupExportProjection(env, exports);
+	setupExportRange(env, exports);
+	setupExportOrderedBinary(env, exports);
 	if (Logging::debugLogging)
 		fprintf(stderr, "Finished initialization\n");
 	return exports;
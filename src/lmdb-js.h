@@ -2,6 +2,7 @@
 #define NODE_LMDB_H
 
 #include <vector>
+#include <atomic>
 #include <unordered_map>
 #include <algorithm>
 #include <ctime>
@@ -12,6 +13,7 @@
 #include "lz4.h"
 #ifdef MDB_RPAGE_CACHE
 #include "chacha8.h"
+#include "crc32c.h"
 #endif
 
 using namespace Napi;
@@ -133,8 +135,16 @@ void consoleLogN(int n);
 void setFlagFromValue(int *flags, int flag, const char *name, bool defaultValue, Object options);
 void writeValueToEntry(const Value &str, MDB_val *val);
 LmdbKeyType keyTypeFromOptions(const Value &val, LmdbKeyType defaultKeyType = LmdbKeyType::DefaultKey);
-int getVersionAndUncompress(MDB_val &data, DbiWrap* dw);
+int getVersionAndUncompress(MDB_val &data, DbiWrap* dw, MDB_txn* txn = nullptr, MDB_val* key = nullptr, mdb_size_t valueTxnId = 0);
+int acquireReadTxn(MDB_env* env, int flags, MDB_txn** txn);
+void releaseReadTxn(MDB_txn* txn, bool keepIdle);
+int resetReadTxn(MDB_txn** txn);
+int renewReadTxn(MDB_txn** txn);
+void releaseIdleReadTxns(MDB_env* env);
+void getReadTxnPoolStats(MDB_env* env, int* active, int* shared, int* idle);
 int compareFast(const MDB_val *a, const MDB_val *b);
+MDB_cmp_func* getCompareFast();
+void setupExportOrderedBinary(Env env, Object exports);
 napi_value setGlobalBuffer(napi_env env, napi_callback_info info);
 napi_value lmdbError(napi_env env, napi_callback_info info);
 napi_value createBufferForAddress(napi_env env, napi_callback_info info);
@@ -173,6 +183,137 @@ int putWithVersion(MDB_txn* txn,
 		MDB_val *   data,
 		unsigned int	flags, double version);
 
+// header of the value of a put with a value operation, which computes the new value from the existing value
+typedef struct {
+	uint8_t operation;
+	uint8_t mergeOperator; // id of the merge operator for merges
+	uint8_t reserved[2];
+	uint32_t argument; // size of the expected value for compare and swap, or the argument for the merge operator
+	double compression; // address of the compression for the db (0 if none)
+} value_operation_t;
+bool readMsgpackNumber(const uint8_t* data, size_t size, double* number);
+size_t writeMsgpackNumber(double number, uint8_t* target);
+// merge operator function, existing is nullptr if there is no existing value, and the result is allocated with malloc
+typedef int (merge_function_t)(const MDB_val* existing, const MDB_val* operand, uint32_t argument, MDB_val* result);
+int registerMergeOperator(const char* name, merge_function_t* merge);
+int mergeValue(uint8_t operatorId, const MDB_val* existing, const MDB_val* operand, uint32_t argument, MDB_val* result);
+void setupExportMerge(Env env, Object exports);
+void setupExportBackup(Env env, Object exports);
+// shared cache of decompressed values, for all threads (see value-cache.cpp)
+bool getCachedValue(DbiWrap* dw, MDB_val* key, mdb_size_t txnId, MDB_val& data);
+void cacheValue(DbiWrap* dw, MDB_val* key, mdb_size_t txnId, MDB_val& data);
+void clearCachedValues(MDB_env* env);
+void getValueCacheStats(uint64_t* hits, uint64_t* misses, size_t* size);
+void setupExportValueCache(Env env, Object exports);
+// decoding selected fields of msgpackr records into columns (see projection.cpp)
+const uint32_t PROJECTION_FILLED = 0; // the row limit was reached
+const uint32_t PROJECTION_HEAP_FULL = 1;
+const uint32_t PROJECTION_DONE = 2;
+struct projection_t {
+	uint32_t* header;
+	uint32_t fieldCount;
+	uint32_t rowCapacity;
+	uint32_t heapSize;
+	uint32_t structureCount;
+	int32_t* structures; // for each structure, the number of keys, and the position of each field
+	double* values;
+	uint32_t* lengths;
+	uint32_t* keyStarts;
+	uint32_t* keyLengths;
+	uint8_t* types;
+	char* heap;
+	uint32_t heapUsed;
+	projection_t(char* workspace, char* heap);
+	const uint8_t* skipValue(const uint8_t* position, const uint8_t* end, int depth);
+	bool copyToHeap(const uint8_t* start, size_t length, uint32_t* heapStart);
+	bool projectField(uint32_t field, uint32_t row, const uint8_t* position, const uint8_t* end);
+	bool projectRow(uint32_t row, MDB_val* key, MDB_val& data);
+};
+bool readMsgpackNumber(const uint8_t* position, const uint8_t* end, double* number);
+void setupExportProjection(Env env, Object exports);
+// reads keys and fixed-offset fields of a range into typed arrays, on multiple threads (see export-range.cpp)
+void setupExportRange(Env env, Object exports);
+// negative lookup filters of the keys of databases, shared by all threads (see key-filter.cpp)
+typedef struct key_filter_t key_filter_t;
+void addToKeyFilter(key_filter_t* filter, MDB_val* key);
+void addToKeyFilters(MDB_env* env, MDB_dbi dbi, MDB_val* key);
+bool keyFilterExcludes(key_filter_t* filter, MDB_txn* txn, MDB_val* key);
+void commitKeyFilters(MDB_env* env, mdb_size_t txnId);
+void dropKeyFilter(MDB_env* env, MDB_dbi dbi);
+void closeKeyFilters(MDB_env* env);
+// samples of the pages that gets read, saved on close and read ahead on the next open (see access-profile.cpp)
+typedef struct access_profile_t access_profile_t;
+access_profile_t* openAccessProfile(MDB_env* env, uint32_t pages, uint32_t sampleInterval);
+void recordAccess(access_profile_t* profile, MDB_val* data);
+void getAccessProfileStats(access_profile_t* profile, uint64_t* samples, uint64_t* replayedPages);
+void closeAccessProfile(MDB_env* env);
+
+// latency histograms (tracked when metrics are enabled)
+const int GET_LATENCY = 0;
+const int CURSOR_POSITION_LATENCY = 1;
+const int CURSOR_ITERATE_LATENCY = 2;
+const int READ_QUEUE_LATENCY = 3; // time async reads wait in the queue before executing
+const int READ_EXECUTION_LATENCY = 4;
+const int WRITE_BATCH_LATENCY = 5; // applying a batch of writes, excluding time waiting for callbacks
+const int COMMIT_LATENCY = 6;
+const int SYNC_LATENCY = 7;
+const int LATENCY_HISTOGRAM_COUNT = 8;
+// log-linear buckets: 16 sub-buckets for each power of two, for ~6% precision over the full 64-bit range
+const int HISTOGRAM_SUB_BUCKET_BITS = 4;
+const int HISTOGRAM_BUCKETS = (64 - HISTOGRAM_SUB_BUCKET_BITS + 1) << HISTOGRAM_SUB_BUCKET_BITS;
+typedef struct {
+	// all updates are relaxed atomic increments, so recording is lock-free and snapshots never block writers
+	std::atomic<uint64_t> counts[HISTOGRAM_BUCKETS];
+	std::atomic<uint64_t> total;
+	std::atomic<uint64_t> max;
+} latency_histogram_t;
+#ifdef MDB_OVERLAPPINGSYNC
+// the environment's user context when tracking metrics, shared by all the threads using the environment
+typedef struct {
+	MDB_metrics metrics; // must be first, since LMDB accesses the user context as MDB_metrics
+	latency_histogram_t histograms[LATENCY_HISTOGRAM_COUNT];
+} env_metrics_t;
+#endif
+latency_histogram_t* getLatencyHistograms(MDB_env* env);
+void recordLatency(latency_histogram_t* histogram, uint64_t time);
+// commit, recording the commit time, and the time spent syncing during the commit
+int commitWithMetrics(MDB_txn* txn, latency_histogram_t* histograms);
+// records the time from construction to destruction of the timer (if there is a histogram)
+class LatencyTimer {
+	latency_histogram_t* histogram;
+	uint64_t start;
+public:
+	LatencyTimer(latency_histogram_t* histogram) : histogram(histogram), start(histogram ? get_time64() : 0) {}
+	~LatencyTimer() {
+		if (histogram)
+			recordLatency(histogram, get_time64() - start);
+	}
+};
+
+// commit notifications, shared between processes through a memory mapped file next to the lock file
+const uint32_t COMMIT_NOTIFICATIONS_MAGIC = 0x4c4d4331;
+const int COMMIT_RING_SIZE = 256;
+typedef struct {
+	std::atomic<uint64_t> stamp; // position + 1 once the entry has been written
+	uint64_t txnId;
+	uint32_t dbi;
+	uint32_t padding;
+} commit_entry_t;
+typedef struct {
+	uint32_t magic;
+	std::atomic<uint32_t> sequence; // incremented on each commit, waiters wait on this (with a futex on linux)
+	std::atomic<uint32_t> waiters;
+	uint32_t padding;
+	std::atomic<uint64_t> position; // number of entries that have been written to the ring
+	commit_entry_t entries[COMMIT_RING_SIZE];
+} commit_notifications_t;
+commit_notifications_t* openCommitNotifications(MDB_env* env);
+void closeCommitNotifications(commit_notifications_t* notifications);
+void publishCommit(commit_notifications_t* notifications, uint64_t txnId, std::vector<MDB_dbi>& dbis);
+void wakeCommitWaiters(commit_notifications_t* notifications);
+struct commit_watcher_t;
+void closeCommitWatcher(commit_watcher_t* watcher);
+
 Napi::Value throwLmdbError(Napi::Env env, int rc);
 Napi::Value throwError(Napi::Env env, const char* message);
 
@@ -196,6 +337,8 @@ const int RESUME_BATCH = 9996;
 const int USER_HAS_LOCK = 9995;
 const int SEPARATE_FLUSHED = 1;
 const int DELETE_ON_CLOSE = 2;
+const int COMMIT_NOTIFICATIONS = 4;
+const int SHARED_VALUE_CACHE = 8;
 const int OPEN_FAILED = 0x10000;
 
 class WriteWorker {
@@ -219,7 +362,7 @@ class WriteWorker {
 	uint32_t* instructions;
 	int progressStatus;
 	MDB_env* env;
-	static int DoWrites(MDB_txn* txn, EnvWrap* envForTxn, uint32_t* instruction, WriteWorker* worker);
+	static int DoWrites(MDB_txn* txn, EnvWrap* envForTxn, uint32_t* instruction, WriteWorker* worker, uint32_t* batchStatus = nullptr);
 	static bool threadSafeCallsEnabled;
 };
 class TxnTracked {
@@ -291,11 +434,40 @@ public:
 	std::vector<AsyncWorker*> workers;
 
 	MDB_txn* currentReadTxn;
+	TxnWrap* currentReadTw; // the TxnWrap that currentReadTxn belongs to, nullptr once it is closed
 	WriteWorker* writeWorker;
 	bool readTxnRenewed;
     bool hasWrites;
 	bool trackMetrics;
 	uint64_t timeTxnWaiting;
+	latency_histogram_t* histograms; // nullptr if not tracking metrics
+	napi_ref commitSequence; // reference to the ArrayBuffer of the last committed txn id, detached on close
+	commit_notifications_t* notifications; // nullptr if commit notifications are not enabled
+	std::vector<MDB_dbi> touchedDbis; // databases written in the current write txn, for commit notifications
+	commit_watcher_t* commitWatcher; // the thread that waits for commits, nullptr until waitForCommit is first called
+	std::atomic<int> warmers; // background warming workers that are running (see warm.cpp)
+	std::atomic<bool> warmCancelled; // set when the env is closed
+	pthread_mutex_t* warmLock; // held to set warmCancelled, and by a warming worker to check it before it starts
+	std::atomic<uint32_t> warmCancels; // the number of times cancelWarm has been called
+	access_profile_t* accessProfile; // nullptr if accesses are not being profiled
+	void touchDbi(MDB_dbi dbi) {
+		if (notifications && std::find(touchedDbis.begin(), touchedDbis.end(), dbi) == touchedDbis.end())
+			touchedDbis.push_back(dbi);
+	}
+	MDB_dbi changeLogDbi; // 0 if changes are not logged
+	bool changeLogValues;
+	mdb_size_t changeLogTxnId;
+	uint32_t changeLogSequence;
+	// called after each top-level commit
+	void publishTouched(uint64_t txnId) {
+		if (notifications && !touchedDbis.empty())
+			publishCommit(notifications, txnId, touchedDbis);
+		touchedDbis.clear();
+		commitKeyFilters(env, txnId);
+	}
+	latency_histogram_t* histogram(int type) {
+		return histograms ? histograms + type : nullptr;
+	}
 	unsigned int jsFlags;
 	char* keyBuffer;
 	int pageSize;
@@ -306,7 +478,9 @@ public:
 	static void setupExports(Napi::Env env, Object exports);
 	void closeEnv(bool hasLock = false);
 	int openEnv(int flags, int jsFlags, const char* path, char* keyBuffer, Compression* compression, int maxDbs,
-		int maxReaders, mdb_size_t mapSize, int pageSize, char* encryptionKey);
+		int maxReaders, mdb_size_t mapSize, int pageSize, char* encryptionKey, int encryptionRounds = 8, bool checksum = false,
+		unsigned int remapCacheChunks = 0, unsigned int remapTxnCacheChunks = 0, uint32_t accessProfilePages = 0,
+		uint32_t accessProfileInterval = 0);
 	
 	/*
 		Gets statistics about the database environment.
@@ -314,7 +488,8 @@ public:
 	Napi::Value stat(const CallbackInfo& info);
 
 	/*
-		Gets statistics about the free space database
+		Gets statistics about the free space database, and optionally a histogram of the lengths of the runs of contiguous
+		free pages
 	*/
 	Napi::Value freeStat(const CallbackInfo& info);
 	
@@ -322,6 +497,35 @@ public:
 		Gets information about the database environment.
 	*/
 	Napi::Value info(const CallbackInfo& info);
+	/*
+		Gets a snapshot of the latency histograms, optionally resetting them
+	*/
+	Napi::Value getLatencyHistograms(const CallbackInfo& info);
+	/*
+		Gets an ArrayBuffer of the id of the last committed txn, in the shared lock region
+	*/
+	Napi::Value getCommitSequence(const CallbackInfo& info);
+	/*
+		Waits (in a worker thread) for a txn after the given txn id to be committed, by any thread or process
+	*/
+	Napi::Value waitForCommit(const CallbackInfo& info);
+	/*
+		Reads the top levels of the trees of every database (and all of the pages of hot databases) in a worker thread,
+		so they are in the OS cache
+	*/
+	Napi::Value warm(const CallbackInfo& info);
+	/*
+		Cancels any warming that is in progress
+	*/
+	Napi::Value cancelWarm(const CallbackInfo& info);
+	/*
+		Gets the (txn id, dbi) entries of recent commits from the commit notification ring
+	*/
+	Napi::Value getRecentCommits(const CallbackInfo& info);
+	/*
+		Sets the database that writes are logged to (0 to stop logging), and whether values are included
+	*/
+	Napi::Value setChangeLog(const CallbackInfo& info);
 	/*
 		Check for stale readers
 	*/
@@ -361,6 +565,28 @@ public:
 	*/
 	Napi::Value copy(const CallbackInfo& info);	
 
+	/*
+		Copies the pages that changed after a txn to a file, for an incremental backup.
+		(Wrapper for `mdb_env_copy_incremental`)
+
+		Parameters:
+
+		* path - Path to the target file
+		* since - Txn id of the backup this is relative to (0 for all pages)
+		* callback - Callback with the txn id and number of pages that were copied (this is performed asynchronously)
+	*/
+	Napi::Value copyIncremental(const CallbackInfo& info);
+
+	/*
+		Moves pages from the end of the file into free pages, and truncates the file, in the current write txn.
+		(Wrapper for `mdb_env_compact_step`)
+
+		Parameters:
+
+		* maxPages - Maximum number of pages to move in this step (0 to only truncate free pages)
+	*/
+	Napi::Value compactStep(const CallbackInfo& info);
+
 	/*
 		Closes the database environment.
 		(Wrapper for `mdb_env_close`)
@@ -430,10 +656,13 @@ private:
 	
 	// Flags used with mdb_txn_begin
 	unsigned int flags;
+	// reset (with reset()), and waiting to be renewed
+	bool isReset;
 
 	friend class CursorWrap;
 	friend class DbiWrap;
 	friend class EnvWrap;
+	friend void do_read(napi_env nenv, void* instruction_pointer);
 
 public:
 	TxnWrap(const CallbackInfo& info);
@@ -464,6 +693,11 @@ public:
 		(Wrapper for `mdb_txn_reset`)
 	*/
 	void reset();
+	/*
+		Renews a read-only transaction after it has been reset, through the read txn pool.
+		Returns MDB_READERS_FULL if it was shared and there is still no reader slot to move it to.
+	*/
+	int renewTxn();
 	/*
 		Renews a read-only transaction after it has been reset.
 		(Wrapper for `mdb_txn_renew`)
@@ -498,6 +732,8 @@ public:
 	bool hasVersions;
 	// current unsafe buffer for this db
 	bool getFast;
+	// negative lookup filter of the keys, if enabled
+	key_filter_t* keyFilter;
 
 	friend class TxnWrap;
 	friend class CursorWrap;
@@ -527,12 +763,43 @@ public:
 	Napi::Value drop(const CallbackInfo& info);
 
 	Napi::Value stat(const CallbackInfo& info);
+	/*
+		Opens the negative lookup filter of the keys (shared with other threads), loading or building it if needed.
+		This should be called in a write txn, unless the env is read-only.
+
+		Parameters:
+
+		* The name of the database
+		* The number of bits per key
+	*/
+	Napi::Value openKeyFilter(const CallbackInfo& info);
+	/*
+		Gets statistics about the key filter
+	*/
+	Napi::Value getKeyFilterStats(const CallbackInfo& info);
 	int prefetch(uint32_t* keys);
 	int open(int flags, char* name, bool hasVersions, LmdbKeyType keyType, Compression* compression);
 	int32_t doGetByBinary(uint32_t keySize, uint32_t ifNotTxnId, int64_t txnAddress);
+	int32_t doGetByUint32(uint32_t key, uint32_t ifNotTxnId, int64_t txnAddress);
+	int32_t doGet(MDB_val& key, uint32_t ifNotTxnId, int64_t txnAddress);
 	static void setupExports(Napi::Env env, Object exports);
 };
 
+typedef struct {
+	MDB_env* env;
+	mdb_size_t offset; // of the compressed value in the data file
+	mdb_size_t txnId; // of the page that holds the compressed value
+	uint32_t size;
+	bool referenced;
+	char* data;
+} decompressed_entry_t;
+typedef std::pair<MDB_env*, mdb_size_t> decompressed_key_t;
+struct decompressed_key_hash {
+	size_t operator()(const decompressed_key_t& key) const {
+		return std::hash<void*>()(key.first) ^ std::hash<mdb_size_t>()(key.second);
+	}
+};
+
 class Compression : public ObjectWrap<Compression> {
 public:
 	char* dictionary; // dictionary to use to decompress
@@ -544,7 +811,23 @@ public:
 	// compression acceleration (defaults to 1)
 	int acceleration;
 	static thread_local LZ4_stream_t* stream;
+	// optional CLOCK cache of decompressed values, only used by the thread that owns this compression
+	std::vector<decompressed_entry_t> cacheEntries;
+	std::unordered_map<decompressed_key_t, unsigned int, decompressed_key_hash> cacheIndex;
+	size_t cacheCapacity;
+	size_t cacheSize;
+	unsigned int cacheHand;
+	uint32_t cacheGeneration;
+	uint64_t cacheHits;
+	uint64_t cacheMisses;
+	// incremented when an env is closed, since another env can be opened at its address
+	static std::atomic<uint32_t> mapGeneration;
 	void decompress(MDB_val& data, bool &isValid, bool canAllocate);
+	bool getDecompressed(MDB_val& data, MDB_env* env, mdb_size_t offset, mdb_size_t txnId);
+	void cacheDecompressed(MDB_env* env, mdb_size_t offset, mdb_size_t txnId, MDB_val& data);
+	void clearDecompressed();
+	Napi::Value getCacheStats(const CallbackInfo& info);
+	~Compression();
 	argtokey_callback_t compress(MDB_val* value, argtokey_callback_t freeValue);
 	int compressInstruction(EnvWrap* env, double* compressionAddress);
 	Napi::Value ctor(const CallbackInfo& info);
@@ -605,9 +888,48 @@ public:
 
 	int returnEntry(int lastRC, MDB_val &key, MDB_val &data);
 	int32_t doPosition(uint32_t offset, uint32_t keySize, uint64_t endKeyAddress);
+	int32_t doProject(char* workspace, char* heap);
 	//Value getStringByBinary(const CallbackInfo& info);
 };
 
+class SortedRun;
+/*
+	`BulkLoader`
+	Sorts unordered entries for a database instance in runs on the thread pool (spilling runs to temporary
+	files once the memory limit is reached), and then merges the runs into the database with appending puts.
+*/
+class BulkLoader : public ObjectWrap<BulkLoader> {
+public:
+	DbiWrap* dw;
+	// maximum number of bytes of sorted runs to keep in memory
+	size_t memoryLimit;
+	size_t memoryUsed;
+	std::string tempDirectory;
+	// sorted runs, in the order their entries were added
+	std::vector<SortedRun*> runs;
+	// heap of the runs that are being merged
+	std::vector<SortedRun*> merge;
+	pthread_mutex_t* runsLock;
+	int pendingRuns;
+	uint32_t nextFileId;
+	bool merging;
+
+	BulkLoader(const CallbackInfo& info);
+	~BulkLoader();
+	int sortRun(char* chunk, size_t size, uint32_t runIndex);
+	void clear();
+	/*
+		Adds a buffer of entries to be sorted as a run (asynchronously).
+	*/
+	Napi::Value add(const CallbackInfo& info);
+	/*
+		Writes the next merged entries into the current write transaction.
+	*/
+	Napi::Value load(const CallbackInfo& info);
+	Napi::Value close(const CallbackInfo& info);
+	static void setupExports(Napi::Env env, Object exports);
+};
+
 #endif // NODE_LMDB_H
 
 // Portions of this file are from node-lmdb
@@ -0,0 +1,289 @@
+#include "lmdb-js.h"
+#include <cstdlib>
+
+using namespace Napi;
+
+/*
+Merge operators compute the new value of an entry from the existing value and an operand, in the write thread. The
+values and operands are msgpack encoded. The merged result must be allocated with malloc. Operators can only be
+registered from C++ (compiled into the addon), and the registry is guarded by a lock, since the write thread reads it.
+*/
+typedef struct {
+	std::string name;
+	merge_function_t* merge;
+} merge_operator_t;
+
+const int MAX_MERGE_OPERATORS = 256;
+static merge_operator_t mergeOperators[MAX_MERGE_OPERATORS]; // guarded by mergeOperatorsLock
+static int mergeOperatorCount = 0;
+static pthread_mutex_t* initMergeOperatorsLock() {
+	pthread_mutex_t* lock = new pthread_mutex_t;
+	pthread_mutex_init(lock, nullptr);
+	return lock;
+}
+static pthread_mutex_t* mergeOperatorsLock = initMergeOperatorsLock();
+
+// size of a msgpack scalar (nil, boolean, number, string, or binary), or 0 if it is not a (complete) scalar
+static size_t msgpackScalarSize(const uint8_t* data, size_t size) {
+	if (size == 0)
+		return 0;
+	uint8_t type = data[0];
+	size_t valueSize;
+	if (type < 0x80 || type >= 0xe0 || type == 0xc0 || type == 0xc2 || type == 0xc3)
+		valueSize = 1;
+	else if (type >= 0xa0 && type < 0xc0)
+		valueSize = 1 + (type & 0x1f);
+	else {
+		switch (type) {
+			case 0xcc: case 0xd0: valueSize = 2; break;
+			case 0xcd: case 0xd1: valueSize = 3; break;
+			case 0xce: case 0xd2: case 0xca: valueSize = 5; break;
+			case 0xcf: case 0xd3: case 0xcb: valueSize = 9; break;
+			case 0xd9: case 0xc4: valueSize = size > 1 ? 2 + data[1] : 0; break;
+			case 0xda: case 0xc5: valueSize = size > 2 ? 3 + ((data[1] << 8) | data[2]) : 0; break;
+			case 0xdb: case 0xc6: valueSize = size > 4 ? 5 + (((size_t) data[1] << 24) | (data[2] << 16) | (data[3] << 8) | data[4]) : 0; break;
+			default: return 0; // arrays, maps, and extensions (including records) are not supported as elements
+		}
+	}
+	return valueSize <= size ? valueSize : 0;
+}
+
+typedef struct {
+	const uint8_t* data;
+	size_t size;
+} msgpack_element_t;
+
+// read the elements of a msgpack array of scalars (or a single scalar, as an array of one)
+static bool readMsgpackElements(const uint8_t* data, size_t size, std::vector<msgpack_element_t>& elements) {
+	if (size == 0)
+		return false;
+	uint8_t type = data[0];
+	uint32_t length;
+	size_t position;
+	if (type >= 0x90 && type < 0xa0) {
+		length = type & 0xf;
+		position = 1;
+	} else if (type == 0xdc && size >= 3) {
+		length = (data[1] << 8) | data[2];
+		position = 3;
+	} else if (type == 0xdd && size >= 5) {
+		length = ((uint32_t) data[1] << 24) | (data[2] << 16) | (data[3] << 8) | data[4];
+		position = 5;
+	} else {
+		size_t elementSize = msgpackScalarSize(data, size);
+		if (elementSize != size)
+			return false;
+		elements.push_back({ data, size });
+		return true;
+	}
+	for (uint32_t i = 0; i < length; i++) {
+		size_t elementSize = msgpackScalarSize(data + position, size - position);
+		if (!elementSize)
+			return false;
+		elements.push_back({ data + position, elementSize });
+		position += elementSize;
+	}
+	return position == size;
+}
+
+static int writeMsgpackArray(std::vector<msgpack_element_t>::iterator start, std::vector<msgpack_element_t>::iterator end, MDB_val* result) {
+	size_t length = end - start;
+	size_t size = 5;
+	for (auto element = start; element != end; element++)
+		size += element->size;
+	uint8_t* target = (uint8_t*) malloc(size);
+	if (!target)
+		return ENOMEM;
+	size_t position;
+	if (length < 16) {
+		target[0] = 0x90 | (uint8_t) length;
+		position = 1;
+	} else if (length < 0x10000) {
+		target[0] = 0xdc;
+		target[1] = (uint8_t) (length >> 8);
+		target[2] = (uint8_t) length;
+		position = 3;
+	} else {
+		target[0] = 0xdd;
+		target[1] = (uint8_t) (length >> 24);
+		target[2] = (uint8_t) (length >> 16);
+		target[3] = (uint8_t) (length >> 8);
+		target[4] = (uint8_t) length;
+		position = 5;
+	}
+	for (auto element = start; element != end; element++) {
+		memcpy(target + position, element->data, element->size);
+		position += element->size;
+	}
+	result->mv_data = target;
+	result->mv_size = position;
+	return 0;
+}
+
+static int writeNumber(double number, MDB_val* result) {
+	uint8_t* target = (uint8_t*) malloc(9);
+	if (!target)
+		return ENOMEM;
+	result->mv_size = writeMsgpackNumber(number, target);
+	result->mv_data = target;
+	return 0;
+}
+
+// order of elements in sorted sets: nil, booleans, numbers, strings, and then binary
+static int scalarClass(uint8_t type) {
+	if (type == 0xc0)
+		return 0;
+	if (type == 0xc2 || type == 0xc3)
+		return 1;
+	if ((type >= 0xa0 && type < 0xc0) || type == 0xd9 || type == 0xda || type == 0xdb)
+		return 3;
+	if (type == 0xc4 || type == 0xc5 || type == 0xc6)
+		return 4;
+	return 2;
+}
+static int compareElements(const msgpack_element_t& a, const msgpack_element_t& b) {
+	int aClass = scalarClass(a.data[0]);
+	int diff = aClass - scalarClass(b.data[0]);
+	if (diff)
+		return diff;
+	if (aClass == 2) {
+		double aNumber = 0, bNumber = 0;
+		readMsgpackNumber(a.data, a.size, &aNumber);
+		readMsgpackNumber(b.data, b.size, &bNumber);
+		return aNumber < bNumber ? -1 : aNumber > bNumber ? 1 : 0;
+	}
+	if (aClass >= 3) {
+		// compare the bytes of the string or binary, after its header
+		uint8_t type = a.data[0];
+		size_t aHeader = type < 0xc0 ? 1 : type == 0xd9 || type == 0xc4 ? 2 : type == 0xda || type == 0xc5 ? 3 : 5;
+		type = b.data[0];
+		size_t bHeader = type < 0xc0 ? 1 : type == 0xd9 || type == 0xc4 ? 2 : type == 0xda || type == 0xc5 ? 3 : 5;
+		size_t aSize = a.size - aHeader, bSize = b.size - bHeader;
+		diff = memcmp(a.data + aHeader, b.data + bHeader, aSize < bSize ? aSize : bSize);
+		return diff ? diff : aSize < bSize ? -1 : aSize > bSize ? 1 : 0;
+	}
+	return (int) a.data[0] - (int) b.data[0];
+}
+static void sortElements(std::vector<msgpack_element_t>& elements) {
+	for (size_t i = 1; i < elements.size(); i++) {
+		if (compareElements(elements[i - 1], elements[i]) > 0) {
+			std::stable_sort(elements.begin(), elements.end(), [](const msgpack_element_t& a, const msgpack_element_t& b) {
+				return compareElements(a, b) < 0;
+			});
+			return;
+		}
+	}
+}
+
+static int mergeAdd(const MDB_val* existing, const MDB_val* operand, uint32_t argument, MDB_val* result) {
+	double number = 0, addend;
+	if (!readMsgpackNumber((uint8_t*) operand->mv_data, operand->mv_size, &addend))
+		return EINVAL;
+	if (existing && !readMsgpackNumber((uint8_t*) existing->mv_data, existing->mv_size, &number))
+		return MDB_NOTFOUND;
+	return writeNumber(number + addend, result);
+}
+
+static int mergeMax(const MDB_val* existing, const MDB_val* operand, uint32_t argument, MDB_val* result) {
+	double number, candidate;
+	if (!readMsgpackNumber((uint8_t*) operand->mv_data, operand->mv_size, &candidate))
+		return EINVAL;
+	if (existing) {
+		if (!readMsgpackNumber((uint8_t*) existing->mv_data, existing->mv_size, &number))
+			return MDB_NOTFOUND;
+		if (number >= candidate)
+			candidate = number;
+	}
+	return writeNumber(candidate, result);
+}
+
+static int mergeUnion(const MDB_val* existing, const MDB_val* operand, uint32_t argument, MDB_val* result) {
+	std::vector<msgpack_element_t> existingElements, operandElements, merged;
+	if (!readMsgpackElements((uint8_t*) operand->mv_data, operand->mv_size, operandElements))
+		return EINVAL;
+	if (existing && !readMsgpackElements((uint8_t*) existing->mv_data, existing->mv_size, existingElements))
+		return MDB_NOTFOUND;
+	sortElements(existingElements);
+	sortElements(operandElements);
+	merged.reserve(existingElements.size() + operandElements.size());
+	auto a = existingElements.begin(), b = operandElements.begin();
+	while (a != existingElements.end() || b != operandElements.end()) {
+		int diff = a == existingElements.end() ? 1 : b == operandElements.end() ? -1 : compareElements(*a, *b);
+		msgpack_element_t& next = diff <= 0 ? *a++ : *b++;
+		if (diff == 0)
+			b++;
+		if (merged.empty() || compareElements(merged.back(), next) != 0)
+			merged.push_back(next);
+	}
+	return writeMsgpackArray(merged.begin(), merged.end(), result);
+}
+
+static int mergeAppend(const MDB_val* existing, const MDB_val* operand, uint32_t maxLength, MDB_val* result) {
+	std::vector<msgpack_element_t> elements;
+	if (existing && !readMsgpackElements((uint8_t*) existing->mv_data, existing->mv_size, elements))
+		return MDB_NOTFOUND;
+	if (!readMsgpackElements((uint8_t*) operand->mv_data, operand->mv_size, elements))
+		return EINVAL;
+	auto start = elements.begin();
+	if (maxLength > 0 && elements.size() > maxLength)
+		start = elements.end() - maxLength; // keep the most recent elements
+	return writeMsgpackArray(start, elements.end(), result);
+}
+
+int registerMergeOperator(const char* name, merge_function_t* merge) {
+	pthread_mutex_lock(mergeOperatorsLock);
+	int id = -1;
+	for (int i = 1; i < mergeOperatorCount; i++) {
+		if (mergeOperators[i].name == name) {
+			mergeOperators[i].merge = merge;
+			id = i;
+			break;
+		}
+	}
+	if (id < 0) {
+		if (mergeOperatorCount == 0)
+			mergeOperatorCount = 1; // 0 is not a valid operator id
+		if (mergeOperatorCount < MAX_MERGE_OPERATORS) {
+			mergeOperators[mergeOperatorCount].name = name;
+			mergeOperators[mergeOperatorCount].merge = merge;
+			id = mergeOperatorCount++;
+		}
+	}
+	pthread_mutex_unlock(mergeOperatorsLock);
+	return id;
+}
+
+static int registerDefaultOperators() {
+	registerMergeOperator("add", mergeAdd);
+	registerMergeOperator("max", mergeMax);
+	registerMergeOperator("union", mergeUnion);
+	registerMergeOperator("append", mergeAppend);
+	return 0;
+}
+static int defaultOperatorsRegistered = registerDefaultOperators();
+
+int mergeValue(uint8_t operatorId, const MDB_val* existing, const MDB_val* operand, uint32_t argument, MDB_val* result) {
+	pthread_mutex_lock(mergeOperatorsLock);
+	merge_function_t* merge = operatorId < mergeOperatorCount ? mergeOperators[operatorId].merge : nullptr;
+	pthread_mutex_unlock(mergeOperatorsLock);
+	if (!merge)
+		return EINVAL;
+	return merge(existing, operand, argument, result);
+}
+
+NAPI_FUNCTION(getMergeOperators) {
+	ARGS(0)
+	napi_create_object(env, &returnValue);
+	pthread_mutex_lock(mergeOperatorsLock);
+	for (int i = 1; i < mergeOperatorCount; i++) {
+		napi_value id;
+		napi_create_uint32(env, i, &id);
+		napi_set_named_property(env, returnValue, mergeOperators[i].name.c_str(), id);
+	}
+	pthread_mutex_unlock(mergeOperatorsLock);
+	return returnValue;
+}
+
+void setupExportMerge(Napi::Env env, Object exports) {
+	EXPORT_NAPI_FUNCTION("getMergeOperators", getMergeOperators);
+}
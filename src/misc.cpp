@@ -100,7 +100,7 @@ Value valToBinaryUnsafe(MDB_val &data, DbiWrap* dw, Env env) {
 }
 
 
-int getVersionAndUncompress(MDB_val &data, DbiWrap* dw) {
+int getVersionAndUncompress(MDB_val &data, DbiWrap* dw, MDB_txn* txn, MDB_val* key, mdb_size_t valueTxnId) {
 	//fprintf(stdout, "uncompressing %u\n", compressionThreshold);
 	unsigned char* charData = (unsigned char*) data.mv_data;
 	if (dw->hasVersions) {
@@ -117,7 +117,27 @@ int getVersionAndUncompress(MDB_val &data, DbiWrap* dw) {
 		//fprintf(stdout, "uncompressing status %X\n", statusByte);
 	if (statusByte >= 250) {
 		bool isValid;
-		dw->compression->decompress(data, isValid, !dw->getFast);
+		// with the key and the txn id of its page, the decompressed value can be shared through the value cache
+		bool useCache = key && valueTxnId && (dw->ew->jsFlags & SHARED_VALUE_CACHE);
+		Compression* compression = dw->compression;
+		// first check this thread's cache of decompressed values, keyed by the location of the value and its page txn id
+		MDB_env* env = dw->ew->env;
+		mdb_size_t offset, pageTxnId = 0;
+#ifdef MDB_VAL_TXNID
+		if (compression->cacheCapacity && txn && mdb_val_txnid(txn, &data, &pageTxnId, &offset))
+			pageTxnId = 0;
+#endif
+		if (pageTxnId && compression->getDecompressed(data, env, offset, pageTxnId))
+			return 2;
+		if (useCache && getCachedValue(dw, key, valueTxnId, data))
+			isValid = true;
+		else {
+			compression->decompress(data, isValid, !dw->getFast);
+			if (useCache && isValid)
+				cacheValue(dw, key, valueTxnId, data);
+		}
+		if (pageTxnId && isValid)
+			compression->cacheDecompressed(env, offset, pageTxnId, data);
 		return isValid ? 2 : 0;
 	}
 	return 1;
@@ -258,10 +278,12 @@ typedef struct {
 	napi_async_work work;
 	//napi_deferred deferred;
 	js_buffers_t* buffers;
+	uint64_t queuedTime;
 } read_instruction_t;
 const uint32_t ZERO = 0;
 void do_read(napi_env nenv, void* instruction_pointer) {
 	read_instruction_t* readInstruction = (read_instruction_t*) instruction_pointer;
+	uint64_t start = get_time64();
 	//fprintf(stderr, "lock %p\n", &readInstruction->buffers->modification_lock);
 	uint32_t* instruction = readInstruction->instructionAddress;
 	MDB_val key;
@@ -285,6 +307,8 @@ void do_read(napi_env nenv, void* instruction_pointer) {
 	key.mv_data = (void*) (instruction + 4);
 	rc = mdb_cursor_get(cursor, &key, &data, MDB_SET_KEY);
 	*(instruction + 3) = data.mv_size;
+	if (!rc && tw->ew->accessProfile)
+		recordAccess(tw->ew->accessProfile, &data);
 
 	//instruction += (key.mv_size + 28) >> 2;
 	while (!rc) {
@@ -346,6 +370,11 @@ void do_read(napi_env nenv, void* instruction_pointer) {
 		read_buffer->offset = (char*)position - read_buffer->data;
 	}
 	mdb_cursor_close(cursor);
+	latency_histogram_t* histograms = getLatencyHistograms(env);
+	if (histograms) {
+		recordLatency(histograms + READ_QUEUE_LATENCY, start - readInstruction->queuedTime);
+		recordLatency(histograms + READ_EXECUTION_LATENCY, get_time64() - start);
+	}
 	//fprintf(stderr, "unlock %p\n", &readInstruction->buffers->modification_lock);
 }
 static thread_local napi_ref* read_callback;
@@ -385,6 +414,7 @@ NAPI_FUNCTION(startRead) {
 	//napi_create_reference(env, args[1], 1, &readInstruction->callback);
 	readInstruction->callback_id = callback_id;
 	readInstruction->buffers = EnvWrap::sharedBuffers;
+	readInstruction->queuedTime = get_time64();
 	napi_status status;
 	status = napi_create_async_work(env, args[2], args[3], do_read, read_complete, readInstruction, &readInstruction->work);
 	status = napi_queue_async_work(env, readInstruction->work);
@@ -0,0 +1,319 @@
+#include "lmdb-js.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace Napi;
+
+/*
+Commit notifications let readers in any process wait for commits, instead of polling. Each top-level commit from an
+env with commitNotifications enabled appends a (txn id, dbi) entry to a ring for each database it wrote to, increments
+the sequence, and wakes any waiters (with a shared futex on linux, other platforms poll the last txn id).
+*/
+const int MAX_WAIT_SLICE = 100; // ms, waiters recheck the last txn id, for commits from processes that don't notify
+
+commit_notifications_t* openCommitNotifications(MDB_env* env) {
+#ifdef _WIN32
+	return nullptr;
+#else
+	const char* path;
+	unsigned int flags;
+	mdb_env_get_path(env, &path);
+	mdb_env_get_flags(env, &flags);
+	std::string notifyPath(path);
+	notifyPath += (flags & MDB_NOSUBDIR) ? "-notify" : "/notify.mdb";
+	int fd = open(notifyPath.c_str(), O_RDWR | O_CREAT, 0664);
+	if (fd < 0)
+		return nullptr;
+	struct stat st;
+	if (fstat(fd, &st) || (st.st_size < (off_t) sizeof(commit_notifications_t) &&
+			ftruncate(fd, sizeof(commit_notifications_t)))) {
+		close(fd);
+		return nullptr;
+	}
+	void* map = mmap(nullptr, sizeof(commit_notifications_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return nullptr;
+	commit_notifications_t* notifications = (commit_notifications_t*) map;
+	// a new (zero-filled) file is a valid empty ring, we just need to mark it
+	if (notifications->magic == 0)
+		notifications->magic = COMMIT_NOTIFICATIONS_MAGIC;
+	if (notifications->magic != COMMIT_NOTIFICATIONS_MAGIC) {
+		munmap(map, sizeof(commit_notifications_t));
+		return nullptr;
+	}
+	return notifications;
+#endif
+}
+
+void closeCommitNotifications(commit_notifications_t* notifications) {
+#ifndef _WIN32
+	munmap((void*) notifications, sizeof(commit_notifications_t));
+#endif
+}
+
+void wakeCommitWaiters(commit_notifications_t* notifications) {
+#ifdef __linux__
+	syscall(SYS_futex, (uint32_t*) &notifications->sequence, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+void publishCommit(commit_notifications_t* notifications, uint64_t txnId, std::vector<MDB_dbi>& dbis) {
+	for (MDB_dbi dbi : dbis) {
+		// claim a position, and stamp the entry once it is written, so readers can detect entries that are in
+		// progress or have been overwritten
+		uint64_t position = notifications->position.fetch_add(1);
+		commit_entry_t* entry = notifications->entries + (position % COMMIT_RING_SIZE);
+		entry->stamp.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release); // the stamp is cleared before the fields change
+		entry->txnId = txnId;
+		entry->dbi = dbi;
+		entry->stamp.store(position + 1, std::memory_order_release);
+	}
+	notifications->sequence.fetch_add(1);
+	if (notifications->waiters.load())
+		wakeCommitWaiters(notifications);
+}
+
+static uint64_t lastTxnId(MDB_env* env) {
+#ifdef MDB_LAST_TXNID_ADDRESS
+	volatile mdb_size_t* address = mdb_env_last_txnid_address(env);
+	if (address)
+		return *address;
+#endif
+	MDB_envinfo stat;
+	mdb_env_info(env, &stat);
+	return stat.me_last_txnid;
+}
+
+struct commit_waiter_t {
+	uint64_t afterTxnId;
+	bool hasDeadline;
+	std::chrono::steady_clock::time_point deadline;
+	uint64_t txnId; // the last txn id when it was done
+	bool closed; // the env was closed before it was done
+	napi_ref callback;
+};
+
+/*
+Each env has (at most) one watcher thread that waits for commits on behalf of all of its waiters, so waiting doesn't
+hold threads from the libuv pool (which the write worker needs). Finished waiters are called back on the JS thread
+through a threadsafe function, and the watcher is freed when that is finalized, after the env is closed.
+*/
+struct commit_watcher_t {
+	MDB_env* env;
+	commit_notifications_t* notifications;
+	napi_threadsafe_function done;
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::vector<commit_waiter_t*> waiters; // guarded by lock
+	std::chrono::steady_clock::time_point sleepUntil; // guarded by lock
+	bool closing; // guarded by lock
+	int pending; // waiters that haven't been called back yet, only used on the JS thread
+};
+
+// wake the watcher thread, called with the lock held
+static void interruptCommitWatcher(commit_watcher_t* watcher) {
+	watcher->wake.notify_one();
+	if (watcher->notifications) {
+		// changing the sequence ensures that a futex wait that is about to start returns immediately
+		watcher->notifications->sequence.fetch_add(1);
+		wakeCommitWaiters(watcher->notifications);
+	}
+}
+
+static void watchCommits(commit_watcher_t* watcher) {
+	using namespace std::chrono;
+	commit_notifications_t* notifications = watcher->notifications;
+	int pollInterval = 100; // us, when there is no futex
+	std::unique_lock<std::mutex> lock(watcher->lock);
+	while (true) {
+		if (watcher->waiters.empty() && !watcher->closing) {
+			watcher->sleepUntil = steady_clock::time_point::max();
+			watcher->wake.wait(lock);
+			pollInterval = 100;
+			continue;
+		}
+		// register before checking the last txn id, so a commit after the check will wake us
+		uint32_t sequence = notifications ? notifications->sequence.load() : 0;
+		if (notifications)
+			notifications->waiters++;
+		uint64_t txnId = lastTxnId(watcher->env);
+		steady_clock::time_point now = steady_clock::now();
+		steady_clock::time_point until = now + milliseconds(MAX_WAIT_SLICE);
+		for (auto waiterRef = watcher->waiters.begin(); waiterRef != watcher->waiters.end(); ) {
+			commit_waiter_t* waiter = *waiterRef;
+			if (watcher->closing || txnId > waiter->afterTxnId || (waiter->hasDeadline && waiter->deadline <= now)) {
+				waiter->txnId = txnId;
+				waiter->closed = watcher->closing;
+				napi_call_threadsafe_function(watcher->done, waiter, napi_tsfn_nonblocking);
+				waiterRef = watcher->waiters.erase(waiterRef);
+				continue;
+			}
+			if (waiter->hasDeadline && waiter->deadline < until)
+				until = waiter->deadline;
+			++waiterRef;
+		}
+		if (watcher->closing || watcher->waiters.empty()) {
+			if (notifications)
+				notifications->waiters--;
+			if (watcher->closing)
+				break;
+			continue;
+		}
+		watcher->sleepUntil = until;
+#ifdef __linux__
+		if (notifications) {
+			int64_t remaining = duration_cast<nanoseconds>(until - now).count();
+			struct timespec time = { (time_t) (remaining / 1000000000), (long) (remaining % 1000000000) };
+			lock.unlock();
+			syscall(SYS_futex, (uint32_t*) &notifications->sequence, FUTEX_WAIT, sequence, &time, nullptr, 0);
+			notifications->waiters--;
+			lock.lock();
+			continue;
+		}
+#endif
+		if (notifications)
+			notifications->waiters--;
+		if (now + microseconds(pollInterval) < until)
+			until = now + microseconds(pollInterval);
+		watcher->wake.wait_until(lock, until);
+		if (pollInterval < 10000)
+			pollInterval <<= 1;
+	}
+}
+
+static void callCommitWaiter(napi_env env, napi_value callback, void* context, void* data) {
+	commit_watcher_t* watcher = (commit_watcher_t*) context;
+	commit_waiter_t* waiter = (commit_waiter_t*) data;
+	if (env) { // otherwise the env is being torn down
+		if (--watcher->pending == 0)
+			napi_unref_threadsafe_function(env, watcher->done); // nothing to wait for, don't hold the event loop open
+		napi_value result, fn, args[2];
+		napi_get_reference_value(env, waiter->callback, &fn);
+		napi_delete_reference(env, waiter->callback);
+		int argc = 2;
+		if (!waiter->closed) {
+			napi_get_null(env, &args[0]);
+			napi_create_double(env, (double) waiter->txnId, &args[1]);
+		} else {
+			napi_value message;
+			napi_create_string_utf8(env, "The database was closed while waiting for a commit", NAPI_AUTO_LENGTH, &message);
+			napi_create_error(env, nullptr, message, &args[0]);
+			argc = 1;
+		}
+		// we use direct napi call here because node-addon-api interface with throw a fatal error if a worker thread is terminating
+		napi_call_function(env, callback, fn, argc, args, &result);
+	}
+	delete waiter;
+}
+
+static void finalizeCommitWatcher(napi_env env, void* data, void* hint) {
+	delete (commit_watcher_t*) data;
+}
+
+void closeCommitWatcher(commit_watcher_t* watcher) {
+	{
+		std::lock_guard<std::mutex> lock(watcher->lock);
+		watcher->closing = true;
+		interruptCommitWatcher(watcher);
+	}
+	// the remaining waiters are called back with an error, and the watcher is freed once they have been
+	watcher->thread.join();
+	napi_release_threadsafe_function(watcher->done, napi_tsfn_release);
+}
+
+Napi::Value EnvWrap::waitForCommit(const CallbackInfo& info) {
+	if (!this->env) {
+		return throwError(info.Env(), "The environment is already closed.");
+	}
+	double afterTxnId = info[0].As<Number>();
+	uint64_t after = afterTxnId < 0 ? lastTxnId(this->env) : (uint64_t) afterTxnId;
+	int64_t timeout = info[1].As<Number>().Int64Value();
+	if (!commitWatcher) {
+		commit_watcher_t* watcher = new commit_watcher_t();
+		watcher->env = this->env;
+		watcher->notifications = notifications;
+		watcher->closing = false;
+		watcher->pending = 0;
+		napi_value resource_name;
+		napi_create_string_latin1(info.Env(), "waitForCommit", NAPI_AUTO_LENGTH, &resource_name);
+		if (napi_create_threadsafe_function(info.Env(), nullptr, nullptr, resource_name, 0, 1, watcher,
+				finalizeCommitWatcher, watcher, callCommitWaiter, &watcher->done) != napi_ok) {
+			delete watcher;
+			return throwError(info.Env(), "Unable to wait for commits");
+		}
+		napi_unref_threadsafe_function(info.Env(), watcher->done);
+		watcher->thread = std::thread(watchCommits, watcher);
+		commitWatcher = watcher;
+	}
+	commit_waiter_t* waiter = new commit_waiter_t();
+	waiter->afterTxnId = after;
+	waiter->hasDeadline = timeout >= 0;
+	if (waiter->hasDeadline)
+		waiter->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+	napi_create_reference(info.Env(), info[2], 1, &waiter->callback);
+	if (commitWatcher->pending++ == 0)
+		napi_ref_threadsafe_function(info.Env(), commitWatcher->done);
+	{
+		std::lock_guard<std::mutex> lock(commitWatcher->lock);
+		commitWatcher->waiters.push_back(waiter);
+		if (commitWatcher->waiters.size() == 1)
+			commitWatcher->wake.notify_one(); // the thread is idle
+		else if (waiter->hasDeadline && waiter->deadline < commitWatcher->sleepUntil)
+			interruptCommitWatcher(commitWatcher); // it would sleep past this waiter's deadline
+	}
+	return Number::New(info.Env(), (double) after);
+}
+
+Napi::Value EnvWrap::getRecentCommits(const CallbackInfo& info) {
+	if (!this->env) {
+		return throwError(info.Env(), "The environment is already closed.");
+	}
+	uint64_t afterTxnId = (uint64_t) info[0].As<Number>().Int64Value();
+	Object result = Object::New(info.Env());
+	Array commits = Array::New(info.Env());
+	bool complete = false;
+	if (notifications) {
+		uint64_t position = notifications->position.load();
+		// if the ring hasn't wrapped, we have every commit
+		complete = position <= COMMIT_RING_SIZE;
+		uint64_t first = complete ? 0 : position - COMMIT_RING_SIZE;
+		uint32_t length = 0;
+		for (uint64_t i = first; i < position; i++) {
+			commit_entry_t* entry = notifications->entries + (i % COMMIT_RING_SIZE);
+			// read it like a seqlock, the stamp must be the same before and after the fields are copied
+			uint64_t stamp = entry->stamp.load(std::memory_order_acquire);
+			uint64_t txnId = entry->txnId;
+			MDB_dbi dbi = entry->dbi;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (stamp != i + 1 || entry->stamp.load(std::memory_order_relaxed) != i + 1)
+				continue; // in progress, or already overwritten
+			if (txnId <= afterTxnId) {
+				complete = true; // we have reached commits that were already seen
+				continue;
+			}
+			Object commit = Object::New(info.Env());
+			commit.Set("txnId", Number::New(info.Env(), (double) txnId));
+			commit.Set("dbi", Number::New(info.Env(), dbi));
+			commits.Set(length++, commit);
+		}
+	}
+	result.Set("commits", commits);
+	result.Set("complete", Boolean::New(info.Env(), complete));
+	return result;
+}
@@ -7,12 +7,14 @@
 #include <arpa/inet.h>
 #endif
 
-// compare items by 32-bit comparison, a is user provided and assumed to be zero terminated/padded
-// which allows us to do the full 32-bit comparisons safely
-int compareFast(const MDB_val *a, const MDB_val *b) {
-    uint32_t* dataA = (uint32_t*) a->mv_data;
-    uint32_t* dataB = (uint32_t*) b->mv_data;
-    size_t remaining = b->mv_size;
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define COMPARE_SIMD
+#endif
+
+// compare the remaining bytes (of b's size) 32 bits at a time, a is user provided and assumed to be zero
+// terminated/padded which allows us to do the full 32-bit comparisons safely
+static inline int compareWords(const uint32_t* dataA, const uint32_t* dataB, size_t remaining) {
     uint32_t aVal, bVal;
     while(remaining >= 4) {
         aVal = ntohl(*dataA);
@@ -42,5 +44,145 @@ int compareFast(const MDB_val *a, const MDB_val *b) {
         if (aVal < bVal)
             return -1;
     }
+    return 0;
+}
+
+// compare items by 32-bit comparison, a is user provided and assumed to be zero terminated/padded
+// which allows us to do the full 32-bit comparisons safely
+int compareFast(const MDB_val *a, const MDB_val *b) {
+    int diff = compareWords((uint32_t*) a->mv_data, (uint32_t*) b->mv_data, b->mv_size);
+    if (diff)
+        return diff;
+    return a->mv_size - b->mv_size;
+}
+
+#ifdef COMPARE_SIMD
+static inline int firstDifference(const uint8_t* a, const uint8_t* b, uint32_t equalMask) {
+#ifdef _WIN32
+    unsigned long index;
+    _BitScanForward(&index, ~equalMask);
+#else
+    int index = __builtin_ctz(~equalMask);
+#endif
+    return a[index] > b[index] ? 1 : -1;
+}
+
+// compare 16 bytes at a time, finding the first differing byte with a byte-wise compare and mask. We only load
+// full blocks within b's size (b may be at the end of the memory map), and the tail is compared by words
+static int compareFastSSE2(const MDB_val *a, const MDB_val *b) {
+    const uint8_t* dataA = (uint8_t*) a->mv_data;
+    const uint8_t* dataB = (uint8_t*) b->mv_data;
+    size_t remaining = b->mv_size;
+    while (remaining >= 16) {
+        __m128i blockA = _mm_loadu_si128((const __m128i*) dataA);
+        __m128i blockB = _mm_loadu_si128((const __m128i*) dataB);
+        uint32_t equalMask = _mm_movemask_epi8(_mm_cmpeq_epi8(blockA, blockB));
+        if (equalMask != 0xffff)
+            return firstDifference(dataA, dataB, equalMask);
+        dataA += 16;
+        dataB += 16;
+        remaining -= 16;
+    }
+    int diff = compareWords((uint32_t*) dataA, (uint32_t*) dataB, remaining);
+    if (diff)
+        return diff;
     return a->mv_size - b->mv_size;
 }
+
+#ifndef _WIN32
+// compare 32 bytes at a time, only used if the CPU supports AVX2
+__attribute__((target("avx2")))
+static int compareFastAVX2(const MDB_val *a, const MDB_val *b) {
+    const uint8_t* dataA = (uint8_t*) a->mv_data;
+    const uint8_t* dataB = (uint8_t*) b->mv_data;
+    size_t remaining = b->mv_size;
+    while (remaining >= 32) {
+        __m256i blockA = _mm256_loadu_si256((const __m256i*) dataA);
+        __m256i blockB = _mm256_loadu_si256((const __m256i*) dataB);
+        uint32_t equalMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(blockA, blockB));
+        if (equalMask != 0xffffffff)
+            return firstDifference(dataA, dataB, equalMask);
+        dataA += 32;
+        dataB += 32;
+        remaining -= 32;
+    }
+    if (remaining >= 16) {
+        __m128i blockA = _mm_loadu_si128((const __m128i*) dataA);
+        __m128i blockB = _mm_loadu_si128((const __m128i*) dataB);
+        uint32_t equalMask = _mm_movemask_epi8(_mm_cmpeq_epi8(blockA, blockB));
+        if (equalMask != 0xffff)
+            return firstDifference(dataA, dataB, equalMask);
+        dataA += 16;
+        dataB += 16;
+        remaining -= 16;
+    }
+    int diff = compareWords((uint32_t*) dataA, (uint32_t*) dataB, remaining);
+    if (diff)
+        return diff;
+    return a->mv_size - b->mv_size;
+}
+#endif
+#endif
+
+const int COMPARE_SCALAR = 0;
+const int COMPARE_SSE2 = 1;
+const int COMPARE_AVX2 = 2;
+static MDB_cmp_func* getCompareImplementation(int implementation) {
+    switch (implementation) {
+        case COMPARE_SCALAR: return compareFast;
+#ifdef COMPARE_SIMD
+        case COMPARE_SSE2: return compareFastSSE2; // always available on x86-64
+#ifndef _WIN32
+        case COMPARE_AVX2:
+            if (__builtin_cpu_supports("avx2"))
+                return compareFastAVX2;
+#endif
+#endif
+    }
+    return nullptr;
+}
+
+// the fastest key comparator for this CPU, selected at runtime
+MDB_cmp_func* getCompareFast() {
+    static MDB_cmp_func* compare = nullptr;
+    if (!compare) {
+        for (int implementation = COMPARE_AVX2; implementation >= COMPARE_SCALAR && !compare; implementation--)
+            compare = getCompareImplementation(implementation);
+    }
+    return compare;
+}
+
+// microbenchmark of a comparator implementation, comparing keys of the given size that differ at the given position,
+// returns the average time of each comparison in nanoseconds (or -1 if the implementation isn't supported)
+NAPI_FUNCTION(benchmarkCompare) {
+    ARGS(4)
+    uint32_t implementation, keySize, differAt, iterations;
+    GET_UINT32_ARG(implementation, 0);
+    GET_UINT32_ARG(keySize, 1);
+    GET_UINT32_ARG(differAt, 2);
+    GET_UINT32_ARG(iterations, 3);
+    MDB_cmp_func* volatile compare = getCompareImplementation(implementation);
+    if (!compare) {
+        napi_create_double(env, -1, &returnValue);
+        return returnValue;
+    }
+    uint8_t* keyA = new uint8_t[keySize + 8]();
+    uint8_t* keyB = new uint8_t[keySize + 8]();
+    for (uint32_t i = 0; i < keySize; i++)
+        keyA[i] = keyB[i] = (uint8_t) (i * 31 + 7);
+    if (differAt < keySize)
+        keyB[differAt]++;
+    MDB_val a = { keySize, keyA }, b = { keySize, keyB };
+    uint64_t start = get_time64();
+    for (uint32_t i = 0; i < iterations; i++)
+        compare(&a, &b); // called through a volatile pointer, like LMDB's indirect call, so it isn't optimized out
+    double elapsed = (double) (get_time64() - start) * 1000000000 / TICKS_PER_SECOND;
+    delete[] keyA;
+    delete[] keyB;
+    napi_create_double(env, elapsed / iterations, &returnValue);
+    return returnValue;
+}
+
+void setupExportOrderedBinary(Napi::Env env, Object exports) {
+    EXPORT_NAPI_FUNCTION("benchmarkCompare", benchmarkCompare);
+}
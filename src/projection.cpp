@@ -0,0 +1,320 @@
+#include "lmdb-js.h"
+#include <string.h>
+
+using namespace Napi;
+
+/*
+A projection decodes selected fields of msgpackr records directly from the database, into columns, without creating an
+object for each entry. With shared structures, msgpackr encodes an object as a record: a byte (0x40 + the index of its
+structure) followed by the values of the properties, in the order of the keys of the structure. JS resolves the fields
+to their position in each structure, and this walks the values of each record to the positions of the fields. Numbers,
+booleans and nulls are written to a Float64 column, strings are copied (as UTF-8) to a heap, and any other value is
+copied to the heap as msgpack for JS to decode. A value that isn't a record with a shared structure (or can't be
+walked here) is copied to the heap whole, so JS can decode it and pick the fields out of the object.
+The workspace (laid out by getProjection in read.js) starts with a header of PROJECTION_HEADER_WORDS uint32s, followed by
+the positions of the fields in each structure, and then the columns.
+*/
+const int PROJECTION_HEADER_WORDS = 8;
+const int MAX_SHARED_RECORD_IDS = 32; // ids 0x60-0x7f are used for unshared structures (or as two byte ids)
+const uint8_t VALUE_UNDEFINED = 0;
+const uint8_t VALUE_NUMBER = 1;
+const uint8_t VALUE_BOOLEAN = 2;
+const uint8_t VALUE_NULL = 3;
+const uint8_t VALUE_MSGPACK = 4;
+const uint8_t VALUE_WHOLE = 5;
+const uint8_t VALUE_STRING = 6;
+
+static size_t align8(size_t offset) {
+	return (offset + 7) & ~(size_t) 7;
+}
+
+projection_t::projection_t(char* workspace, char* heap) {
+	header = (uint32_t*) workspace;
+	fieldCount = header[0];
+	rowCapacity = header[2];
+	heapSize = header[3];
+	structureCount = header[4] < MAX_SHARED_RECORD_IDS ? header[4] : MAX_SHARED_RECORD_IDS;
+	structures = (int32_t*) (header + PROJECTION_HEADER_WORDS);
+	size_t offset = align8((PROJECTION_HEADER_WORDS + header[4] * (1 + fieldCount)) * 4);
+	values = (double*) (workspace + offset);
+	offset += fieldCount * rowCapacity * 8;
+	lengths = (uint32_t*) (workspace + offset);
+	offset += fieldCount * rowCapacity * 4;
+	keyStarts = (uint32_t*) (workspace + offset);
+	offset += rowCapacity * 4;
+	keyLengths = (uint32_t*) (workspace + offset);
+	offset += rowCapacity * 4;
+	types = (uint8_t*) (workspace + offset);
+	this->heap = heap;
+	heapUsed = 0;
+}
+
+static inline uint16_t read16(const uint8_t* p) {
+	return (p[0] << 8) | p[1];
+}
+static inline uint32_t read32(const uint8_t* p) {
+	return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+static inline uint64_t read64(const uint8_t* p) {
+	return ((uint64_t) read32(p) << 32) | read32(p + 4);
+}
+
+/*
+Decodes a msgpack number (or boolean) at position, returning false if it is another type.
+*/
+bool readMsgpackNumber(const uint8_t* position, const uint8_t* end, double* number) {
+	if (position >= end)
+		return false;
+	uint8_t token = *position++;
+	if (token < 0x40) { // positive fixint (0x40-0x7f are records)
+		*number = token;
+		return true;
+	}
+	if (token >= 0xe0) { // negative fixint
+		*number = (int8_t) token;
+		return true;
+	}
+	static const uint8_t sizes[] = { 4, 8, 1, 2, 4, 8, 1, 2, 4, 8 }; // 0xca - 0xd3
+	if (token < 0xc2 || token > 0xd3 || (token > 0xc3 && token < 0xca))
+		return false;
+	if (token <= 0xc3) {
+		*number = token == 0xc3;
+		return true;
+	}
+	if (position + sizes[token - 0xca] > end)
+		return false;
+	switch (token) {
+		case 0xca: { uint32_t bits = read32(position); float f; memcpy(&f, &bits, 4); *number = f; break; }
+		case 0xcb: { uint64_t bits = read64(position); memcpy(number, &bits, 8); break; }
+		case 0xcc: *number = position[0]; break;
+		case 0xcd: *number = read16(position); break;
+		case 0xce: *number = read32(position); break;
+		case 0xcf: *number = (double) read64(position); break;
+		case 0xd0: *number = (int8_t) position[0]; break;
+		case 0xd1: *number = (int16_t) read16(position); break;
+		case 0xd2: *number = (int32_t) read32(position); break;
+		case 0xd3: *number = (double) (int64_t) read64(position); break;
+	}
+	return true;
+}
+
+/*
+Skips over a msgpack value (which may be a record of a shared structure), returning nullptr if it can't be skipped.
+*/
+const uint8_t* projection_t::skipValue(const uint8_t* position, const uint8_t* end, int depth) {
+	if (position >= end || depth > 64)
+		return nullptr;
+	uint8_t token = *position++;
+	size_t length = 0, elements = 0;
+	if (token < 0x40 || token >= 0xe0)
+		return position;
+	if (token < 0x80) { // record
+		uint32_t index = token - 0x40;
+		if (index >= structureCount)
+			return nullptr;
+		elements = structures[index * (1 + fieldCount)];
+	} else if (token < 0x90)
+		elements = (token & 0xf) * 2;
+	else if (token < 0xa0)
+		elements = token & 0xf;
+	else if (token < 0xc0)
+		length = token & 0x1f;
+	else {
+		const uint8_t* data = position;
+		switch (token) {
+			case 0xc0: case 0xc2: case 0xc3: return position;
+			case 0xc4: case 0xd9: if (data + 1 > end) return nullptr; length = data[0]; position += 1; break;
+			case 0xc5: case 0xda: if (data + 2 > end) return nullptr; length = read16(data); position += 2; break;
+			case 0xc6: case 0xdb: if (data + 4 > end) return nullptr; length = read32(data); position += 4; break;
+			case 0xc7: if (data + 2 > end) return nullptr; length = data[0] + 1; position += 1; break;
+			case 0xc8: if (data + 3 > end) return nullptr; length = read16(data) + 1; position += 2; break;
+			case 0xc9: if (data + 5 > end) return nullptr; length = (size_t) read32(data) + 1; position += 4; break;
+			case 0xca: length = 4; break;
+			case 0xcb: length = 8; break;
+			case 0xcc: case 0xd0: length = 1; break;
+			case 0xcd: case 0xd1: length = 2; break;
+			case 0xce: case 0xd2: length = 4; break;
+			case 0xcf: case 0xd3: length = 8; break;
+			case 0xd4:
+				// msgpackr defines unshared record structures inline, with an extension of type 0x72
+				if (data + 1 > end || data[0] == 0x72) return nullptr;
+				length = 2; break;
+			case 0xd5: length = 3; break;
+			case 0xd6: length = 5; break;
+			case 0xd7: length = 9; break;
+			case 0xd8: length = 17; break;
+			case 0xdc: if (data + 2 > end) return nullptr; elements = read16(data); position += 2; break;
+			case 0xdd: if (data + 4 > end) return nullptr; elements = read32(data); position += 4; break;
+			case 0xde: if (data + 2 > end) return nullptr; elements = read16(data) * 2; position += 2; break;
+			case 0xdf: if (data + 4 > end) return nullptr; elements = (size_t) read32(data) * 2; position += 4; break;
+			default: return nullptr;
+		}
+	}
+	if (length > (size_t) (end - position))
+		return nullptr;
+	position += length;
+	while (elements-- > 0) {
+		position = skipValue(position, end, depth + 1);
+		if (!position)
+			return nullptr;
+	}
+	return position;
+}
+
+bool projection_t::copyToHeap(const uint8_t* start, size_t length, uint32_t* heapStart) {
+	if (length > heapSize - heapUsed)
+		return false;
+	memcpy(heap + heapUsed, start, length);
+	*heapStart = heapUsed;
+	heapUsed += length;
+	return true;
+}
+
+// decodes a value into the column of the field, returning false if the heap is full
+bool projection_t::projectField(uint32_t field, uint32_t row, const uint8_t* position, const uint8_t* end) {
+	size_t index = (size_t) field * rowCapacity + row;
+	uint8_t token = *position;
+	double number;
+	if (token == 0xc0) {
+		types[index] = VALUE_NULL;
+	} else if (readMsgpackNumber(position, end, &number)) {
+		types[index] = (token == 0xc2 || token == 0xc3) ? VALUE_BOOLEAN : VALUE_NUMBER;
+		values[index] = number;
+	} else {
+		uint32_t heapStart;
+		if ((token >= 0xa0 && token < 0xc0) || (token >= 0xd9 && token <= 0xdb)) {
+			size_t headerSize = token < 0xc0 ? 1 : token == 0xd9 ? 2 : token == 0xda ? 3 : 5;
+			const uint8_t* next = skipValue(position, end, 0);
+			if (!next)
+				return false;
+			if (!copyToHeap(position + headerSize, next - position - headerSize, &heapStart))
+				return false;
+			types[index] = VALUE_STRING;
+			lengths[index] = next - position - headerSize;
+		} else {
+			const uint8_t* next = skipValue(position, end, 0);
+			if (!next || !copyToHeap(position, next - position, &heapStart))
+				return false;
+			types[index] = VALUE_MSGPACK;
+			lengths[index] = next - position;
+		}
+		values[index] = heapStart;
+	}
+	return true;
+}
+
+/*
+Projects the fields of a value into a row of the columns (and copies the key, if keys are included), returning false
+(and leaving the heap as it was) if the heap doesn't have room for the row.
+*/
+bool projection_t::projectRow(uint32_t row, MDB_val* key, MDB_val& data) {
+	uint32_t rowHeapStart = heapUsed;
+	if (key) {
+		if (!copyToHeap((uint8_t*) key->mv_data, key->mv_size, keyStarts + row))
+			return false;
+		keyLengths[row] = key->mv_size;
+	}
+	const uint8_t* position = (const uint8_t*) data.mv_data;
+	const uint8_t* end = position + data.mv_size;
+	uint32_t index = data.mv_size > 0 ? *position - 0x40 : structureCount;
+	bool projected = false;
+	if (index < structureCount) {
+		int32_t* structure = structures + index * (1 + fieldCount);
+		int32_t length = structure[0];
+		int32_t* positions = structure + 1;
+		int32_t last = -1;
+		for (uint32_t f = 0; f < fieldCount; f++) {
+			if (positions[f] > last)
+				last = positions[f];
+		}
+		position++;
+		projected = true;
+		for (int32_t i = 0; i <= last && i < length && projected; i++) {
+			for (uint32_t f = 0; f < fieldCount; f++) {
+				if (positions[f] == i && !projectField(f, row, position, end)) {
+					projected = false;
+					break;
+				}
+			}
+			if (projected && i < last && !(position = skipValue(position, end, 0)))
+				projected = false;
+		}
+		for (uint32_t f = 0; f < fieldCount && projected; f++) {
+			if (positions[f] < 0 || positions[f] >= length)
+				types[(size_t) f * rowCapacity + row] = VALUE_UNDEFINED;
+		}
+	}
+	if (!projected) {
+		// decode the whole value in JS
+		heapUsed = rowHeapStart + (key ? key->mv_size : 0);
+		uint32_t heapStart;
+		if (!copyToHeap((const uint8_t*) data.mv_data, data.mv_size, &heapStart)) {
+			heapUsed = rowHeapStart;
+			return false;
+		}
+		for (uint32_t f = 0; f < fieldCount; f++) {
+			size_t index = (size_t) f * rowCapacity + row;
+			types[index] = VALUE_WHOLE;
+			values[index] = heapStart;
+			lengths[index] = data.mv_size;
+		}
+	}
+	return true;
+}
+
+/*
+Projects the values of a list of keys, each written as a uint32 length followed by the key (padded to 4 bytes), starting
+from the key at the given offset. Keys that aren't found have undefined fields.
+*/
+NAPI_FUNCTION(projectValues) {
+	ARGS(6)
+	GET_INT64_ARG(0);
+	DbiWrap* dw = (DbiWrap*) i64;
+	int64_t txnAddress, keys, workspace, heap;
+	napi_get_value_int64(env, args[1], &txnAddress);
+	napi_get_value_int64(env, args[2], &keys);
+	uint32_t keyOffset;
+	GET_UINT32_ARG(keyOffset, 3);
+	napi_get_value_int64(env, args[4], &workspace);
+	napi_get_value_int64(env, args[5], &heap);
+	if (dw->ew->env == nullptr)
+		RETURN_INT32(-MDB_BAD_TXN);
+	projection_t projection((char*) workspace, (char*) heap);
+	uint32_t rowLimit = projection.header[1];
+	MDB_txn* txn = dw->ew->getReadTxn(txnAddress);
+	uint32_t* key = (uint32_t*) ((char*) keys + keyOffset);
+	uint32_t rows = 0;
+	projection.header[5] = PROJECTION_FILLED;
+	while (rows < rowLimit) {
+		MDB_val keyVal, data;
+		keyVal.mv_size = key[0];
+		if (keyVal.mv_size == 0xffffffff) { // end of the keys
+			projection.header[5] = PROJECTION_DONE;
+			break;
+		}
+		keyVal.mv_data = key + 1;
+		int rc = mdb_get(txn, dw->dbi, &keyVal, &data);
+		if (rc == MDB_NOTFOUND) {
+			for (uint32_t f = 0; f < projection.fieldCount; f++)
+				projection.types[(size_t) f * projection.rowCapacity + rows] = VALUE_UNDEFINED;
+		} else if (rc) {
+			RETURN_INT32(rc > 0 ? -rc : rc);
+		} else {
+			if (!getVersionAndUncompress(data, dw, txn))
+				RETURN_INT32(-MDB_CORRUPTED);
+			if (!projection.projectRow(rows, nullptr, data)) {
+				projection.header[5] = PROJECTION_HEAP_FULL;
+				break;
+			}
+		}
+		rows++;
+		key += 1 + ((keyVal.mv_size + 3) >> 2);
+	}
+	projection.header[6] = projection.heapUsed;
+	projection.header[7] = (char*) key - (char*) keys; // where to continue from
+	RETURN_INT32(rows);
+}
+
+void setupExportProjection(Napi::Env env, Object exports) {
+	EXPORT_NAPI_FUNCTION("projectValues", projectValues);
+}
@@ -12,12 +12,184 @@ TxnTracked::~TxnTracked() {
 	this->txn = nullptr;
 }
 
+/*
+Read txns are pooled per thread (and environment), so that TxnWraps that begin at the same snapshot (txn id) share a
+single read txn (and reader slot), reference counted. When a pooled txn is no longer referenced, it is reset and kept
+to be renewed for a later snapshot, rather than releasing and reacquiring its reader slot. Read txns are not shared
+across threads, since LMDB read txns may be modified on access (stale dbi handles and the page cache).
+*/
+typedef struct {
+	MDB_env* env;
+	MDB_txn* txn;
+	mdb_size_t txnId;
+	int refCount; // 0 if it is idle (reset and available to renew)
+	bool isReset; // reset by the one TxnWrap using it, waiting to be renewed
+} pooled_read_txn_t;
+static thread_local std::vector<pooled_read_txn_t>* readTxnPool;
+const int MAX_IDLE_READ_TXNS = 2;
+
+static pooled_read_txn_t* findPooledReadTxn(MDB_txn* txn) {
+	if (readTxnPool) {
+		for (auto& entry : *readTxnPool) {
+			if (entry.txn == txn)
+				return &entry;
+		}
+	}
+	return nullptr;
+}
+
+// take an idle txn from the pool, or begin a new one, returns the entry index (or -1 with rc set)
+static int takeIdleReadTxn(MDB_env* env, int flags, bool renew, int* rc) {
+	for (size_t i = 0; i < readTxnPool->size(); i++) {
+		pooled_read_txn_t& entry = (*readTxnPool)[i];
+		if (entry.env == env && entry.refCount == 0) {
+			if (!renew || (*rc = mdb_txn_renew(entry.txn)) == 0) {
+				entry.refCount = 1;
+				entry.isReset = !renew;
+				entry.txnId = mdb_txn_id(entry.txn);
+				return i;
+			}
+			mdb_txn_abort(entry.txn);
+			readTxnPool->erase(readTxnPool->begin() + i);
+			break;
+		}
+	}
+	MDB_txn* txn;
+	*rc = mdb_txn_begin(env, nullptr, flags, &txn);
+	if (*rc)
+		return -1;
+	if (!renew)
+		mdb_txn_reset(txn);
+	readTxnPool->push_back({ env, txn, mdb_txn_id(txn), 1, !renew });
+	return readTxnPool->size() - 1;
+}
+
+int acquireReadTxn(MDB_env* env, int flags, MDB_txn** txn) {
+	if (!readTxnPool)
+		readTxnPool = new std::vector<pooled_read_txn_t>();
+	MDB_envinfo stat;
+	mdb_env_info(env, &stat);
+	for (auto& entry : *readTxnPool) {
+		// a txn that was reset by its TxnWrap belongs to it until it renews it, so it can't be shared
+		if (entry.env != env || entry.refCount == 0 || entry.isReset)
+			continue;
+		if (entry.txnId == stat.me_last_txnid) {
+			// there is already a read txn at the latest snapshot, share it
+			entry.refCount++;
+			*txn = entry.txn;
+			return 0;
+		}
+	}
+	int rc;
+	int index = takeIdleReadTxn(env, flags, true, &rc);
+	*txn = index >= 0 ? (*readTxnPool)[index].txn : nullptr;
+	return rc;
+}
+
+void releaseReadTxn(MDB_txn* txn, bool keepIdle) {
+	pooled_read_txn_t* entry = findPooledReadTxn(txn);
+	if (!entry) {
+		mdb_txn_abort(txn);
+		return;
+	}
+	if (--entry->refCount > 0)
+		return;
+	if (keepIdle) {
+		int idle = 0;
+		for (auto& other : *readTxnPool) {
+			if (other.env == entry->env && other.refCount == 0)
+				idle++;
+		}
+		if (idle <= MAX_IDLE_READ_TXNS) {
+			mdb_txn_reset(txn);
+			entry->isReset = false;
+			return;
+		}
+	}
+	mdb_txn_abort(txn);
+	readTxnPool->erase(readTxnPool->begin() + (entry - readTxnPool->data()));
+}
+
+// reset a read txn, replacing it with the txn that should be used in its place (if it was shared, the others still
+// need it). If there is no slot for a separate txn, it is left shared (and active) and MDB_READERS_FULL is returned,
+// renewReadTxn will then try again to move it to its own txn
+int resetReadTxn(MDB_txn** txn) {
+	pooled_read_txn_t* entry = findPooledReadTxn(*txn);
+	if (!entry || entry->refCount == 1) {
+		mdb_txn_reset(*txn);
+		if (entry)
+			entry->isReset = true;
+		return 0;
+	}
+	int rc;
+	int index = takeIdleReadTxn(entry->env, MDB_RDONLY, false, &rc);
+	if (index < 0)
+		return rc;
+	// the vector may have been reallocated, so find the shared entry again
+	findPooledReadTxn(*txn)->refCount--;
+	*txn = (*readTxnPool)[index].txn;
+	return 0;
+}
+
+// renew a read txn that was reset with resetReadTxn, updating its entry so it can be shared again
+int renewReadTxn(MDB_txn** txn) {
+	pooled_read_txn_t* entry = findPooledReadTxn(*txn);
+	if (entry && !entry->isReset) {
+		// it is still active, since there was no slot to move it to when it was reset
+		if (entry->refCount > 1) {
+			int rc;
+			int index = takeIdleReadTxn(entry->env, MDB_RDONLY, true, &rc);
+			if (index < 0)
+				return rc;
+			findPooledReadTxn(*txn)->refCount--;
+			*txn = (*readTxnPool)[index].txn;
+			return 0;
+		}
+		mdb_txn_reset(*txn); // the others have released it, so we can renew it ourselves
+	}
+	int rc = mdb_txn_renew(*txn);
+	if (rc == 0 && entry) {
+		entry->isReset = false;
+		entry->txnId = mdb_txn_id(*txn);
+	}
+	return rc;
+}
+
+// abort idle pooled read txns, to free their reader slots
+void releaseIdleReadTxns(MDB_env* env) {
+	if (!readTxnPool)
+		return;
+	for (auto entry = readTxnPool->begin(); entry != readTxnPool->end();) {
+		if (entry->env == env && entry->refCount == 0) {
+			mdb_txn_abort(entry->txn);
+			entry = readTxnPool->erase(entry);
+		} else
+			entry++;
+	}
+}
+
+void getReadTxnPoolStats(MDB_env* env, int* active, int* shared, int* idle) {
+	*active = *shared = *idle = 0;
+	if (!readTxnPool)
+		return;
+	for (auto& entry : *readTxnPool) {
+		if (entry.env != env)
+			continue;
+		if (entry.refCount > 0) {
+			(*active)++;
+			*shared += entry.refCount - 1;
+		} else
+			(*idle)++;
+	}
+}
+
 TxnWrap::TxnWrap(const Napi::CallbackInfo& info) : ObjectWrap<TxnWrap>(info) {
 	EnvWrap *ew;
 	napi_unwrap(info.Env(), info[0], (void**)&ew);
 	if (ew->env == nullptr) throwError(info.Env(), "Attempt to start a transaction on a database environment that is closed");
 	int flags = 0;
 	TxnWrap *parentTw;
+	isReset = false;
 	if (info[1].IsBoolean() && ew->writeWorker) { // this is from a transaction callback
 		txn = ew->writeWorker->AcquireTxn(&flags);
 		parentTw = nullptr;
@@ -64,12 +236,12 @@ TxnWrap::TxnWrap(const Napi::CallbackInfo& info) : ObjectWrap<TxnWrap>(info) {
 			}
 			parentTxn = nullptr;
 		}
-		int rc = mdb_txn_begin(ew->env, parentTxn, flags, &txn);
+		int rc = (flags & MDB_RDONLY) ? acquireReadTxn(ew->env, flags, &txn) : mdb_txn_begin(ew->env, parentTxn, flags, &txn);
 		if (rc == MDB_READERS_FULL) { // try again after reader check, in case a dead process frees a slot
 			int dead;
 			mdb_reader_check(ew->env, &dead);
 			ew->consolidateTxns();
-			rc = mdb_txn_begin(ew->env, parentTxn, flags, &txn);
+			rc = (flags & MDB_RDONLY) ? acquireReadTxn(ew->env, flags, &txn) : mdb_txn_begin(ew->env, parentTxn, flags, &txn);
 		}
 		if (rc != 0) {
 			txn = nullptr;
@@ -84,7 +256,9 @@ TxnWrap::TxnWrap(const Napi::CallbackInfo& info) : ObjectWrap<TxnWrap>(info) {
 	}
 	else {
 		ew->readTxns.push_back(this);
+		ew->currentReadTw = this;
 		ew->currentReadTxn = txn;
+		ew->readTxnRenewed = true; // acquired read txns are active
 	}
 	this->parentTw = parentTw;
 	this->flags = flags;
@@ -96,7 +270,10 @@ TxnWrap::TxnWrap(const Napi::CallbackInfo& info) : ObjectWrap<TxnWrap>(info) {
 TxnWrap::~TxnWrap() {
 	// Close if not closed already
 	if (this->txn) {
-		mdb_txn_abort(txn);
+		if (flags & MDB_RDONLY)
+			releaseReadTxn(txn, true);
+		else
+			mdb_txn_abort(txn);
 		this->removeFromEnvWrap();
 	}
 }
@@ -107,6 +284,10 @@ void TxnWrap::removeFromEnvWrap() {
 			this->ew->currentWriteTxn = this->parentTw;
 		}
 		else {
+			if (this->ew->currentReadTw == this) {
+				this->ew->currentReadTw = nullptr;
+				this->ew->readTxnRenewed = false; // it may be reset (or aborted) in the pool now
+			}
 			auto it = std::find(ew->readTxns.begin(), ew->readTxns.end(), this);
 			if (it != ew->readTxns.end()) {
 				ew->readTxns.erase(it);
@@ -115,6 +296,7 @@ void TxnWrap::removeFromEnvWrap() {
 		this->ew = nullptr;
 	}
 	this->txn = nullptr;
+	this->isReset = false;
 }
 
 Value TxnWrap::commit(const Napi::CallbackInfo& info) {
@@ -122,7 +304,11 @@ Value TxnWrap::commit(const Napi::CallbackInfo& info) {
 	if (!this->txn) {
 		return throwError(info.Env(), "The transaction is already closed.");
 	}
-	int rc = mdb_txn_commit(this->txn);
+	int rc = 0;
+	if (flags & MDB_RDONLY)
+		releaseReadTxn(this->txn, true);
+	else
+		rc = mdb_txn_commit(this->txn);
 	this->removeFromEnvWrap();
 	if (rc != 0) {
 		return throwLmdbError(info.Env(), rc);
@@ -135,7 +321,10 @@ Value TxnWrap::abort(const Napi::CallbackInfo& info) {
 		return throwError(info.Env(), "The transaction is already closed.");
 	}
 
-	mdb_txn_abort(this->txn);
+	if (flags & MDB_RDONLY)
+		releaseReadTxn(this->txn, true);
+	else
+		mdb_txn_abort(this->txn);
 	this->removeFromEnvWrap();
 	return info.Env().Undefined();
 }
@@ -156,15 +345,31 @@ void resetTxnFFI(double twPointer) {
 }
 
 void TxnWrap::reset() {
-	ew->readTxnRenewed = false;
-	mdb_txn_reset(txn);
+	// if it is still shared (no reader slot to move it to), it stays on the old snapshot until renewTxn can move it
+	resetReadTxn(&txn);
+	isReset = true;
+	if (ew->currentReadTw == this) {
+		ew->currentReadTxn = txn;
+		ew->readTxnRenewed = false;
+	}
+}
+int TxnWrap::renewTxn() {
+	int rc = renewReadTxn(&txn);
+	if (rc)
+		return rc;
+	isReset = false;
+	if (ew->currentReadTw == this) {
+		ew->currentReadTxn = txn;
+		ew->readTxnRenewed = true;
+	}
+	return 0;
 }
 Value TxnWrap::renew(const Napi::CallbackInfo& info) {
 	if (!this->txn || !this->ew->env) {
 		return throwError(info.Env(), "The transaction is already closed.");
 	}
 
-	int rc = mdb_txn_renew(this->txn);
+	int rc = this->isReset ? this->renewTxn() : EINVAL; // like mdb_txn_renew, it must have been reset
 	if (rc != 0) {
 		return throwLmdbError(info.Env(), rc);
 	}
@@ -29,6 +29,19 @@ void getByBinaryV8(const FunctionCallbackInfo<v8::Value>& info) {
 		info[2]->Uint32Value(context).FromJust(),
 		info[3]->NumberValue(context).FromJust())));
 }
+int32_t getByUint32Fast(Local<v8::Object> instance, double dwPointer, uint32_t key, uint32_t ifNotTxnId, int64_t txnAddress) {
+	DbiWrap* dw = (DbiWrap*) (size_t) dwPointer;
+	return dw->doGetByUint32(key, ifNotTxnId, txnAddress);
+}
+void getByUint32V8(const FunctionCallbackInfo<v8::Value>& info) {
+	Isolate* isolate = Isolate::GetCurrent();
+	auto context = isolate->GetCurrentContext();
+	DbiWrap* dw = (DbiWrap*) (size_t) info[0]->NumberValue(context).FromJust();
+	info.GetReturnValue().Set(v8::Number::New(isolate, dw->doGetByUint32(
+		info[1]->Uint32Value(context).FromJust(),
+		info[2]->Uint32Value(context).FromJust(),
+		info[3]->NumberValue(context).FromJust())));
+}
 int32_t positionFast(Local<v8::Object> instance, double cwPointer, uint32_t flags, uint32_t offset, uint32_t keySize, uint64_t endKeyAddress) {
 	CursorWrap* cw = (CursorWrap*) (size_t) cwPointer;
 	DbiWrap* dw = cw->dw;
@@ -148,6 +161,7 @@ NAPI_FUNCTION(enableDirectV8) {
 	napi_get_value_bool(env, args[1], &useFastApi);
 	if (useFastApi) {
 		EXPORT_FAST("getByBinary", getByBinaryV8, getByBinaryFast);
+		EXPORT_FAST("getByUint32", getByUint32V8, getByUint32Fast);
 		EXPORT_FAST("position", positionV8, positionFast);
 		EXPORT_FAST("iterate", iterateV8, iterateFast);
 		EXPORT_FAST("write", writeV8, writeFast);
@@ -156,6 +170,7 @@ NAPI_FUNCTION(enableDirectV8) {
 	} else {
 	#endif
 	EXPORT_FUNCTION("getByBinary", getByBinaryV8);
+	EXPORT_FUNCTION("getByUint32", getByUint32V8);
 	EXPORT_FUNCTION("position", positionV8);
 	EXPORT_FUNCTION("iterate", iterateV8);
 	EXPORT_FUNCTION("write", writeV8);
@@ -0,0 +1,194 @@
+#include "lmdb-js.h"
+#include <cstdlib>
+
+using namespace Napi;
+
+/*
+The shared value cache holds decompressed values, so a compressed value that is read frequently is decompressed once
+for the process, instead of once for each thread (each thread has its own decompression target). It is shared by all
+the threads, and entries are keyed by env, dbi, and key, and tagged with the txn id of the leaf page the value was read
+from. A value can only be changed by writing a new leaf page (with a newer txn id), so an entry is valid for any read
+txn that finds the value on a page with the same txn id. The cache is divided into stripes, each with its own lock and
+LRU list, to limit contention.
+*/
+const int VALUE_CACHE_STRIPES = 64;
+
+typedef struct value_cache_entry_t {
+	value_cache_entry_t* newer;
+	value_cache_entry_t* older;
+	uint64_t hash;
+	MDB_env* env;
+	MDB_dbi dbi;
+	mdb_size_t txnId;
+	uint32_t keySize;
+	uint32_t valueSize;
+	char data[1]; // key followed by the value
+} value_cache_entry_t;
+
+typedef struct {
+	pthread_mutex_t lock;
+	std::unordered_map<uint64_t, value_cache_entry_t*> entries;
+	value_cache_entry_t* newest;
+	value_cache_entry_t* oldest;
+	size_t size;
+} value_cache_stripe_t;
+
+static value_cache_stripe_t* stripes;
+static std::atomic<size_t> stripeCapacity; // 0 if the cache is disabled
+static std::atomic<uint64_t> cacheHits;
+static std::atomic<uint64_t> cacheMisses;
+
+static uint64_t hashKey(MDB_env* env, MDB_dbi dbi, MDB_val* key) {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ull ^ (uint64_t) (size_t) env ^ ((uint64_t) dbi << 32);
+	uint8_t* bytes = (uint8_t*) key->mv_data;
+	for (size_t i = 0; i < key->mv_size; i++)
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	return hash;
+}
+
+static void unlinkEntry(value_cache_stripe_t* stripe, value_cache_entry_t* entry) {
+	if (entry->newer)
+		entry->newer->older = entry->older;
+	else
+		stripe->newest = entry->older;
+	if (entry->older)
+		entry->older->newer = entry->newer;
+	else
+		stripe->oldest = entry->newer;
+}
+
+static void linkNewest(value_cache_stripe_t* stripe, value_cache_entry_t* entry) {
+	entry->newer = nullptr;
+	entry->older = stripe->newest;
+	if (stripe->newest)
+		stripe->newest->newer = entry;
+	else
+		stripe->oldest = entry;
+	stripe->newest = entry;
+}
+
+static void removeEntry(value_cache_stripe_t* stripe, value_cache_entry_t* entry) {
+	unlinkEntry(stripe, entry);
+	stripe->entries.erase(entry->hash);
+	stripe->size -= sizeof(value_cache_entry_t) + entry->keySize + entry->valueSize;
+	free(entry);
+}
+
+static bool matches(value_cache_entry_t* entry, MDB_env* env, MDB_dbi dbi, MDB_val* key) {
+	return entry->env == env && entry->dbi == dbi && entry->keySize == key->mv_size &&
+		!memcmp(entry->data, key->mv_data, key->mv_size);
+}
+
+bool getCachedValue(DbiWrap* dw, MDB_val* key, mdb_size_t txnId, MDB_val& data) {
+	if (!stripeCapacity.load(std::memory_order_acquire))
+		return false;
+	uint64_t hash = hashKey(dw->env, dw->dbi, key);
+	value_cache_stripe_t* stripe = stripes + (hash % VALUE_CACHE_STRIPES);
+	bool found = false;
+	pthread_mutex_lock(&stripe->lock);
+	auto position = stripe->entries.find(hash);
+	if (position != stripe->entries.end()) {
+		value_cache_entry_t* entry = position->second;
+		Compression* compression = dw->compression;
+		if (entry->txnId == txnId && matches(entry, dw->env, dw->dbi, key) &&
+				entry->valueSize <= compression->decompressSize) {
+			// copy to the decompression target while we hold the lock, since the entry can be evicted by other threads
+			memcpy(compression->decompressTarget, entry->data + entry->keySize, entry->valueSize);
+			data.mv_data = compression->decompressTarget;
+			data.mv_size = entry->valueSize;
+			unlinkEntry(stripe, entry);
+			linkNewest(stripe, entry);
+			found = true;
+		}
+	}
+	pthread_mutex_unlock(&stripe->lock);
+	(found ? cacheHits : cacheMisses).fetch_add(1, std::memory_order_relaxed);
+	return found;
+}
+
+void cacheValue(DbiWrap* dw, MDB_val* key, mdb_size_t txnId, MDB_val& data) {
+	size_t capacity = stripeCapacity.load(std::memory_order_acquire);
+	size_t entrySize = sizeof(value_cache_entry_t) + key->mv_size + data.mv_size;
+	if (entrySize > capacity / 4) // don't let one large value flush the stripe
+		return;
+	value_cache_entry_t* entry = (value_cache_entry_t*) malloc(entrySize);
+	if (!entry)
+		return;
+	uint64_t hash = hashKey(dw->env, dw->dbi, key);
+	entry->hash = hash;
+	entry->env = dw->env;
+	entry->dbi = dw->dbi;
+	entry->txnId = txnId;
+	entry->keySize = key->mv_size;
+	entry->valueSize = data.mv_size;
+	memcpy(entry->data, key->mv_data, key->mv_size);
+	memcpy(entry->data + key->mv_size, data.mv_data, data.mv_size);
+	value_cache_stripe_t* stripe = stripes + (hash % VALUE_CACHE_STRIPES);
+	pthread_mutex_lock(&stripe->lock);
+	auto position = stripe->entries.find(hash);
+	if (position != stripe->entries.end())
+		removeEntry(stripe, position->second); // an older version (or a hash collision), replace it
+	while (stripe->oldest && stripe->size + entrySize > capacity)
+		removeEntry(stripe, stripe->oldest);
+	stripe->entries[hash] = entry;
+	linkNewest(stripe, entry);
+	stripe->size += entrySize;
+	pthread_mutex_unlock(&stripe->lock);
+}
+
+// remove the entries of an env that is being closed (another env could be opened with the same address)
+void clearCachedValues(MDB_env* env) {
+	if (!stripes)
+		return;
+	for (int i = 0; i < VALUE_CACHE_STRIPES; i++) {
+		value_cache_stripe_t* stripe = stripes + i;
+		pthread_mutex_lock(&stripe->lock);
+		for (value_cache_entry_t* entry = stripe->oldest; entry;) {
+			value_cache_entry_t* next = entry->newer;
+			if (entry->env == env)
+				removeEntry(stripe, entry);
+			entry = next;
+		}
+		pthread_mutex_unlock(&stripe->lock);
+	}
+}
+
+void getValueCacheStats(uint64_t* hits, uint64_t* misses, size_t* size) {
+	*hits = cacheHits.load(std::memory_order_relaxed);
+	*misses = cacheMisses.load(std::memory_order_relaxed);
+	*size = 0;
+	if (!stripes)
+		return;
+	for (int i = 0; i < VALUE_CACHE_STRIPES; i++) {
+		pthread_mutex_lock(&stripes[i].lock);
+		*size += stripes[i].size;
+		pthread_mutex_unlock(&stripes[i].lock);
+	}
+}
+
+// the cache is shared by the whole process, so the size can only be increased, by the largest size requested by an env
+NAPI_FUNCTION(setValueCacheSize) {
+	ARGS(1)
+	double size;
+	napi_get_value_double(env, args[0], &size);
+	pthread_mutex_lock(EnvWrap::envTracking->envsLock);
+	if (!stripes) {
+		stripes = new value_cache_stripe_t[VALUE_CACHE_STRIPES];
+		for (int i = 0; i < VALUE_CACHE_STRIPES; i++) {
+			pthread_mutex_init(&stripes[i].lock, nullptr);
+			stripes[i].newest = nullptr;
+			stripes[i].oldest = nullptr;
+			stripes[i].size = 0;
+		}
+	}
+	size_t capacity = (size_t) (size / VALUE_CACHE_STRIPES);
+	if (capacity > stripeCapacity.load())
+		stripeCapacity.store(capacity);
+	pthread_mutex_unlock(EnvWrap::envTracking->envsLock);
+	RETURN_UNDEFINED;
+}
+
+void setupExportValueCache(Napi::Env env, Object exports) {
+	EXPORT_NAPI_FUNCTION("setValueCacheSize", setValueCacheSize);
+}
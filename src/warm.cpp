@@ -0,0 +1,217 @@
+#include "lmdb-js.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace Napi;
+
+/*
+Warming reads the pages of the B-trees of every database in a background thread, after the database is opened, so
+the first reads don't have to wait for the pages to be faulted in. It reads the top levels of branch pages of every
+database (the pages that nearly every lookup goes through), and all of the branch and leaf pages of the databases that
+are named as hot. It can be throttled to a number of bytes per second, reports its progress, and is cancelled when the
+env is closed.
+*/
+#ifdef MDB_TXN_WARM
+const int WARM_PROGRESS_INTERVAL = 100; // ms between progress callbacks
+const int WARM_THROTTLE_SLICE = 50; // ms, the longest we sleep before checking for cancellation
+const int WARM_CANCELLED = -1;
+
+typedef struct {
+	double pages;
+	double bytes;
+} warm_progress_t;
+
+static void sleepMs(int ms) {
+#ifdef _WIN32
+	Sleep(ms);
+#else
+	usleep(ms * 1000);
+#endif
+}
+
+class WarmWorker : public AsyncWorker {
+  public:
+	// the env object is the receiver, so the EnvWrap is kept alive until the worker is done
+	WarmWorker(EnvWrap* ew, const Object& envObject, unsigned int levels, bool allHot, std::vector<std::string>& hotDbs,
+			bool rootHot, double bytesPerSecond, napi_threadsafe_function progress, const Function& callback)
+	 : AsyncWorker(envObject, callback), ew(ew), levels(levels), allHot(allHot), hotDbs(hotDbs), rootHot(rootHot),
+		bytesPerSecond(bytesPerSecond), progress(progress), pages(0), pageSize(0), cancelled(false),
+		warmCancels(ew->warmCancels) {
+	}
+	void Execute() {
+		// the env may have been closed while this was queued, closeEnv only waits for the warmers that have started
+		pthread_mutex_lock(ew->warmLock);
+		if (ew->warmCancelled) {
+			pthread_mutex_unlock(ew->warmLock);
+			cancelled = true;
+			if (progress)
+				napi_release_threadsafe_function(progress, napi_tsfn_release);
+			return;
+		}
+		ew->warmers++;
+		pthread_mutex_unlock(ew->warmLock);
+		MDB_stat stat;
+		mdb_env_stat(ew->env, &stat);
+		pageSize = stat.ms_psize;
+		start = lastProgress = get_time64();
+		MDB_txn* txn;
+		int rc = mdb_txn_begin(ew->env, nullptr, MDB_RDONLY, &txn);
+		if (rc == 0) {
+			rc = mdb_txn_warm(txn, levels, isHot, onPage, this);
+			mdb_txn_abort(txn);
+		}
+		if (rc == WARM_CANCELLED) {
+			cancelled = true;
+			rc = 0;
+		}
+		if (progress) {
+			sendProgress();
+			napi_release_threadsafe_function(progress, napi_tsfn_release);
+		}
+		ew->warmers--;
+		if (rc)
+			SetError(mdb_strerror(rc));
+	}
+	static int isHot(const MDB_val* name, void* ctx) {
+		WarmWorker* worker = (WarmWorker*) ctx;
+		if (worker->isCancelled()) {
+			worker->cancelled = true;
+			return -1;
+		}
+		if (worker->allHot)
+			return 1;
+		if (!name)
+			return worker->rootHot;
+		size_t size = name->mv_size;
+		if (size > 0 && ((char*) name->mv_data)[size - 1] == 0)
+			size--; // names are stored with their null terminator
+		for (auto& hotDb : worker->hotDbs) {
+			if (hotDb.size() == size && !memcmp(hotDb.data(), name->mv_data, size))
+				return 1;
+		}
+		return 0;
+	}
+	static int onPage(mdb_size_t pages, void* ctx) {
+		WarmWorker* worker = (WarmWorker*) ctx;
+		worker->pages = pages;
+		if (pages & 15)
+			return 0;
+		if (worker->isCancelled())
+			return WARM_CANCELLED;
+		uint64_t now = get_time64();
+		if (worker->bytesPerSecond > 0) {
+			// stay within the I/O budget, sleeping in slices so we can be cancelled
+			double ahead = (double) pages * worker->pageSize / worker->bytesPerSecond -
+				(double) (now - worker->start) / TICKS_PER_SECOND;
+			while (ahead > 0) {
+				int ms = ahead * 1000 > WARM_THROTTLE_SLICE ? WARM_THROTTLE_SLICE : (int) (ahead * 1000) + 1;
+				sleepMs(ms);
+				if (worker->isCancelled())
+					return WARM_CANCELLED;
+				ahead -= ms / 1000.0;
+			}
+			now = get_time64();
+		}
+		if (worker->progress && (now - worker->lastProgress) * 1000 / TICKS_PER_SECOND >= WARM_PROGRESS_INTERVAL) {
+			worker->lastProgress = now;
+			worker->sendProgress();
+		}
+		return 0;
+	}
+	// cancelled by closing the env, or by cancelWarm since this worker was started
+	bool isCancelled() {
+		return ew->warmCancelled || ew->warmCancels != warmCancels;
+	}
+	void sendProgress() {
+		warm_progress_t* data = new warm_progress_t;
+		data->pages = (double) pages;
+		data->bytes = (double) pages * pageSize;
+		if (napi_call_threadsafe_function(progress, data, napi_tsfn_nonblocking) != napi_ok)
+			delete data;
+	}
+	void OnOK() {
+		napi_value result, args[4];
+		napi_get_null(Env(), &args[0]);
+		napi_create_double(Env(), (double) pages, &args[1]);
+		napi_create_double(Env(), (double) pages * pageSize, &args[2]);
+		napi_get_boolean(Env(), cancelled, &args[3]);
+		// we use direct napi call here because node-addon-api interface with throw a fatal error if a worker thread is terminating
+		napi_call_function(Env(), Env().Undefined(), Callback().Value(), 4, args, &result);
+	}
+	void OnError(const Error& e) {
+		napi_value result;
+		napi_value arg = e.Value();
+		napi_call_function(Env(), Env().Undefined(), Callback().Value(), 1, &arg, &result);
+	}
+
+  private:
+	EnvWrap* ew;
+	unsigned int levels;
+	bool allHot;
+	std::vector<std::string> hotDbs;
+	bool rootHot;
+	double bytesPerSecond;
+	napi_threadsafe_function progress;
+	mdb_size_t pages;
+	unsigned int pageSize;
+	uint64_t start;
+	uint64_t lastProgress;
+	bool cancelled;
+	uint32_t warmCancels; // the env's cancelWarm count when this was started
+};
+
+static void warm_progress(napi_env env, napi_value js_callback, void* context, void* data) {
+	warm_progress_t* progress = (warm_progress_t*) data;
+	if (js_callback) {
+		napi_value result, args[2];
+		napi_create_double(env, progress->pages, &args[0]);
+		napi_create_double(env, progress->bytes, &args[1]);
+		napi_value undefined;
+		napi_get_undefined(env, &undefined);
+		napi_call_function(env, undefined, js_callback, 2, args, &result);
+	}
+	delete progress;
+}
+#endif
+
+Napi::Value EnvWrap::warm(const CallbackInfo& info) {
+	if (!this->env) {
+		return throwError(info.Env(), "The environment is already closed.");
+	}
+#ifdef MDB_TXN_WARM
+	unsigned int levels = info[0].As<Number>().Uint32Value();
+	bool allHot = info[1].IsBoolean() && info[1].As<Boolean>().Value();
+	bool rootHot = false;
+	std::vector<std::string> hotDbs;
+	if (info[1].IsArray()) {
+		Array names = info[1].As<Array>();
+		for (uint32_t i = 0; i < names.Length(); i++) {
+			Napi::Value name = names.Get(i);
+			if (name.IsString())
+				hotDbs.push_back(name.As<String>().Utf8Value());
+			else if (name.IsNull())
+				rootHot = true;
+		}
+	}
+	double bytesPerSecond = info[2].As<Number>().DoubleValue();
+	napi_threadsafe_function progress = nullptr;
+	if (info[3].IsFunction()) {
+		napi_value resource_name;
+		napi_create_string_latin1(info.Env(), "warm", NAPI_AUTO_LENGTH, &resource_name);
+		napi_create_threadsafe_function(info.Env(), info[3], nullptr, resource_name, 0, 1, nullptr, nullptr, nullptr,
+			warm_progress, &progress);
+	}
+	WarmWorker* worker = new WarmWorker(this, info.This().As<Object>(), levels, allHot, hotDbs, rootHot, bytesPerSecond, progress,
+		info[4].As<Function>());
+	worker->Queue();
+	return info.Env().Undefined();
+#else
+	return throwError(info.Env(), "Warming is not supported with data format version 1");
+#endif
+}
+
+Napi::Value EnvWrap::cancelWarm(const CallbackInfo& info) {
+	warmCancels++; // cancels the workers that are running, but not ones started later
+	return info.Env().Undefined();
+}
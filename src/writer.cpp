@@ -10,10 +10,25 @@
 8 bytes (optional): conditional version
 8 bytes (optional): version
 inline value?
+
+With UINT32_KEY, the key-size is replaced with the (4-byte) uint32 key itself, followed directly by the value-size.
+
+A batch without results (NO_RESULTS_BATCH) has:
+0-3 flags
+4-7 unused
+8 bytes: pointer to the instructions of the batch (terminated by a zero flag word)
+8 bytes: pointer to the batch status: the txn id (a double), the number of failed operations, the number of
+operations (written by JS), and then a bitmap of the failed operations
+The instructions in the batch are not updated with their results. The flags don't include CONDITIONAL, so the batch
+is always decoded, and if it is in a block whose condition failed, all of its operations are marked as failed.
+
+A put with VALUE_OPERATION has a value that starts with a value_operation_t header, followed by the operand(s),
+and the value to write is computed from the existing value in the write thread.
 */
 #include "lmdb-js.h"
 #include <atomic>
 #include <ctime>
+#include <cmath>
 #ifndef _WIN32
 #include <unistd.h>
 #endif
@@ -31,6 +46,8 @@ const int POINTER_NEXT = 3;
 const int USER_CALLBACK = 8;
 const int USER_CALLBACK_STRICT_ORDER = 0x100000;
 const int DROP_DB = 12;
+const int BATCH_WITHOUT_RESULTS = 0x800000; // distinguishes a batch from the (START_BLOCK) opcode it shares
+const int NO_RESULTS_BATCH = BATCH_WITHOUT_RESULTS | START_BLOCK;
 const int HAS_KEY = 4;
 const int HAS_VALUE = 2;
 const int CONDITIONAL = 8;
@@ -40,6 +57,14 @@ const int CONDITIONAL_ALLOW_NOTFOUND = 0x1000;
 const int SET_VERSION = 0x200;
 //const int HAS_INLINE_VALUE = 0x400;
 const int COMPRESSIBLE = 0x100000;
+const int VALUE_OPERATION = 0x200000;
+const int UINT32_KEY = 0x400000;
+// value operations:
+const uint8_t ADD_VALUE = 1;
+const uint8_t COMPARE_AND_SWAP = 2;
+const uint8_t APPEND_VALUE = 3;
+const uint8_t MERGE_VALUE = 4;
+const uint32_t EXPECT_NOT_EXISTS = 0xffffffff;
 const int DELETE_DATABASE = 0x400;
 const int TXN_HAD_ERROR = 0x40000000;
 const int TXN_DELIMITER = 0x8000000;
@@ -139,7 +164,12 @@ int WriteWorker::WaitForCallbacks(MDB_txn** txn, bool allowCommit, uint32_t* tar
 	}
 	if (interruptionStatus == INTERRUPT_BATCH) { // interrupted by JS code that wants to run a synchronous transaction
 		interruptionStatus = RESTART_WORKER_TXN;
+		mdb_size_t txnId = mdb_txn_id(*txn);
 		rc = mdb_txn_commit(*txn);
+		if (rc == 0)
+			envForTxn->publishTouched(txnId);
+		else
+			envForTxn->touchedDbis.clear();
 #ifdef MDB_EMPTY_TXN
 		if (rc == MDB_EMPTY_TXN)
 			rc = 0;
@@ -163,13 +193,329 @@ int WriteWorker::WaitForCallbacks(MDB_txn** txn, bool allowCommit, uint32_t* tar
 		interruptionStatus = 0;
 	return 0;
 }
-int WriteWorker::DoWrites(MDB_txn* txn, EnvWrap* envForTxn, uint32_t* instruction, WriteWorker* worker) {
+static uint64_t readBigEndian(const uint8_t* data, int size) {
+	uint64_t value = 0;
+	for (int i = 0; i < size; i++)
+		value = (value << 8) | data[i];
+	return value;
+}
+static void writeBigEndian(uint64_t value, uint8_t* target, int size) {
+	for (int i = size - 1; i >= 0; i--) {
+		target[i] = (uint8_t) value;
+		value >>= 8;
+	}
+}
+// read a number that is a complete msgpack value
+bool readMsgpackNumber(const uint8_t* data, size_t size, double* number) {
+	if (size == 0)
+		return false;
+	uint8_t type = data[0];
+	if (type < 0x80 || type >= 0xe0) {
+		*number = type < 0x80 ? type : (int8_t) type; // positive or negative fixint
+		return size == 1;
+	}
+	int numberSize;
+	switch (type) {
+		case 0xcc: case 0xd0: numberSize = 1; break;
+		case 0xcd: case 0xd1: numberSize = 2; break;
+		case 0xce: case 0xd2: case 0xca: numberSize = 4; break;
+		case 0xcf: case 0xd3: case 0xcb: numberSize = 8; break;
+		default: return false;
+	}
+	if (size != (size_t) numberSize + 1)
+		return false;
+	uint64_t bits = readBigEndian(data + 1, numberSize);
+	switch (type) {
+		case 0xcc: case 0xcd: case 0xce: *number = (double) bits; break;
+		case 0xcf: *number = (double) bits; break;
+		case 0xd0: *number = (int8_t) bits; break;
+		case 0xd1: *number = (int16_t) bits; break;
+		case 0xd2: *number = (int32_t) bits; break;
+		case 0xd3: *number = (double) (int64_t) bits; break;
+		case 0xca: {
+			uint32_t floatBits = (uint32_t) bits;
+			float floatValue;
+			memcpy(&floatValue, &floatBits, 4);
+			*number = floatValue;
+			break;
+		}
+		case 0xcb: memcpy(number, &bits, 8); break;
+	}
+	return true;
+}
+// write a number as msgpack, returning the size (at most 9 bytes)
+size_t writeMsgpackNumber(double number, uint8_t* target) {
+	if (number >= -2147483648.0 && number <= 4294967295.0 && number == std::floor(number)) {
+		int64_t integer = (int64_t) number;
+		if (integer >= 0) {
+			if (integer < 0x80) {
+				target[0] = (uint8_t) integer;
+				return 1;
+			}
+			int size = integer < 0x100 ? 1 : integer < 0x10000 ? 2 : 4;
+			target[0] = size == 1 ? 0xcc : size == 2 ? 0xcd : 0xce;
+			writeBigEndian(integer, target + 1, size);
+			return size + 1;
+		}
+		// -6 to -1 would start with a byte that is used as the compression indicator, so they use int8 instead of fixint
+		if (integer >= -32 && integer < -6) {
+			target[0] = (uint8_t) (int8_t) integer;
+			return 1;
+		}
+		int size = integer >= -128 ? 1 : integer >= -32768 ? 2 : 4;
+		target[0] = size == 1 ? 0xd0 : size == 2 ? 0xd1 : 0xd2;
+		writeBigEndian((uint64_t) integer, target + 1, size);
+		return size + 1;
+	}
+	uint64_t bits;
+	memcpy(&bits, &number, 8);
+	target[0] = 0xcb;
+	writeBigEndian(bits, target + 1, 8);
+	return 9;
+}
+
+/*
+Computes the new value from the existing value with the value operation, and writes it. Returns MDB_NOTFOUND
+if the existing value does not meet the operation's condition.
+*/
+static int putValueOperation(MDB_txn* txn, MDB_dbi dbi, MDB_val* key, MDB_val* value, bool hasVersions, double version) {
+	value_operation_t operation;
+	if (value->mv_size < sizeof(operation))
+		return EINVAL;
+	memcpy(&operation, value->mv_data, sizeof(operation));
+	char* operand = (char*) value->mv_data + sizeof(operation);
+	size_t operandSize = value->mv_size - sizeof(operation);
+	Compression* compression = (Compression*) (size_t) operation.compression;
+	MDB_val existing;
+	int rc = mdb_get(txn, dbi, key, &existing);
+	if (rc && rc != MDB_NOTFOUND)
+		return rc;
+	bool exists = !rc;
+	if (exists && hasVersions) {
+		if (existing.mv_size < 8)
+			return MDB_NOTFOUND;
+		existing.mv_data = (char*) existing.mv_data + 8;
+		existing.mv_size -= 8;
+	}
+	// compressed values can't be decompressed in the write thread
+	bool existingCompressed = exists && compression && existing.mv_size > 0 && ((uint8_t*) existing.mv_data)[0] >= 250;
+	MDB_val result;
+	uint8_t numberBytes[9];
+	char* appended = nullptr;
+	void* merged = nullptr;
+	argtokey_callback_t freeCompressed = nullptr;
+	switch (operation.operation) {
+		case ADD_VALUE: {
+			double number = 0, delta;
+			if (operandSize != 8)
+				return EINVAL;
+			memcpy(&delta, operand, 8);
+			if (exists && (existingCompressed || !readMsgpackNumber((uint8_t*) existing.mv_data, existing.mv_size, &number)))
+				return MDB_NOTFOUND; // existing value is not a number
+			result.mv_size = writeMsgpackNumber(number + delta, numberBytes);
+			result.mv_data = numberBytes;
+			break;
+		}
+		case COMPARE_AND_SWAP: {
+			uint32_t expectedSize = operation.argument;
+			if (expectedSize == EXPECT_NOT_EXISTS) {
+				if (exists)
+					return MDB_NOTFOUND;
+				expectedSize = 0;
+			} else {
+				if (expectedSize > operandSize)
+					return EINVAL;
+				if (!exists)
+					return MDB_NOTFOUND;
+				// compare in the stored form, compressing the expected value if it would have been compressed
+				MDB_val expected;
+				expected.mv_data = operand;
+				expected.mv_size = expectedSize;
+				argtokey_callback_t freeExpected = compression ? compression->compress(&expected, nullptr) : nullptr;
+				bool matches = expected.mv_size == existing.mv_size && !memcmp(expected.mv_data, existing.mv_data, existing.mv_size);
+				if (freeExpected)
+					freeExpected(expected);
+				if (!matches)
+					return MDB_NOTFOUND;
+			}
+			result.mv_data = operand + expectedSize;
+			result.mv_size = operandSize - expectedSize;
+			if (compression)
+				freeCompressed = compression->compress(&result, nullptr);
+			break;
+		}
+		case APPEND_VALUE:
+			if (existingCompressed)
+				return MDB_NOTFOUND;
+			if (exists) {
+				// the existing value starts with an uncompressed first byte, so the result doesn't need compression
+				// (and can be appended to again)
+				result.mv_size = existing.mv_size + operandSize;
+				result.mv_data = appended = new char[result.mv_size];
+				memcpy(appended, existing.mv_data, existing.mv_size);
+				memcpy(appended + existing.mv_size, operand, operandSize);
+			} else {
+				result.mv_data = operand;
+				result.mv_size = operandSize;
+				if (compression && operandSize > 0 && ((uint8_t*) operand)[0] >= 250)
+					freeCompressed = compression->compress(&result, nullptr);
+			}
+			break;
+		case MERGE_VALUE: {
+			if (existingCompressed)
+				return MDB_NOTFOUND;
+			MDB_val mergeOperand;
+			mergeOperand.mv_data = operand;
+			mergeOperand.mv_size = operandSize;
+			rc = mergeValue(operation.mergeOperator, exists ? &existing : nullptr, &mergeOperand, operation.argument, &result);
+			if (rc)
+				return rc;
+			merged = result.mv_data;
+			if (compression && result.mv_size > 0 && ((uint8_t*) result.mv_data)[0] >= 250)
+				freeCompressed = compression->compress(&result, nullptr);
+			break;
+		}
+		default:
+			return EINVAL;
+	}
+	if (hasVersions)
+		rc = putWithVersion(txn, dbi, key, &result, 0, version);
+	else
+		rc = mdb_put(txn, dbi, key, &result, 0);
+	if (freeCompressed)
+		freeCompressed(result);
+	if (appended)
+		delete[] appended;
+	if (merged)
+		free(merged);
+	return rc;
+}
+
+/*
+Appends a record of a write to the change log database, in the same txn, so only committed writes are logged. Log keys
+are the txn id (8 bytes) and the sequence of the change in the txn (4 bytes), big-endian, and values are a
+change_record_t followed by the version (if there is one), the key, and the value (if values are logged).
+*/
+typedef struct {
+	uint8_t operation; // the instruction opcode: PUT, DEL, DEL_VALUE, or DROP_DB
+	uint8_t flags;
+	uint16_t reserved;
+	uint32_t dbi;
+	uint32_t keySize;
+} change_record_t;
+const uint8_t CHANGE_HAS_VERSION = 1;
+const uint8_t CHANGE_HAS_VALUE = 2;
+
+// finds the sequence after the last logged change of the txn in logKeyBytes
+static int nextChangeSequence(MDB_txn* txn, MDB_dbi dbi, uint8_t* logKeyBytes, uint32_t* sequence) {
+	MDB_cursor* cursor;
+	int rc = mdb_cursor_open(txn, dbi, &cursor);
+	if (rc)
+		return rc;
+	uint8_t lastKeyBytes[12];
+	memcpy(lastKeyBytes, logKeyBytes, 8);
+	memset(lastKeyBytes + 8, 0xff, 4);
+	MDB_val key, data;
+	key.mv_size = 12;
+	key.mv_data = lastKeyBytes;
+	// position at (or after) the last possible key of this txn, and step back to its last change
+	rc = mdb_cursor_get(cursor, &key, &data, MDB_SET_RANGE);
+	if (rc == 0 && (key.mv_size != 12 || memcmp(key.mv_data, lastKeyBytes, 12)))
+		rc = mdb_cursor_get(cursor, &key, &data, MDB_PREV);
+	else if (rc == MDB_NOTFOUND)
+		rc = mdb_cursor_get(cursor, &key, &data, MDB_LAST);
+	*sequence = 0;
+	if (rc == 0 && key.mv_size == 12 && !memcmp(key.mv_data, logKeyBytes, 8)) {
+		uint8_t* bytes = (uint8_t*) key.mv_data;
+		uint32_t last = ((uint32_t) bytes[8] << 24) | ((uint32_t) bytes[9] << 16) | ((uint32_t) bytes[10] << 8) | bytes[11];
+		if (last == 0xffffffff)
+			rc = MDB_KEYEXIST; // no sequences left
+		else
+			*sequence = last + 1;
+	} else if (rc == MDB_NOTFOUND)
+		rc = 0;
+	mdb_cursor_close(cursor);
+	return rc;
+}
+
+static int logChange(MDB_txn* txn, EnvWrap* envForTxn, MDB_dbi dbi, uint32_t flags, MDB_val* key, MDB_val* value, double version) {
+	mdb_size_t txnId = mdb_txn_id(txn);
+	if (txnId != envForTxn->changeLogTxnId) {
+		envForTxn->changeLogTxnId = txnId;
+		envForTxn->changeLogSequence = 0;
+	}
+	uint8_t logKeyBytes[12];
+	for (int i = 0; i < 8; i++)
+		logKeyBytes[i] = (uint8_t) (txnId >> ((7 - i) * 8));
+	uint32_t sequence = envForTxn->changeLogSequence++;
+	for (int i = 0; i < 4; i++)
+		logKeyBytes[8 + i] = (uint8_t) (sequence >> ((3 - i) * 8));
+	change_record_t record;
+	record.operation = flags & 0xf;
+	record.flags = 0;
+	record.reserved = 0;
+	record.dbi = dbi;
+	record.keySize = record.operation == DROP_DB ? 0 : key->mv_size;
+	MDB_val logValue;
+	logValue.mv_size = 0;
+	if (envForTxn->changeLogValues && (record.operation == PUT || record.operation == DEL_VALUE)) {
+		if (flags & VALUE_OPERATION) {
+			// the value is computed in the write thread, so read back what was written
+			if (mdb_get(txn, dbi, key, &logValue) == 0 && (flags & SET_VERSION) && logValue.mv_size >= 8) {
+				logValue.mv_data = (char*) logValue.mv_data + 8;
+				logValue.mv_size -= 8;
+			}
+		} else if (!(flags & COMPRESSIBLE)) // compressed values are not logged, since we can't decompress them here
+			logValue = *value;
+		if (!(flags & COMPRESSIBLE) || (flags & VALUE_OPERATION))
+			record.flags |= CHANGE_HAS_VALUE;
+	}
+	if (flags & SET_VERSION)
+		record.flags |= CHANGE_HAS_VERSION;
+	size_t size = sizeof(record) + ((flags & SET_VERSION) ? 8 : 0) + record.keySize + logValue.mv_size;
+	MDB_val logKey, logEntry;
+	logKey.mv_size = 12;
+	logKey.mv_data = logKeyBytes;
+	logEntry.mv_size = size;
+	// reserve the space in the log entry and write the record directly into it
+	int rc = mdb_put(txn, envForTxn->changeLogDbi, &logKey, &logEntry, MDB_APPEND | MDB_RESERVE);
+	if (rc == MDB_KEYEXIST) {
+		// the log already has an entry at or after this key (this txn id was also used by another writer), so take
+		// the next free sequence of this txn, and fail rather than overwrite a logged change
+		rc = nextChangeSequence(txn, envForTxn->changeLogDbi, logKeyBytes, &sequence);
+		if (rc)
+			return rc;
+		envForTxn->changeLogSequence = sequence + 1;
+		for (int i = 0; i < 4; i++)
+			logKeyBytes[8 + i] = (uint8_t) (sequence >> ((3 - i) * 8));
+		rc = mdb_put(txn, envForTxn->changeLogDbi, &logKey, &logEntry, MDB_NOOVERWRITE | MDB_RESERVE);
+	}
+	if (rc)
+		return rc;
+	char* target = (char*) logEntry.mv_data;
+	memcpy(target, &record, sizeof(record));
+	target += sizeof(record);
+	if (flags & SET_VERSION) {
+		memcpy(target, &version, 8);
+		target += 8;
+	}
+	if (record.keySize) {
+		memcpy(target, key->mv_data, record.keySize);
+		target += record.keySize;
+	}
+	if (logValue.mv_size)
+		memcpy(target, logValue.mv_data, logValue.mv_size);
+	return 0;
+}
+
+int WriteWorker::DoWrites(MDB_txn* txn, EnvWrap* envForTxn, uint32_t* instruction, WriteWorker* worker, uint32_t* batchStatus) {
 	MDB_val key, value;
 	int rc = 0;
 	int conditionDepth = 0;
 	int validatedDepth = 0;
 	double conditionalVersion, setVersion = 0;
-	bool overlappedWord = !!worker;
+	bool overlappedWord = !!worker && !batchStatus;
+	uint32_t batchIndex = 0;
 	uint32_t* start;
     do {
 next_inst:	start = instruction++;
@@ -186,9 +532,16 @@ next_inst:	start = instruction++;
 		if (flags & HAS_KEY) {
 			// a key based instruction, get the key
 			dbi = (MDB_dbi) *instruction++;
-			key.mv_size = *instruction++;
-			key.mv_data = instruction;
-			instruction = (uint32_t*) (((size_t) instruction + key.mv_size + 16) & (~7));
+			if (flags & UINT32_KEY) {
+				// inline uint32 key
+				key.mv_size = 4;
+				key.mv_data = instruction;
+				instruction += 2;
+			} else {
+				key.mv_size = *instruction++;
+				key.mv_data = instruction;
+				instruction = (uint32_t*) (((size_t) instruction + key.mv_size + 16) & (~7));
+			}
 			if (flags & HAS_VALUE) {
 				if (flags & COMPRESSIBLE) {
 					int64_t status = -1;
@@ -251,8 +604,10 @@ next_inst:	start = instruction++;
 			instruction++;
 		//fprintf(stderr, "instr flags %p %p %u\n", start, flags, conditionDepth);
 		if (validated || !(flags & CONDITIONAL)) {
-			switch (flags & 0xf) {
+			switch (flags & (BATCH_WITHOUT_RESULTS | 0xf)) {
 			case NO_INSTRUCTION_YET:
+				if (batchStatus)
+					return 0; // end of the batch, all the instructions of a batch are written before it is submitted
 				instruction -= 2; // reset back to the previous flag as the current instruction
 				rc = 0;
 				// in windows InterlockedCompareExchange might be faster
@@ -281,19 +636,29 @@ next_inst:	start = instruction++;
 				}
 				goto next_inst;
 			case PUT:
-				if (flags & SET_VERSION)
+				if (flags & VALUE_OPERATION)
+					rc = putValueOperation(txn, dbi, &key, &value, flags & SET_VERSION, setVersion);
+				else if (flags & SET_VERSION)
 					rc = putWithVersion(txn, dbi, &key, &value, flags & (MDB_NOOVERWRITE | MDB_NODUPDATA | MDB_APPEND | MDB_APPENDDUP), setVersion);
 				else
 					rc = mdb_put(txn, dbi, &key, &value, flags & (MDB_NOOVERWRITE | MDB_NODUPDATA | MDB_APPEND | MDB_APPENDDUP));
+				if (!rc)
+					addToKeyFilters(envForTxn->env, dbi, &key);
+				if (!rc && envForTxn->changeLogDbi && dbi != envForTxn->changeLogDbi)
+					rc = logChange(txn, envForTxn, dbi, flags, &key, &value, setVersion);
 				if (flags & COMPRESSIBLE)
 					delete value.mv_data;
 				//fprintf(stdout, "put %u \n", key.mv_size);
 				break;
 			case DEL:
 				rc = mdb_del(txn, dbi, &key, nullptr);
+				if (!rc && envForTxn->changeLogDbi && dbi != envForTxn->changeLogDbi)
+					rc = logChange(txn, envForTxn, dbi, flags, &key, nullptr, setVersion);
 				break;
 			case DEL_VALUE:
 				rc = mdb_del(txn, dbi, &key, &value);
+				if (!rc && envForTxn->changeLogDbi && dbi != envForTxn->changeLogDbi)
+					rc = logChange(txn, envForTxn, dbi, flags, &key, &value, setVersion);
 				if (flags & COMPRESSIBLE)
 					delete value.mv_data;
 				break;
@@ -316,10 +681,32 @@ next_inst:	start = instruction++;
 				break;
 			case DROP_DB:
 				rc = mdb_drop(txn, dbi, (flags & DELETE_DATABASE) ? 1 : 0);
+				if (!rc && (flags & DELETE_DATABASE))
+					dropKeyFilter(envForTxn->env, dbi);
+				if (!rc && envForTxn->changeLogDbi && dbi != envForTxn->changeLogDbi)
+					rc = logChange(txn, envForTxn, dbi, flags, &key, nullptr, setVersion);
 				break;
 			case POINTER_NEXT:
 				instruction = (uint32_t*)(size_t) * ((double*)instruction);
 				goto next_inst;
+			case NO_RESULTS_BATCH: {
+				uint32_t* batchInstructions = (uint32_t*)(size_t) * ((double*)instruction);
+				uint32_t* status = (uint32_t*)(size_t) * ((double*)(instruction + 2));
+				instruction += 4;
+				if (validated)
+					rc = DoWrites(txn, envForTxn, batchInstructions, worker, status);
+				else {
+					// in a block whose condition failed, so none of the operations are done
+					uint32_t count = status[3];
+					status[2] = count;
+					for (uint32_t i = 0; i < count; i++)
+						status[4 + (i >> 5)] |= 1 << (i & 31);
+					rc = 0;
+				}
+				double txnId = (double) mdb_txn_id(txn);
+				memcpy(status, &txnId, 8);
+				break;
+			}
 			default:
 				fprintf(stderr, "Unknown flags %u %p\n", flags, start);
 				fprintf(stderr, "flags after message %u\n", *start);
@@ -336,17 +723,27 @@ next_inst:	start = instruction++;
 				}
 				flags = FINISHED_OPERATION | FAILED_CONDITION;
 			}
-			else
+			else {
+				if ((flags & 0xf) >= DROP_DB) // a successful write (drop, delete, or put)
+					envForTxn->touchDbi(dbi);
 				flags = FINISHED_OPERATION;
+			}
 		} else
 			flags = FINISHED_OPERATION | FAILED_CONDITION;
 		//fprintf(stderr, "finished flag %p\n", flags);
-		if (overlappedWord) {
+		if (batchStatus) {
+			// only record failures in a batch without results
+			if (flags & FAILED_CONDITION) {
+				batchStatus[2]++;
+				batchStatus[4 + (batchIndex >> 5)] |= 1 << (batchIndex & 31);
+			}
+			batchIndex++;
+		} else if (overlappedWord) {
 			std::atomic_fetch_or((std::atomic<uint32_t>*) start, flags);
 			overlappedWord = false;
 		} else
 			*start |= flags;
-	} while(worker); // keep iterating in async/multiple-instruction mode, just one instruction in sync mode
+	} while(worker || batchStatus); // keep iterating in async/multiple-instruction mode, just one instruction in sync mode
 	return rc;
 }
 
@@ -397,8 +794,12 @@ void WriteWorker::Write() {
 		resultCode = rc;
 		return;
 	}
+	uint64_t start = envForTxn->histograms ? get_time64() : 0;
+	uint64_t timeWaiting = envForTxn->timeTxnWaiting;
 	rc = DoWrites(txn, envForTxn, instructions, this);
-	uint32_t txnId = (uint32_t) mdb_txn_id(txn);
+	if (envForTxn->histograms)
+		recordLatency(envForTxn->histogram(WRITE_BATCH_LATENCY), get_time64() - start - (envForTxn->timeTxnWaiting - timeWaiting));
+	mdb_size_t txnId = mdb_txn_id(txn);
 	progressStatus = 1;
 	#ifdef MDB_OVERLAPPINGSYNC
 	if (envForTxn->jsFlags & MDB_OVERLAPPINGSYNC) {
@@ -408,9 +809,13 @@ void WriteWorker::Write() {
 	if (rc || resultCode)
 		mdb_txn_abort(txn);
 	else
-		rc = mdb_txn_commit(txn);
+		rc = commitWithMetrics(txn, envForTxn->histograms);
 	#ifdef MDB_OVERLAPPINGSYNC
 	#endif
+	if (rc == 0 && !resultCode)
+		envForTxn->publishTouched(txnId);
+	else
+		envForTxn->touchedDbis.clear(); // nothing was committed (including an empty txn)
 #ifdef MDB_EMPTY_TXN
 	if (rc == MDB_EMPTY_TXN)
 		rc = 0;
@@ -425,7 +830,7 @@ void WriteWorker::Write() {
 			resultCode = rc ? rc : resultCode;
 		return;
 	}
-	*(instructions - 1) = txnId;
+	*(instructions - 1) = (uint32_t) txnId;
 	std::atomic_fetch_or((std::atomic<uint32_t>*) instructions, (uint32_t) TXN_COMMITTED);
 }
 
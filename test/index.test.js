@@ -22,7 +22,7 @@ import {
 	levelup,
 	open,
 } from '../node-index.js';
-import { openAsClass } from '../open.js';
+import { openAsClass, restoreIncrementalBackup } from '../open.js';
 import { RangeIterable } from '../util/RangeIterable.js';
 const require = createRequire(import.meta.url);
 // we don't always test CJS because it messes up debugging in webstorm (and I am not about to give the awesomeness
@@ -72,6 +72,14 @@ describe('lmdb-js', function () {
 			encryptionKey: 'Use this key to encrypt the data',
 		}),
 	);
+	describe(
+		'Basic use with chacha20 encryption',
+		basicTests({
+			compression: false,
+			encryptionKey: 'Use this key to encrypt the data',
+			encryptionCipher: 'chacha20',
+		}),
+	);
 	//describe('Check encrypted data', basicTests({ compression: false, encryptionKey: 'Use this key to encrypt the data', checkLast: true }));
 	describe('Basic use with JSON', basicTests({ encoding: 'json' }));
 	describe(
@@ -253,6 +261,64 @@ describe('lmdb-js', function () {
 					await db.put('key1', 'Hello world!');
 					expect(db.getStats().timeDuringTxns).gte(0);
 				});
+			it('read txn kept across turns sees later commits', async function () {
+				await db.put('key1', 'before');
+				should.equal(db.get('key1'), 'before');
+				await delay(1);
+				should.equal(db.get('key1'), 'before');
+				await delay(1);
+				db.putSync('key1', 'after');
+				should.equal(db.get('key1'), 'after');
+				await delay(1);
+				db.transactionSync(() => db.put('key1', 'last'));
+				should.equal(db.get('key1'), 'last');
+			});
+			it('wait for commit', async function () {
+				let waiting = db.waitForCommit();
+				await db.put('key1', 'changed');
+				let { txnId, touched, commits } = await waiting;
+				txnId.should.be.gt(0);
+				touched.should.equal(true);
+				let result = await db.waitForCommit(undefined, 10);
+				result.touched.should.equal(false);
+			});
+			it('pooled read txns and reader slot stats', async function () {
+				await db.put('key1', 'Hello world!');
+				let txn = db.useReadTransaction();
+				db.get('key1');
+				let stats = db.getStats();
+				stats.pooledReadTxns.should.be.gte(1);
+				stats.activeReaders.should.be.gte(1);
+				stats.usedReaders.should.be.gte(stats.activeReaders);
+				stats.usedReaders.should.be.lte(stats.maxReaders);
+				txn.done();
+			});
+			it('free run stats', async function () {
+				for (let i = 0; i < 20; i++)
+					await db.put('for-free-runs-' + i, 'x'.repeat(5000));
+				for (let i = 0; i < 20; i += 2)
+					await db.remove('for-free-runs-' + i);
+				let free = db.getStats({ freeRuns: true }).free;
+				free.freePages.should.be.greaterThan(0);
+				free.largestFreeRun.should.be.gte(1);
+				free.freeRuns.should.be.lte(free.freePages);
+				free.freeRunLengths.reduce((sum, runs) => sum + runs, 0).should.equal(free.freeRuns);
+				should.equal(db.getStats().free.freeRuns, undefined);
+			});
+			if (options.trackMetrics)
+				it('latency histograms', async function () {
+					await db.put('key1', 'Hello world!');
+					for (let i = 0; i < 100; i++) db.get('key1');
+					for (let { key } of db.getRange({ limit: 10 })) {}
+					let histograms = db.getLatencyHistograms();
+					histograms.get.count.should.be.gte(100);
+					histograms.get.p99.should.be.gte(histograms.get.p50);
+					histograms.get.max.should.be.gte(histograms.get.p999);
+					histograms.cursorPosition.count.should.be.gte(1);
+					histograms.commit.count.should.be.gte(1);
+					db.getLatencyHistograms(true);
+					db.getLatencyHistograms().get.count.should.equal(0);
+				});
 			it('string', async function () {
 				await db.put('key1', 'Hello world!');
 				let data = db.get('key1');
@@ -1299,6 +1365,101 @@ describe('lmdb-js', function () {
 					await db.clearAsync();
 				}
 			});
+			it('value operations', async function () {
+				if (!options.encoding) {
+					// adding is only supported with msgpack
+					await db.remove('counter');
+					(await db.addToValue('counter', 5)).should.equal(true);
+					(await db.addToValue('counter', -8)).should.equal(true);
+					db.get('counter').should.equal(-3);
+					(await db.addToValue('counter', 0.5)).should.equal(true);
+					db.get('counter').should.equal(-2.5);
+					await db.put('not-a-counter', 'text');
+					(await db.addToValue('not-a-counter', 1)).should.equal(false);
+					db.transactionSync(() => {
+						db.addToValue('counter', 2.5);
+					});
+					db.get('counter').should.equal(0);
+				}
+				(await db.compareAndSwap('cas', undefined, { state: 1 })).should.equal(true);
+				(await db.compareAndSwap('cas', { state: 2 }, { state: 3 })).should.equal(false);
+				(await db.compareAndSwap('cas', { state: 1 }, { state: 2 })).should.equal(true);
+				db.get('cas').state.should.equal(2);
+				let binaryDb = db.openDB({ name: 'append-values', encoding: 'binary' });
+				await binaryDb.put('log', Buffer.from('first'));
+				(await binaryDb.appendToValue('log', Buffer.from(',second'))).should.equal(true);
+				binaryDb.get('log').toString().should.equal('first,second');
+			});
+			it('merge operators', async function () {
+				if (options.encoding) return; // merging is only supported with msgpack
+				await db.merge('merge-add', 'add', 3);
+				await db.merge('merge-add', 'add', 4);
+				db.get('merge-add').should.equal(7);
+				await db.merge('merge-max', 'max', 3);
+				await db.merge('merge-max', 'max', 1);
+				db.get('merge-max').should.equal(3);
+				await db.merge('merge-set', 'union', ['c', 'a']);
+				await db.merge('merge-set', 'union', ['b', 'c', 2]);
+				db.get('merge-set').should.deep.equal([2, 'a', 'b', 'c']);
+				for (let i = 0; i < 5; i++)
+					await db.merge('merge-list', 'append', i, { maxLength: 3 });
+				db.get('merge-list').should.deep.equal([2, 3, 4]);
+				await db.put('merge-text', 'text');
+				(await db.merge('merge-text', 'max', 1)).should.equal(false);
+				(() => db.merge('merge-add', 'unknown', 1)).should.throw();
+			});
+			it('batch without results', async function () {
+				let result = await db.batchWithoutResults(() => {
+					// enough writes to span multiple instruction buffers
+					for (let i = 0; i < 2000; i++) db.put('no-result-' + i, { i });
+					db.put('no-result-0', 'conditional', 1, 12345); // version doesn't match, so this fails
+				});
+				result.txnId.should.be.greaterThan(0);
+				result.failedCount.should.equal(1);
+				(result.failed[2000 >> 5] & (1 << (2000 & 31))).should.not.equal(0);
+				(result.failed[0] & 1).should.equal(0);
+				db.get('no-result-0').i.should.equal(0);
+				db.get('no-result-1999').i.should.equal(1999);
+						// blocks can't be written into a batch without results
+				(() => db.batchWithoutResults(() => db.ifVersion('no-result-0', 1, () => {}))).should.throw();
+				// a batch in a block whose condition fails is skipped, without disturbing the writes after it
+				let skipped;
+				await db.ifVersion('no-result-0', 12345, () => {
+					skipped = db.batchWithoutResults(() => {
+						db.put('no-result-0', 'skipped');
+						db.put('no-result-skipped', 'skipped');
+					});
+				});
+				result = await skipped;
+				result.failedCount.should.equal(2);
+				result.failed[0].should.equal(3);
+				should.equal(db.get('no-result-skipped'), undefined);
+				await db.put('after-skipped-batch', 'written');
+				db.get('after-skipped-batch').should.equal('written');
+			});
+			it('bulk load unsorted entries', async function () {
+				let bulkDb = db.openDB({
+					name: 'bulk-load',
+					create: true,
+				});
+				await bulkDb.clearAsync();
+				await bulkDb.put('aaa', 'existing');
+				let keys = [];
+				for (let i = 0; i < 1000; i++) keys.push(i);
+				keys.sort(() => Math.random() - 0.5);
+				let entries = keys.map((i) => ({ key: 'key-' + i.toString().padStart(4, '0'), value: { i } }));
+				entries.push({ key: 'key-0001', value: { i: 'last wins' } });
+				// use small runs and memory limit to sort in many runs and spill to temporary files
+				let count = await bulkDb.bulkLoad(entries, { runSize: 0x4000, memoryLimit: 0x4000 });
+				count.should.equal(1001);
+				let all = Array.from(bulkDb.getRange());
+				all.length.should.equal(1001);
+				all[0].value.should.equal('existing');
+				all[1].key.should.equal('key-0000');
+				all[2].value.i.should.equal('last wins');
+				all[1000].key.should.equal('key-0999');
+				for (let i = 1; i < all.length; i++) (all[i - 1].key < all[i].key).should.equal(true);
+			});
 			it('clearAsync with different keys', async function () {
 				let binDb = db.openDB({
 					name: 'binary-key',
@@ -1483,6 +1644,62 @@ describe('lmdb-js', function () {
 					await backupDb.close();
 				}
 			});
+			it('can make and restore incremental backups', async function () {
+				if (options.encryptionKey)
+					// pages are copied from the memory map, which is remapped in chunks with encryption
+					return;
+				for (let file of ['/backup-0.inc', '/backup-1.inc', '/restored.mdb', '/restored.mdb-lock']) {
+					try {
+						fs.unlinkSync(testDirPath + file);
+					} catch (error) {}
+				}
+				for (let i = 0; i < 100; i++) {
+					db.put('for-incremental-' + i, 'first ' + i);
+				}
+				await db.flushed;
+				let full = await db.backupIncremental(testDirPath + '/backup-0.inc');
+				for (let i = 0; i < 10; i++) {
+					await db.put('for-incremental-' + i, 'second ' + i);
+				}
+				let incremental = await db.backupIncremental(testDirPath + '/backup-1.inc', full.txnId);
+				incremental.txnId.should.be.greaterThan(full.txnId);
+				incremental.pages.should.be.lessThan(full.pages);
+				restoreIncrementalBackup(testDirPath + '/restored.mdb', [
+					testDirPath + '/backup-0.inc',
+					testDirPath + '/backup-1.inc',
+				]).should.equal(incremental.txnId);
+				// the incremental backup can only be applied to the txn it was made from
+				should.throw(() => restoreIncrementalBackup(testDirPath + '/restored.mdb', testDirPath + '/backup-1.inc'));
+				let restoredDb = open(testDirPath + '/restored.mdb', options);
+				try {
+					restoredDb.get('for-incremental-5').should.equal('second 5');
+					restoredDb.get('for-incremental-50').should.equal('first 50');
+				} finally {
+					await restoredDb.close();
+				}
+			});
+			it('can compact online', async function () {
+				if (options.encryptionKey)
+					return;
+				let compactDb = db.openDB('for-compaction');
+				let value = 'x'.repeat(10000);
+				for (let i = 0; i < 200; i++) {
+					compactDb.put(i, value);
+				}
+				await compactDb.committed;
+				for (let i = 0; i < 190; i++) {
+					compactDb.remove(i);
+				}
+				compactDb.put('last', value);
+				await compactDb.committed;
+				let before = db.getStats().lastPageNumber;
+				let result = await db.compact({ maxPages: 100, delay: 0 });
+				result.steps.should.be.greaterThan(0);
+				db.getStats().lastPageNumber.should.be.lessThan(before);
+				compactDb.get(195).should.equal(value);
+				compactDb.get('last').should.equal(value);
+				should.equal(compactDb.get(5), undefined);
+			});
 			after(function (done) {
 				db.get('key1');
 				let iterator = db.getRange({})[Symbol.iterator]();
@@ -1528,6 +1745,343 @@ describe('lmdb-js', function () {
 			serializedKeys.should.deep.equal(keys);
 		});
 	});
+	describe('prefix search', function () {
+		it('finds keys in pages where the keys share a long prefix', async function () {
+			let db = open(testDirPath + '/prefix-search.mdb', {});
+			let prefix = 'tenant/0001/collection/items/';
+			let keys = [];
+			for (let i = 0; i < 2000; i++) {
+				// keys that differ within the 8 bytes after the prefix, and keys that only differ after them
+				keys.push(prefix + i.toString().padStart(6, '0'));
+				keys.push(prefix + '99999999' + i.toString().padStart(6, '0'));
+			}
+			for (let key of keys)
+				db.put(key, key.length);
+			await db.committed;
+			for (let key of keys) {
+				db.get(key).should.equal(key.length);
+				should.equal(db.get(key + '-'), undefined);
+			}
+			should.equal(db.get(prefix), undefined);
+			should.equal(db.get('tenant/0001/'), undefined); // shorter than the prefix of the page
+			should.equal(db.get(prefix + '000100x'), undefined);
+			// ranges start at the first key that is greater or equal, including between keys that tie on 8 bytes
+			let sorted = keys.slice().sort();
+			db.getKeys({ start: prefix + '0001005', limit: 2 }).asArray.should.deep.equal(
+				[prefix + '000101', prefix + '000102']);
+			db.getKeys({ start: prefix + '99999999000100-', limit: 1 }).asArray.should.deep.equal(
+				[prefix + '99999999000101']);
+			db.getKeys({ start: 'tenant/0001/', limit: 1 }).asArray.should.deep.equal([sorted[0]]);
+			db.getKeys({ start: prefix }).asArray.should.deep.equal(sorted);
+			await db.close();
+		});
+	});
+	describe('commit notifications', function () {
+		it('wakes waiters with the databases that were written', async function () {
+			let db = open(testDirPath + '/commit-notifications.mdb', {
+				commitNotifications: true,
+			});
+			let other = db.openDB('other');
+			// more waiters than there are threads in the libuv pool, which writes still need
+			let waiting = [];
+			for (let i = 0; i < 8; i++) waiting.push(db.waitForCommit());
+			await db.put('key', 'value');
+			for (let { touched, commits } of await Promise.all(waiting)) {
+				touched.should.equal(true);
+				commits.some((commit) => commit.dbi === db.db.dbi).should.equal(true);
+			}
+			let waitingOnOther = other.waitForCommit(undefined, 1000);
+			await db.put('key', 'changed');
+			let { txnId, touched, complete } = await waitingOnOther;
+			txnId.should.be.gt(0);
+			complete.should.equal(true);
+			touched.should.equal(false);
+			let pending = db.waitForCommit();
+			await db.close();
+			let error;
+			try {
+				await pending;
+			} catch (e) {
+				error = e;
+			}
+			error.message.should.contain('closed');
+		});
+	});
+	describe('read txn pool', function () {
+		it('shares a read txn between readers that begin at the same snapshot', async function () {
+			let path = testDirPath + '/read-txn-pool.mdb';
+			let db = open(path, {});
+			let db2 = open(path, {}); // the same environment, with its own read txns
+			await db.put('key', 1);
+			let transaction = db.useReadTransaction();
+			let transaction2 = db2.useReadTransaction();
+			db.get('key', { transaction }).should.equal(1);
+			db2.get('key', { transaction: transaction2 }).should.equal(1);
+			let { sharedReadTxns, pooledReadTxns } = db.getStats();
+			sharedReadTxns.should.be.gte(1);
+			// both readers keep the snapshot they share after a newer txn is committed
+			await db.put('key', 2);
+			db.get('key', { transaction }).should.equal(1);
+			db2.get('key', { transaction: transaction2 }).should.equal(1);
+			transaction.done();
+			db2.get('key', { transaction: transaction2 }).should.equal(1);
+			transaction2.done();
+			db.get('key').should.equal(2);
+			db.getStats().pooledReadTxns.should.be.lte(pooledReadTxns + 1);
+			await db2.close();
+			await db.close();
+		});
+	});
+	describe('shared value cache', function () {
+		it('shares decompressed values', async function () {
+			let db = open(testDirPath + '/value-cache.mdb', {
+				compression: { threshold: 100 },
+				sharedValueCache: true,
+			});
+			let value = 'compressible value '.repeat(100);
+			await db.put('key', value);
+			db.get('key').should.equal(value);
+			let hits = db.getStats().valueCacheHits;
+			db.get('key').should.equal(value);
+			db.getStats().valueCacheHits.should.be.greaterThan(hits);
+			// a new version of the value is on a new page, so the cached value is not used
+			await db.put('key', value + 'changed');
+			db.get('key').should.equal(value + 'changed');
+			db.transactionSync(() => {
+				db.putSync('key', value + 'in txn');
+				db.get('key').should.equal(value + 'in txn');
+			});
+			db.get('key').should.equal(value + 'in txn');
+			await db.close();
+		});
+		it('caches decompressed values', async function () {
+			let db = open(testDirPath + '/decompression-cache.mdb', {
+				compression: { threshold: 100, cacheSize: 100000 },
+			});
+			let value = 'compressible value '.repeat(100);
+			await db.put('key', value);
+			db.get('key').should.equal(value);
+			let { hits } = db.getStats().decompressionCache;
+			db.get('key').should.equal(value);
+			for (let { value: rangeValue } of db.getRange())
+				rangeValue.should.equal(value);
+			db.getStats().decompressionCache.hits.should.equal(hits + 2);
+			await db.put('key', value + 'changed');
+			db.get('key').should.equal(value + 'changed');
+			db.transactionSync(() => {
+				db.putSync('key', value + 'in txn');
+				db.get('key').should.equal(value + 'in txn');
+			});
+			db.get('key').should.equal(value + 'in txn');
+			await db.close();
+		});
+	});
+	describe('key filter', function () {
+		it('excludes keys that do not exist', async function () {
+			let path = testDirPath + '/key-filter.mdb';
+			let db = open(path, { keyFilter: true });
+			for (let i = 0; i < 100; i++)
+				db.put('key' + i, i);
+			await db.committed;
+			for (let i = 0; i < 100; i++) {
+				db.get('key' + i).should.equal(i);
+				should.equal(db.get('missing' + i), undefined);
+			}
+			db.getStats().keyFilter.excluded.should.be.greaterThan(90);
+			db.transactionSync(() => {
+				db.putSync('in-txn', 1);
+				db.get('in-txn').should.equal(1);
+			});
+			db.get('in-txn').should.equal(1);
+			await db.close();
+			// the filter is saved on close, and loaded when it is reopened
+			db = open(path, { keyFilter: true });
+			db.get('key1').should.equal(1);
+			db.get('in-txn').should.equal(1);
+			should.equal(db.get('missing'), undefined);
+			db.getStats().keyFilter.stale.should.equal(false);
+			await db.close();
+		});
+	});
+	describe('checksums', function () {
+		it('verifies page checksums', async function () {
+			let path = testDirPath + '/checksums.mdb';
+			let db = open(path, { checksum: true });
+			for (let i = 0; i < 1000; i++)
+				db.put('key' + i, 'value' + i);
+			db.put('large', 'x'.repeat(20000));
+			await db.committed;
+			await db.close();
+			db = open(path, { checksum: true, trackMetrics: true });
+			for (let i = 0; i < 1000; i++)
+				db.get('key' + i).should.equal('value' + i);
+			db.get('large').length.should.equal(20000);
+			let stats = db.getStats();
+			stats.checksumsVerified.should.be.greaterThan(0);
+			stats.checksumFailures.should.equal(0);
+			await db.close();
+			// a database with checksums can't be opened without them
+			should.throw(() => open(path, {}));
+		});
+	});
+	describe('warm', function () {
+		it('reads the trees of the databases in the background', async function () {
+			let path = testDirPath + '/warm.mdb';
+			let db = open(path, {});
+			let hot = db.openDB('hot');
+			let cold = db.openDB('cold');
+			for (let i = 0; i < 5000; i++) {
+				hot.put('key' + i, 'value' + i);
+				cold.put('key' + i, 'value' + i);
+			}
+			await db.committed;
+			await db.close();
+			let progressed;
+			db = open(path, { warm: { hotDbs: ['hot'], onProgress(pages) { progressed = pages; } } });
+			let all = await db.warmed;
+			hot = db.openDB('hot');
+			all.pages.should.be.greaterThan(hot.getStats().treeLeafPageCount);
+			all.bytes.should.equal(all.pages * db.getStats().pageSize);
+			all.cancelled.should.equal(false);
+			await new Promise((resolve) => setTimeout(resolve, 10)); // progress is delivered asynchronously
+			progressed.should.equal(all.pages);
+			let branches = await db.warm({ levels: 1 });
+			branches.pages.should.be.lessThan(all.pages);
+			// one page every second, so this is cancelled long before it finishes
+			let cancelled = db.warm({ hotDbs: true, bytesPerSecond: db.getStats().pageSize });
+			db.cancelWarm();
+			// warming that is started later is not cancelled, and doesn't undo the cancellation
+			let later = db.warm({ levels: 1 });
+			(await cancelled).cancelled.should.equal(true);
+			(await later).cancelled.should.equal(false);
+			await db.close();
+		});
+	});
+	describe('columns', function () {
+		it('reads the selected fields of records into columns', async function () {
+			let db = open(testDirPath + '/columns.mdb', { sharedStructuresKey: Symbol.for('structures') });
+			for (let i = 0; i < 3000; i++)
+				db.put(i, { name: 'item' + i, price: i / 2, quantity: i % 5, tags: ['a', { nested: i }], inStock: i % 2 == 0 });
+			db.put(3000, 'not a record');
+			db.put(3001, { price: 'free', quantity: null });
+			await db.committed;
+			let batches = db.getRange({ start: 0, end: 3000, columns: ['price', 'quantity', 'name', 'inStock', 'missing'] }).asArray;
+			batches.map((batch) => batch.count).should.deep.equal([1024, 1024, 952]);
+			let { keys, columns } = batches[1];
+			keys[0].should.equal(1024);
+			columns.price.should.be.instanceOf(Float64Array);
+			columns.price[10].should.equal(517);
+			columns.quantity[10].should.equal(4);
+			columns.name[10].should.equal('item1034');
+			columns.inStock[10].should.equal(true);
+			should.equal(columns.missing[10], undefined);
+			let limited = db.getRange({ start: 10, columns: ['quantity'], batchSize: 100, limit: 250 }).asArray;
+			limited.map((batch) => batch.count).should.deep.equal([100, 100, 50]);
+			let many = await db.getMany([3, 3000, 3001, 4000], { columns: ['price', 'tags', 'quantity'] });
+			many.count.should.equal(4);
+			many.columns.price.should.deep.equal([1.5, undefined, 'free', undefined]);
+			many.columns.tags[0].should.deep.equal(['a', { nested: 3 }]);
+			should.equal(many.columns.quantity[2], null);
+			// without an end, a last batch that is exactly full ends the iteration (2000 to 3001 is two batches)
+			db.getRange({ start: 2000, columns: ['quantity'], batchSize: 501 }).asArray
+				.map((batch) => batch.count).should.deep.equal([501, 501]);
+			let json = db.openDB('json', { encoding: 'json' });
+			await json.put(1, { price: 1 });
+			let error;
+			try {
+				await json.getMany([1], { columns: ['price'] });
+			} catch (e) {
+				error = e;
+			}
+			error.message.should.contain('msgpack');
+			await db.close();
+		});
+	});
+	describe('access profile', function () {
+		it('saves the pages that were read and reads them ahead when reopened', async function () {
+			let path = testDirPath + '/access-profile.mdb';
+			let db = open(path, { accessProfile: { sampleInterval: 1 } });
+			let bigValue = 'x'.repeat(20000);
+			for (let i = 0; i < 1000; i++) db.put('key' + i, i % 100 == 0 ? bigValue : 'value' + i);
+			await db.committed;
+			for (let i = 0; i < 1000; i++) db.get('key' + i);
+			db.getStats().accessProfileSamples.should.be.greaterThan(999); // and any reads of the shared structures
+			await db.close();
+			db = open(path, { accessProfile: true });
+			let stats = db.getStats();
+			stats.accessProfileReplayedPages.should.be.greaterThan(stats.treeLeafPageCount);
+			db.get('key1').should.equal('value1');
+			await db.close();
+		});
+	});
+	describe('export range', function () {
+		it('exports keys and fixed-offset fields into typed arrays', async function () {
+			let db = open(testDirPath + '/export-range.mdb', { keyEncoding: 'uint32', encoding: 'binary' });
+			for (let i = 0; i < 20000; i++) {
+				let value = Buffer.alloc(i % 1000 == 0 ? 8 : 12);
+				value.writeDoubleLE(i / 2, 0);
+				if (value.length > 8) value.writeUInt32BE(i, 8);
+				db.put(i, value);
+			}
+			await db.committed;
+			let keys = new Uint32Array(20000), prices = new Float64Array(20000), quantities = new Int32Array(20000);
+			let { count, more } = await db.exportRange(100, 15000, { keys, threads: 4, columns: {
+				price: { array: prices, offset: 0 },
+				quantity: { array: quantities, offset: 8, bigEndian: true },
+			} });
+			count.should.equal(14900);
+			more.should.equal(false);
+			keys[0].should.equal(100);
+			keys[14899].should.equal(14999);
+			prices[1234].should.equal(667);
+			quantities[1234].should.equal(1334);
+			quantities[900].should.equal(0); // the value for 1000 is too short
+			let small = new Float64Array(50);
+			({ count, more } = await db.exportRange(undefined, undefined, { columns: { price: { array: small, offset: 0 } } }));
+			count.should.equal(50);
+			more.should.equal(true);
+			small[49].should.equal(24.5);
+			await db.close();
+		});
+		it('decodes other keys', async function () {
+			let db = open(testDirPath + '/export-range-keys.mdb', { encoding: 'binary' });
+			for (let i = 0; i < 1000; i++)
+				db.put(i * 1.5, Buffer.from([i & 0xff]));
+			await db.committed;
+			let keys = new Float64Array(1000), bytes = new Uint8Array(1000);
+			let { count } = await db.exportRange(3, undefined, { keys, columns: { byte: { array: bytes, offset: 0 } } });
+			count.should.equal(998);
+			keys[0].should.equal(3);
+			keys[997].should.equal(1498.5);
+			bytes[300].should.equal(302 & 0xff);
+			await db.close();
+		});
+	});
+	describe('remap cache', function () {
+		it('evicts chunks beyond the cache size', async function () {
+			let path = testDirPath + '/remap-cache.mdb';
+			let options = { encryptionKey: 'Use this key to encrypt the data' };
+			let db = open(path, options);
+			let value = 'x'.repeat(1000);
+			for (let i = 0; i < 3000; i++)
+				db.put('key' + i, value + i);
+			await db.committed;
+			await db.close();
+			db = open(path, Object.assign({ remapCacheChunks: 16 }, options));
+			for (let round = 0; round < 2; round++) {
+				for (let i = 0; i < 3000; i++)
+					db.get('key' + i).should.equal(value + i);
+				await new Promise((resolve) => setTimeout(resolve, 1)); // let the read txn reset
+			}
+			let stats = db.getStats();
+			stats.remapCacheMisses.should.be.greaterThan(0);
+			stats.remapCacheHits.should.be.greaterThan(0);
+			stats.remapCacheEvictions.should.be.greaterThan(0);
+			stats.remapCacheDecrypts.should.be.greaterThan(0);
+			stats.remapCacheMappedBytes.should.be.greaterThan(0);
+			await db.close();
+		});
+	});
 	describe('uint32 keys', function () {
 		this.timeout(10000);
 		let db, db2;
@@ -1558,6 +2112,59 @@ describe('lmdb-js', function () {
 				i++;
 			}
 		});
+		it('write and read with integer keys', async function () {
+			await db.put(0xffffffff, 'max');
+			await db.put(0x80000001, 'large');
+			db.putSync(7, 'seven');
+			db.get(0xffffffff).should.equal('max');
+			db.get(0x80000001).should.equal('large');
+			db.get(7).should.equal('seven');
+			should.equal(db.get(12345678), undefined);
+			await db.remove(0xffffffff);
+			should.equal(db.get(0xffffffff), undefined);
+		});
+		it('bulk load', async function () {
+			let entries = [];
+			for (let i = 0; i < 100; i++) entries.push({ key: (i * 37) % 100 + 100, value: 'bulk' + i });
+			await db.bulkLoad(entries);
+			let i = 100;
+			for (let { key, value } of db.getRange({ start: 100 })) {
+				key.should.equal(i);
+				value.should.equal('bulk' + entries.findIndex((entry) => entry.key == i));
+				i++;
+			}
+			i.should.equal(200);
+		});
+		after(function () {
+			db.close();
+		});
+	});
+	describe('change log', function () {
+		this.timeout(10000);
+		let db, store;
+		before(function () {
+			db = open(testDirPath + '/test-changes.mdb', { changeLog: { values: true } });
+			store = db.openDB('changes-test', { useVersions: true });
+		});
+		it('tail committed changes', async function () {
+			let start = db.getStats().lastTxnId + 1;
+			await store.put('a', { name: 'one' }, 3);
+			await store.remove('a');
+			await db.put('b', 'two');
+			let changes = Array.from(db.getChanges(start));
+			changes.length.should.equal(3);
+			changes[0].operation.should.equal('put');
+			changes[0].key.should.equal('a');
+			changes[0].value.name.should.equal('one');
+			changes[0].version.should.equal(3);
+			changes[0].db.should.equal(store);
+			changes[1].operation.should.equal('delete');
+			changes[2].key.should.equal('b');
+			changes[2].txnId.should.be.gt(changes[0].txnId);
+			Array.from(db.getChanges(changes[2].txnId)).length.should.equal(1);
+			await db.pruneChanges(changes[2].txnId);
+			Array.from(db.getChanges(0)).length.should.equal(1);
+		});
 		after(function () {
 			db.close();
 		});
@@ -1,4 +1,4 @@
-import { getAddress, getBufferAddress, write, compress, lmdbError } from './native.js';
+import { getAddress, getBufferAddress, write, compress, lmdbError, BulkLoader, getMergeOperators } from './native.js';
 import { when } from './util/when.js';
 var backpressureArray;
 
@@ -15,12 +15,21 @@ const NO_RESOLVE = 16;
 const HAS_TXN = 8;
 const CONDITIONAL_VERSION_LESS_THAN = 0x800;
 const CONDITIONAL_ALLOW_NOTFOUND = 0x800;
+const NO_RESULTS_BATCH = 0x800001; // not CONDITIONAL, so the write thread always decodes (and can skip) all of it
+const VALUE_OPERATION = 0x200000;
+const UINT32_KEY = 0x400000;
+const ADD_VALUE = 1;
+const COMPARE_AND_SWAP = 2;
+const APPEND_VALUE = 3;
+const MERGE_VALUE = 4;
+const EXPECT_NOT_EXISTS = 0xffffffff;
 
 const SYNC_PROMISE_SUCCESS = Promise.resolve(true);
 const SYNC_PROMISE_FAIL = Promise.resolve(false);
 SYNC_PROMISE_SUCCESS.isSync = true;
 SYNC_PROMISE_FAIL.isSync = true;
 const PROMISE_SUCCESS = Promise.resolve(true);
+const NO_RESULT = () => {};
 export const ABORT = 4.452694326329068e-106; // random/unguessable numbers, which work across module/versions and native
 export const IF_EXISTS = 3.542694326329068e-103;
 const CALLBACK_THREW = {};
@@ -29,7 +38,21 @@ const ByteArray = typeof Buffer != 'undefined' ? function(buffer) { return Buffe
 const queueTask = typeof setImmediate != 'undefined' ? setImmediate : setTimeout; // TODO: Or queueMicrotask?
 //let debugLog = []
 const WRITE_BUFFER_SIZE = 0x10000;
+const BULK_LOAD_RUN_SIZE = 0x1000000;
+const BULK_LOAD_ENTRIES_PER_TXN = 100000;
 var log = [];
+var mergeOperatorIds;
+function getMergeOperatorId(name) {
+	let id = mergeOperatorIds && mergeOperatorIds[name];
+	if (!id) {
+		// operators may have been registered since we last retrieved them
+		mergeOperatorIds = getMergeOperators();
+		id = mergeOperatorIds[name];
+		if (!id)
+			throw new Error('Unknown merge operator ' + name);
+	}
+	return id;
+}
 export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, useWritemap, maxKeySize,
 	eventTurnBatching, txnStartThreshold, batchStartThreshold, overlappingSync, commitDelay, separateFlushed, maxFlushDelay }) {
 	//  stands for write instructions
@@ -54,6 +77,23 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 		return dynamicBytes;
 	}
 	var newBufferThreshold = (WRITE_BUFFER_SIZE - maxKeySize - 64) >> 3; // need to reserve more room if we do inline values
+	var noResultsBytes; // the target for instructions in a batch without results
+	function allocateBatchBuffer(lastBytes) {
+		// buffers for batches are not visible to the write thread until the batch is submitted, so they don't need to be shared
+		let bytes = new ByteArray(new ArrayBuffer(WRITE_BUFFER_SIZE));
+		bytes.uint32 = new Uint32Array(bytes.buffer, 0, WRITE_BUFFER_SIZE >> 2);
+		bytes.float64 = new Float64Array(bytes.buffer, 0, WRITE_BUFFER_SIZE >> 3);
+		bytes.uint32.address = getBufferAddress(bytes);
+		bytes.position = 0;
+		if (lastBytes) {
+			lastBytes.uint32[lastBytes.position << 1] = 3; // pointer instruction
+			lastBytes.float64[lastBytes.position + 1] = bytes.uint32.address;
+			bytes.retained = lastBytes.retained;
+			bytes.count = lastBytes.count;
+			bytes.retained.push(bytes);
+		}
+		return bytes;
+	}
 	var outstandingWriteCount = 0;
 	var startAddress = 0;
 	var writeTxn = null;
@@ -119,6 +159,9 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 		if (writeTxn) {
 			targetBytes = fixedBuffer;
 			position = 0;
+		} else if (noResultsBytes) {
+			targetBytes = noResultsBytes;
+			position = targetBytes.position;
 		} else {
 			if (eventTurnBatching && !enqueuedEventTurnBatch && batchDepth == 0) {
 				enqueuedEventTurnBatch = queueTask(() => {
@@ -157,25 +200,32 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 		}
 		uint32[flagPosition + 1] = store.db.dbi;
 		if (flags & 4) {
-			let keyStartPosition = (position << 3) + 12;
-			let endPosition;
-			try {
-				endPosition = store.writeKey(key, targetBytes, keyStartPosition);
-				if (!(keyStartPosition < endPosition) && (flags & 0xf) != 12)
-					throw new Error('Invalid key or zero length key is not allowed in LMDB ' + key)
-			} catch(error) {
-				targetBytes.fill(0, keyStartPosition);
-				if (error.name == 'RangeError')
-					error = new Error('Key size is larger than the maximum key size (' + maxKeySize + ')');
-				throw error;
-			}
-			let keySize = endPosition - keyStartPosition;
-			if (keySize > maxKeySize) {
-				targetBytes.fill(0, keyStartPosition); // restore zeros
-				throw new Error('Key size is larger than the maximum key size (' + maxKeySize + ')');
+			if (store.keyIsUint32 && key >>> 0 === key) {
+				// uint32 keys are written inline, in place of the key size
+				flags |= UINT32_KEY;
+				uint32[flagPosition + 2] = key;
+				position += 2;
+			} else {
+				let keyStartPosition = (position << 3) + 12;
+				let endPosition;
+				try {
+					endPosition = store.writeKey(key, targetBytes, keyStartPosition);
+					if (!(keyStartPosition < endPosition) && (flags & 0xf) != 12)
+						throw new Error('Invalid key or zero length key is not allowed in LMDB ' + key)
+				} catch(error) {
+					targetBytes.fill(0, keyStartPosition);
+					if (error.name == 'RangeError')
+						error = new Error('Key size is larger than the maximum key size (' + maxKeySize + ')');
+					throw error;
+				}
+				let keySize = endPosition - keyStartPosition;
+				if (keySize > maxKeySize) {
+					targetBytes.fill(0, keyStartPosition); // restore zeros
+					throw new Error('Key size is larger than the maximum key size (' + maxKeySize + ')');
+				}
+				uint32[flagPosition + 2] = keySize;
+				position = (endPosition + 16) >> 3;
 			}
-			uint32[flagPosition + 2] = keySize;
-			position = (endPosition + 16) >> 3;
 			if (flags & 2) {
 				let mustCompress;
 				if (valueBufferStart > -1) { // if we have buffers with start/end position
@@ -196,10 +246,10 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 					mustCompress = valueBuffer[0] >= 250; // this is the compression indicator, so we must compress
 				}
 				uint32[(position++ << 1) - 1] = valueSize;
-				if (store.compression && (valueSize >= store.compression.threshold || mustCompress)) {
+				if (store.compression && (valueSize >= store.compression.threshold || mustCompress) && !(flags & VALUE_OPERATION)) {
 					flags |= 0x100000;
 					float64[position] = store.compression.address;
-					if (!writeTxn)
+					if (!writeTxn && !noResultsBytes) // batches without results are compressed by the write thread
 						compress(env.address, uint32.address + (position << 3), () => {
 							// this is never actually called in NodeJS, just use to pin the buffer in memory until it is finished
 							// and is a no-op in Deno
@@ -221,14 +271,31 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 				flags |= 0x200;
 				float64[position++] = version || 0;
 			}
-		} else
+		} else {
 			position++;
+			if (flags == NO_RESULTS_BATCH) {
+				// record the addresses of the batch instructions and the batch status
+				float64[position++] = key;
+				float64[position++] = value;
+			}
+		}
 		targetBytes.position = position;
 		if (writeTxn) {
 			uint32[0] = flags;
 			write(env.address, uint32.address);
 			return () => (uint32[0] & FAILED_CONDITION) ? SYNC_PROMISE_FAIL : SYNC_PROMISE_SUCCESS;
 		}
+		if (noResultsBytes) {
+			// no resolution is tracked for each write in a batch without results, the value buffers just need to be
+			// retained until the batch is finished
+			uint32[flagPosition] = flags;
+			targetBytes.count++;
+			if (valueBuffer && valueBuffer.buffer !== targetBytes.lastValueBuffer)
+				targetBytes.retained.push(targetBytes.lastValueBuffer = valueBuffer.buffer);
+			if (position > newBufferThreshold)
+				noResultsBytes = allocateBatchBuffer(targetBytes);
+			return NO_RESULT;
+		}
 		// if we ever use buffers that haven't been zero'ed, need to clear out the next slot like this:
 		// uint32[position << 1] = 0 // clear out the next slot
 		let nextUint32;
@@ -582,6 +649,45 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 			nextResolution.uint32 = dynamicBytes.uint32;
 		}
 	}
+	function encodeValue(store, value) {
+		// encode a value to a buffer that is not reused
+		let valueBuffer;
+		if (value && value['\x10binary-data\x02'])
+			valueBuffer = value['\x10binary-data\x02'];
+		else if (store.encoder) {
+			valueBuffer = store.encoder.encode(value);
+			if (typeof valueBuffer == 'string')
+				valueBuffer = Buffer.from(valueBuffer);
+		} else if (typeof value == 'string')
+			valueBuffer = Buffer.from(value);
+		else if (value instanceof Uint8Array)
+			valueBuffer = value;
+		else
+			throw new Error('Invalid value to put in database ' + value + ' (' + (typeof value) +'), consider using encoder');
+		return valueBuffer;
+	}
+	function writeValueOperation(store, key, operation, argument, operandSize, version) {
+		// a put with a value operation, where the new value is computed from the existing value in the write thread
+		let operationBytes = Buffer.alloc(16 + operandSize);
+		operationBytes.dataView = new DataView(operationBytes.buffer, operationBytes.byteOffset, operationBytes.length);
+		operationBytes[0] = operation;
+		operationBytes.dataView.setUint32(4, argument, true);
+		operationBytes.dataView.setFloat64(8, store.compression ? store.compression.address : 0, true);
+		return (writeOperand) => {
+			writeOperand(operationBytes);
+			let finishWrite = writeInstructions(15 | VALUE_OPERATION, store, key, asBinary(operationBytes),
+				store.useVersions ? version || 0 : undefined);
+			if (writeTxn || noResultsBytes)
+				return finishWrite();
+			// resolve to whether the operation succeeded
+			return new Promise((resolve, reject) => finishWrite((error, result) => {
+				if (error)
+					reject(error);
+				else
+					resolve(result);
+			}));
+		};
+	}
 	function clearWriteTxn(parentTxn) {
 		// TODO: We might actually want to track cursors in a write txn and manually
 		// close them.
@@ -642,6 +748,8 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 					return promise;
 				});
 			}
+			if (noResultsBytes) // the batch has no results for a block to be resolved with
+				throw new Error('Can not use ifVersion or batch blocks within a batch without results');
 			if (writeTxn) {
 				if (version === undefined || this.doesExist(key, version)) {
 					callback();
@@ -690,6 +798,79 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 		batch(callbackOrOperations) {
 			return this.ifVersion(undefined, undefined, callbackOrOperations);
 		},
+		addToValue(key, delta, version) {
+			if (this.encoding && this.encoding != 'msgpack')
+				throw new Error('addToValue is only supported with msgpack encoding');
+			return writeValueOperation(this, key, ADD_VALUE, 0, 8, version)((operationBytes) => {
+				operationBytes.dataView.setFloat64(16, delta, true);
+			});
+		},
+		compareAndSwap(key, expectedValue, value, version) {
+			let expectedBuffer = expectedValue === undefined ? null : encodeValue(this, expectedValue);
+			let expectedSize = expectedBuffer ? expectedBuffer.length : 0;
+			let valueBuffer = encodeValue(this, value);
+			return writeValueOperation(this, key, COMPARE_AND_SWAP, expectedBuffer ? expectedSize : EXPECT_NOT_EXISTS,
+					expectedSize + valueBuffer.length, version)((operationBytes) => {
+				if (expectedBuffer)
+					operationBytes.set(expectedBuffer, 16);
+				operationBytes.set(valueBuffer, 16 + expectedSize);
+			});
+		},
+		appendToValue(key, value, version) {
+			let valueBuffer = encodeValue(this, value);
+			return writeValueOperation(this, key, APPEND_VALUE, 0, valueBuffer.length, version)((operationBytes) => {
+				operationBytes.set(valueBuffer, 16);
+			});
+		},
+		merge(key, operator, operand, options) {
+			if (this.encoding && this.encoding != 'msgpack')
+				throw new Error('merge is only supported with msgpack encoding');
+			let operatorId = getMergeOperatorId(operator);
+			let operandBuffer = encodeValue(this, operand);
+			return writeValueOperation(this, key, MERGE_VALUE, options?.maxLength || 0, operandBuffer.length, options?.version)((operationBytes) => {
+				operationBytes[1] = operatorId;
+				operationBytes.set(operandBuffer, 16);
+			});
+		},
+		batchWithoutResults(callback) {
+			if (writeTxn)
+				throw new Error('Can not start a batch without results in a write transaction');
+			if (noResultsBytes)
+				throw new Error('Can not nest batches without results');
+			let firstBytes = noResultsBytes = allocateBatchBuffer();
+			firstBytes.retained = [firstBytes];
+			firstBytes.count = 0;
+			try {
+				callback();
+			} finally {
+				var lastBytes = noResultsBytes;
+				noResultsBytes = null;
+			}
+			lastBytes.uint32[lastBytes.position << 1] = 0; // end of the batch
+			// each write (but not the pointers between buffers) is an operation with a bit in the status, in the order that
+			// the write thread does them
+			let count = lastBytes.count;
+			// the status holds the txn id (a double), the number of failed operations, the number of operations, and then
+			// a bitmap of the failed operations
+			let statusBuffer = new ArrayBuffer(((count + 31) >> 5 << 2) + 16);
+			let status = new Uint32Array(statusBuffer);
+			status[3] = count;
+			let statusAddress = getBufferAddress(new Uint8Array(statusBuffer));
+			let retained = firstBytes.retained;
+			return new Promise((resolve, reject) => {
+				writeInstructions(NO_RESULTS_BATCH, this, firstBytes.uint32.address, statusAddress)((error) => {
+					retained = null; // keep the instructions and values pinned in memory until the batch is finished
+					if (error)
+						reject(error);
+					else
+						resolve({
+							txnId: new Float64Array(statusBuffer, 0, 1)[0],
+							failedCount: status[2],
+							failed: status.subarray(4),
+						});
+				});
+			});
+		},
 		drop(callback) {
 			return writeInstructions(1024 + 12, this, Buffer.from([]), undefined, undefined, undefined)(callback);
 		},
@@ -702,6 +883,74 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 			}
 			return writeInstructions(12, this, Buffer.from([]), undefined, undefined, undefined)(callback);
 		},
+		async bulkLoad(entries, options) {
+			// entries are written into large buffers that are each sorted as a run in the thread pool, and then the runs
+			// are merged and appended to the database
+			options = options || {};
+			let runSize = options.runSize || BULK_LOAD_RUN_SIZE;
+			let concurrency = options.concurrency || 4;
+			let loader = new BulkLoader(this.db, options);
+			let sortingRuns = [];
+			let chunk, position = 0, count = 0;
+			const sortRun = () => {
+				let run = chunk, size = position;
+				sortingRuns.push(new Promise((resolve, reject) => {
+					loader.add(run, size, (error) => {
+						run = null; // the buffer is kept pinned in memory until the run is sorted
+						if (error)
+							reject(error);
+						else
+							resolve();
+					});
+				}));
+				chunk = null;
+			};
+			try {
+				for await (let { key, value, version } of entries) {
+					let valueBuffer = encodeValue(this, value);
+					let entrySize = 16 + maxKeySize + valueBuffer.length;
+					if (!chunk || position + entrySize > chunk.length) {
+						if (chunk) {
+							sortRun();
+							if (sortingRuns.length >= concurrency)
+								await Promise.all(sortingRuns.splice(0, sortingRuns.length - concurrency + 1));
+						}
+						chunk = Buffer.alloc(Math.max(runSize, entrySize + 8));
+						chunk.dataView = new DataView(chunk.buffer, chunk.byteOffset, chunk.length);
+						position = 0;
+					}
+					let keyEnd;
+					try {
+						keyEnd = this.writeKey(key, chunk, position + 16);
+					} catch(error) {
+						if (error.name == 'RangeError')
+							error = new Error('Key size is larger than the maximum key size (' + maxKeySize + ')');
+						throw error;
+					}
+					let keySize = keyEnd - position - 16;
+					if (!(keySize > 0))
+						throw new Error('Invalid key or zero length key is not allowed in LMDB ' + key);
+					if (keySize > maxKeySize)
+						throw new Error('Key size is larger than the maximum key size (' + maxKeySize + ')');
+					chunk.dataView.setUint32(position, keySize, true);
+					chunk.dataView.setUint32(position + 4, valueBuffer.length, true);
+					if (this.useVersions)
+						chunk.dataView.setFloat64(position + 8, version || 0, true);
+					chunk.set(valueBuffer, keyEnd);
+					position = (keyEnd + valueBuffer.length + 7) & ~7;
+					count++;
+				}
+				if (chunk && position > 0)
+					sortRun();
+				await Promise.all(sortingRuns);
+				let entriesPerTransaction = options.entriesPerTransaction || BULK_LOAD_ENTRIES_PER_TXN;
+				while (await this.transaction(() => loader.load(entriesPerTransaction)) > 0) {}
+			} finally {
+				await Promise.allSettled(sortingRuns);
+				loader.close();
+			}
+			return count;
+		},
 		_triggerError() {
 			finishBatch();
 		},